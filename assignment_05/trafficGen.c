@@ -0,0 +1,309 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+/**
+ * Paced traffic generator for benchmarking our own servers (in place of
+ * iperf / D-ITG). Traffic leaves from this host's real address through
+ * ordinary UDP or TCP sockets.
+ *
+ * Departure times come from the arrival process (constant, Poisson or
+ * on-off). The sender sleeps with clock_nanosleep(TIMER_ABSTIME) until the
+ * next departure (spinning for very short gaps), then hands every packet
+ * that is due to the kernel in one sendmmsg() call, so hundreds of thousands
+ * of packets per second stay on schedule.
+ *
+ * Build: gcc -O2 trafficGen.c -o trafficGen -lm
+ */
+
+#define MAX_BATCH 256
+#define MAX_PAYLOAD 65507
+#define SPIN_NS 50000          // gaps shorter than this are busy-waited
+
+enum arrival { ARRIVAL_CONST, ARRIVAL_POISSON, ARRIVAL_ONOFF };
+enum size_dist { SIZE_FIXED, SIZE_UNIFORM, SIZE_BIMODAL, SIZE_IMIX };
+enum payload_kind { PAYLOAD_RANDOM, PAYLOAD_FRUIT, PAYLOAD_CALC };
+
+typedef struct {
+    enum arrival arrival;
+    double rate;               // packets per second (during ON periods for on-off)
+    double on_ms, off_ms;
+    enum size_dist dist;
+    int size_a, size_b;
+    double size_p;             // bimodal: probability of size_a
+    enum payload_kind payload;
+    double duration;
+    int batch;
+    int tcp;
+} config_t;
+
+uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+// xorshift64* generator: fast and good enough for traffic shaping
+uint64_t rng_next(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 0x2545f4914f6cdd1dULL;
+}
+
+double rng_uniform(void) {
+    return (rng_next() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void sleep_until(int64_t t) {
+    int64_t gap = t - now_ns();
+    if (gap <= 0) return;
+    if (gap > SPIN_NS) {
+        struct timespec ts = {.tv_sec = (t - SPIN_NS / 2) / 1000000000LL, .tv_nsec = (t - SPIN_NS / 2) % 1000000000LL};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (now_ns() < t);
+}
+
+/* Next departure time after `t`, in ns relative to the start of the run. */
+int64_t next_departure(const config_t *cfg, int64_t t) {
+    double gap_ns = 1e9 / cfg->rate;
+
+    switch (cfg->arrival) {
+    case ARRIVAL_POISSON:
+        return t + (int64_t)(-log(1.0 - rng_uniform()) * gap_ns);
+    case ARRIVAL_ONOFF: {
+        int64_t period = (int64_t)((cfg->on_ms + cfg->off_ms) * 1e6);
+        int64_t on = (int64_t)(cfg->on_ms * 1e6);
+        int64_t next = t + (int64_t)gap_ns;
+        if (next % period >= on) next = (next / period + 1) * period;  // skip the OFF period
+        return next;
+    }
+    default:
+        return t + (int64_t)gap_ns;
+    }
+}
+
+int next_size(const config_t *cfg) {
+    static const int imix[12] = {64, 64, 64, 64, 64, 64, 64, 576, 576, 576, 576, 1500};
+    int size;
+
+    switch (cfg->dist) {
+    case SIZE_UNIFORM: size = cfg->size_a + (int)(rng_next() % (uint64_t)(cfg->size_b - cfg->size_a + 1)); break;
+    case SIZE_BIMODAL: size = rng_uniform() < cfg->size_p ? cfg->size_a : cfg->size_b; break;
+    case SIZE_IMIX: size = imix[rng_next() % 12] - 28; break;  // IMIX is in IP bytes; 28 = IP + UDP headers
+    default: size = cfg->size_a; break;
+    }
+    return size < 1 ? 1 : size;
+}
+
+/* Fill `buf` with the next message; application payloads ignore the size distribution.
+ * A TCP stream has no message boundaries, so there requests are newline-terminated. */
+int make_payload(const config_t *cfg, char *buf, uint64_t seq) {
+    static const char *fruits[] = {"Apple", "Banana", "Mango"};
+    static const char *ops[] = {"sin", "cos", "tan", "sqrt", "log", "add", "sub", "mul", "div"};
+    const char *eol = cfg->tcp ? "\n" : "";
+
+    switch (cfg->payload) {
+    case PAYLOAD_FRUIT:
+        // Mix inventory queries with small purchases, like real fruit store clients.
+        // The TCP store (assignment 2) sends its inventory on connect and has no MENU request.
+        if (!cfg->tcp && rng_next() % 4 == 0) return sprintf(buf, "MENU");
+        return sprintf(buf, "%s %d%s", fruits[rng_next() % 3], 1 + (int)(rng_next() % 3), eol);
+    case PAYLOAD_CALC: {
+        const char *op = ops[rng_next() % 9];
+        return sprintf(buf, "%s %.3f %.3f%s", op, rng_uniform() * 100, 1 + rng_uniform() * 100, eol);
+    }
+    default: {
+        int size = next_size(cfg);
+        memcpy(buf, &seq, sizeof(seq) < (size_t)size ? sizeof(seq) : (size_t)size);
+        return size;
+    }
+    }
+}
+
+int parse_host_port(const char *spec, struct sockaddr_in *addr) {
+    char host[64];
+    const char *colon = strrchr(spec, ':');
+    if (colon == NULL || colon - spec >= (long)sizeof(host)) return -1;
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_port = htons(atoi(colon + 1));
+    return inet_pton(AF_INET, host, &addr->sin_addr) == 1 && addr->sin_port != 0 ? 0 : -1;
+}
+
+int parse_arrival(const char *s, config_t *cfg) {
+    if (strcmp(s, "const") == 0) cfg->arrival = ARRIVAL_CONST;
+    else if (strcmp(s, "poisson") == 0) cfg->arrival = ARRIVAL_POISSON;
+    else if (sscanf(s, "onoff:%lf:%lf", &cfg->on_ms, &cfg->off_ms) == 2 && cfg->on_ms > 0 && cfg->off_ms >= 0)
+        cfg->arrival = ARRIVAL_ONOFF;
+    else return -1;
+    return 0;
+}
+
+int parse_sizes(const char *s, config_t *cfg) {
+    if (strcmp(s, "imix") == 0) cfg->dist = SIZE_IMIX;
+    else if (sscanf(s, "uniform:%d:%d", &cfg->size_a, &cfg->size_b) == 2 && cfg->size_a <= cfg->size_b) cfg->dist = SIZE_UNIFORM;
+    else if (sscanf(s, "bimodal:%d:%d:%lf", &cfg->size_a, &cfg->size_b, &cfg->size_p) == 3) cfg->dist = SIZE_BIMODAL;
+    else if (sscanf(s, "%d", &cfg->size_a) == 1) cfg->dist = SIZE_FIXED;
+    else return -1;
+    if (cfg->size_a > MAX_PAYLOAD || cfg->size_b > MAX_PAYLOAD) return -1;
+    return 0;
+}
+
+void usage(const char *prog) {
+    printf("Usage: %s [options] <Server IP:port>\n", prog);
+    printf("  -T             use TCP instead of UDP: one byte stream, fruit/calc requests are\n");
+    printf("                 newline-terminated and random payloads are sent unframed\n");
+    printf("  -r pps         target packet (message) rate, default 1000\n");
+    printf("  -t seconds     duration, default 10\n");
+    printf("  -a arrival     const | poisson | onoff:ON_MS:OFF_MS (default const)\n");
+    printf("  -s sizes       N | uniform:MIN:MAX | bimodal:A:B:P(A) | imix (payload bytes, default 64)\n");
+    printf("  -p payload     random | fruit | calc (fruit/calc send assignment 3/7 requests)\n");
+    printf("  -b batch       max packets per sendmmsg() call, default 32\n");
+    printf("  -S seed        random seed\n");
+}
+
+int main(int argc, char *argv[]) {
+    config_t cfg = {.arrival = ARRIVAL_CONST, .rate = 1000, .dist = SIZE_FIXED, .size_a = 64,
+                    .payload = PAYLOAD_RANDOM, .duration = 10, .batch = 32};
+    struct sockaddr_in dest;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "Tr:t:a:s:p:b:S:")) != -1) {
+        switch (opt) {
+        case 'T': cfg.tcp = 1; break;
+        case 'r': cfg.rate = atof(optarg); break;
+        case 't': cfg.duration = atof(optarg); break;
+        case 'a':
+            if (parse_arrival(optarg, &cfg) < 0) { usage(argv[0]); return 1; }
+            break;
+        case 's':
+            if (parse_sizes(optarg, &cfg) < 0) { usage(argv[0]); return 1; }
+            break;
+        case 'p':
+            if (strcmp(optarg, "fruit") == 0) cfg.payload = PAYLOAD_FRUIT;
+            else if (strcmp(optarg, "calc") == 0) cfg.payload = PAYLOAD_CALC;
+            else cfg.payload = PAYLOAD_RANDOM;
+            break;
+        case 'b': cfg.batch = atoi(optarg); break;
+        case 'S': rng_state = strtoull(optarg, NULL, 0) | 1; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind != argc - 1 || parse_host_port(argv[optind], &dest) < 0 || cfg.rate <= 0 ||
+        cfg.duration <= 0 || cfg.batch < 1 || cfg.batch > MAX_BATCH) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int sockfd = socket(AF_INET, cfg.tcp ? SOCK_STREAM : SOCK_DGRAM, 0);
+    if (sockfd < 0) {
+        perror("socket creation failed");
+        return 1;
+    }
+    int sndbuf = 4 * 1024 * 1024, one = 1;
+    setsockopt(sockfd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+    if (cfg.tcp) setsockopt(sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    if (connect(sockfd, (struct sockaddr *)&dest, sizeof(dest)) < 0) {
+        perror("connect failed");
+        return 1;
+    }
+
+    // Preallocated batch: one buffer, iovec and mmsghdr per slot
+    static char bufs[MAX_BATCH][MAX_PAYLOAD];
+    static struct iovec iov[MAX_BATCH];
+    static struct mmsghdr msgs[MAX_BATCH];
+    static char rxbuf[MAX_PAYLOAD];
+    for (int i = 0; i < MAX_BATCH; i++) {
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+
+    printf("Sending %s to %s for %.1f s at %.0f pkt/s (%s arrivals, batch %d)\n", cfg.tcp ? "TCP" : "UDP",
+           argv[optind], cfg.duration, cfg.rate,
+           cfg.arrival == ARRIVAL_CONST ? "constant" : cfg.arrival == ARRIVAL_POISSON ? "Poisson" : "on-off", cfg.batch);
+
+    uint64_t sent = 0, bytes = 0, errors = 0, replies = 0, calls = 0;
+    double lateness_sum = 0, lateness_max = 0;
+    int64_t start = now_ns(), end = start + (int64_t)(cfg.duration * 1e9);
+    int64_t due = 0;   // next departure, relative to start
+    int closed = 0;    // TCP: the server closed the connection
+
+    while (start + due < end && !closed) {
+        sleep_until(start + due);
+        int64_t now = now_ns() - start;
+        if (start + now >= end) break;   // fell behind: don't run past the requested duration
+
+        // Gather every packet whose departure time has passed
+        int n = 0;
+        while (n < cfg.batch && due <= now && start + due < end) {
+            double late = (now - due) / 1000.0;
+            lateness_sum += late;
+            if (late > lateness_max) lateness_max = late;
+            iov[n].iov_base = bufs[n];
+            iov[n].iov_len = make_payload(&cfg, bufs[n], sent + n);
+            n++;
+            due = next_departure(&cfg, due);
+        }
+
+        int done = 0;
+        while (done < n) {
+            int r = sendmmsg(sockfd, msgs + done, n - done, MSG_NOSIGNAL);
+            calls++;
+            if (r < 0) {
+                if (errno == EINTR) continue;
+                errors += n - done;   // ENOBUFS / ECONNREFUSED: count and move on
+                if (errno == EPIPE || errno == ECONNRESET) closed = 1;
+                break;
+            }
+            for (int i = done; i < done + r; i++) {
+                bytes += msgs[i].msg_len;
+                if (msgs[i].msg_len < iov[i].iov_len) {
+                    // Short stream write: send the rest of this message before the next one
+                    iov[i].iov_base = (char *)iov[i].iov_base + msgs[i].msg_len;
+                    iov[i].iov_len -= msgs[i].msg_len;
+                    r = i - done;
+                    break;
+                }
+            }
+            done += r;
+            sent += r;
+        }
+
+        // Drain server replies so the receive queue never fills up
+        ssize_t got;
+        while ((got = recv(sockfd, rxbuf, sizeof(rxbuf), MSG_DONTWAIT)) > 0) replies++;
+        if (got == 0 && cfg.tcp) closed = 1;
+    }
+
+    if (closed) printf("Connection closed by the server after %.3f s\n", (now_ns() - start) / 1e9);
+    else sleep_until(end);   // e.g. a trailing OFF period still counts towards the run
+    double elapsed = (now_ns() - start) / 1e9;
+    double target = cfg.arrival == ARRIVAL_ONOFF ? cfg.rate * cfg.on_ms / (cfg.on_ms + cfg.off_ms) : cfg.rate;
+    uint64_t attempted = sent + errors;
+
+    printf("\nTarget rate      : %12.0f pkt/s\n", target);
+    printf("Achieved rate    : %12.0f pkt/s (%.2f%% of target)\n", sent / elapsed, 100.0 * sent / elapsed / target);
+    printf("Throughput       : %12.3f Mbit/s payload\n", bytes * 8 / elapsed / 1e6);
+    printf("Packets sent     : %12lu (%lu send errors)\n", (unsigned long)sent, (unsigned long)errors);
+    printf("Packets / syscall: %12.2f\n", calls ? (double)sent / calls : 0.0);
+    printf("Pacing lateness  : %12.2f us mean, %.2f us max\n", attempted ? lateness_sum / attempted : 0.0, lateness_max);
+    printf("Replies received : %12lu\n", (unsigned long)replies);
+
+    close(sockfd);
+    return 0;
+}
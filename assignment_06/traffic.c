@@ -8,11 +8,13 @@
 #include <netinet/ip.h>
 #include <netinet/tcp.h>
 #include <netinet/in.h>
+#include "../common/capture.h"
+#include "../common/dissect.h"
 
 void process_packet(unsigned char* buffer, int size);
 void print_ethernet_header(unsigned char* buffer);
-void print_ip_header(unsigned char* buffer);
-void print_tcp_header(unsigned char* buffer, int ip_header_len);
+void print_ip_header(unsigned char* buffer, int ip_off);
+void print_tcp_header(unsigned char* buffer, int tcp_off);
 void print_payload(unsigned char* buffer, int size);
 
 int tcp_count = 0;
@@ -57,19 +59,19 @@ int main() {
 
 // Dissects the raw packet buffer to extract protocol layers.
 void process_packet(unsigned char* buffer, int size) {
-    // Extract IP Header (Starts after Ethernet header which is 14 bytes)
-    struct iphdr *iph = (struct iphdr *)(buffer + sizeof(struct ethhdr));
+    struct dissection d;
 
-    // We are specifically interested in TCP (Protocol 6)
-    if (iph->protocol == 6) {
+    // The dissector checks the ethertype (skipping VLAN tags) and every header length
+    dissect_packet(&d, buffer, size, CAP_LINK_ETHERNET);
+
+    // We are specifically interested in TCP over IPv4
+    if ((d.layers & DISSECT_IPV4) && (d.layers & DISSECT_TCP)) {
         tcp_count++;
         printf("--- [ Packet #%d | TCP Packet #%d ] ---\n", total_count, tcp_count);
         
         print_ethernet_header(buffer);
-        print_ip_header(buffer);
-        
-        int ip_header_len = iph->ihl * 4;
-        print_tcp_header(buffer, ip_header_len);        
+        print_ip_header(buffer, d.l3_off);
+        print_tcp_header(buffer, d.l4_off);
         printf("\n");
     }
 }
@@ -84,8 +86,8 @@ void print_ethernet_header(unsigned char* buffer) {
 }
 
 // Prints IP Layer information
-void print_ip_header(unsigned char* buffer) {
-    struct iphdr *iph = (struct iphdr *)(buffer + sizeof(struct ethhdr));
+void print_ip_header(unsigned char* buffer, int ip_off) {
+    struct iphdr *iph = (struct iphdr *)(buffer + ip_off);
     struct sockaddr_in source, dest;
     
     memset(&source, 0, sizeof(source));
@@ -107,9 +109,9 @@ void print_ip_header(unsigned char* buffer) {
 }
 
 // Prints TCP Layer information.
-void print_tcp_header(unsigned char* buffer, int ip_header_len) {
-    // TCP Header starts after Ethernet (14 bytes) and IP Header
-    struct tcphdr *tcph = (struct tcphdr *)(buffer + ip_header_len + sizeof(struct ethhdr));
+void print_tcp_header(unsigned char* buffer, int tcp_off) {
+    // TCP Header starts after the Ethernet header, any VLAN tags and the IP header
+    struct tcphdr *tcph = (struct tcphdr *)(buffer + tcp_off);
 
     printf("TCP Header\n");
     printf(" |-Source Port          : %u\n", ntohs(tcph->source));
@@ -2,98 +2,268 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
-#include <netinet/ip_icmp.h>
-#include <netinet/ip.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/time.h>
+#include <poll.h>
+#include <time.h>
+#include "../common/packet.h"
+
+#define MAX_HOSTS 1024
+#define MS_PER_DAY 86400000L
+
+// Timestamp fields following the ICMP header (RFC 792, type 13/14)
+struct icmp_timestamp_body {
+    u_int32_t originate_timestamp;
+    u_int32_t receive_timestamp;
+    u_int32_t transmit_timestamp;
+};
+
+// One request/reply exchange
+typedef struct {
+    double t1;     // local send time, ms since midnight UT
+    double t4;     // local receive time, ms since midnight UT
+    double t2;     // remote receive time
+    double t3;     // remote transmit time
+    int answered;
+} sample_t;
+
+// Per-host probe state
+typedef struct {
+    char name[64];
+    struct in_addr addr;
+    sample_t *samples;
+    int sent;
+    int received;
+    int nonstandard; // replies with the "non-standard time" bit set
+} host_t;
+
+host_t hosts[MAX_HOSTS];
+int host_count = 0;
+int samples_per_host = 5;
+
+// Current wall-clock time in milliseconds since midnight UT, with microsecond resolution
+double now_ms(void) {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return (tv.tv_sec % 86400) * 1000.0 + tv.tv_usec / 1000.0;
+}
+
+// Difference a - b of two times-of-day, wrapped into [-12h, +12h)
+double tod_diff(double a, double b) {
+    double d = a - b;
+    while (d >= MS_PER_DAY / 2) d -= MS_PER_DAY;
+    while (d < -MS_PER_DAY / 2) d += MS_PER_DAY;
+    return d;
+}
+
+void add_host(const char *name) {
+    if (host_count == MAX_HOSTS) {
+        fprintf(stderr, "Too many hosts (max %d)\n", MAX_HOSTS);
+        exit(1);
+    }
+    host_t *h = &hosts[host_count];
+    if (inet_pton(AF_INET, name, &h->addr) != 1) {
+        fprintf(stderr, "Invalid IPv4 address: %s\n", name);
+        exit(1);
+    }
+    snprintf(h->name, sizeof(h->name), "%s", name);
+    host_count++;
+}
+
+void load_hosts(const char *path) {
+    char line[128];
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        perror("Cannot open host list");
+        exit(1);
+    }
+    while (fgets(line, sizeof(line), fp)) {
+        line[strcspn(line, " \t\r\n#")] = '\0';
+        if (line[0] != '\0') add_host(line);
+    }
+    fclose(fp);
+}
 
 /**
- * Generic Checksum calculation function.
+ * Send one Type 13 request. The sequence number identifies host and sample:
+ * seq = sample * host_count + host index.
  */
-unsigned short checksum(unsigned short *ptr, int nbytes) {
-    long sum;
-    unsigned short oddbyte;
-    short answer;
-
-    sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
+void send_request(int s, uint16_t id, int host_idx, int sample_idx) {
+    char packet[64];
+    struct pkt_builder pb;
+    struct icmp_timestamp_body body;
+    struct sockaddr_in dest;
+    host_t *h = &hosts[host_idx];
+    sample_t *smp = &h->samples[sample_idx];
+
+    memset(&dest, 0, sizeof(dest));
+    dest.sin_family = AF_INET;
+    dest.sin_addr = h->addr;
+
+    smp->t1 = now_ms();
+    body.originate_timestamp = htonl((uint32_t)smp->t1);
+    body.receive_timestamp = 0;
+    body.transmit_timestamp = 0;
+
+    pkt_init(&pb, packet, sizeof(packet));
+    struct icmphdr *icmp = pkt_icmp(&pb, ICMP_TIMESTAMP, 0);
+    if (icmp) {
+        icmp->un.echo.id = htons(id);
+        icmp->un.echo.sequence = htons((uint16_t)(sample_idx * host_count + host_idx));
     }
-    if (nbytes == 1) {
-        oddbyte = 0;
-        *((u_char *)&oddbyte) = *(u_char *)ptr;
-        sum += oddbyte;
+    pkt_payload(&pb, &body, sizeof(body));
+    size_t packet_len = pkt_finalize(&pb, NULL);
+
+    if (sendto(s, packet, packet_len, 0, (struct sockaddr *)&dest, sizeof(dest)) <= 0) {
+        perror("sendto failed");
+        return;
     }
+    h->sent++;
+}
+
+// Read every pending datagram and match Type 14 replies by id/seq
+void drain_replies(int s, uint16_t id) {
+    unsigned char buffer[1500];
+    struct sockaddr_in from;
+    socklen_t from_len = sizeof(from);
+    ssize_t n;
+
+    while ((n = recvfrom(s, buffer, sizeof(buffer), MSG_DONTWAIT, (struct sockaddr *)&from, &from_len)) > 0) {
+        double t4 = now_ms();
+        struct iphdr *iph = (struct iphdr *)buffer;
+        size_t ihl = iph->ihl * 4;
+        from_len = sizeof(from);
 
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum = sum + (sum >> 16);
-    answer = (short)~sum;
+        if ((size_t)n < ihl + sizeof(struct icmphdr) + sizeof(struct icmp_timestamp_body)) continue;
+        struct icmphdr *icmp = (struct icmphdr *)(buffer + ihl);
+        if (icmp->type != ICMP_TIMESTAMPREPLY || ntohs(icmp->un.echo.id) != id) continue;
 
-    return (answer);
+        int seq = ntohs(icmp->un.echo.sequence);
+        int host_idx = seq % host_count;
+        int sample_idx = seq / host_count;
+        if (sample_idx >= samples_per_host) continue;
+
+        host_t *h = &hosts[host_idx];
+        sample_t *smp = &h->samples[sample_idx];
+        if (h->addr.s_addr != from.sin_addr.s_addr || smp->answered || smp->t1 == 0) continue;
+
+        struct icmp_timestamp_body *body = (struct icmp_timestamp_body *)(icmp + 1);
+        uint32_t rx = ntohl(body->receive_timestamp);
+        uint32_t tx = ntohl(body->transmit_timestamp);
+        if ((rx | tx) & 0x80000000u) h->nonstandard++;
+
+        smp->t2 = rx & 0x7fffffffu;
+        smp->t3 = tx & 0x7fffffffu;
+        smp->t4 = t4;
+        smp->answered = 1;
+        h->received++;
+    }
 }
 
-// ICMP Timestamp structure as defined in RFC 792
-struct icmp_timestamp {
-    u_int8_t type;
-    u_int8_t code;
-    u_int16_t checksum;
-    u_int16_t id;
-    u_int16_t sequence;
-    u_int32_t originate_timestamp;
-    u_int32_t receive_timestamp;
-    u_int32_t transmit_timestamp;
-};
+// Receive replies until `deadline` (ms since midnight)
+void wait_until(int s, uint16_t id, double deadline) {
+    struct pollfd pfd = {.fd = s, .events = POLLIN};
+    double remaining;
+
+    while ((remaining = tod_diff(deadline, now_ms())) > 0) {
+        if (poll(&pfd, 1, (int)remaining + 1) > 0) drain_replies(s, id);
+    }
+}
+
+/**
+ * NTP-style estimate for one host:
+ *   delay  = (T4 - T1) - (T3 - T2)
+ *   offset = ((T2 - T1) + (T3 - T4)) / 2
+ * Only the sample with the smallest round trip is trusted for the offset,
+ * since queueing delay on either path skews the estimate.
+ */
+void report_host(host_t *h) {
+    double min_rtt = 1e12, sum_rtt = 0, best_offset = 0, best_delay = 0;
+    double min_offset = 1e12, max_offset = -1e12;
+
+    for (int i = 0; i < samples_per_host; i++) {
+        sample_t *smp = &h->samples[i];
+        if (!smp->answered) continue;
+        double rtt = tod_diff(smp->t4, smp->t1);
+        double delay = rtt - tod_diff(smp->t3, smp->t2);
+        double offset = (tod_diff(smp->t2, smp->t1) + tod_diff(smp->t3, smp->t4)) / 2;
+        sum_rtt += rtt;
+        if (offset < min_offset) min_offset = offset;
+        if (offset > max_offset) max_offset = offset;
+        if (rtt < min_rtt) {
+            min_rtt = rtt;
+            best_offset = offset;
+            best_delay = delay;
+        }
+    }
+
+    if (h->received == 0) {
+        printf("%-16s %4d %4d %10s %10s %10s %12s %10s\n", h->name, h->sent, 0, "-", "-", "-", "-", "-");
+        return;
+    }
+    printf("%-16s %4d %4d %10.3f %10.3f %10.3f %12.3f %10.3f%s\n", h->name, h->sent, h->received,
+           min_rtt, sum_rtt / h->received, best_delay, best_offset, max_offset - min_offset,
+           h->nonstandard ? "  (non-standard clock)" : "");
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 2) {
-        printf("Usage: sudo %s <Target IP>\n", argv[0]);
+    int interval_ms = 200;
+    int timeout_ms = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "c:i:w:f:")) != -1) {
+        switch (opt) {
+        case 'c': samples_per_host = atoi(optarg); break;
+        case 'i': interval_ms = atoi(optarg); break;
+        case 'w': timeout_ms = atoi(optarg); break;
+        case 'f': load_hosts(optarg); break;
+        default: host_count = 0; optind = argc; break;
+        }
+    }
+    for (int i = optind; i < argc; i++) add_host(argv[i]);
+
+    if (host_count == 0 || samples_per_host < 1) {
+        printf("Usage: sudo %s [-c samples] [-i interval_ms] [-w timeout_ms] [-f host_file] <Target IP>...\n", argv[0]);
+        return 1;
+    }
+    if ((long)host_count * samples_per_host > 65536) {
+        fprintf(stderr, "hosts x samples must not exceed 65536 (one ICMP sequence number each)\n");
         return 1;
     }
 
-    char *target_ip = argv[1];
+    for (int h = 0; h < host_count; h++) hosts[h].samples = calloc(samples_per_host, sizeof(sample_t));
 
-    // Create raw ICMP socket
+    // Create raw ICMP socket shared by all probes
     int s = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
     if (s < 0) {
         perror("Socket creation failed");
         exit(1);
     }
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(s, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
 
-    struct sockaddr_in dest;
-    dest.sin_family = AF_INET;
-    dest.sin_addr.s_addr = inet_addr(target_ip);
-
-    char packet[sizeof(struct icmp_timestamp)];
-    struct icmp_timestamp *icmp = (struct icmp_timestamp *)packet;
+    uint16_t id = (uint16_t)getpid();
+    printf("Probing %d host(s), %d timestamp request(s) each\n\n", host_count, samples_per_host);
 
-    // Set ICMP Header fields
-    icmp->type = 13; // ICMP_TIMESTAMP (Type 13)
-    icmp->code = 0;
-    icmp->checksum = 0;
-    icmp->id = getpid();
-    icmp->sequence = 1;
-
-    // Get current time since midnight in milliseconds
-    struct timeval tv;
-    gettimeofday(&tv, NULL);
-    uint32_t milliseconds = (tv.tv_sec % 86400) * 1000 + (tv.tv_usec / 1000);
-    
-    icmp->originate_timestamp = htonl(milliseconds);
-    icmp->receive_timestamp = 0;
-    icmp->transmit_timestamp = 0;
-
-    // Calculate ICMP Checksum
-    icmp->checksum = checksum((unsigned short *)icmp, sizeof(struct icmp_timestamp));
-
-    // Send the packet
-    if (sendto(s, packet, sizeof(struct icmp_timestamp), 0, (struct sockaddr *)&dest, sizeof(dest)) <= 0) {
-        perror("sendto failed");
-    } else {
-        printf("ICMP Timestamp Message sent to %s\n", target_ip);
+    // Each round sends one request to every host, then collects replies while pacing
+    for (int r = 0; r < samples_per_host; r++) {
+        for (int h = 0; h < host_count; h++) {
+            send_request(s, id, h, r);
+            drain_replies(s, id);
+        }
+        wait_until(s, id, now_ms() + interval_ms);
     }
+    wait_until(s, id, now_ms() + timeout_ms);
+
+    printf("%-16s %4s %4s %10s %10s %10s %12s %10s\n", "Host", "Sent", "Recv", "MinRTT", "AvgRTT",
+           "Delay", "Offset", "Spread");
+    printf("%-16s %4s %4s %10s %10s %10s %12s %10s\n", "", "", "", "(ms)", "(ms)", "(ms)", "(ms)", "(ms)");
+    for (int h = 0; h < host_count; h++) report_host(&hosts[h]);
+    printf("\nOffset = remote clock - local clock, from the minimum-RTT sample. "
+           "ICMP timestamps have 1 ms resolution.\n");
 
     close(s);
+    for (int h = 0; h < host_count; h++) free(hosts[h].samples);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,324 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include "../common/packet.h"
+
+/**
+ * Parallel TTL-sweep path tracer.
+ *
+ * Unlike traceroute, every TTL probe for every destination is sent up front
+ * (paced only to stay under ICMP rate limits), and ICMP Time Exceeded /
+ * Port Unreachable replies are matched afterwards through the quoted IP
+ * header: the IP id of each probe indexes the probe table. Only a Port
+ * Unreachable from the destination itself means it was reached; other
+ * unreachable codes are shown at the hop that sent them with traceroute's
+ * flags (!N, !H, !X, ...).
+ *
+ * Each "flow" keeps its UDP 5-tuple fixed across TTLs (Paris-traceroute
+ * style) and flows differ in source port, so ECMP switches hash different
+ * flows onto different paths and the distinct paths can be enumerated.
+ */
+
+#define MAX_DESTS 64
+#define MAX_TTL 32
+#define MAX_PROBES 65535
+#define BASE_SPORT 33000
+#define DPORT 33434
+
+typedef struct {
+    uint16_t dest;
+    uint8_t flow;
+    uint8_t ttl;
+    double sent_at;
+    double rtt;            // ms, < 0 while unanswered
+    in_addr_t responder;
+    int reached;           // reply came from the destination itself
+    int unreach;           // other Destination Unreachable: its code + 1, else 0
+} probe_t;
+
+typedef struct {
+    char name[32];
+    struct sockaddr_in addr;
+    in_addr_t source;
+} dest_t;
+
+dest_t dests[MAX_DESTS];
+int dest_count = 0;
+probe_t probes[MAX_PROBES];
+int probe_total = 0;
+
+double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+in_addr_t route_source(struct sockaddr_in *dst) {
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0 || connect(s, (struct sockaddr *)dst, sizeof(*dst)) < 0 ||
+        getsockname(s, (struct sockaddr *)&local, &len) < 0) {
+        perror("Cannot determine source address");
+        exit(1);
+    }
+    close(s);
+    return local.sin_addr.s_addr;
+}
+
+void add_dest(const char *name) {
+    if (dest_count == MAX_DESTS) {
+        fprintf(stderr, "Too many destinations (max %d)\n", MAX_DESTS);
+        exit(1);
+    }
+    dest_t *d = &dests[dest_count];
+    memset(d, 0, sizeof(*d));
+    d->addr.sin_family = AF_INET;
+    if (inet_pton(AF_INET, name, &d->addr.sin_addr) != 1) {
+        fprintf(stderr, "Invalid IPv4 address: %s\n", name);
+        exit(1);
+    }
+    snprintf(d->name, sizeof(d->name), "%s", name);
+    d->source = route_source(&d->addr);
+    dest_count++;
+}
+
+// Build and send one UDP probe; its IP id is the probe's index in the table
+void send_probe(int s, int idx) {
+    char packet[64];
+    struct pkt_builder pb;
+    probe_t *p = &probes[idx];
+    dest_t *d = &dests[p->dest];
+    static const char payload[12] = "pathTracer";
+
+    pkt_init(&pb, packet, sizeof(packet));
+    struct iphdr *iph = pkt_ipv4(&pb, d->source, d->addr.sin_addr.s_addr, p->ttl);
+    if (iph) iph->id = htons((uint16_t)(idx + 1));
+    pkt_udp(&pb, BASE_SPORT + p->flow, DPORT);
+    pkt_payload(&pb, payload, sizeof(payload));
+    size_t len = pkt_finalize(&pb, NULL);
+
+    p->sent_at = now_ms();
+    if (sendto(s, packet, len, 0, (struct sockaddr *)&d->addr, sizeof(d->addr)) < 0) {
+        perror("sendto failed");
+        p->sent_at = 0;
+    }
+}
+
+// Match an ICMP error against the probe it quotes
+void handle_icmp(unsigned char *buf, ssize_t n, double rx_time) {
+    struct iphdr *iph = (struct iphdr *)buf;
+    size_t ihl = iph->ihl * 4;
+    if ((size_t)n < ihl + sizeof(struct icmphdr) + sizeof(struct iphdr) + 8) return;
+
+    struct icmphdr *icmp = (struct icmphdr *)(buf + ihl);
+    if (!(icmp->type == ICMP_TIME_EXCEEDED && icmp->code == ICMP_EXC_TTL) && icmp->type != ICMP_DEST_UNREACH) return;
+
+    // The error quotes our IP header and the first 8 bytes of our UDP header
+    struct iphdr *quoted = (struct iphdr *)(icmp + 1);
+    size_t qhl = quoted->ihl * 4;
+    if ((size_t)n < ihl + sizeof(struct icmphdr) + qhl + 8 || quoted->protocol != IPPROTO_UDP) return;
+    struct udphdr *qudp = (struct udphdr *)((unsigned char *)quoted + qhl);
+
+    int idx = ntohs(quoted->id) - 1;
+    if (idx < 0 || idx >= probe_total) return;
+    probe_t *p = &probes[idx];
+    if (p->sent_at == 0 || p->rtt >= 0) return;
+    if (quoted->daddr != dests[p->dest].addr.sin_addr.s_addr || ntohs(qudp->source) != BASE_SPORT + p->flow) return;
+
+    p->rtt = rx_time - p->sent_at;
+    p->responder = iph->saddr;
+    if (icmp->type != ICMP_DEST_UNREACH) return;
+    // Only the destination's own port unreachable ends the path; a router's
+    // net/host unreachable or admin prohibited is an error at that hop
+    if (icmp->code == ICMP_PORT_UNREACH && iph->saddr == dests[p->dest].addr.sin_addr.s_addr) p->reached = 1;
+    else p->unreach = icmp->code + 1;
+}
+
+// traceroute's annotation for a Destination Unreachable code
+void unreach_flag(int code, char *buf, size_t size) {
+    switch (code) {
+    case ICMP_NET_UNREACH: snprintf(buf, size, "!N"); break;
+    case ICMP_HOST_UNREACH: snprintf(buf, size, "!H"); break;
+    case ICMP_PROT_UNREACH: snprintf(buf, size, "!P"); break;
+    case ICMP_PORT_UNREACH: snprintf(buf, size, "!U"); break;
+    case ICMP_FRAG_NEEDED: snprintf(buf, size, "!F"); break;
+    case ICMP_PKT_FILTERED: snprintf(buf, size, "!X"); break;
+    default: snprintf(buf, size, "!<%d>", code); break;
+    }
+}
+
+void drain(int s) {
+    unsigned char buf[1500];
+    ssize_t n;
+    while ((n = recv(s, buf, sizeof(buf), MSG_DONTWAIT)) > 0) handle_icmp(buf, n, now_ms());
+}
+
+void wait_for(int s, double ms) {
+    struct pollfd pfd = {.fd = s, .events = POLLIN};
+    double deadline = now_ms() + ms, remaining;
+    while ((remaining = deadline - now_ms()) > 0) {
+        if (poll(&pfd, 1, (int)remaining + 1) > 0) drain(s);
+    }
+}
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * Per-destination report: for every hop, each distinct responder with the
+ * number of flows that crossed it and its RTT distribution; then the number
+ * of distinct paths seen across flows.
+ */
+void report_dest(int d, int flows, int max_ttl, int rounds) {
+    int hop_limit = max_ttl, reached = 0, error_hop = 0;
+    static double rtts[MAX_PROBES];
+
+    // The path ends at the first TTL where the destination answered
+    for (int i = 0; i < probe_total; i++) {
+        probe_t *p = &probes[i];
+        if (p->dest == d && p->reached) {
+            reached = 1;
+            if (p->ttl < hop_limit) hop_limit = p->ttl;
+        }
+        if (p->dest == d && p->unreach && (!error_hop || p->ttl < error_hop)) error_hop = p->ttl;
+    }
+    // Without the destination, nothing answers beyond a router's error
+    if (!reached && error_hop) hop_limit = error_hop;
+
+    printf("\nDestination %s: %s", dests[d].name, reached ? "reached" : "not reached");
+    if (reached) printf(" at hop %d", hop_limit);
+    else if (error_hop) printf(" (unreachable reported at hop %d)", error_hop);
+    printf(", %d flow(s) x %d round(s)\n", flows, rounds);
+    printf("%4s  %-16s %6s %8s %9s %9s %9s\n", "Hop", "Responder", "Flows", "Replies", "Min(ms)", "P50", "Max");
+
+    for (int ttl = 1; ttl <= hop_limit; ttl++) {
+        in_addr_t seen[256];
+        int seen_count = 0, any = 0;
+
+        for (int i = 0; i < probe_total; i++) {
+            probe_t *p = &probes[i];
+            if (p->dest != d || p->ttl != ttl || p->rtt < 0) continue;
+            int k;
+            for (k = 0; k < seen_count && seen[k] != p->responder; k++);
+            if (k == seen_count && seen_count < 256) seen[seen_count++] = p->responder;
+        }
+
+        for (int k = 0; k < seen_count; k++) {
+            int n = 0, unreach = 0;
+            uint64_t flow_mask[4] = {0};
+            for (int i = 0; i < probe_total; i++) {
+                probe_t *p = &probes[i];
+                if (p->dest != d || p->ttl != ttl || p->rtt < 0 || p->responder != seen[k]) continue;
+                rtts[n++] = p->rtt;
+                if (p->unreach) unreach = p->unreach;
+                flow_mask[p->flow / 64] |= 1ULL << (p->flow % 64);
+            }
+            int flow_hits = 0;
+            for (int w = 0; w < 4; w++) flow_hits += __builtin_popcountll(flow_mask[w]);
+            qsort(rtts, n, sizeof(double), compare_double);
+
+            // The hop number is only printed on the first responder line
+            char hop[12] = "";
+            if (!any) snprintf(hop, sizeof(hop), "%d", ttl);
+            char flag[16] = "";
+            if (unreach) unreach_flag(unreach - 1, flag, sizeof(flag));
+            struct in_addr a = {.s_addr = seen[k]};
+            printf("%4s  %-16s %6d %8d %9.3f %9.3f %9.3f%s%s\n", hop, inet_ntoa(a), flow_hits, n,
+                   rtts[0], rtts[(n - 1) / 2], rtts[n - 1], *flag ? " " : "", flag);
+            any = 1;
+        }
+        if (!any) printf("%4d  %-16s\n", ttl, "*");
+    }
+
+    // Count distinct responder sequences (paths) across flows, using the first reply per hop
+    in_addr_t paths[256][MAX_TTL];
+    int path_count = 0;
+    for (int f = 0; f < flows; f++) {
+        in_addr_t path[MAX_TTL] = {0};
+        for (int i = 0; i < probe_total; i++) {
+            probe_t *p = &probes[i];
+            if (p->dest == d && p->flow == f && p->rtt >= 0 && p->ttl <= hop_limit && path[p->ttl - 1] == 0)
+                path[p->ttl - 1] = p->responder;
+        }
+        int k;
+        for (k = 0; k < path_count && memcmp(paths[k], path, sizeof(path)) != 0; k++);
+        if (k == path_count && path_count < 256) memcpy(paths[path_count++], path, sizeof(path));
+    }
+    printf("Distinct paths across flows: %d\n", path_count);
+}
+
+int main(int argc, char *argv[]) {
+    int max_ttl = 16, flows = 8, rounds = 3, timeout_ms = 2000, rate = 1000;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "m:f:q:w:r:")) != -1) {
+        switch (opt) {
+        case 'm': max_ttl = atoi(optarg); break;
+        case 'f': flows = atoi(optarg); break;
+        case 'q': rounds = atoi(optarg); break;
+        case 'w': timeout_ms = atoi(optarg); break;
+        case 'r': rate = atoi(optarg); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || max_ttl < 1 || max_ttl > MAX_TTL || flows < 1 || flows > 256 || rounds < 1 || rate < 1) {
+        printf("Usage: sudo %s [-m max_ttl<=%d] [-f flows<=256] [-q rounds] [-w timeout_ms] [-r probes_per_sec] <Target IP>...\n",
+               argv[0], MAX_TTL);
+        return 1;
+    }
+    for (int i = optind; i < argc; i++) add_dest(argv[i]);
+
+    if ((long)dest_count * flows * max_ttl * rounds > MAX_PROBES) {
+        fprintf(stderr, "destinations x flows x TTLs x rounds must not exceed %d\n", MAX_PROBES);
+        return 1;
+    }
+
+    // Probes go out through a raw socket with our own IP header; ICMP errors come back on another
+    int send_sock = socket(AF_INET, SOCK_RAW, IPPROTO_RAW);
+    int recv_sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (send_sock < 0 || recv_sock < 0) {
+        perror("Failed to create raw sockets (Run as root)");
+        exit(1);
+    }
+    int rcvbuf = 8 * 1024 * 1024;
+    setsockopt(recv_sock, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+
+    // Interleave destinations and flows so no single router sees a burst
+    for (int r = 0; r < rounds; r++)
+        for (int ttl = 1; ttl <= max_ttl; ttl++)
+            for (int f = 0; f < flows; f++)
+                for (int d = 0; d < dest_count; d++) {
+                    probe_t *p = &probes[probe_total];
+                    p->dest = d;
+                    p->flow = f;
+                    p->ttl = ttl;
+                    p->rtt = -1;
+                    probe_total++;
+                }
+
+    printf("Tracing %d destination(s): %d flows x %d TTLs x %d rounds = %d probes at %d/s\n",
+           dest_count, flows, max_ttl, rounds, probe_total, rate);
+
+    double gap = 1000.0 / rate, next = now_ms();
+    for (int i = 0; i < probe_total; i++) {
+        send_probe(send_sock, i);
+        next += gap;
+        drain(recv_sock);
+        if (next > now_ms()) wait_for(recv_sock, next - now_ms());
+    }
+    wait_for(recv_sock, timeout_ms);
+
+    for (int d = 0; d < dest_count; d++) report_dest(d, flows, max_ttl, rounds);
+
+    close(send_sock);
+    close(recv_sock);
+    return 0;
+}
@@ -0,0 +1,322 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include "../common/packet.h"
+
+/**
+ * Path MTU discovery and fragmentation cost probe.
+ *
+ * Phase 1 binary-searches the largest ICMP echo that reaches the target with
+ * DF set, using Fragmentation Needed replies (and their next-hop MTU) and
+ * local EMSGSIZE errors to shrink the range.
+ * Phase 2 sends bursts of echoes at several packet sizes, unfragmented up to
+ * the path MTU and kernel-fragmented beyond it, and reports latency and
+ * throughput so application buffer sizes can be matched to the real path.
+ *
+ * The kernel builds the IP header; DF is controlled with IP_MTU_DISCOVER
+ * (IP_PMTUDISC_PROBE sets DF without using the cached PMTU, IP_PMTUDISC_DONT
+ * lets the kernel fragment).
+ */
+
+#define IP_ICMP_HDR 28
+#define MIN_MTU 68
+#define MAX_PACKET 65535
+
+enum probe_result { PROBE_REPLY, PROBE_FRAG_NEEDED, PROBE_TOO_BIG_LOCAL, PROBE_TIMEOUT };
+
+int sock;
+struct sockaddr_in target;
+uint16_t probe_id;
+uint16_t next_seq = 1;
+static char packet[MAX_PACKET];
+
+double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+void set_df(int df) {
+    int mode = df ? IP_PMTUDISC_PROBE : IP_PMTUDISC_DONT;
+    if (setsockopt(sock, IPPROTO_IP, IP_MTU_DISCOVER, &mode, sizeof(mode)) < 0) {
+        perror("IP_MTU_DISCOVER");
+        exit(1);
+    }
+}
+
+// Send an echo request whose IP datagram is `size` bytes; returns 0, or errno on failure
+int send_echo(int size, uint16_t seq) {
+    struct pkt_builder pb;
+    pkt_init(&pb, packet, sizeof(packet));
+    struct icmphdr *icmp = pkt_icmp(&pb, ICMP_ECHO, 0);
+    if (icmp) {
+        icmp->un.echo.id = htons(probe_id);
+        icmp->un.echo.sequence = htons(seq);
+    }
+    pkt_payload(&pb, NULL, size - IP_ICMP_HDR);
+    size_t len = pkt_finalize(&pb, NULL);
+
+    if (sendto(sock, packet, len, 0, (struct sockaddr *)&target, sizeof(target)) < 0) return errno;
+    return 0;
+}
+
+/**
+ * Read one ICMP message relevant to us. Returns 1 for an echo reply,
+ * 2 for Fragmentation Needed (with *mtu set), 0 for anything else.
+ * *seq receives the echo sequence number (quoted, for errors).
+ */
+int read_icmp(uint16_t *seq, int *mtu) {
+    unsigned char buf[MAX_PACKET];
+    ssize_t n = recv(sock, buf, sizeof(buf), MSG_DONTWAIT);
+    if (n <= 0) return -1;
+
+    struct iphdr *iph = (struct iphdr *)buf;
+    size_t ihl = iph->ihl * 4;
+    if ((size_t)n < ihl + sizeof(struct icmphdr)) return 0;
+    struct icmphdr *icmp = (struct icmphdr *)(buf + ihl);
+
+    if (icmp->type == ICMP_ECHOREPLY && iph->saddr == target.sin_addr.s_addr &&
+        ntohs(icmp->un.echo.id) == probe_id) {
+        *seq = ntohs(icmp->un.echo.sequence);
+        return 1;
+    }
+    if (icmp->type == ICMP_DEST_UNREACH && icmp->code == ICMP_FRAG_NEEDED) {
+        // Quoted datagram: our IP header followed by the first 8 bytes of our echo request
+        struct iphdr *q = (struct iphdr *)(icmp + 1);
+        size_t qhl = q->ihl * 4;
+        if ((size_t)n < ihl + sizeof(struct icmphdr) + qhl + 8 || q->daddr != target.sin_addr.s_addr) return 0;
+        struct icmphdr *qicmp = (struct icmphdr *)((unsigned char *)q + qhl);
+        if (qicmp->type != ICMP_ECHO || ntohs(qicmp->un.echo.id) != probe_id) return 0;
+        *seq = ntohs(qicmp->un.echo.sequence);
+        *mtu = ntohs(icmp->un.frag.mtu);
+        return 2;
+    }
+    return 0;
+}
+
+// One DF probe of `size` bytes
+enum probe_result probe_once(int size, int timeout_ms, int *mtu, double *rtt) {
+    uint16_t seq = next_seq++, got;
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    double start = now_ms(), remaining;
+
+    int err = send_echo(size, seq);
+    if (err == EMSGSIZE) return PROBE_TOO_BIG_LOCAL;
+    if (err) {
+        fprintf(stderr, "sendto failed: %s\n", strerror(err));
+        exit(1);
+    }
+
+    while ((remaining = start + timeout_ms - now_ms()) > 0) {
+        if (poll(&pfd, 1, (int)remaining + 1) <= 0) continue;
+        int kind;
+        while ((kind = read_icmp(&got, mtu)) >= 0) {
+            if (got != seq) continue;
+            if (kind == 1) {
+                *rtt = now_ms() - start;
+                return PROBE_REPLY;
+            }
+            if (kind == 2) return PROBE_FRAG_NEEDED;
+        }
+    }
+    return PROBE_TIMEOUT;
+}
+
+/* Binary search for the largest DF datagram that gets an echo reply. */
+int discover_pmtu(int hi, int timeout_ms, int retries) {
+    int lo = MIN_MTU;
+    double rtt;
+
+    set_df(1);
+    printf("Path MTU discovery to %s (DF set, %d..%d bytes)\n", inet_ntoa(target.sin_addr), lo, hi);
+
+    // Make sure the target answers at all
+    int mtu = 0, ok = 0;
+    for (int r = 0; r <= retries && !ok; r++) ok = probe_once(lo, timeout_ms, &mtu, &rtt) == PROBE_REPLY;
+    if (!ok) {
+        fprintf(stderr, "No echo reply from target at %d bytes\n", lo);
+        exit(1);
+    }
+
+    while (lo < hi) {
+        int size = lo + (hi - lo + 1) / 2;
+        enum probe_result res = PROBE_TIMEOUT;
+        for (int r = 0; r <= retries; r++) {
+            res = probe_once(size, timeout_ms, &mtu, &rtt);
+            if (res != PROBE_TIMEOUT) break;
+        }
+
+        switch (res) {
+        case PROBE_REPLY:
+            printf("  %5d bytes: reply in %.3f ms\n", size, rtt);
+            lo = size;
+            break;
+        case PROBE_FRAG_NEEDED:
+            printf("  %5d bytes: Fragmentation Needed, next-hop MTU %d\n", size, mtu);
+            // Trust a sane next-hop MTU; old routers report 0
+            hi = (mtu >= MIN_MTU && mtu < size) ? mtu : size - 1;
+            if (hi < lo) hi = lo;
+            break;
+        case PROBE_TOO_BIG_LOCAL:
+            printf("  %5d bytes: larger than the local interface MTU\n", size);
+            hi = size - 1;
+            break;
+        case PROBE_TIMEOUT:
+            printf("  %5d bytes: no reply (silently dropped?)\n", size);
+            hi = size - 1;
+            break;
+        }
+    }
+    return lo;
+}
+
+typedef struct {
+    int sent, received;
+    double p50, p90, max;
+    double elapsed_ms;
+} burst_t;
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Send `count` echoes of `size` bytes keeping `window` outstanding; collect RTTs. */
+burst_t run_burst(int size, int df, int count, int window, int timeout_ms) {
+    burst_t b = {0};
+    double *sent_at = calloc(count, sizeof(double));
+    double *rtts = malloc(count * sizeof(double));
+    uint16_t base = next_seq;
+    struct pollfd pfd = {.fd = sock, .events = POLLIN};
+    int outstanding = 0, mtu, limit = count;
+    uint16_t got;
+
+    next_seq += count;
+    set_df(df);
+    double start = now_ms(), last_activity = start;
+
+    while (b.received < limit && now_ms() - last_activity < timeout_ms) {
+        while (b.sent < limit && outstanding < window) {
+            if (send_echo(size, (uint16_t)(base + b.sent)) != 0) {
+                limit = b.sent;   // too big to send at all
+                break;
+            }
+            sent_at[b.sent++] = now_ms();
+            outstanding++;
+        }
+        if (poll(&pfd, 1, 10) <= 0) {
+            // Replace lost probes once the window has been idle for a while
+            if (b.sent < limit && now_ms() - last_activity > timeout_ms / 4.0) outstanding = 0;
+            continue;
+        }
+        int kind;
+        while ((kind = read_icmp(&got, &mtu)) >= 0) {
+            int idx = (uint16_t)(got - base);
+            if (kind != 1 || idx >= b.sent || sent_at[idx] == 0) continue;
+            rtts[b.received++] = now_ms() - sent_at[idx];
+            sent_at[idx] = 0;
+            outstanding--;
+            last_activity = now_ms();
+        }
+    }
+    b.elapsed_ms = last_activity - start;
+
+    if (b.received > 0) {
+        qsort(rtts, b.received, sizeof(double), compare_double);
+        b.p50 = rtts[(b.received - 1) / 2];
+        b.p90 = rtts[(int)(0.9 * (b.received - 1))];
+        b.max = rtts[b.received - 1];
+    }
+    free(sent_at);
+    free(rtts);
+    return b;
+}
+
+int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+// Number of IP packets a datagram of `size` bytes is split into (fragments carry multiples of 8 bytes)
+int ip_packets(int size, int pmtu) {
+    if (size <= pmtu) return 1;
+    return 1 + (size - 20 - 1) / ((pmtu - 20) & ~7);
+}
+
+void report_burst(int size, int pmtu, burst_t *b) {
+    int frags = ip_packets(size, pmtu);
+    double mbps = b->elapsed_ms > 0 ? b->received * (double)(size - IP_ICMP_HDR) * 8 / b->elapsed_ms / 1000 : 0;
+    printf("%7d %6d %7d %7d %6.1f%%", size, frags, b->sent, b->received,
+           b->sent ? 100.0 * (b->sent - b->received) / b->sent : 0.0);
+    if (b->received == 0) {
+        printf(" %9s %9s %9s %10s\n", "-", "-", "-", "-");
+        return;
+    }
+    printf(" %9.3f %9.3f %9.3f %10.2f\n", b->p50, b->p90, b->max, mbps);
+}
+
+int main(int argc, char *argv[]) {
+    int max_size = 9000, count = 200, window = 16, timeout_ms = 1000, retries = 2;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "M:c:W:w:")) != -1) {
+        switch (opt) {
+        case 'M': max_size = atoi(optarg); break;
+        case 'c': count = atoi(optarg); break;
+        case 'W': window = atoi(optarg); break;
+        case 'w': timeout_ms = atoi(optarg); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind != argc - 1 || max_size < MIN_MTU || max_size > MAX_PACKET - 1 || count < 1 || window < 1) {
+        printf("Usage: sudo %s [-M max_size] [-c echoes_per_size] [-W window] [-w timeout_ms] <Target IP>\n", argv[0]);
+        return 1;
+    }
+
+    memset(&target, 0, sizeof(target));
+    target.sin_family = AF_INET;
+    if (inet_pton(AF_INET, argv[optind], &target.sin_addr) != 1) {
+        fprintf(stderr, "Invalid IPv4 address: %s\n", argv[optind]);
+        return 1;
+    }
+
+    sock = socket(AF_INET, SOCK_RAW, IPPROTO_ICMP);
+    if (sock < 0) {
+        perror("Socket creation failed (Run as root)");
+        exit(1);
+    }
+    int bufsize = 8 * 1024 * 1024;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &bufsize, sizeof(bufsize));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &bufsize, sizeof(bufsize));
+    probe_id = (uint16_t)getpid();
+
+    int pmtu = discover_pmtu(max_size, timeout_ms, retries);
+    printf("\nPath MTU: %d bytes (max UDP payload %d, TCP MSS %d)\n\n", pmtu, pmtu - 28, pmtu - 40);
+
+    // Fixed sizes plus the path MTU itself and a few fragmenting sizes beyond it
+    int sizes[] = {84, 256, 576, 1052, 1500, 2076, 4096, 8192, 16384, 32768, 0};
+    sizes[sizeof(sizes) / sizeof(sizes[0]) - 1] = pmtu;
+    int n_sizes = sizeof(sizes) / sizeof(sizes[0]);
+    qsort(sizes, n_sizes, sizeof(int), compare_int);
+
+    printf("%7s %6s %7s %7s %7s %9s %9s %9s %10s\n", "Size", "Frags", "Sent", "Recv", "Loss",
+           "P50(ms)", "P90", "Max", "Mbit/s");
+    for (int i = 0; i < n_sizes; i++) {
+        if (sizes[i] < MIN_MTU || (i > 0 && sizes[i] == sizes[i - 1])) continue;
+        burst_t b = run_burst(sizes[i], sizes[i] <= pmtu, count, window, timeout_ms);
+        report_burst(sizes[i], pmtu, &b);
+    }
+
+    // How the 1024/2048-byte BUFFER_SIZE constants of the socket assignments map onto this path
+    printf("\nUDP payloads above %d bytes are fragmented on this path:\n", pmtu - 28);
+    for (int payload = 1024; payload <= 2048; payload *= 2)
+        printf("  %d-byte datagram -> %d IP packet(s)\n", payload, ip_packets(payload + 28, pmtu));
+
+    close(sock);
+    return 0;
+}
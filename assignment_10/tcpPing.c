@@ -0,0 +1,289 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <poll.h>
+#include <time.h>
+#include "../common/packet.h"
+
+/**
+ * TCP handshake latency prober (tcpping / hping -S style).
+ *
+ * For every endpoint a SYN template is built once with the packet builder;
+ * each probe only patches the sequence number and IP id. Replies are read
+ * from the same raw TCP socket: a SYN/ACK (port open) or RST (port closed)
+ * whose ack number is our seq + 1 completes the probe, and an RST is sent
+ * back so the server drops the half-open connection.
+ */
+
+#define MAX_ENDPOINTS 256
+#define BASE_PORT 40000
+
+typedef struct {
+    char name[64];
+    struct sockaddr_in addr;
+    in_addr_t source;
+    uint16_t sport;
+    struct pkt_template tmpl;
+    char packet[64];
+    size_t packet_len;
+    uint32_t seq_base;
+    double *sent_at;      // send time per probe, 0 if not sent
+    double *rtt;          // RTT per probe in ms, < 0 if unanswered
+    int sent;
+    int synack;
+    int rst;
+} endpoint_t;
+
+endpoint_t endpoints[MAX_ENDPOINTS];
+int endpoint_count = 0;
+int probe_count = 5;
+in_addr_t forced_source = 0;
+
+double now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+// Ask the routing table which local address reaches `dst`
+in_addr_t route_source(struct sockaddr_in *dst) {
+    struct sockaddr_in local;
+    socklen_t len = sizeof(local);
+    int s = socket(AF_INET, SOCK_DGRAM, 0);
+    if (s < 0 || connect(s, (struct sockaddr *)dst, sizeof(*dst)) < 0 ||
+        getsockname(s, (struct sockaddr *)&local, &len) < 0) {
+        perror("Cannot determine source address");
+        exit(1);
+    }
+    close(s);
+    return local.sin_addr.s_addr;
+}
+
+// Parse "ip:port" and prepare the endpoint's SYN template
+void add_endpoint(const char *spec) {
+    char host[64];
+    const char *colon = strrchr(spec, ':');
+
+    if (endpoint_count == MAX_ENDPOINTS) {
+        fprintf(stderr, "Too many endpoints (max %d)\n", MAX_ENDPOINTS);
+        exit(1);
+    }
+    if (colon == NULL || colon - spec >= (long)sizeof(host)) {
+        fprintf(stderr, "Endpoint must be <IP>:<port>: %s\n", spec);
+        exit(1);
+    }
+    memcpy(host, spec, colon - spec);
+    host[colon - spec] = '\0';
+
+    endpoint_t *ep = &endpoints[endpoint_count];
+    memset(ep, 0, sizeof(*ep));
+    snprintf(ep->name, sizeof(ep->name), "%s", spec);
+    ep->addr.sin_family = AF_INET;
+    ep->addr.sin_port = htons(atoi(colon + 1));
+    if (inet_pton(AF_INET, host, &ep->addr.sin_addr) != 1 || ep->addr.sin_port == 0) {
+        fprintf(stderr, "Invalid endpoint: %s\n", spec);
+        exit(1);
+    }
+    ep->source = forced_source ? forced_source : route_source(&ep->addr);
+    ep->sport = BASE_PORT + endpoint_count;
+    ep->seq_base = (uint32_t)rand() << 16;
+    endpoint_count++;
+}
+
+void build_template(endpoint_t *ep) {
+    struct pkt_builder pb;
+    pkt_init(&pb, ep->packet, sizeof(ep->packet));
+    pkt_ipv4(&pb, ep->source, ep->addr.sin_addr.s_addr, 64);
+    pkt_tcp(&pb, ep->sport, ntohs(ep->addr.sin_port), ep->seq_base, 0, TH_SYN, 64240);
+    pkt_tcp_mss(&pb, 1460);
+    ep->packet_len = pkt_finalize(&pb, &ep->tmpl);
+}
+
+void send_probe(int s, endpoint_t *ep, int probe) {
+    tmpl_set_tcp_seq(&ep->tmpl, ep->seq_base + probe);
+    tmpl_set_ip_id(&ep->tmpl, (uint16_t)rand());
+    ep->sent_at[probe] = now_ms();
+    if (sendto(s, ep->packet, ep->packet_len, 0, (struct sockaddr *)&ep->addr, sizeof(ep->addr)) < 0) {
+        perror("sendto failed");
+        ep->sent_at[probe] = 0;
+        return;
+    }
+    ep->sent++;
+}
+
+// Tear down the half-open connection the server created for our SYN
+void send_rst(int s, endpoint_t *ep, uint32_t seq) {
+    char packet[64];
+    struct pkt_builder pb;
+    pkt_init(&pb, packet, sizeof(packet));
+    pkt_ipv4(&pb, ep->source, ep->addr.sin_addr.s_addr, 64);
+    pkt_tcp(&pb, ep->sport, ntohs(ep->addr.sin_port), seq, 0, TH_RST, 0);
+    size_t len = pkt_finalize(&pb, NULL);
+    if (len > 0) sendto(s, packet, len, 0, (struct sockaddr *)&ep->addr, sizeof(ep->addr));
+}
+
+/* Match a received TCP segment against outstanding probes, using the
+ * kernel receive timestamp when available. */
+void handle_segment(int s, unsigned char *buf, ssize_t n, double rx_time) {
+    struct iphdr *iph = (struct iphdr *)buf;
+    size_t ihl = iph->ihl * 4;
+    if ((size_t)n < ihl + sizeof(struct tcphdr) || iph->protocol != IPPROTO_TCP) return;
+    struct tcphdr *tcph = (struct tcphdr *)(buf + ihl);
+
+    uint16_t dport = ntohs(tcph->dest);
+    if (dport < BASE_PORT || dport >= BASE_PORT + endpoint_count) return;
+    endpoint_t *ep = &endpoints[dport - BASE_PORT];
+    if (iph->saddr != ep->addr.sin_addr.s_addr || tcph->source != ep->addr.sin_port) return;
+    if (!tcph->ack || !(tcph->syn || tcph->rst)) return;
+
+    uint32_t probe = ntohl(tcph->ack_seq) - 1 - ep->seq_base;
+    if (probe >= (uint32_t)probe_count || ep->sent_at[probe] == 0 || ep->rtt[probe] >= 0) return;
+
+    ep->rtt[probe] = rx_time - ep->sent_at[probe];
+    if (tcph->syn) {
+        ep->synack++;
+        send_rst(s, ep, ntohl(tcph->ack_seq));
+    } else {
+        ep->rst++;
+    }
+}
+
+void drain(int s) {
+    unsigned char buf[1500];
+    char control[256];
+    struct iovec iov = {.iov_base = buf, .iov_len = sizeof(buf)};
+    struct msghdr msg;
+    ssize_t n;
+
+    for (;;) {
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        if ((n = recvmsg(s, &msg, MSG_DONTWAIT)) <= 0) break;
+
+        double rx_time = now_ms();
+        for (struct cmsghdr *c = CMSG_FIRSTHDR(&msg); c != NULL; c = CMSG_NXTHDR(&msg, c)) {
+            if (c->cmsg_level == SOL_SOCKET && c->cmsg_type == SCM_TIMESTAMPNS) {
+                struct timespec ts;
+                memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+                rx_time = ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+            }
+        }
+        handle_segment(s, buf, n, rx_time);
+    }
+}
+
+void wait_for(int s, double ms) {
+    struct pollfd pfd = {.fd = s, .events = POLLIN};
+    double deadline = now_ms() + ms, remaining;
+    while ((remaining = deadline - now_ms()) > 0) {
+        if (poll(&pfd, 1, (int)remaining + 1) > 0) drain(s);
+    }
+}
+
+int compare_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// Nearest-rank percentile of a sorted array
+double percentile(const double *v, int n, double p) {
+    int idx = (int)(p / 100.0 * n + 0.999999) - 1;
+    if (idx < 0) idx = 0;
+    if (idx >= n) idx = n - 1;
+    return v[idx];
+}
+
+void report(endpoint_t *ep) {
+    double v[probe_count];
+    int n = 0;
+    double sum = 0;
+
+    for (int i = 0; i < probe_count; i++) {
+        if (ep->rtt[i] >= 0) {
+            v[n++] = ep->rtt[i];
+            sum += ep->rtt[i];
+        }
+    }
+    int lost = ep->sent - n;
+    printf("%-22s %4d %4d %4d %5.1f%%", ep->name, ep->sent, ep->synack, ep->rst,
+           ep->sent ? 100.0 * lost / ep->sent : 0.0);
+    if (n == 0) {
+        printf("  %9s %9s %9s %9s %9s\n", "-", "-", "-", "-", "-");
+        return;
+    }
+    qsort(v, n, sizeof(double), compare_double);
+    printf("  %9.3f %9.3f %9.3f %9.3f %9.3f\n", v[0], percentile(v, n, 50), percentile(v, n, 90),
+           v[n - 1], sum / n);
+}
+
+int main(int argc, char *argv[]) {
+    int interval_ms = 1000;
+    int timeout_ms = 2000;
+    int opt;
+
+    srand(time(NULL) ^ getpid());
+    while ((opt = getopt(argc, argv, "c:i:w:s:")) != -1) {
+        switch (opt) {
+        case 'c': probe_count = atoi(optarg); break;
+        case 'i': interval_ms = atoi(optarg); break;
+        case 'w': timeout_ms = atoi(optarg); break;
+        case 's': forced_source = inet_addr(optarg); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || probe_count < 1 || interval_ms < 1) {
+        printf("Usage: sudo %s [-c count] [-i interval_ms] [-w timeout_ms] [-s source_ip] <IP:port>...\n", argv[0]);
+        return 1;
+    }
+    for (int i = optind; i < argc; i++) add_endpoint(argv[i]);
+
+    // One raw socket sends our SYN/RST segments and sees every incoming TCP segment
+    int s = socket(AF_INET, SOCK_RAW, IPPROTO_TCP);
+    if (s < 0) {
+        perror("Failed to create socket (Run as root)");
+        exit(1);
+    }
+    int one = 1;
+    if (setsockopt(s, IPPROTO_IP, IP_HDRINCL, &one, sizeof(one)) < 0) {
+        perror("Error setting IP_HDRINCL");
+        exit(1);
+    }
+    setsockopt(s, SOL_SOCKET, SO_TIMESTAMPNS, &one, sizeof(one));
+
+    for (int i = 0; i < endpoint_count; i++) {
+        endpoint_t *ep = &endpoints[i];
+        build_template(ep);
+        ep->sent_at = calloc(probe_count, sizeof(double));
+        ep->rtt = malloc(probe_count * sizeof(double));
+        for (int p = 0; p < probe_count; p++) ep->rtt[p] = -1;
+    }
+
+    printf("TCP handshake probe: %d endpoint(s), %d SYN(s) each, %d ms apart\n\n",
+           endpoint_count, probe_count, interval_ms);
+
+    // Paced rounds: one SYN per endpoint, spread evenly over the interval
+    for (int p = 0; p < probe_count; p++) {
+        for (int i = 0; i < endpoint_count; i++) {
+            send_probe(s, &endpoints[i], p);
+            wait_for(s, (double)interval_ms / endpoint_count);
+        }
+    }
+    wait_for(s, timeout_ms);
+
+    printf("%-22s %4s %4s %4s %6s  %9s %9s %9s %9s %9s\n", "Endpoint", "Sent", "SYN+", "RST", "Loss",
+           "Min(ms)", "P50", "P90", "Max", "Avg");
+    for (int i = 0; i < endpoint_count; i++) report(&endpoints[i]);
+
+    close(s);
+    for (int i = 0; i < endpoint_count; i++) {
+        free(endpoints[i].sent_at);
+        free(endpoints[i].rtt);
+    }
+    return 0;
+}
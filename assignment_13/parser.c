@@ -1,55 +1,491 @@
 #include <stdio.h>
-#include <pcap.h>
-#include <netinet/ip.h>
-#include <netinet/tcp.h>
-#include <netinet/udp.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <arpa/inet.h>
 #include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include <netinet/if_ether.h>
 #include <net/ethernet.h>
 #include <time.h>
+#include "../common/capture.h"
+#include "../common/dissect.h"
 
-void packet_handler(u_char *args, const struct pcap_pkthdr *header, const u_char *packet) {
-    struct ether_header *eth_header = (struct ether_header *) packet;
-    static long start_sec = 0;
-    if (start_sec == 0) start_sec = header->ts.tv_sec;
+/**
+ * Protocol sequence parser and time-diagram generator.
+ *
+ * ICMP/ICMPv6 echo requests are paired with their replies and ARP who-has
+ * with is-at through a hash table keyed on (src, dst, id, seq), so matching
+ * stays O(1) per packet for captures with millions of pings. For every host
+ * pair it reports requests, answers, loss and RTT statistics, prints log2
+ * RTT histograms, and draws the first messages as a text sequence diagram
+ * and optionally as a Mermaid sequenceDiagram (-m) like assignment_04.
+ */
 
-    double timestamp = (header->ts.tv_sec - start_sec) + (header->ts.tv_usec / 1000000.0);
-    
-    printf("[%0.6f] ", timestamp);
+#define INITIAL_SLOTS 4096
+#define MAX_PARTICIPANTS 8
+#define LANE_WIDTH 22
+#define HIST_BUCKETS 32       // log2 buckets of microseconds
 
-    if (ntohs(eth_header->ether_type) == ETHERTYPE_IP) {
-        struct ip *ip_header = (struct ip *)(packet + sizeof(struct ether_header));
-        
-        if (ip_header->ip_p == IPPROTO_ICMP) {
-            printf("ICMP Packet Detected\n");
-            printf("    |--- (L2: Ethernet) --- (L3: IPv4) --- (L4: ICMP)\n");
-        } else if (ip_header->ip_p == IPPROTO_TCP) {
-            printf("TCP Packet Detected\n");
-        } else if (ip_header->ip_p == IPPROTO_UDP) {
-            printf("UDP Packet Detected\n");
+enum kind { KIND_ICMP, KIND_ICMP6, KIND_ARP, KIND_COUNT };
+static const char *kind_names[KIND_COUNT] = {"ICMP", "ICMPv6", "ARP"};
+
+struct exch_key {
+    uint8_t src[16];           // requester
+    uint8_t dst[16];           // responder
+    uint16_t id;
+    uint16_t seq;
+    uint8_t kind;
+    uint8_t pad[3];
+};
+
+// Start of every hash table slot
+struct slot {
+    struct exch_key key;
+    uint8_t used;
+};
+
+struct exchange {
+    struct slot head;
+    int64_t sent_ns;
+    uint32_t pair;             // index into pairs[]
+    uint32_t serial;           // order of the request, for the diagram
+    uint8_t answered;
+};
+
+// Requester, responder and kind (id/seq zero) -> pair number
+struct pair_slot {
+    struct slot head;
+    uint32_t pair;
+};
+
+struct pair_stats {
+    struct exch_key key;       // id/seq are zero
+    uint64_t sent;
+    uint64_t answered;
+    double rtt_min, rtt_max, rtt_sum, rtt_sumsq;   // ms
+};
+
+// One message drawn in the sequence diagram
+struct event {
+    double t;                  // seconds since the first packet
+    int from, to;              // participant indices
+    int reply;
+    uint32_t serial;           // request serial this message belongs to
+    double rtt_ms;             // replies only
+    char label[64];
+};
+
+struct table {
+    void *slots;
+    size_t cap, count, slot_size;
+};
+
+struct table exchanges = {NULL, 0, 0, sizeof(struct exchange)};
+struct table pair_index = {NULL, 0, 0, sizeof(struct pair_slot)};
+struct pair_stats *pairs = NULL;
+size_t pair_count = 0, pair_cap = 0;
+
+uint64_t hist[KIND_COUNT][HIST_BUCKETS];
+uint64_t unmatched_replies = 0, duplicate_replies = 0;
+uint32_t next_serial = 0;
+
+struct event *events;
+int event_limit = 40, event_count = 0;
+uint8_t *answered_serials;     // answered flag per request serial < event_limit
+uint8_t participants[MAX_PARTICIPANTS][16];
+int participant_family[MAX_PARTICIPANTS];
+int participant_count = 0;
+
+int quiet = 0;
+int64_t start_ns = -1;
+
+uint64_t hash_key(const struct exch_key *k) {
+    const uint8_t *p = (const uint8_t *)k;
+    uint64_t h = 0xcbf29ce484222325ull;   // FNV-1a
+    for (size_t i = 0; i < sizeof(*k); i++) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+struct slot *slot_at(struct table *t, size_t i) {
+    return (struct slot *)((uint8_t *)t->slots + i * t->slot_size);
+}
+
+// Find the slot for `k`, or the empty slot where it belongs (linear probing)
+struct slot *table_find(struct table *t, const struct exch_key *k) {
+    size_t i = hash_key(k) & (t->cap - 1);
+    while (slot_at(t, i)->used && memcmp(&slot_at(t, i)->key, k, sizeof(*k)) != 0) i = (i + 1) & (t->cap - 1);
+    return slot_at(t, i);
+}
+
+// Find or insert, setting *created (if given) for a new, zeroed slot; the table is
+// kept at most half full
+struct slot *table_insert(struct table *t, const struct exch_key *k, int *created) {
+    if (2 * (t->count + 1) > t->cap) {
+        struct table grown = {calloc(t->cap ? 2 * t->cap : INITIAL_SLOTS, t->slot_size),
+                              t->cap ? 2 * t->cap : INITIAL_SLOTS, t->count, t->slot_size};
+        if (grown.slots == NULL) {
+            perror("calloc failed");
+            exit(1);
         }
-    } else if (ntohs(eth_header->ether_type) == ETHERTYPE_ARP) {
-        printf("ARP Packet Detected\n");
-        printf("    |--- (L2: Ethernet) --- (L3: ARP)\n");
+        for (size_t i = 0; i < t->cap; i++)
+            if (slot_at(t, i)->used) memcpy(table_find(&grown, &slot_at(t, i)->key), slot_at(t, i), t->slot_size);
+        free(t->slots);
+        *t = grown;
+    }
+    struct slot *e = table_find(t, k);
+    if (created) *created = !e->used;
+    if (!e->used) {
+        memset(e, 0, t->slot_size);
+        e->key = *k;
+        e->used = 1;
+        t->count++;
+    }
+    return e;
+}
+
+uint32_t pair_for(const struct exch_key *k) {
+    struct exch_key pk = *k;
+    pk.id = pk.seq = 0;
+    int created;
+    struct pair_slot *slot = (struct pair_slot *)table_insert(&pair_index, &pk, &created);
+    if (created) {
+        if (pair_count == pair_cap) {
+            pair_cap = pair_cap ? 2 * pair_cap : 64;
+            pairs = realloc(pairs, pair_cap * sizeof(*pairs));
+            if (pairs == NULL) {
+                perror("realloc failed");
+                exit(1);
+            }
+        }
+        memset(&pairs[pair_count], 0, sizeof(*pairs));
+        pairs[pair_count].key = pk;
+        pairs[pair_count].rtt_min = 1e18;
+        slot->pair = pair_count++;
+    }
+    return slot->pair;
+}
+
+int participant(const uint8_t *addr, int family) {
+    for (int i = 0; i < participant_count; i++)
+        if (participant_family[i] == family && memcmp(participants[i], addr, family == 6 ? 16 : 4) == 0) return i;
+    if (participant_count == MAX_PARTICIPANTS) return -1;
+    memset(participants[participant_count], 0, 16);
+    memcpy(participants[participant_count], addr, family == 6 ? 16 : 4);
+    participant_family[participant_count] = family;
+    return participant_count++;
+}
+
+void add_event(double t, const uint8_t *from, const uint8_t *to, int family, int reply, uint32_t serial,
+               double rtt_ms, const char *label) {
+    if (event_count == event_limit) return;
+    int a = participant(from, family), b = participant(to, family);
+    if (a < 0 || b < 0) return;
+    struct event *ev = &events[event_count++];
+    ev->t = t;
+    ev->from = a;
+    ev->to = b;
+    ev->reply = reply;
+    ev->serial = serial;
+    ev->rtt_ms = rtt_ms;
+    snprintf(ev->label, sizeof(ev->label), "%s", label);
+}
+
+void record_request(const struct exch_key *k, int64_t ts_ns, int family, const char *label) {
+    struct exchange *e = (struct exchange *)table_insert(&exchanges, k, NULL);
+    uint32_t p = pair_for(k);
+
+    // A key seen again (sequence wrap, ARP retry) starts a new exchange
+    e->pair = p;
+    e->sent_ns = ts_ns;
+    e->answered = 0;
+    e->serial = next_serial++;
+    pairs[p].sent++;
+    add_event((ts_ns - start_ns) / 1e9, k->src, k->dst, family, 0, e->serial, 0, label);
+}
+
+void record_reply(const struct exch_key *k, int64_t ts_ns, int family, const char *label) {
+    struct exchange *e = exchanges.cap ? (struct exchange *)table_find(&exchanges, k) : NULL;
+    char text[64];
+
+    if (e == NULL || !e->head.used) {
+        unmatched_replies++;
+        return;
+    }
+    if (e->answered) {
+        duplicate_replies++;
+        return;
+    }
+    e->answered = 1;
+
+    double rtt = (ts_ns - e->sent_ns) / 1e6;
+    struct pair_stats *ps = &pairs[e->pair];
+    ps->answered++;
+    ps->rtt_sum += rtt;
+    ps->rtt_sumsq += rtt * rtt;
+    if (rtt < ps->rtt_min) ps->rtt_min = rtt;
+    if (rtt > ps->rtt_max) ps->rtt_max = rtt;
+
+    int bucket = 0;
+    for (double us = rtt * 1000; us >= 1 && bucket < HIST_BUCKETS - 1; us /= 2) bucket++;
+    hist[k->kind][bucket]++;
+
+    if (e->serial < (uint32_t)event_limit) answered_serials[e->serial] = 1;
+    snprintf(text, sizeof(text), "%s (%.3f ms)", label, rtt);
+    add_event((ts_ns - start_ns) / 1e9, k->dst, k->src, family, 1, e->serial, rtt, text);
+}
+
+void handle_icmp(const struct cap_packet *pkt, const struct dissection *d) {
+    struct exch_key k;
+    char label[64];
+    int family = d->family;
+
+    int kind = family == 6 ? KIND_ICMP6 : KIND_ICMP;
+    int request = family == 6 ? d->icmp_type == ICMP6_ECHO_REQUEST : d->icmp_type == ICMP_ECHO;
+    int reply = family == 6 ? d->icmp_type == ICMP6_ECHO_REPLY : d->icmp_type == ICMP_ECHOREPLY;
+    if (!request && !reply) return;
+
+    memset(&k, 0, sizeof(k));
+    k.kind = kind;
+    k.id = d->echo_id;
+    k.seq = d->echo_seq;
+    // Keys are always (requester, responder)
+    memcpy(k.src, request ? d->saddr : d->daddr, family == 6 ? 16 : 4);
+    memcpy(k.dst, request ? d->daddr : d->saddr, family == 6 ? 16 : 4);
+
+    snprintf(label, sizeof(label), "%s Echo %s (seq %u)", kind_names[kind], request ? "Request" : "Reply", k.seq);
+    if (request) record_request(&k, pkt->ts_ns, family, label);
+    else record_reply(&k, pkt->ts_ns, family, label);
+}
+
+void handle_arp(const struct cap_packet *pkt, const struct dissection *d) {
+    const struct ether_arp *a = (const struct ether_arp *)(pkt->data + d->l3_off);
+    struct exch_key k;
+    char label[64], ip[INET_ADDRSTRLEN];
+
+    if (ntohs(a->arp_pro) != ETHERTYPE_IP || a->arp_pln != 4) return;
+    if (d->arp_opcode != ARPOP_REQUEST && d->arp_opcode != ARPOP_REPLY) return;
+
+    memset(&k, 0, sizeof(k));
+    k.kind = KIND_ARP;
+    if (d->arp_opcode == ARPOP_REQUEST) {
+        memcpy(k.src, d->saddr, 4);
+        memcpy(k.dst, d->daddr, 4);
+        inet_ntop(AF_INET, d->daddr, ip, sizeof(ip));
+        snprintf(label, sizeof(label), "ARP Who has %s?", ip);
+        record_request(&k, pkt->ts_ns, 4, label);
+    } else {
+        memcpy(k.src, d->daddr, 4);
+        memcpy(k.dst, d->saddr, 4);
+        const uint8_t *m = a->arp_sha;
+        snprintf(label, sizeof(label), "ARP is at %02x:%02x:%02x:%02x:%02x:%02x", m[0], m[1], m[2], m[3], m[4], m[5]);
+        record_reply(&k, pkt->ts_ns, 4, label);
     }
 }
 
+const char *l2_name(const struct dissection *d) {
+    if (d->layers & DISSECT_ETH) return "Ethernet";
+    if (d->layers & DISSECT_SLL) return "Linux cooked";
+    return "Raw";
+}
+
+void packet_handler(const struct cap_packet *pkt) {
+    struct dissection d;
+
+    if (start_ns < 0) start_ns = pkt->ts_ns;
+    double timestamp = (pkt->ts_ns - start_ns) / 1e9;
+
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+
+    if (d.layers & DISSECT_IPV4) {
+        if (d.l4_proto == IPPROTO_ICMP) {
+            if (!quiet) {
+                printf("[%0.6f] ICMP Packet Detected\n", timestamp);
+                printf("    |--- (L2: %s) --- (L3: IPv4) --- (L4: ICMP)\n", l2_name(&d));
+            }
+            if (d.layers & DISSECT_ICMP) handle_icmp(pkt, &d);
+        } else if (d.l4_proto == IPPROTO_TCP) {
+            if (!quiet) printf("[%0.6f] TCP Packet Detected\n", timestamp);
+        } else if (d.l4_proto == IPPROTO_UDP) {
+            if (!quiet) printf("[%0.6f] UDP Packet Detected\n", timestamp);
+        }
+    } else if (d.layers & DISSECT_IPV6) {
+        if (d.l4_proto == IPPROTO_ICMPV6) {
+            if (!quiet) {
+                printf("[%0.6f] ICMPv6 Packet Detected\n", timestamp);
+                printf("    |--- (L2: %s) --- (L3: IPv6) --- (L4: ICMPv6)\n", l2_name(&d));
+            }
+            if (d.layers & DISSECT_ICMPV6) handle_icmp(pkt, &d);
+        }
+    } else if (d.layers & DISSECT_ARP) {
+        if (!quiet) {
+            printf("[%0.6f] ARP Packet Detected\n", timestamp);
+            printf("    |--- (L2: %s) --- (L3: ARP)\n", l2_name(&d));
+        }
+        handle_arp(pkt, &d);
+    }
+}
+
+void format_addr(char *out, size_t size, const uint8_t *addr, int kind) {
+    inet_ntop(kind == KIND_ICMP6 ? AF_INET6 : AF_INET, addr, out, size);
+}
+
+void print_pairs(void) {
+    printf("\nRequest/reply pairs\n");
+    printf("%-7s %-26s %-26s %8s %8s %7s %10s %10s %10s %10s\n", "Kind", "Requester", "Responder", "Sent",
+           "Answered", "Loss", "Min(ms)", "Avg(ms)", "Max(ms)", "StdDev");
+    for (size_t i = 0; i < pair_count; i++) {
+        const struct pair_stats *ps = &pairs[i];
+        char src[INET6_ADDRSTRLEN], dst[INET6_ADDRSTRLEN];
+        format_addr(src, sizeof(src), ps->key.src, ps->key.kind);
+        format_addr(dst, sizeof(dst), ps->key.dst, ps->key.kind);
+        printf("%-7s %-26s %-26s %8lu %8lu %6.1f%%", kind_names[ps->key.kind], src, dst, (unsigned long)ps->sent,
+               (unsigned long)ps->answered, ps->sent ? 100.0 * (ps->sent - ps->answered) / ps->sent : 0.0);
+        if (ps->answered == 0) {
+            printf(" %10s %10s %10s %10s\n", "-", "-", "-", "-");
+            continue;
+        }
+        double avg = ps->rtt_sum / ps->answered;
+        double var = ps->rtt_sumsq / ps->answered - avg * avg;
+        printf(" %10.3f %10.3f %10.3f %10.3f\n", ps->rtt_min, avg, ps->rtt_max, sqrt(var > 0 ? var : 0));
+    }
+    printf("Unmatched replies: %lu, duplicate replies: %lu\n", (unsigned long)unmatched_replies,
+           (unsigned long)duplicate_replies);
+}
+
+void print_histograms(void) {
+    for (int kind = 0; kind < KIND_COUNT; kind++) {
+        uint64_t total = 0, peak = 0;
+        int lo = HIST_BUCKETS, hi = -1;
+        for (int b = 0; b < HIST_BUCKETS; b++) {
+            total += hist[kind][b];
+            if (hist[kind][b] > peak) peak = hist[kind][b];
+            if (hist[kind][b]) {
+                if (b < lo) lo = b;
+                hi = b;
+            }
+        }
+        if (total == 0) continue;
+
+        printf("\nRTT histogram (%s, %lu replies)\n", kind_names[kind], (unsigned long)total);
+        for (int b = lo; b <= hi; b++) {
+            double from = b == 0 ? 0 : ldexp(1, b - 1), to = ldexp(1, b);   // microseconds
+            int bar = (int)(40.0 * hist[kind][b] / peak + 0.5);
+            printf("  [%9.0f us, %9.0f us) %10lu  ", from, to, (unsigned long)hist[kind][b]);
+            for (int i = 0; i < bar; i++) putchar('#');
+            putchar('\n');
+        }
+    }
+}
+
+const char *participant_name(int i, char *buf, size_t size) {
+    inet_ntop(participant_family[i] == 6 ? AF_INET6 : AF_INET, participants[i], buf, size);
+    return buf;
+}
+
+void print_text_diagram(void) {
+    char name[INET6_ADDRSTRLEN];
+    if (event_count == 0) return;
+
+    printf("\nSequence diagram (first %d messages)\n", event_count);
+    printf("%12s", "");
+    for (int p = 0; p < participant_count; p++) printf("%-*.*s", LANE_WIDTH, LANE_WIDTH - 1, participant_name(p, name, sizeof(name)));
+    printf("\n");
+
+    for (int i = 0; i < event_count; i++) {
+        const struct event *ev = &events[i];
+        char lanes[MAX_PARTICIPANTS * LANE_WIDTH + 1];
+        int width = participant_count * LANE_WIDTH;
+        memset(lanes, ' ', width);
+        lanes[width] = '\0';
+        for (int p = 0; p < participant_count; p++) lanes[p * LANE_WIDTH + 2] = '|';
+
+        int a = ev->from * LANE_WIDTH + 2, b = ev->to * LANE_WIDTH + 2;
+        int lo = a < b ? a : b, hi = a < b ? b : a;
+        for (int x = lo + 1; x < hi; x++) lanes[x] = '-';
+        if (a < b) lanes[hi - 1] = '>';
+        else if (a > b) lanes[lo + 1] = '<';
+
+        const char *lost = !ev->reply && ev->serial < (uint32_t)event_limit && !answered_serials[ev->serial] ? "  [no reply]" : "";
+        printf("%10.6f  %s %s%s\n", ev->t, lanes, ev->label, lost);
+    }
+}
+
+// Mermaid sequenceDiagram in the style of assignment_04/timeDiagram.md
+int write_mermaid(const char *path) {
+    char name[INET6_ADDRSTRLEN];
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+
+    fprintf(fp, "```mermaid\nsequenceDiagram\n");
+    for (int p = 0; p < participant_count; p++)
+        fprintf(fp, "    participant H%d as %s\n", p + 1, participant_name(p, name, sizeof(name)));
+    fprintf(fp, "\n");
+    for (int i = 0; i < event_count; i++) {
+        const struct event *ev = &events[i];
+        fprintf(fp, "    H%d%sH%d: [%.6f s] %s\n", ev->from + 1, ev->reply ? "-->>" : "->>", ev->to + 1, ev->t, ev->label);
+        if (!ev->reply && ev->serial < (uint32_t)event_limit && !answered_serials[ev->serial])
+            fprintf(fp, "    Note over H%d: no reply\n", ev->from + 1);
+    }
+    fprintf(fp, "```\n");
+    return fclose(fp);
+}
+
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        printf("Usage: %s <pcap_file>\n", argv[0]);
+    const char *mermaid_path = NULL;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "qm:l:")) != -1) {
+        switch (opt) {
+        case 'q': quiet = 1; break;
+        case 'm': mermaid_path = optarg; break;
+        case 'l': event_limit = atoi(optarg); break;
+        default: optind = argc + 1; break;
+        }
+    }
+    if (optind >= argc || event_limit < 0) {
+        printf("Usage: %s [-q] [-m diagram.md] [-l diagram_messages] <pcap_or_pcapng_file>\n", argv[0]);
+        printf("  -q  skip the per-packet listing\n");
         return 1;
     }
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-    pcap_t *handle = pcap_open_offline(argv[1], errbuf);
+    struct capture cap;
+    struct cap_packet pkt;
+    int rc;
+
+    if (cap_open(&cap, argv[optind]) < 0) {
+        fprintf(stderr, "Error opening capture: %s\n", cap.err);
+        return 1;
+    }
 
-    if (handle == NULL) {
-        fprintf(stderr, "Error opening pcap: %s\n", errbuf);
+    events = calloc((size_t)event_limit + 1, sizeof(*events));
+    answered_serials = calloc((size_t)event_limit + 1, 1);
+    if (events == NULL || answered_serials == NULL) {
+        perror("calloc failed");
         return 1;
     }
 
-    printf("Time (s)   | Protocol Sequence\n");
-    printf("-----------|------------------\n");
-    pcap_loop(handle, 0, packet_handler, NULL);
-    pcap_close(handle);
+    if (!quiet) {
+        printf("Time (s)   | Protocol Sequence\n");
+        printf("-----------|------------------\n");
+    }
+    while ((rc = cap_next(&cap, &pkt)) > 0) packet_handler(&pkt);
+    if (rc < 0) fprintf(stderr, "Stopped early: %s\n", cap.err);
+    cap_close(&cap);
+
+    print_pairs();
+    print_histograms();
+    print_text_diagram();
+    if (mermaid_path) {
+        if (write_mermaid(mermaid_path) != 0) perror("Cannot write Mermaid diagram");
+        else printf("\nMermaid diagram written to %s\n", mermaid_path);
+    }
+
+    free(events);
+    free(answered_serials);
+    free(exchanges.slots);
+    free(pair_index.slots);
+    free(pairs);
     return 0;
-}
\ No newline at end of file
+}
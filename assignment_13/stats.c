@@ -0,0 +1,251 @@
+#include "stats.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include "../common/dissect.h"
+#include "../common/colexport.h"
+
+#define INITIAL_FLOWS 1024
+
+static const char *proto_names[PROTO_COUNT] = {
+    "ARP", "IPv4", "IPv6", "TCP", "UDP", "ICMP", "ICMPv6", "Other IP", "Other L2",
+};
+
+static uint64_t hash_key(const struct flow_key *k) {
+    const uint8_t *p = (const uint8_t *)k;
+    uint64_t h = 0xcbf29ce484222325ull;   // FNV-1a
+    for (size_t i = 0; i < sizeof(*k); i++) h = (h ^ p[i]) * 0x100000001b3ull;
+    return h ^ (h >> 29);
+}
+
+void stats_init(struct cap_stats *s) {
+    memset(s, 0, sizeof(*s));
+    s->first_ns = INT64_MAX;
+    s->last_ns = INT64_MIN;
+    s->flow_cap = INITIAL_FLOWS;
+    s->flows = calloc(s->flow_cap, sizeof(struct flow_stats));
+    if (s->flows == NULL) {
+        perror("calloc failed");
+        exit(1);
+    }
+}
+
+static struct flow_stats *find_slot(struct flow_stats *table, size_t cap, const struct flow_key *k) {
+    size_t i = hash_key(k) & (cap - 1);
+    while (table[i].used && memcmp(&table[i].key, k, sizeof(*k)) != 0) i = (i + 1) & (cap - 1);
+    return &table[i];
+}
+
+static void grow(struct cap_stats *s) {
+    size_t cap = s->flow_cap * 2;
+    struct flow_stats *table = calloc(cap, sizeof(struct flow_stats));
+    if (table == NULL) {
+        perror("calloc failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < s->flow_cap; i++) {
+        if (s->flows[i].used) *find_slot(table, cap, &s->flows[i].key) = s->flows[i];
+    }
+    free(s->flows);
+    s->flows = table;
+    s->flow_cap = cap;
+}
+
+// Find or create the entry for `k`
+static struct flow_stats *flow_entry(struct cap_stats *s, const struct flow_key *k) {
+    if (2 * (s->flow_count + 1) > s->flow_cap) grow(s);
+    struct flow_stats *f = find_slot(s->flows, s->flow_cap, k);
+    if (!f->used) {
+        f->key = *k;
+        f->used = 1;
+        f->first_ns = INT64_MAX;
+        f->last_ns = INT64_MIN;
+        s->flow_count++;
+    }
+    return f;
+}
+
+static void count(struct cap_stats *s, enum stats_proto p, uint32_t len) {
+    s->proto_packets[p]++;
+    s->proto_bytes[p] += len;
+}
+
+/* Classify one packet and update its flow. The dissector bounds-checks every
+ * header against caplen since the data comes straight from the capture file. */
+void stats_packet(struct cap_stats *s, const struct cap_packet *pkt) {
+    struct dissection d;
+    struct flow_key k;
+
+    s->packets++;
+    s->bytes += pkt->len;
+    if (pkt->ts_ns < s->first_ns) s->first_ns = pkt->ts_ns;
+    if (pkt->ts_ns > s->last_ns) s->last_ns = pkt->ts_ns;
+
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+    if (d.layers & DISSECT_ARP) {
+        count(s, PROTO_ARP, pkt->len);
+        return;
+    }
+    if (!(d.layers & (DISSECT_IPV4 | DISSECT_IPV6))) {
+        count(s, PROTO_OTHER_L2, pkt->len);
+        return;
+    }
+
+    count(s, d.family == 4 ? PROTO_IPV4 : PROTO_IPV6, pkt->len);
+    memset(&k, 0, sizeof(k));
+    k.family = d.family;
+    k.proto = d.l4_proto;
+    memcpy(k.saddr, d.saddr, sizeof(k.saddr));
+    memcpy(k.daddr, d.daddr, sizeof(k.daddr));
+
+    switch (k.proto) {
+    case IPPROTO_TCP:
+    case IPPROTO_UDP:
+        count(s, k.proto == IPPROTO_TCP ? PROTO_TCP : PROTO_UDP, pkt->len);
+        if (d.layers & (DISSECT_TCP | DISSECT_UDP)) {
+            k.sport = d.sport;
+            k.dport = d.dport;
+        }
+        break;
+    case IPPROTO_ICMP: count(s, PROTO_ICMP, pkt->len); break;
+    case IPPROTO_ICMPV6: count(s, PROTO_ICMPV6, pkt->len); break;
+    default: count(s, PROTO_OTHER_IP, pkt->len); break;
+    }
+
+    struct flow_stats *f = flow_entry(s, &k);
+    f->packets++;
+    f->bytes += pkt->len;
+    if (pkt->ts_ns < f->first_ns) f->first_ns = pkt->ts_ns;
+    if (pkt->ts_ns > f->last_ns) f->last_ns = pkt->ts_ns;
+}
+
+void stats_merge(struct cap_stats *dst, const struct cap_stats *src) {
+    dst->packets += src->packets;
+    dst->bytes += src->bytes;
+    if (src->first_ns < dst->first_ns) dst->first_ns = src->first_ns;
+    if (src->last_ns > dst->last_ns) dst->last_ns = src->last_ns;
+    for (int p = 0; p < PROTO_COUNT; p++) {
+        dst->proto_packets[p] += src->proto_packets[p];
+        dst->proto_bytes[p] += src->proto_bytes[p];
+    }
+    for (size_t i = 0; i < src->flow_cap; i++) {
+        const struct flow_stats *sf = &src->flows[i];
+        if (!sf->used) continue;
+        struct flow_stats *df = flow_entry(dst, &sf->key);
+        df->packets += sf->packets;
+        df->bytes += sf->bytes;
+        if (sf->first_ns < df->first_ns) df->first_ns = sf->first_ns;
+        if (sf->last_ns > df->last_ns) df->last_ns = sf->last_ns;
+    }
+}
+
+// Bytes descending, then packets, then key: a total order, so reports are reproducible
+static int compare_flows(const void *a, const void *b) {
+    const struct flow_stats *x = *(const struct flow_stats *const *)a;
+    const struct flow_stats *y = *(const struct flow_stats *const *)b;
+    if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+    if (x->packets != y->packets) return x->packets < y->packets ? 1 : -1;
+    return memcmp(&x->key, &y->key, sizeof(x->key));
+}
+
+// Flows in report order; the caller frees the array
+static const struct flow_stats **sorted_flows(const struct cap_stats *s) {
+    const struct flow_stats **sorted = malloc((s->flow_count ? s->flow_count : 1) * sizeof(*sorted));
+    size_t n = 0;
+    if (sorted == NULL) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (size_t i = 0; i < s->flow_cap; i++)
+        if (s->flows[i].used) sorted[n++] = &s->flows[i];
+    qsort(sorted, n, sizeof(*sorted), compare_flows);
+    return sorted;
+}
+
+static void format_endpoint(char *out, size_t size, const struct flow_key *k, const uint8_t *addr, uint16_t port) {
+    char ip[INET6_ADDRSTRLEN];
+    inet_ntop(k->family == 6 ? AF_INET6 : AF_INET, addr, ip, sizeof(ip));
+    if (k->proto == IPPROTO_TCP || k->proto == IPPROTO_UDP)
+        snprintf(out, size, k->family == 6 ? "[%s]:%u" : "%s:%u", ip, port);
+    else
+        snprintf(out, size, "%s", ip);
+}
+
+// Protocol column of the flow table; protocols without a name print as their number
+static const char *flow_proto_name(uint8_t proto, char *buf, size_t size) {
+    switch (proto) {
+    case IPPROTO_TCP: return "tcp";
+    case IPPROTO_UDP: return "udp";
+    case IPPROTO_ICMP: return "icmp";
+    case IPPROTO_ICMPV6: return "icmpv6";
+    default: snprintf(buf, size, "%u", proto); return buf;
+    }
+}
+
+void stats_print(const struct cap_stats *s, int top_flows) {
+    double duration = s->packets ? (s->last_ns - s->first_ns) / 1e9 : 0;
+
+    printf("Packets: %lu   Bytes: %lu   Duration: %.6f s   Flows: %zu\n\n", (unsigned long)s->packets,
+           (unsigned long)s->bytes, duration, s->flow_count);
+    printf("%-10s %12s %14s\n", "Protocol", "Packets", "Bytes");
+    printf("--------------------------------------\n");
+    for (int p = 0; p < PROTO_COUNT; p++) {
+        if (s->proto_packets[p] == 0) continue;
+        printf("%-10s %12lu %14lu\n", proto_names[p], (unsigned long)s->proto_packets[p],
+               (unsigned long)s->proto_bytes[p]);
+    }
+
+    if (s->flow_count == 0 || top_flows <= 0) return;
+
+    const struct flow_stats **sorted = sorted_flows(s);
+    size_t n = s->flow_count;
+
+    printf("\nTop %zu flows by bytes\n", n < (size_t)top_flows ? n : (size_t)top_flows);
+    printf("%-6s %-46s %-46s %10s %12s %12s\n", "Proto", "Source", "Destination", "Packets", "Bytes", "Duration(s)");
+    for (size_t i = 0; i < n && i < (size_t)top_flows; i++) {
+        const struct flow_stats *f = sorted[i];
+        char src[64], dst[64], proto[4];
+        format_endpoint(src, sizeof(src), &f->key, f->key.saddr, f->key.sport);
+        format_endpoint(dst, sizeof(dst), &f->key, f->key.daddr, f->key.dport);
+        printf("%-6s %-46s %-46s %10lu %12lu %12.6f\n", flow_proto_name(f->key.proto, proto, sizeof(proto)), src,
+               dst, (unsigned long)f->packets, (unsigned long)f->bytes, (f->last_ns - f->first_ns) / 1e9);
+    }
+    free(sorted);
+}
+
+int stats_export_flows(const struct cap_stats *s, const char *path) {
+    enum { C_FAMILY, C_PROTO, C_SRC, C_DST, C_SPORT, C_DPORT, C_PACKETS, C_BYTES, C_FIRST, C_LAST, C_COUNT };
+    static const struct col_def defs[C_COUNT] = {
+        {"family", COL_U8}, {"proto", COL_U8}, {"src", COL_BYTES16}, {"dst", COL_BYTES16},
+        {"sport", COL_U16}, {"dport", COL_U16}, {"packets", COL_U64}, {"bytes", COL_U64},
+        {"first_ns", COL_I64}, {"last_ns", COL_I64},
+    };
+    struct col_writer w;
+
+    if (col_open(&w, path, defs, C_COUNT, 0) < 0) return -1;
+    const struct flow_stats **sorted = sorted_flows(s);
+    for (size_t i = 0; i < s->flow_count; i++) {
+        const struct flow_stats *f = sorted[i];
+        *(uint8_t *)col_cell(&w, C_FAMILY) = f->key.family;
+        *(uint8_t *)col_cell(&w, C_PROTO) = f->key.proto;
+        memcpy(col_cell(&w, C_SRC), f->key.saddr, 16);
+        memcpy(col_cell(&w, C_DST), f->key.daddr, 16);
+        *(uint16_t *)col_cell(&w, C_SPORT) = f->key.sport;
+        *(uint16_t *)col_cell(&w, C_DPORT) = f->key.dport;
+        *(uint64_t *)col_cell(&w, C_PACKETS) = f->packets;
+        *(uint64_t *)col_cell(&w, C_BYTES) = f->bytes;
+        *(int64_t *)col_cell(&w, C_FIRST) = f->first_ns;
+        *(int64_t *)col_cell(&w, C_LAST) = f->last_ns;
+        col_commit(&w);
+    }
+    free(sorted);
+    return col_close(&w);
+}
+
+void stats_free(struct cap_stats *s) {
+    free(s->flows);
+    s->flows = NULL;
+}
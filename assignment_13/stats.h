@@ -0,0 +1,70 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include "../common/capture.h"
+
+/**
+ * Protocol and flow statistics for a capture.
+ *
+ * Each analysis thread fills its own struct cap_stats; the partial results
+ * are then combined with stats_merge(). Every counter is a sum, minimum or
+ * maximum and the report is sorted by value and then by flow key, so the
+ * output is the same no matter how the capture was split or in which order
+ * the parts are merged.
+ */
+
+enum stats_proto {
+    PROTO_ARP,
+    PROTO_IPV4,
+    PROTO_IPV6,
+    PROTO_TCP,
+    PROTO_UDP,
+    PROTO_ICMP,
+    PROTO_ICMPV6,
+    PROTO_OTHER_IP,
+    PROTO_OTHER_L2,
+    PROTO_COUNT
+};
+
+// Addresses are stored as 16 bytes; IPv4 uses the first 4
+struct flow_key {
+    uint8_t saddr[16];
+    uint8_t daddr[16];
+    uint16_t sport;
+    uint16_t dport;
+    uint8_t proto;
+    uint8_t family;        // 4 or 6
+};
+
+struct flow_stats {
+    struct flow_key key;
+    uint64_t packets;
+    uint64_t bytes;
+    int64_t first_ns;
+    int64_t last_ns;
+    int used;
+};
+
+struct cap_stats {
+    uint64_t packets;
+    uint64_t bytes;            // original (wire) length
+    int64_t first_ns;
+    int64_t last_ns;
+    uint64_t proto_packets[PROTO_COUNT];
+    uint64_t proto_bytes[PROTO_COUNT];
+    struct flow_stats *flows;  // open-addressing hash table
+    size_t flow_cap;           // power of two
+    size_t flow_count;
+};
+
+void stats_init(struct cap_stats *s);
+void stats_packet(struct cap_stats *s, const struct cap_packet *pkt);
+void stats_merge(struct cap_stats *dst, const struct cap_stats *src);
+void stats_print(const struct cap_stats *s, int top_flows);
+/* Write every flow, in report order, as a column chunk file (common/colexport.h).
+ * Returns 0, or -1 with errno set. */
+int stats_export_flows(const struct cap_stats *s, const char *path);
+void stats_free(struct cap_stats *s);
+
+#endif
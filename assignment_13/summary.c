@@ -0,0 +1,428 @@
+#include "summary.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+#define SLOT_COUNT (2 * SUMMARY_ENTRIES)   // hash index at most half full
+
+// Lower bound of each frame length bucket; the last one is open-ended
+static const uint32_t size_bounds[SUMMARY_SIZE_BUCKETS] = {0, 20, 40, 80, 160, 320, 640, 1280, 2560, 5120};
+static const char *class_names[SIZE_CLASSES] = {"all", "tcp", "udp", "icmp", "other"};
+
+static uint64_t hash_key(const struct summary_key *k) {
+    uint64_t w[5], h = 0;
+    memcpy(w, k, sizeof(w));
+    for (int i = 0; i < 5; i++) h = (h ^ w[i] ^ (h >> 31)) * 0x9e3779b97f4a7c15ull;
+    h = (h ^ (h >> 33)) * 0xff51afd7ed558ccdull;   // MurmurHash3 finalizer: the low bits pick the slot
+    return h ^ (h >> 33);
+}
+
+static void table_init(struct summary_table *t) {
+    memset(t, 0, sizeof(*t));
+    t->entries = calloc(SUMMARY_ENTRIES, sizeof(*t->entries));
+    t->slots = calloc(SLOT_COUNT, sizeof(*t->slots));
+    t->heap = malloc(SUMMARY_ENTRIES * sizeof(*t->heap));
+    if (t->entries == NULL || t->slots == NULL || t->heap == NULL) {
+        perror("calloc failed");
+        exit(1);
+    }
+}
+
+void summary_init(struct summary *s) {
+    memset(s, 0, sizeof(*s));
+    s->first_ns = INT64_MAX;
+    s->last_ns = INT64_MIN;
+    strcpy(s->nodes[0].name, "frame");
+    s->node_count = 1;
+    s->io_interval_ns = 1000000000;
+    table_init(&s->endpoints);
+    table_init(&s->conversations);
+}
+
+static void heap_swap(struct summary_table *t, uint32_t i, uint32_t j) {
+    struct summary_heap a = t->heap[i];
+    t->heap[i] = t->heap[j];
+    t->heap[j] = a;
+    t->entries[t->heap[i].entry].heap_pos = i;
+    t->entries[t->heap[j].entry].heap_pos = j;
+}
+
+// Move a new, light entry at `i` towards the root
+static void sift_up(struct summary_table *t, uint32_t i) {
+    while (i > 0 && t->heap[i].weight < t->heap[(i - 1) / 2].weight) {
+        heap_swap(t, i, (i - 1) / 2);
+        i = (i - 1) / 2;
+    }
+}
+
+// Restore the heap after the weight at `i` grew
+static void sift_down(struct summary_table *t, uint32_t i) {
+    for (;;) {
+        uint32_t l = 2 * i + 1, r = l + 1, m = i;
+        if (l < t->count && t->heap[l].weight < t->heap[m].weight) m = l;
+        if (r < t->count && t->heap[r].weight < t->heap[m].weight) m = r;
+        if (m == i) return;
+        heap_swap(t, i, m);
+        i = m;
+    }
+}
+
+// Slot holding `k`, or the empty slot where it would go
+static uint32_t find_slot(const struct summary_table *t, const struct summary_key *k, uint32_t hash) {
+    uint32_t i = hash & (SLOT_COUNT - 1);
+    for (; t->slots[i].entry; i = (i + 1) & (SLOT_COUNT - 1)) {
+        if (t->slots[i].hash == hash && memcmp(&t->entries[t->slots[i].entry - 1].key, k, sizeof(*k)) == 0) break;
+    }
+    return i;
+}
+
+// Empty slot `i`, moving later entries of the probe run back so lookups still find them
+static void clear_slot(struct summary_table *t, uint32_t i) {
+    for (uint32_t j = (i + 1) & (SLOT_COUNT - 1); t->slots[j].entry; j = (j + 1) & (SLOT_COUNT - 1)) {
+        uint32_t home = t->slots[j].hash & (SLOT_COUNT - 1);
+        if (((j - home) & (SLOT_COUNT - 1)) >= ((j - i) & (SLOT_COUNT - 1))) {
+            t->slots[i] = t->slots[j];
+            i = j;
+        }
+    }
+    t->slots[i].entry = 0;
+}
+
+/* Find or admit the entry for `k`. A full table gives up its lightest entry:
+ * the newcomer takes over that entry's weight as its error, so the heap
+ * order is unchanged. */
+static struct summary_entry *table_entry(struct summary_table *t, const struct summary_key *k) {
+    uint32_t hash = hash_key(k), slot = find_slot(t, k, hash), n;
+    if (t->slots[slot].entry) return &t->entries[t->slots[slot].entry - 1];
+
+    if (t->count < SUMMARY_ENTRIES) {
+        n = t->count++;
+        t->heap[n] = (struct summary_heap){0, n};
+        t->entries[n].heap_pos = n;
+        memset(&t->entries[n], 0, offsetof(struct summary_entry, heap_pos));
+        sift_up(t, n);
+    } else {
+        n = t->heap[0].entry;
+        struct summary_entry *old = &t->entries[n];
+        clear_slot(t, find_slot(t, &old->key, hash_key(&old->key)));
+        slot = find_slot(t, k, hash);
+        memset(old, 0, offsetof(struct summary_entry, heap_pos));
+        old->error = t->heap[0].weight;
+        t->evicted++;
+    }
+    struct summary_entry *e = &t->entries[n];
+    e->key = *k;
+    e->first_ns = INT64_MAX;
+    e->last_ns = INT64_MIN;
+    t->slots[slot] = (struct summary_slot){n + 1, hash};
+    return e;
+}
+
+static void table_add(struct summary_table *t, const struct summary_key *k, int dir, uint32_t len, int64_t ts) {
+    struct summary_entry *e = table_entry(t, k);
+    e->packets[dir]++;
+    e->bytes[dir] += len;
+    if (ts < e->first_ns) e->first_ns = ts;
+    if (ts > e->last_ns) e->last_ns = ts;
+    t->heap[e->heap_pos].weight += len;
+    sift_down(t, e->heap_pos);
+}
+
+// Child of `parent` called `name`, created if needed; -1 once the table is full
+static int child_node(struct summary *s, int parent, const char *name) {
+    for (int i = 1; i < s->node_count; i++) {
+        if (s->nodes[i].parent == parent && strcmp(s->nodes[i].name, name) == 0) return i;
+    }
+    if (s->node_count == SUMMARY_NODES) return -1;
+    struct summary_node *n = &s->nodes[s->node_count];
+    strcpy(n->name, name);   // callers pass names of at most 23 characters
+    n->parent = parent;
+    return s->node_count++;
+}
+
+static const char *ip_proto_name(uint8_t proto, char *buf, size_t size) {
+    switch (proto) {
+    case IPPROTO_TCP: return "tcp";
+    case IPPROTO_UDP: return "udp";
+    case IPPROTO_ICMP: return "icmp";
+    case IPPROTO_ICMPV6: return "icmpv6";
+    case IPPROTO_IGMP: return "igmp";
+    case IPPROTO_GRE: return "gre";
+    case IPPROTO_ESP: return "esp";
+    case IPPROTO_AH: return "ah";
+    case IPPROTO_SCTP: return "sctp";
+    default: snprintf(buf, size, "ipproto-%u", proto); return buf;
+    }
+}
+
+// Layer names of a packet from the frame down, Wireshark style
+static void build_path(struct summary *s, struct summary_path *p, uint16_t linktype, const struct dissection *d) {
+    char names[SUMMARY_DEPTH][24];
+    int n = 0;
+
+    if (d->layers & DISSECT_ETH) strcpy(names[n++], "eth");
+    else if (d->layers & DISSECT_SLL) strcpy(names[n++], "sll");
+    else if (linktype == CAP_LINK_NULL) strcpy(names[n++], "null");
+    else if (linktype == CAP_LINK_RAW || linktype == CAP_LINK_IPV4 || linktype == CAP_LINK_IPV6) strcpy(names[n++], "raw");
+    else snprintf(names[n++], sizeof(names[0]), "linktype-%u", linktype);
+
+    for (int v = 0; v < d->vlan_count && v < 3; v++) strcpy(names[n++], "vlan");
+
+    // The dissector records the ethertype even when the L3 header is cut off
+    switch (d->ethertype) {
+    case 0: break;
+    case 0x0800: strcpy(names[n++], "ip"); break;
+    case 0x86dd: strcpy(names[n++], "ipv6"); break;
+    case 0x0806: strcpy(names[n++], "arp"); break;
+    default: snprintf(names[n++], sizeof(names[0]), "ethertype-0x%04x", d->ethertype); break;
+    }
+    if (d->l4_off != DISSECT_NONE) {
+        char buf[24];
+        strcpy(names[n++], ip_proto_name(d->l4_proto, buf, sizeof(buf)));
+    } else if (d->layers & DISSECT_FRAGMENT) {
+        strcpy(names[n++], "fragment");
+    }
+    if (d->layers & DISSECT_TRUNCATED) strcpy(names[n++], "malformed");
+    else if (d->payload_off != DISSECT_NONE && d->payload_len > 0) strcpy(names[n++], "data");
+
+    p->nodes[0] = 0;
+    p->depth = 1;
+    p->cut = 0;
+    for (int i = 0; i < n; i++) {
+        int node = child_node(s, p->nodes[p->depth - 1], names[i]);
+        if (node < 0) {
+            p->cut = 1;
+            break;
+        }
+        p->nodes[p->depth++] = node;
+    }
+}
+
+/* Everything build_path() looks at, packed into one word (never 0). */
+static uint64_t path_signature(uint16_t linktype, const struct dissection *d) {
+    uint64_t vlans = d->vlan_count < 3 ? d->vlan_count : 3;
+    uint64_t has_l4 = d->l4_off != DISSECT_NONE;
+    uint64_t has_payload = d->payload_off != DISSECT_NONE && d->payload_len > 0;
+    return 1ull << 63 | (d->layers & 0xfff) | vlans << 12 | has_l4 << 14 | has_payload << 15 |
+           (uint64_t)d->l4_proto << 16 | (uint64_t)d->ethertype << 24 | (uint64_t)linktype << 40;
+}
+
+static int size_bucket(uint32_t len) {
+    if (len < 20) return 0;
+    int b = 32 - __builtin_clz(len / 20);
+    return b < SUMMARY_SIZE_BUCKETS ? b : SUMMARY_SIZE_BUCKETS - 1;
+}
+
+// Double the I/O interval, folding pairs of bins into one
+static void coarsen_io(struct summary *s) {
+    for (uint32_t i = 0; i < SUMMARY_IO_BINS / 2; i++) {
+        s->io_packets[i] = s->io_packets[2 * i] + s->io_packets[2 * i + 1];
+        s->io_bytes[i] = s->io_bytes[2 * i] + s->io_bytes[2 * i + 1];
+    }
+    memset(s->io_packets + SUMMARY_IO_BINS / 2, 0, SUMMARY_IO_BINS / 2 * sizeof(s->io_packets[0]));
+    memset(s->io_bytes + SUMMARY_IO_BINS / 2, 0, SUMMARY_IO_BINS / 2 * sizeof(s->io_bytes[0]));
+    s->io_interval_ns *= 2;
+    s->io_used = (s->io_used + 1) / 2;
+}
+
+void summary_packet(struct summary *s, const struct cap_packet *pkt, const struct dissection *d) {
+    if (s->packets++ == 0) s->io_start_ns = pkt->ts_ns;
+    s->bytes += pkt->len;
+    if (pkt->ts_ns < s->first_ns) s->first_ns = pkt->ts_ns;
+    if (pkt->ts_ns > s->last_ns) s->last_ns = pkt->ts_ns;
+
+    uint64_t sig = path_signature(pkt->linktype, d);
+    struct summary_path *p = &s->paths[(sig * 0x9e3779b97f4a7c15ull) >> 56 & (SUMMARY_PATH_CACHE - 1)];
+    if (p->signature != sig) {
+        build_path(s, p, pkt->linktype, d);
+        p->signature = sig;
+    }
+    for (int i = 0; i < p->depth; i++) {
+        s->nodes[p->nodes[i]].packets++;
+        s->nodes[p->nodes[i]].bytes += pkt->len;
+    }
+    s->unplaced += p->cut;
+
+    int b = size_bucket(pkt->len);
+    s->sizes[SIZE_ALL][b]++;
+    if (d->layers & DISSECT_TCP) s->sizes[SIZE_TCP][b]++;
+    else if (d->layers & DISSECT_UDP) s->sizes[SIZE_UDP][b]++;
+    else if (d->layers & (DISSECT_ICMP | DISSECT_ICMPV6)) s->sizes[SIZE_ICMP][b]++;
+    else s->sizes[SIZE_OTHER][b]++;
+
+    // Packets before the first one (out-of-order captures) go into the first bin
+    uint64_t bin = pkt->ts_ns > s->io_start_ns ? (uint64_t)(pkt->ts_ns - s->io_start_ns) / s->io_interval_ns : 0;
+    while (bin >= SUMMARY_IO_BINS) {
+        coarsen_io(s);
+        bin /= 2;
+    }
+    s->io_packets[bin]++;
+    s->io_bytes[bin] += pkt->len;
+    if (bin >= s->io_used) s->io_used = bin + 1;
+
+    if (!(d->layers & (DISSECT_IPV4 | DISSECT_IPV6))) return;
+
+    struct summary_key k;
+    memset(&k, 0, sizeof(k));
+    k.family = d->family;
+    memcpy(k.a, d->saddr, 16);
+    table_add(&s->endpoints, &k, 0, pkt->len, pkt->ts_ns);
+    memcpy(k.a, d->daddr, 16);
+    table_add(&s->endpoints, &k, 1, pkt->len, pkt->ts_ns);
+
+    uint16_t sport = 0, dport = 0;
+    if (d->layers & (DISSECT_TCP | DISSECT_UDP)) {
+        sport = d->sport;
+        dport = d->dport;
+    }
+    int cmp = memcmp(d->saddr, d->daddr, 16);
+    int forward = cmp < 0 || (cmp == 0 && sport <= dport);
+    k.proto = d->l4_proto;
+    memcpy(k.a, forward ? d->saddr : d->daddr, 16);
+    memcpy(k.b, forward ? d->daddr : d->saddr, 16);
+    k.aport = forward ? sport : dport;
+    k.bport = forward ? dport : sport;
+    table_add(&s->conversations, &k, !forward, pkt->len, pkt->ts_ns);
+}
+
+// Bytes descending, then name: children are listed in a reproducible order
+static int compare_nodes(const void *a, const void *b) {
+    const struct summary_node *x = *(const struct summary_node *const *)a;
+    const struct summary_node *y = *(const struct summary_node *const *)b;
+    if (x->bytes != y->bytes) return x->bytes < y->bytes ? 1 : -1;
+    return strcmp(x->name, y->name);
+}
+
+static void write_node(const struct summary *s, FILE *fp, int node) {
+    const struct summary_node *children[SUMMARY_NODES];
+    int n = 0;
+
+    for (int i = 1; i < s->node_count; i++) {
+        if (s->nodes[i].parent == node) children[n++] = &s->nodes[i];
+    }
+    qsort(children, n, sizeof(children[0]), compare_nodes);
+    fprintf(fp, "{\"name\":\"%s\",\"packets\":%lu,\"bytes\":%lu", s->nodes[node].name,
+            (unsigned long)s->nodes[node].packets, (unsigned long)s->nodes[node].bytes);
+    if (n > 0) {
+        fprintf(fp, ",\"children\":[");
+        for (int i = 0; i < n; i++) {
+            if (i) fputc(',', fp);
+            write_node(s, fp, children[i] - s->nodes);
+        }
+        fputc(']', fp);
+    }
+    fputc('}', fp);
+}
+
+/* Observed bytes descending (a lower bound on the true count, whereas the
+ * weight of a recently admitted key is mostly inherited error), then smaller
+ * error, then packets, then key. */
+static int compare_entries(const void *a, const void *b) {
+    const struct summary_entry *x = *(const struct summary_entry *const *)a;
+    const struct summary_entry *y = *(const struct summary_entry *const *)b;
+    uint64_t bx = x->bytes[0] + x->bytes[1], by = y->bytes[0] + y->bytes[1];
+    if (bx != by) return bx < by ? 1 : -1;
+    if (x->error != y->error) return x->error > y->error ? 1 : -1;
+    uint64_t px = x->packets[0] + x->packets[1], py = y->packets[0] + y->packets[1];
+    if (px != py) return px < py ? 1 : -1;
+    return memcmp(&x->key, &y->key, sizeof(x->key));
+}
+
+// The heaviest `top` entries; the caller frees the array
+static const struct summary_entry **top_entries(const struct summary_table *t, int top, uint32_t *n) {
+    const struct summary_entry **sorted = malloc((t->count ? t->count : 1) * sizeof(*sorted));
+    if (sorted == NULL) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < t->count; i++) sorted[i] = &t->entries[i];
+    qsort(sorted, t->count, sizeof(*sorted), compare_entries);
+    *n = top < 0 ? 0 : (uint32_t)top < t->count ? (uint32_t)top : t->count;
+    return sorted;
+}
+
+static const char *format_addr(char *out, size_t size, const struct summary_key *k, const uint8_t *addr) {
+    inet_ntop(k->family == 6 ? AF_INET6 : AF_INET, addr, out, size);
+    return out;
+}
+
+static void write_table_header(FILE *fp, const char *name, const struct summary_table *t) {
+    fprintf(fp, ",\"%s\":{\"capacity\":%d,\"tracked\":%u,\"evicted\":%lu,\"top\":[", name, SUMMARY_ENTRIES, t->count,
+            (unsigned long)t->evicted);
+}
+
+static void write_u64_array(FILE *fp, const char *name, const uint64_t *v, uint32_t n) {
+    fprintf(fp, "\"%s\":[", name);
+    for (uint32_t i = 0; i < n; i++) fprintf(fp, i ? ",%lu" : "%lu", (unsigned long)v[i]);
+    fputc(']', fp);
+}
+
+int summary_json(const struct summary *s, FILE *fp, int top) {
+    char a[INET6_ADDRSTRLEN], b[INET6_ADDRSTRLEN];
+    const struct summary_entry **sorted;
+    uint32_t n;
+
+    fprintf(fp, "{\"packets\":%lu,\"bytes\":%lu,\"first_ns\":%ld,\"last_ns\":%ld,\"duration_s\":%.6f",
+            (unsigned long)s->packets, (unsigned long)s->bytes, (long)(s->packets ? s->first_ns : 0),
+            (long)(s->packets ? s->last_ns : 0), s->packets ? (s->last_ns - s->first_ns) / 1e9 : 0.0);
+
+    fprintf(fp, ",\"protocols\":");
+    write_node(s, fp, 0);
+    fprintf(fp, ",\"unplaced_packets\":%lu", (unsigned long)s->unplaced);
+
+    write_table_header(fp, "endpoints", &s->endpoints);
+    sorted = top_entries(&s->endpoints, top, &n);
+    for (uint32_t i = 0; i < n; i++) {
+        const struct summary_entry *e = sorted[i];
+        fprintf(fp, "%s{\"addr\":\"%s\",\"sent_packets\":%lu,\"sent_bytes\":%lu,\"received_packets\":%lu,"
+                    "\"received_bytes\":%lu,\"error_bytes\":%lu}", i ? "," : "", format_addr(a, sizeof(a), &e->key, e->key.a),
+                (unsigned long)e->packets[0], (unsigned long)e->bytes[0], (unsigned long)e->packets[1],
+                (unsigned long)e->bytes[1], (unsigned long)e->error);
+    }
+    free(sorted);
+    fprintf(fp, "]}");
+
+    write_table_header(fp, "conversations", &s->conversations);
+    sorted = top_entries(&s->conversations, top, &n);
+    for (uint32_t i = 0; i < n; i++) {
+        const struct summary_entry *e = sorted[i];
+        fprintf(fp, "%s{\"proto\":%u,\"a\":\"%s\",\"a_port\":%u,\"b\":\"%s\",\"b_port\":%u,\"a_to_b_packets\":%lu,"
+                    "\"a_to_b_bytes\":%lu,\"b_to_a_packets\":%lu,\"b_to_a_bytes\":%lu,\"first_ns\":%ld,\"last_ns\":%ld,"
+                    "\"error_bytes\":%lu}", i ? "," : "", e->key.proto, format_addr(a, sizeof(a), &e->key, e->key.a),
+                e->key.aport, format_addr(b, sizeof(b), &e->key, e->key.b), e->key.bport,
+                (unsigned long)e->packets[0], (unsigned long)e->bytes[0], (unsigned long)e->packets[1],
+                (unsigned long)e->bytes[1], (long)e->first_ns, (long)e->last_ns, (unsigned long)e->error);
+    }
+    free(sorted);
+    fprintf(fp, "]}");
+
+    fprintf(fp, ",\"sizes\":{\"bounds\":[");
+    for (int i = 0; i < SUMMARY_SIZE_BUCKETS; i++) fprintf(fp, i ? ",%u" : "%u", size_bounds[i]);
+    fputc(']', fp);
+    for (int c = 0; c < SIZE_CLASSES; c++) {
+        fputc(',', fp);
+        write_u64_array(fp, class_names[c], s->sizes[c], SUMMARY_SIZE_BUCKETS);
+    }
+
+    fprintf(fp, "},\"io\":{\"start_ns\":%ld,\"interval_ns\":%ld,", (long)s->io_start_ns, (long)s->io_interval_ns);
+    write_u64_array(fp, "packets", s->io_packets, s->io_used);
+    fputc(',', fp);
+    write_u64_array(fp, "bytes", s->io_bytes, s->io_used);
+    fprintf(fp, "}}\n");
+    return ferror(fp) ? -1 : 0;
+}
+
+static void table_free(struct summary_table *t) {
+    free(t->entries);
+    free(t->slots);
+    free(t->heap);
+    t->entries = NULL;
+}
+
+void summary_free(struct summary *s) {
+    table_free(&s->endpoints);
+    table_free(&s->conversations);
+}
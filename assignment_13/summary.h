@@ -0,0 +1,126 @@
+#ifndef SUMMARY_H
+#define SUMMARY_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "../common/capture.h"
+#include "../common/dissect.h"
+
+/**
+ * One-pass capture summary with fixed memory, written as compact JSON.
+ *
+ * - Protocol hierarchy: packets and bytes per layer path (frame > eth > vlan >
+ *   ip > tcp > data), like Wireshark's Statistics > Protocol Hierarchy. The
+ *   path of a packet only depends on a few dissection fields, so it is looked
+ *   up in a small cache instead of being rebuilt for every packet.
+ * - Endpoint and conversation tables: IP addresses and address/port pairs
+ *   (both directions of a conversation in one entry). Each table holds at most
+ *   SUMMARY_ENTRIES keys; once it is full a new key replaces the entry with the
+ *   fewest bytes (Space-Saving), inheriting its count as an error bound. The
+ *   tables are exact while they have not evicted anything, and any key with
+ *   more than total_bytes / SUMMARY_ENTRIES bytes is always kept.
+ * - Frame length histograms with Wireshark's buckets (0-19, 20-39, 40-79, ...,
+ *   5120+), overall and per transport protocol.
+ * - I/O graph: packets and bytes per interval since the first packet. The
+ *   interval starts at one second and doubles (merging neighbouring bins)
+ *   whenever the capture outgrows SUMMARY_IO_BINS bins.
+ *
+ * Packets must be fed in capture order; nothing here is thread-safe.
+ */
+
+#define SUMMARY_NODES 128          // protocol hierarchy nodes, including the root
+#define SUMMARY_DEPTH 8            // layers per path, including the root
+#define SUMMARY_PATH_CACHE 256     // direct-mapped, power of two
+#define SUMMARY_ENTRIES 16384      // per endpoint / conversation table
+#define SUMMARY_SIZE_BUCKETS 10
+#define SUMMARY_IO_BINS 4096
+
+enum summary_class { SIZE_ALL, SIZE_TCP, SIZE_UDP, SIZE_ICMP, SIZE_OTHER, SIZE_CLASSES };
+
+struct summary_node {
+    char name[24];
+    uint16_t parent;
+    uint64_t packets;
+    uint64_t bytes;
+};
+
+struct summary_path {
+    uint64_t signature;        // 0: empty slot
+    uint8_t depth;
+    uint8_t cut;               // the node table was full before the last layer
+    uint16_t nodes[SUMMARY_DEPTH];
+};
+
+// Conversation key with the lower (address, port) first; an endpoint only uses `a`
+struct summary_key {
+    uint8_t a[16];
+    uint8_t b[16];
+    uint16_t aport;
+    uint16_t bport;
+    uint8_t proto;
+    uint8_t family;            // 4 or 6
+    uint16_t pad;              // always 0, so the key can be hashed as five words
+};
+
+struct summary_entry {
+    struct summary_key key;
+    uint64_t packets[2];       // conversation: a to b, b to a; endpoint: sent, received
+    uint64_t bytes[2];
+    uint64_t error;            // bytes the key may have had before it was (re)admitted
+    int64_t first_ns;
+    int64_t last_ns;
+    uint32_t heap_pos;
+};
+
+// The hash and weight copies keep probing and sifting out of the entries
+struct summary_slot {
+    uint32_t entry;            // entry number + 1, 0 when empty
+    uint32_t hash;
+};
+
+struct summary_heap {
+    uint64_t weight;           // error + bytes of the entry: the most it can have had
+    uint32_t entry;
+};
+
+struct summary_table {
+    struct summary_entry *entries;
+    struct summary_slot *slots;   // hash index
+    struct summary_heap *heap;    // min-heap on weight
+    uint32_t count;
+    uint64_t evicted;
+};
+
+struct summary {
+    uint64_t packets;
+    uint64_t bytes;            // original (wire) length
+    int64_t first_ns;
+    int64_t last_ns;
+
+    struct summary_node nodes[SUMMARY_NODES];
+    int node_count;
+    uint64_t unplaced;         // packets whose path did not fit in the node table
+    struct summary_path paths[SUMMARY_PATH_CACHE];
+
+    struct summary_table endpoints;
+    struct summary_table conversations;
+
+    uint64_t sizes[SIZE_CLASSES][SUMMARY_SIZE_BUCKETS];
+
+    int64_t io_start_ns;
+    int64_t io_interval_ns;
+    uint32_t io_used;          // bins up to the last one with a packet
+    uint64_t io_packets[SUMMARY_IO_BINS];
+    uint64_t io_bytes[SUMMARY_IO_BINS];
+};
+
+/* Allocate the tables; this is all the memory a summary ever uses. */
+void summary_init(struct summary *s);
+/* Account one packet, already decoded into `d`. */
+void summary_packet(struct summary *s, const struct cap_packet *pkt, const struct dissection *d);
+/* Write the summary as one line of JSON, with at most `top` endpoints and
+ * conversations (by bytes). Returns 0, or -1 if writing failed. */
+int summary_json(const struct summary *s, FILE *fp, int top);
+void summary_free(struct summary *s);
+
+#endif
@@ -0,0 +1,460 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include "../common/simutil.h"
+#include "../common/topology.h"
+
+/**
+ * Flow-level ECMP simulator for the leaf-spine fabric of
+ * leaf_spine_topology.py, at sizes Mininet cannot emulate.
+ *
+ * The fabric is built in memory with the same parameters (spines, leaves,
+ * hosts per leaf, radix) and checks. Flows between hosts get a 5-tuple from
+ * the hosts' 10.0.<leaf>.<host> addresses and random ports, and a size that
+ * is fixed or Pareto distributed (a few elephants carry most bytes).
+ *
+ * Routing is generic shortest-path ECMP: flows are bucketed by destination
+ * leaf, a BFS from that leaf over the switches gives every switch its hop
+ * count, and the next-hop group of a switch (neighbours one hop closer) is
+ * built the first time a flow passes through it. A switch picks
+ * group[hash % size] with the configured hash of the 5-tuple, as switch
+ * ASICs do, and the flow's bytes are added to every port it crosses.
+ *
+ * The report gives the load per tier (host uplinks, leaf uplinks, spine
+ * downlinks, host downlinks) with max/mean and coefficient of variation, and
+ * the spread across the equal-cost uplinks of each leaf, which is what the
+ * hash controls. -H all routes the same flows with every hash for comparison.
+ */
+
+enum pattern { UNIFORM, PERMUTATION, STRIDE };
+enum hash_fn { HASH_CRC32, HASH_XOR, HASH_FNV, HASH_TOEPLITZ, HASH_MURMUR, HASH_COUNT };
+
+const char *hash_names[HASH_COUNT] = {"crc32", "xor", "fnv", "toeplitz", "murmur"};
+const char *pattern_names[] = {"uniform", "permutation", "stride"};
+
+struct flow {
+    uint32_t src, dst;             // host nodes
+    uint32_t saddr, daddr;
+    uint16_t sport, dport;
+    uint8_t proto;
+    double bytes;
+};
+
+struct port_load {
+    uint64_t flows;
+    double bytes;
+};
+
+uint32_t crc_table[256];
+uint32_t toeplitz_table[12][256];   // contribution of each input byte value
+
+// The 5-tuple as it appears in the headers: addresses, ports, protocol
+void flow_bytes(const struct flow *f, uint8_t out[13]) {
+    uint32_t s = f->saddr, d = f->daddr;
+    for (int i = 0; i < 4; i++) {
+        out[i] = s >> (24 - 8 * i);
+        out[4 + i] = d >> (24 - 8 * i);
+    }
+    out[8] = f->sport >> 8;
+    out[9] = f->sport;
+    out[10] = f->dport >> 8;
+    out[11] = f->dport;
+    out[12] = f->proto;
+}
+
+/* Toeplitz hash with the default Microsoft RSS key over addresses and ports,
+ * as NICs spread receive queues. The hash is linear in the input bits, so it
+ * is the XOR of per-byte contributions precomputed by hash_init(). */
+uint32_t toeplitz_bitwise(const uint8_t *in, int len) {
+    static const uint8_t key[40] = {
+        0x6d, 0x5a, 0x56, 0xda, 0x25, 0x5b, 0x0e, 0xc2, 0x41, 0x67, 0x25, 0x3d, 0x43, 0xa3,
+        0x8f, 0xb0, 0xd0, 0xca, 0x2b, 0xcb, 0xae, 0x7b, 0x30, 0xb4, 0x77, 0xcb, 0x2d, 0xa3,
+        0x80, 0x30, 0xf2, 0x0c, 0x6a, 0x42, 0xb7, 0x3b, 0xbe, 0xac, 0x01, 0xfa,
+    };
+    uint32_t result = 0, window = (uint32_t)key[0] << 24 | key[1] << 16 | key[2] << 8 | key[3];
+    for (int i = 0; i < len; i++) {
+        for (int b = 7; b >= 0; b--) {
+            if (in[i] >> b & 1) result ^= window;
+            window = window << 1 | (key[i + 4] >> b & 1);
+        }
+    }
+    return result;
+}
+
+uint32_t toeplitz(const uint8_t in[12]) {
+    uint32_t h = 0;
+    for (int i = 0; i < 12; i++) h ^= toeplitz_table[i][in[i]];
+    return h;
+}
+
+void hash_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+        crc_table[i] = c;
+    }
+    uint8_t in[12] = {0};
+    for (int pos = 0; pos < 12; pos++) {
+        for (int v = 0; v < 256; v++) {
+            in[pos] = v;
+            toeplitz_table[pos][v] = toeplitz_bitwise(in, 12);
+        }
+        in[pos] = 0;
+    }
+}
+
+uint32_t flow_hash(const struct flow *f, enum hash_fn fn) {
+    uint8_t b[13];
+    uint32_t h;
+
+    switch (fn) {
+    case HASH_CRC32:
+        flow_bytes(f, b);
+        h = 0xffffffff;
+        for (int i = 0; i < 13; i++) h = crc_table[(h ^ b[i]) & 0xff] ^ (h >> 8);
+        return ~h;
+    case HASH_XOR:
+        // Fold everything into 16 bits, as simple hardware does
+        h = f->saddr ^ f->daddr ^ ((uint32_t)f->sport << 16 | f->dport) ^ f->proto;
+        return (h ^ h >> 16) & 0xffff;
+    case HASH_FNV:
+        flow_bytes(f, b);
+        h = 2166136261u;
+        for (int i = 0; i < 13; i++) h = (h ^ b[i]) * 16777619u;
+        return h;
+    case HASH_TOEPLITZ:
+        flow_bytes(f, b);
+        return toeplitz(b);
+    default: {
+        uint64_t ports = (uint64_t)f->sport << 24 | (uint64_t)f->dport << 8 | f->proto;
+        uint64_t x = ((uint64_t)f->saddr << 32 | f->daddr) ^ (ports * 0x9e3779b97f4a7c15ull);
+        x = (x ^ x >> 33) * 0xff51afd7ed558ccdull;
+        x = (x ^ x >> 33) * 0xc4ceb9fe1a85ec53ull;
+        return (uint32_t)(x ^ x >> 33);
+    }
+    }
+}
+
+void make_flows(const struct topology *t, struct flow *flows, uint32_t count, enum pattern p, int pareto) {
+    static const uint16_t dports[] = {80, 443, 443, 443, 22, 8080, 25, 5201, 53, 4789};
+    uint32_t hosts = t->host_count;
+    uint32_t *perm = NULL;
+
+    if (p == PERMUTATION) {
+        // Sattolo's shuffle gives a single cycle, so nobody sends to itself
+        perm = malloc(hosts * sizeof(*perm));
+        for (uint32_t i = 0; i < hosts; i++) perm[i] = i;
+        for (uint32_t i = hosts - 1; i > 0; i--) {
+            uint32_t j = sim_below(i), tmp = perm[i];
+            perm[i] = perm[j];
+            perm[j] = tmp;
+        }
+    }
+
+    // Pareto with shape 1.2 and mean 100 KB: most bytes are in a few elephants
+    const double shape = 1.2, mean = 100e3, scale = mean * (shape - 1) / shape;
+    for (uint32_t i = 0; i < count; i++) {
+        struct flow *f = &flows[i];
+        uint32_t s, d;
+        switch (p) {
+        case PERMUTATION:
+            s = i % hosts;
+            d = perm[s];
+            break;
+        case STRIDE:
+            s = i % hosts;
+            d = (s + t->hosts_per_leaf) % hosts;
+            if (d == s) d = (s + 1) % hosts;   // a single leaf
+            break;
+        default:
+            s = sim_below(hosts);
+            d = sim_below(hosts - 1);
+            if (d >= s) d++;
+            break;
+        }
+        f->src = topo_host_node(t, s);
+        f->dst = topo_host_node(t, d);
+        f->saddr = t->nodes[f->src].addr;
+        f->daddr = t->nodes[f->dst].addr;
+        f->sport = 1024 + sim_below(64512);
+        f->dport = dports[sim_below(sizeof(dports) / sizeof(dports[0]))];
+        f->proto = 6;
+        f->bytes = pareto ? scale / pow(sim_uniform(), 1 / shape) : mean;
+    }
+    free(perm);
+}
+
+void add_load(struct port_load *load, uint32_t port, double bytes) {
+    load[port].flows++;
+    load[port].bytes += bytes;
+}
+
+/* Route every flow and accumulate per-port loads. Flows are bucketed by
+ * destination leaf: bucket b is flows[start[b] .. start[b + 1]).
+ * Returns the number of flows that found no path. */
+uint64_t route_flows(const struct topology *t, struct topo_router *r, const struct flow *flows, const uint32_t *start,
+                     enum hash_fn fn, struct port_load *load) {
+    uint64_t unroutable = 0;
+
+    for (int b = 0; b < t->leaf_count; b++) {
+        if (start[b] == start[b + 1]) continue;
+        uint32_t dst_leaf = t->spine_count + b;
+        topo_router_target(r, dst_leaf);
+        for (uint32_t i = start[b]; i < start[b + 1]; i++) {
+            const struct flow *f = &flows[i];
+            uint32_t n = t->nodes[f->src].uplink;
+            if (r->dist[n] == UINT32_MAX) {
+                unroutable++;
+                continue;
+            }
+            // Every switch on the path applies the same hash, like identically configured ASICs
+            uint32_t h = flow_hash(f, fn);
+            add_load(load, topo_host_uplink(t, f->src), f->bytes);
+            while (n != dst_leaf) {
+                uint32_t len;
+                const uint32_t *group = topo_router_group(r, n, &len);
+                uint32_t port = group[h % len];
+                add_load(load, port, f->bytes);
+                n = topo_port_to(t, port);
+            }
+            add_load(load, topo_host_downlink(t, f->dst), f->bytes);
+        }
+    }
+    return unroutable;
+}
+
+struct tier {
+    const char *name;
+    uint64_t links;
+    double sum, sumsq, max;
+};
+
+int tier_of(const struct topology *t, uint32_t port) {
+    uint8_t from = t->nodes[topo_port_from(t, port)].role, to = t->nodes[topo_port_to(t, port)].role;
+    if (from == TOPO_HOST) return 0;
+    if (to == TOPO_SPINE) return 1;
+    if (to == TOPO_LEAF) return 2;
+    return 3;
+}
+
+// Spread of bytes over the spine uplinks of each leaf: mean and worst max/mean
+void uplink_spread(const struct topology *t, const struct port_load *load, double *mean_ratio, double *worst_ratio,
+                   uint32_t *worst_leaf) {
+    *mean_ratio = *worst_ratio = 0;
+    *worst_leaf = 0;
+    int counted = 0;
+    for (int l = 0; l < t->leaf_count; l++) {
+        // Spine-leaf links are numbered spine * leaf_count + leaf, leaf to spine is the odd port
+        double sum = 0, max = 0;
+        for (int s = 0; s < t->spine_count; s++) {
+            double b = load[2 * ((uint32_t)s * t->leaf_count + l) + 1].bytes;
+            sum += b;
+            if (b > max) max = b;
+        }
+        if (sum == 0) continue;
+        double ratio = max / (sum / t->spine_count);
+        *mean_ratio += ratio;
+        counted++;
+        if (ratio > *worst_ratio) {
+            *worst_ratio = ratio;
+            *worst_leaf = t->spine_count + l;
+        }
+    }
+    if (counted) *mean_ratio /= counted;
+}
+
+void report(const struct topology *t, const struct port_load *load, int top) {
+    struct tier tiers[4] = {{.name = "host -> leaf"}, {.name = "leaf -> spine"}, {.name = "spine -> leaf"},
+                            {.name = "leaf -> host"}};
+    uint32_t ports = 2 * t->link_count;
+
+    for (uint32_t p = 0; p < ports; p++) {
+        struct tier *k = &tiers[tier_of(t, p)];
+        double gb = load[p].bytes / 1e9;
+        k->links++;
+        k->sum += gb;
+        k->sumsq += gb * gb;
+        if (gb > k->max) k->max = gb;
+    }
+    printf("%-14s %8s %12s %12s %10s %8s\n", "Tier", "Links", "Mean (GB)", "Max (GB)", "Max/mean", "CoV");
+    for (int i = 0; i < 4; i++) {
+        const struct tier *k = &tiers[i];
+        if (k->links == 0) continue;
+        double mean = k->sum / k->links, var = k->sumsq / k->links - mean * mean;
+        printf("%-14s %8lu %12.3f %12.3f %10.3f %8.3f\n", k->name, (unsigned long)k->links, mean, k->max,
+               mean > 0 ? k->max / mean : 0, mean > 0 ? sqrt(var > 0 ? var : 0) / mean : 0);
+    }
+
+    double mean_ratio, worst_ratio;
+    uint32_t worst_leaf;
+    char name[32];
+    uplink_spread(t, load, &mean_ratio, &worst_ratio, &worst_leaf);
+    topo_node_name(t, worst_leaf, name, sizeof(name));
+    printf("\nEqual-cost uplinks of a leaf: max/mean %.3f on average, worst %.3f (%s)\n", mean_ratio, worst_ratio, name);
+
+    if (top <= 0) return;
+    // Hottest ports by a partial selection sort; top is small
+    uint32_t *best = malloc(top * sizeof(*best));
+    int n = 0;
+    for (uint32_t p = 0; p < ports; p++) {
+        if (n < top) n++;
+        else if (load[p].bytes <= load[best[n - 1]].bytes) continue;
+        int i = n - 1;
+        while (i > 0 && load[best[i - 1]].bytes < load[p].bytes) {
+            best[i] = best[i - 1];
+            i--;
+        }
+        best[i] = p;
+    }
+    printf("\nHottest links\n");
+    for (int i = 0; i < n; i++) {
+        char from[32], to[32];
+        uint32_t p = best[i];
+        topo_node_name(t, topo_port_from(t, p), from, sizeof(from));
+        topo_node_name(t, topo_port_to(t, p), to, sizeof(to));
+        printf("  %-10s -> %-10s %10lu flows %12.3f GB  (%.0f Gbit/s link)\n", from, to,
+               (unsigned long)load[p].flows, load[p].bytes / 1e9, t->links[p >> 1].gbps);
+    }
+    free(best);
+}
+
+int write_loads(const struct topology *t, const struct port_load *load, const char *path) {
+    FILE *fp = fopen(path, "w");
+    if (fp == NULL) return -1;
+    fprintf(fp, "from,to,gbps,flows,bytes\n");
+    for (uint32_t p = 0; p < 2 * t->link_count; p++) {
+        char from[32], to[32];
+        topo_node_name(t, topo_port_from(t, p), from, sizeof(from));
+        topo_node_name(t, topo_port_to(t, p), to, sizeof(to));
+        fprintf(fp, "%s,%s,%g,%lu,%.0f\n", from, to, t->links[p >> 1].gbps, (unsigned long)load[p].flows,
+                load[p].bytes);
+    }
+    return fclose(fp);
+}
+
+int parse_hash(const char *name) {
+    for (int h = 0; h < HASH_COUNT; h++) {
+        if (strcmp(name, hash_names[h]) == 0) return h;
+    }
+    return -1;
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-s spines] [-l leaves] [-n hosts_per_leaf] [-r radix] [-f flows]\n"
+                    "       [-p uniform|permutation|stride] [-z fixed|pareto] [-H hash|all] [-S seed]\n"
+                    "       [-t top_links] [-o loads.csv]\n", prog);
+    fprintf(stderr, "  fabric as in leaf_spine_topology.py (defaults 2 spines, 4 leaves, 2 hosts, radix 16)\n");
+    fprintf(stderr, "  -f flows to route (default 1000000); -p who talks to whom: random pairs,\n");
+    fprintf(stderr, "  a random permutation of hosts, or host i to the same host on the next leaf\n");
+    fprintf(stderr, "  -z flow sizes: 100 KB each, or Pareto (shape 1.2) with the same mean\n");
+    fprintf(stderr, "  -H crc32 (default), xor, fnv, toeplitz, murmur, or all to compare them\n");
+    fprintf(stderr, "  -o per-link flows and bytes as CSV (of the last hash with -H all)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int spines = 2, leaves = 4, hosts = 2, radix = 16, top = 5, pareto = 0, opt;
+    long flow_count = 1000000;
+    enum pattern pattern = UNIFORM;
+    int hash = HASH_CRC32, all = 0;
+    const char *csv_path = NULL;
+    uint64_t seed = 1;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "s:l:n:r:f:p:z:H:S:t:o:")) != -1) {
+        switch (opt) {
+        case 's': spines = atoi(optarg); break;
+        case 'l': leaves = atoi(optarg); break;
+        case 'n': hosts = atoi(optarg); break;
+        case 'r': radix = atoi(optarg); break;
+        case 'f': flow_count = atol(optarg); break;
+        case 'p':
+            if (strcmp(optarg, "permutation") == 0) pattern = PERMUTATION;
+            else if (strcmp(optarg, "stride") == 0) pattern = STRIDE;
+            else if (strcmp(optarg, "uniform") == 0) pattern = UNIFORM;
+            else { usage(argv[0]); return 1; }
+            break;
+        case 'z':
+            if (strcmp(optarg, "pareto") == 0) pareto = 1;
+            else if (strcmp(optarg, "fixed") != 0) { usage(argv[0]); return 1; }
+            break;
+        case 'H':
+            all = strcmp(optarg, "all") == 0;
+            hash = all ? 0 : parse_hash(optarg);
+            if (hash < 0) { usage(argv[0]); return 1; }
+            break;
+        case 'S': seed = strtoull(optarg, NULL, 0); break;
+        case 't': top = atoi(optarg); break;
+        case 'o': csv_path = optarg; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (flow_count < 1 || flow_count > UINT32_MAX) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct topology t;
+    if (topo_leaf_spine(&t, spines, leaves, hosts, radix, err, sizeof(err)) < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    if (t.host_count < 2) {
+        fprintf(stderr, "Need at least two hosts\n");
+        return 1;
+    }
+    printf("Fabric: %d spines, %d leaves, %u hosts, radix %d: %u nodes, %u links\n", spines, leaves, t.host_count,
+           radix, t.node_count, t.link_count);
+
+    sim_seed(seed);
+    hash_init();
+
+    uint32_t n = (uint32_t)flow_count;
+    struct flow *made = malloc(n * sizeof(*made)), *flows = malloc(n * sizeof(*flows));
+    uint32_t *start = calloc(leaves + 1, sizeof(*start));
+    struct port_load *load = malloc(2 * (size_t)t.link_count * sizeof(*load));
+    if (!made || !flows || !start || !load) {
+        perror("malloc failed");
+        return 1;
+    }
+    double t0 = sim_wall_sec();
+    make_flows(&t, made, n, pattern, pareto);
+
+    // Counting sort by destination leaf, so routing reads the flows in order
+    for (uint32_t i = 0; i < n; i++) start[t.nodes[made[i].dst].uplink - spines + 1]++;
+    for (int b = 0; b < leaves; b++) start[b + 1] += start[b];
+    uint32_t *fill = malloc(leaves * sizeof(*fill));
+    memcpy(fill, start, leaves * sizeof(*fill));
+    for (uint32_t i = 0; i < n; i++) flows[fill[t.nodes[made[i].dst].uplink - spines]++] = made[i];
+    free(fill);
+    free(made);
+    printf("Flows: %u, %s pattern, %s sizes, generated in %.3f s\n", n, pattern_names[pattern],
+           pareto ? "Pareto" : "fixed", sim_wall_sec() - t0);
+
+    struct topo_router r;
+    if (topo_router_init(&r, &t) < 0) {
+        perror("malloc failed");
+        return 1;
+    }
+    for (int h = all ? 0 : hash; h < (all ? HASH_COUNT : hash + 1); h++) {
+        memset(load, 0, 2 * (size_t)t.link_count * sizeof(*load));
+        double t1 = sim_wall_sec();
+        uint64_t lost = route_flows(&t, &r, flows, start, h, load);
+        double secs = sim_wall_sec() - t1;
+        printf("\n== %s: routed in %.3f s (%.1f M flows/s)\n", hash_names[h], secs, n / secs / 1e6);
+        if (lost) printf("%lu flows had no path\n", (unsigned long)lost);
+        report(&t, load, all ? 0 : top);
+    }
+    if (csv_path && write_loads(&t, load, csv_path) != 0) {
+        perror("Writing the link loads failed");
+        return 1;
+    }
+
+    topo_router_free(&r);
+    free(flows);
+    free(start);
+    free(load);
+    topo_free(&t);
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../common/ecmp_table.h"
+#include "../common/simutil.h"
+#include "../common/topology.h"
+
+/**
+ * Capacity impact of link and switch failures in the leaf-spine fabric of
+ * leaf_spine_topology.py (or the binary tree of assignment_13/topo.py), at
+ * sizes Mininet cannot emulate.
+ *
+ * The all-pairs ECMP next-hop groups of the intact fabric are built once
+ * with common/ecmp_table.c. Each failure scenario is applied incrementally
+ * and undone again, so only the routes it touches are recomputed. For
+ * every scenario the report gives the update time, how many destination
+ * switches needed a new BFS, the host pairs cut off, and the bisection
+ * bandwidth left between h1 .. h(H/2) and the other hosts over the ports
+ * ECMP still uses.
+ *
+ * Scenarios are given as lists of Mininet names, e.g. -f spine1 or
+ * -f leaf3-spine2,leaf4-spine2 (a link is "a-b"), or swept: -A spines,
+ * leaves, switches or links fails each one on its own, and -R fails -k
+ * random switch-to-switch links at a time. With many scenarios the worst
+ * -t by bisection are listed.
+ */
+
+#define MAX_FAILED 16
+
+struct scenario {
+    char name[96];
+    uint32_t links[MAX_FAILED], nodes[MAX_FAILED];
+    int link_count, node_count;
+    double update_ms, gbps;
+    int redone;
+    uint64_t unreachable;
+};
+
+uint32_t find_node(const struct topology *t, const char *name) {
+    char buf[32];
+    for (uint32_t n = 0; n < t->node_count; n++) {
+        topo_node_name(t, n, buf, sizeof(buf));
+        if (strcmp(buf, name) == 0) return n;
+    }
+    return UINT32_MAX;
+}
+
+uint32_t find_link(const struct topology *t, uint32_t a, uint32_t b) {
+    for (uint32_t i = t->adj_start[a]; i < t->adj_start[a + 1]; i++) {
+        if (t->adj[i].node == b) return t->adj[i].port >> 1;
+    }
+    return UINT32_MAX;
+}
+
+void link_name(const struct topology *t, uint32_t l, char *buf, size_t size) {
+    char a[32], b[32];
+    topo_node_name(t, t->links[l].a, a, sizeof(a));
+    topo_node_name(t, t->links[l].b, b, sizeof(b));
+    snprintf(buf, size, "%s-%s", a, b);
+}
+
+struct scenario *add_scenario(struct scenario **list, uint32_t *count, uint32_t *cap) {
+    if (*count == *cap) {
+        *cap = *cap ? 2 * *cap : 64;
+        *list = realloc(*list, *cap * sizeof(**list));
+        if (!*list) {
+            perror("realloc failed");
+            exit(1);
+        }
+    }
+    struct scenario *s = &(*list)[(*count)++];
+    memset(s, 0, sizeof(*s));
+    return s;
+}
+
+/* Parses "name,name-name,..." into one scenario. Exits on unknown nodes,
+ * nodes that are not linked, or too many elements. */
+void parse_scenario(const struct topology *t, const char *spec, struct scenario *s) {
+    char buf[512];
+    snprintf(buf, sizeof(buf), "%s", spec);
+    snprintf(s->name, sizeof(s->name), "%s", spec);
+    for (char *save = NULL, *item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        char *dash = strchr(item, '-');
+        if (dash) *dash = '\0';
+        uint32_t a = find_node(t, item), b = dash ? find_node(t, dash + 1) : UINT32_MAX;
+        uint32_t l = dash && a != UINT32_MAX && b != UINT32_MAX ? find_link(t, a, b) : UINT32_MAX;
+        if (a == UINT32_MAX || (dash && l == UINT32_MAX)) {
+            fprintf(stderr, "Unknown %s in scenario %s\n", dash ? "link" : "node", spec);
+            exit(1);
+        }
+        if (s->link_count == MAX_FAILED || s->node_count == MAX_FAILED) {
+            fprintf(stderr, "At most %d links and %d nodes per scenario: %s\n", MAX_FAILED, MAX_FAILED, spec);
+            exit(1);
+        }
+        if (dash) s->links[s->link_count++] = l;
+        else s->nodes[s->node_count++] = a;
+    }
+}
+
+void sweep(const struct topology *t, const char *what, struct scenario **list, uint32_t *count, uint32_t *cap) {
+    int spines = strcmp(what, "spines") == 0, leaves = strcmp(what, "leaves") == 0;
+    if (strcmp(what, "links") == 0) {
+        for (uint32_t l = 0; l < t->link_count; l++) {
+            if (t->nodes[t->links[l].a].role == TOPO_HOST || t->nodes[t->links[l].b].role == TOPO_HOST) continue;
+            struct scenario *s = add_scenario(list, count, cap);
+            link_name(t, l, s->name, sizeof(s->name));
+            s->links[s->link_count++] = l;
+        }
+        return;
+    }
+    for (uint32_t n = 0; n < t->node_count; n++) {
+        uint8_t role = t->nodes[n].role;
+        if (role == TOPO_HOST || (spines && role != TOPO_SPINE) || (leaves && role != TOPO_LEAF)) continue;
+        struct scenario *s = add_scenario(list, count, cap);
+        topo_node_name(t, n, s->name, sizeof(s->name));
+        s->nodes[s->node_count++] = n;
+    }
+}
+
+void random_scenarios(const struct topology *t, int count, int links, struct scenario **list, uint32_t *n,
+                      uint32_t *cap) {
+    uint32_t fabric = 0;
+    for (uint32_t l = 0; l < t->link_count; l++) {
+        fabric += t->nodes[t->links[l].a].role != TOPO_HOST && t->nodes[t->links[l].b].role != TOPO_HOST;
+    }
+    if (fabric < (uint32_t)links) {
+        fprintf(stderr, "Only %u switch-to-switch links to fail\n", fabric);
+        exit(1);
+    }
+    for (int i = 0; i < count; i++) {
+        struct scenario *s = add_scenario(list, n, cap);
+        size_t used = 0;
+        for (int k = 0; k < links; k++) {
+            uint32_t l;
+            int taken;
+            do {
+                l = sim_below(t->link_count);
+                taken = t->nodes[t->links[l].a].role == TOPO_HOST || t->nodes[t->links[l].b].role == TOPO_HOST;
+                for (int j = 0; j < k && !taken; j++) taken = s->links[j] == l;
+            } while (taken);
+            s->links[s->link_count++] = l;
+            char name[64];
+            link_name(t, l, name, sizeof(name));
+            if (used < sizeof(s->name)) {
+                used += snprintf(s->name + used, sizeof(s->name) - used, "%s%s", k ? "," : "", name);
+            }
+        }
+    }
+}
+
+int by_bisection(const void *x, const void *y) {
+    const struct scenario *a = x, *b = y;
+    if (a->gbps != b->gbps) return a->gbps < b->gbps ? -1 : 1;
+    return a->unreachable > b->unreachable ? -1 : a->unreachable < b->unreachable;
+}
+
+void report(struct scenario *list, uint32_t count, double full, int top) {
+    double total_ms = 0, max_ms = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        total_ms += list[i].update_ms;
+        if (list[i].update_ms > max_ms) max_ms = list[i].update_ms;
+    }
+    uint32_t shown = count;
+    if ((uint32_t)top < count) {
+        qsort(list, count, sizeof(*list), by_bisection);
+        shown = top;
+        printf("Worst %u of %u scenarios by bisection:\n", shown, count);
+    }
+
+    printf("%10s %8s %12s %24s  %s\n", "update", "redone", "cut pairs", "bisection", "scenario");
+    for (uint32_t i = 0; i < shown; i++) {
+        const struct scenario *s = &list[i];
+        printf("%7.2f ms %8d %12llu %9.1f Gbit/s %6.1f%%  %s\n", s->update_ms, s->redone,
+               (unsigned long long)s->unreachable, s->gbps, full > 0 ? 100 * s->gbps / full : 100.0, s->name);
+    }
+
+    const struct scenario *worst = &list[0];
+    for (uint32_t i = 1; i < count; i++) {
+        if (by_bisection(&list[i], worst) < 0) worst = &list[i];
+    }
+    printf("\n%u scenarios: updates %.2f ms on average, %.2f ms at most; lowest bisection %.1f Gbit/s (%.1f%%) for %s\n",
+           count, total_ms / count, max_ms, worst->gbps, full > 0 ? 100 * worst->gbps / full : 100.0, worst->name);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-T leafspine|tree] [-s spines] [-l leaves] [-n hosts] [-r radix] [-d depth]\n"
+                    "       [-f name[,name-name...]]... [-A spines|leaves|switches|links] [-R scenarios [-k links]]\n"
+                    "       [-S seed] [-t top]\n", prog);
+    fprintf(stderr, "  leafspine: fabric as in leaf_spine_topology.py (defaults 2 spines, 4 leaves, 2 hosts, radix 16)\n");
+    fprintf(stderr, "  tree: binary tree of topo.py (depth 3, h1 on s4, h2 on s7); -n puts hosts on every bottom switch\n");
+    fprintf(stderr, "  -f one scenario: switches, hosts and links (\"leaf1-spine2\") failed together\n");
+    fprintf(stderr, "  -A every single switch or switch-to-switch link of a kind (default: switches)\n");
+    fprintf(stderr, "  -R random scenarios of -k switch-to-switch links each (default 2)\n");
+    fprintf(stderr, "  -t list the worst scenarios by bisection when there are more (default 20)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int tree = 0, spines = 2, leaves = 4, hosts = -1, radix = 16, depth = 3, random_count = 0, random_links = 2;
+    int top = 20, opt;
+    uint64_t seed = 1;
+    const char *specs[64], *sweeps[4];
+    int spec_count = 0, sweep_count = 0;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "T:s:l:n:r:d:f:A:R:k:S:t:")) != -1) {
+        switch (opt) {
+        case 'T':
+            if (strcmp(optarg, "tree") == 0) tree = 1;
+            else if (strcmp(optarg, "leafspine") != 0) { usage(argv[0]); return 1; }
+            break;
+        case 's': spines = atoi(optarg); break;
+        case 'l': leaves = atoi(optarg); break;
+        case 'n': hosts = atoi(optarg); break;
+        case 'r': radix = atoi(optarg); break;
+        case 'd': depth = atoi(optarg); break;
+        case 'f':
+            if (spec_count == 64) { usage(argv[0]); return 1; }
+            specs[spec_count++] = optarg;
+            break;
+        case 'A':
+            if (sweep_count == 4 || (strcmp(optarg, "spines") && strcmp(optarg, "leaves") &&
+                                     strcmp(optarg, "switches") && strcmp(optarg, "links"))) {
+                usage(argv[0]);
+                return 1;
+            }
+            sweeps[sweep_count++] = optarg;
+            break;
+        case 'R': random_count = atoi(optarg); break;
+        case 'k': random_links = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 0); break;
+        case 't': top = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (random_count < 0 || random_links < 1 || random_links > MAX_FAILED || top < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct topology t;
+    int built = tree ? topo_binary_tree(&t, depth, hosts < 0 ? 0 : hosts, err, sizeof(err))
+                     : topo_leaf_spine(&t, spines, leaves, hosts < 0 ? 2 : hosts, radix, err, sizeof(err));
+    if (built < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    if (tree) printf("Binary tree: depth %d, %u hosts: %u nodes, %u links\n", depth, t.host_count, t.node_count,
+                     t.link_count);
+    else printf("Fabric: %d spines, %d leaves, %u hosts, radix %d: %u nodes, %u links\n", spines, leaves,
+                t.host_count, radix, t.node_count, t.link_count);
+
+    sim_seed(seed);
+
+    struct scenario *list = NULL;
+    uint32_t count = 0, cap = 0;
+    for (int i = 0; i < spec_count; i++) parse_scenario(&t, specs[i], add_scenario(&list, &count, &cap));
+    for (int i = 0; i < sweep_count; i++) sweep(&t, sweeps[i], &list, &count, &cap);
+    random_scenarios(&t, random_count, random_links, &list, &count, &cap);
+    if (count == 0) sweep(&t, "switches", &list, &count, &cap);
+
+    struct ecmp_table e;
+    double t0 = sim_wall_sec();
+    if (ecmp_init(&e, &t, err, sizeof(err)) < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    double built_ms = (sim_wall_sec() - t0) * 1e3;
+    t0 = sim_wall_sec();
+    double full = ecmp_bisection(&e);
+    double cut_ms = (sim_wall_sec() - t0) * 1e3;
+    if (full < 0) {
+        perror("malloc failed");
+        return 1;
+    }
+    printf("ECMP groups: %u switches, %u switch links, built in %.1f ms; bisection %.1f Gbit/s in %.1f ms\n\n",
+           e.switch_count, e.adj_start[e.switch_count] / 2, built_ms, full, cut_ms);
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct scenario *s = &list[i];
+        t0 = sim_wall_sec();
+        s->redone = ecmp_fail(&e, s->links, s->link_count, s->nodes, s->node_count);
+        s->update_ms = (sim_wall_sec() - t0) * 1e3;
+        s->gbps = ecmp_bisection(&e);
+        s->unreachable = ecmp_unreachable(&e);
+        if (s->redone < 0 || s->gbps < 0) {
+            perror("malloc failed");
+            return 1;
+        }
+        ecmp_restore(&e);
+    }
+    report(list, count, full, top);
+
+    ecmp_free(&e);
+    topo_free(&t);
+    free(list);
+    return 0;
+}
@@ -18,7 +18,10 @@ from mininet.cli import CLI
 from mininet.log import setLogLevel, info
 from mininet.link import TCLink
 import argparse
+import bisect
+import ctypes
 import math
+import os
 
 
 class LeafSpineTopology(Topo):
@@ -184,52 +187,223 @@ class LeafSpineTopology(Topo):
                 host_id += 1
 
 
-def calculate_optimal_topology(total_hosts, switch_radix=16):
+class _DesignQuery(ctypes.Structure):
+    """struct topo_design_query from common/topo_design.h"""
+    _fields_ = [('hosts', ctypes.c_uint64),
+                ('radix', ctypes.c_int),
+                ('reserved_ports', ctypes.c_int),
+                ('max_oversubscription', ctypes.c_double),
+                ('host_gbps', ctypes.c_double),
+                ('fabric_gbps', ctypes.c_double),
+                ('switch_cost', ctypes.c_double),
+                ('port_cost', ctypes.c_double),
+                ('max_tiers', ctypes.c_int),
+                ('max_parallel_links', ctypes.c_int)]
+
+
+class _Design(ctypes.Structure):
+    """struct topo_design from common/topo_design.h"""
+    _fields_ = [('tiers', ctypes.c_int),
+                ('pods', ctypes.c_int),
+                ('leaves', ctypes.c_int),
+                ('spines', ctypes.c_int),
+                ('super_spines', ctypes.c_int),
+                ('hosts_per_leaf', ctypes.c_int),
+                ('links_per_spine', ctypes.c_int),
+                ('switches', ctypes.c_int),
+                ('links', ctypes.c_int64),
+                ('cost', ctypes.c_double),
+                ('bisection_gbps', ctypes.c_double),
+                ('oversubscription', ctypes.c_double)]
+
+
+_native = None
+
+
+def _load_native():
     """
-    Calculate optimal topology parameters for given constraints
+    Load the native solver, built next to this script with
+        gcc -O2 -shared -fPIC ../common/topo_design.c -o libtopodesign.so -lm
+    Returns None if it is not there, so the Python search is used instead.
+    """
+    global _native
+    if _native is None:
+        path = os.path.join(os.path.dirname(os.path.abspath(__file__)), 'libtopodesign.so')
+        try:
+            lib = ctypes.CDLL(path)
+            lib.topo_design_pareto.argtypes = [ctypes.POINTER(_DesignQuery), ctypes.POINTER(_Design),
+                                               ctypes.c_int, ctypes.c_char_p, ctypes.c_size_t]
+            lib.topo_design_pareto.restype = ctypes.c_int
+            _native = lib
+        except OSError:
+            _native = False
+    return _native or None
+
+
+def _design(tiers, pods, leaves, spines, super_spines, hosts_per_leaf, links_per_spine, switches, links,
+            bisection, oversubscription, q):
+    cost = switches * q['switch_cost'] + (2 * links + q['hosts']) * q['port_cost']
+    return (tiers, pods, leaves, spines, super_spines, hosts_per_leaf, links_per_spine, switches, links, cost,
+            bisection, oversubscription)
+
+
+def _pareto_python(q):
+    """The search of common/topo_design.c, for when the library is not built"""
+    eps = 1e-9
+    ports = q['radix'] - q['reserved_ports']
+    hosts = q['hosts']
+    host_cap = hosts * q['host_gbps']
+    if hosts > ports ** 3:
+        return []
+
+    def min_spines(h, k):
+        if q['max_oversubscription'] <= 0:
+            return 1
+        need = h * q['host_gbps'] / (k * q['fabric_gbps'] * q['max_oversubscription'])
+        return max(1, math.ceil(need - eps))
+
+    # Of the designs with equal link counts, the one with the fewest switches
+    best = {}
+
+    def push(d):
+        key = (d[8], d[0] == 2 and d[2] == 1)
+        if key not in best or d[7] < best[key][7]:
+            best[key] = d
+
+    for leaves in range(1, ports + 1):
+        h = -(-hosts // leaves)
+        if h > ports - 1:
+            continue
+        if (leaves - 1) * h >= hosts:
+            if h == 1:
+                break
+            continue
+        max_k = q['max_parallel_links'] or ports
+        k = 1
+        while k <= max_k and leaves * k <= ports and h + k <= ports:
+            s = min_spines(h, k)
+            while h + s * k <= ports:
+                uplinks = leaves * s * k * q['fabric_gbps']
+                bisection = (host_cap if leaves == 1 else min(host_cap, uplinks)) / 2
+                push(_design(2, 1, leaves, s, 0, h, k, leaves + s, leaves * s * k, bisection,
+                             h * q['host_gbps'] / (s * k * q['fabric_gbps']), q))
+                if leaves == 1 or uplinks >= host_cap - eps:
+                    break
+                s += 1
+            k += 1
+
+    for e in range(1, ports // 2 + 1) if q['max_tiers'] >= 3 else ():
+        for pods in range(2, ports + 1):
+            h = -(-hosts // (pods * e))
+            if h > ports - 1:
+                continue
+            if (pods - 1) * e * h >= hosts:
+                if h == 1:
+                    break
+                continue
+            a = min_spines(h, 1)
+            while h + a <= ports:
+                uplinks = pods * e * a * q['fabric_gbps']
+                push(_design(3, pods, e, a, a * e, h, 1, pods * (e + a) + a * e, 2 * pods * e * a,
+                             min(host_cap, uplinks) / 2, h * q['host_gbps'] / (a * q['fabric_gbps']), q))
+                if uplinks >= host_cap - eps:
+                    break
+                a += 1
+
+    # By switch count, then against the staircase of the best bisection per cost
+    kept, step_cost, step_bisection = [], [], []
+    for d in sorted(best.values(), key=lambda d: (d[7], d[9], -d[10])):
+        cost, bisection = d[9], d[10]
+        lo = bisect.bisect_right(step_cost, cost)
+        if lo > 0 and step_bisection[lo - 1] >= bisection - eps:
+            continue
+        kept.append(d)
+        end = lo
+        while end < len(step_cost) and step_bisection[end] <= bisection:
+            end += 1
+        if lo > 0 and step_cost[lo - 1] == cost:
+            lo -= 1
+        step_cost[lo:end] = [cost]
+        step_bisection[lo:end] = [bisection]
+    return kept
+
+
+def pareto_topologies(total_hosts, switch_radix=16, max_oversubscription=0, max_tiers=3, max_parallel_links=0,
+                      host_gbps=1.0, fabric_gbps=10.0, switch_cost=10000.0, port_cost=300.0, reserved_ports=1):
+    """
+    Enumerate leaf-spine and three-tier Clos designs for given constraints
+    and keep the Pareto-optimal ones over switch count, cost and bisection
+    bandwidth (see common/topo_design.h for the model)
     
     Args:
         total_hosts: Total number of hosts needed
         switch_radix: Switch port capacity
+        max_oversubscription: Host over uplink capacity at the leaves (0 for no limit)
+        max_tiers: 2 for leaf-spine only, 3 to include pods under super-spines
+        max_parallel_links: Links between a leaf and a spine (0 for no limit)
+        reserved_ports: Ports per switch kept for management
         
     Returns:
-        dict: Optimal topology configuration
+        list: Design dicts ordered by switch count
     """
-    # Reserve 1 port per switch for management
-    usable_radix = switch_radix - 1
+    q = {'hosts': total_hosts, 'radix': switch_radix, 'reserved_ports': reserved_ports,
+         'max_oversubscription': max_oversubscription, 'host_gbps': host_gbps, 'fabric_gbps': fabric_gbps,
+         'switch_cost': switch_cost, 'port_cost': port_cost, 'max_tiers': max_tiers,
+         'max_parallel_links': max_parallel_links}
+    lib = _load_native()
+    if lib:
+        query = _DesignQuery(**q)
+        err = ctypes.create_string_buffer(128)
+        count = lib.topo_design_pareto(ctypes.byref(query), None, 0, err, len(err))
+        designs = (_Design * max(count, 1))()
+        if count > 0:
+            count = lib.topo_design_pareto(ctypes.byref(query), designs, count, err, len(err))
+        if count < 0:
+            raise ValueError(err.value.decode())
+        rows = [tuple(getattr(d, name) for name, _ in _Design._fields_) for d in designs[:count]]
+    else:
+        if (switch_radix < 2 or reserved_ports < 0 or switch_radix - reserved_ports < 2 or total_hosts < 1 or
+                host_gbps <= 0 or fabric_gbps <= 0 or max_oversubscription < 0 or max_tiers not in (2, 3)):
+            raise ValueError("Invalid topology query")
+        rows = _pareto_python(q)
     
-    # For leaf switches: ports needed for spines + hosts
-    # For spine switches: ports needed for leaves
-    
-    # Try different configurations
-    best_config = None
-    min_switches = float('inf')
+    return [{
+        'tiers': d[0],
+        'pods': d[1],
+        'leaf_count': d[2],
+        'spine_count': d[3],
+        'super_spine_count': d[4],
+        'hosts_per_leaf': d[5],
+        'links_per_spine': d[6],
+        'total_switches': d[7],
+        'fabric_links': d[8],
+        'cost': d[9],
+        'bisection_gbps': d[10],
+        'oversubscription': d[11],
+        'switch_radix': switch_radix
+    } for d in rows]
+
+
+def calculate_optimal_topology(total_hosts, switch_radix=16, max_oversubscription=0):
+    """
+    Calculate optimal topology parameters for given constraints
     
-    for hosts_per_leaf in range(1, usable_radix):
-        max_spines_per_leaf = usable_radix - hosts_per_leaf
-        
-        # Calculate required leaves
-        leaf_count = math.ceil(total_hosts / hosts_per_leaf)
+    Args:
+        total_hosts: Total number of hosts needed
+        switch_radix: Switch port capacity
+        max_oversubscription: Host over uplink capacity at the leaves (0 for no limit)
         
-        # Calculate required spines (each spine can handle leaf_count leaves)
-        if leaf_count <= usable_radix:
-            spine_count = max(1, math.ceil(leaf_count / max_spines_per_leaf))
-            
-            # Verify spine capacity
-            if leaf_count <= spine_count * usable_radix:
-                total_switches = spine_count + leaf_count
-                
-                if total_switches < min_switches:
-                    min_switches = total_switches
-                    best_config = {
-                        'spine_count': spine_count,
-                        'leaf_count': leaf_count, 
-                        'hosts_per_leaf': hosts_per_leaf,
-                        'total_switches': total_switches,
-                        'switch_radix': switch_radix
-                    }
+    Returns:
+        dict: Optimal topology configuration
+    """
+    # LeafSpineTopology builds two tiers with one link per leaf-spine pair
+    designs = pareto_topologies(total_hosts, switch_radix, max_oversubscription, max_tiers=2,
+                                max_parallel_links=1)
+    if not designs:
+        return None
     
-    return best_config
+    # Fewest switches, then the most bisection bandwidth, then the lowest cost
+    return min(designs, key=lambda d: (d['total_switches'], -d['bisection_gbps'], d['cost']))
 
 
 def main():
@@ -245,15 +419,33 @@ def main():
                        help='Switch radix/port count (default: 16)')
     parser.add_argument('--auto', '-a', type=int,
                        help='Auto-calculate topology for N total hosts')
+    parser.add_argument('--oversub', type=float, default=0,
+                       help='Max leaf oversubscription for --auto (default: no limit)')
+    parser.add_argument('--pareto', action='store_true',
+                       help='Print the Pareto-optimal designs for --auto hosts and exit')
     parser.add_argument('--controller', '-c', type=str, default=None,
                        help='Remote controller IP (default: None)')
     
     args = parser.parse_args()
     
+    if args.pareto:
+        if not args.auto:
+            parser.error('--pareto needs --auto')
+        designs = pareto_topologies(args.auto, args.radix, args.oversub)
+        print(f"{'tiers':>5} {'pods':>5} {'leaves':>6} {'spines':>6} {'super':>6} {'h/leaf':>6} "
+              f"{'links':>5} {'switches':>8} {'cost':>12} {'bisection':>12} {'oversub':>7}")
+        for d in designs:
+            print(f"{d['tiers']:5d} {d['pods']:5d} {d['leaf_count']:6d} {d['spine_count']:6d} "
+                  f"{d['super_spine_count']:6d} {d['hosts_per_leaf']:6d} {d['links_per_spine']:5d} "
+                  f"{d['total_switches']:8d} {d['cost']:12.0f} {d['bisection_gbps']:10.1f} G "
+                  f"{d['oversubscription']:6.2f}:1")
+        print(f"{len(designs)} Pareto-optimal designs")
+        return
+    
     # Auto-calculate topology if requested
     if args.auto:
         info(f"Auto-calculating topology for {args.auto} hosts...\n")
-        config = calculate_optimal_topology(args.auto, args.radix)
+        config = calculate_optimal_topology(args.auto, args.radix, args.oversub)
         if config:
             args.spines = config['spine_count']
             args.leaves = config['leaf_count'] 
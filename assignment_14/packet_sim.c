@@ -0,0 +1,295 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../common/netsim.h"
+#include "../common/simutil.h"
+#include "../common/topology.h"
+
+/**
+ * Packet-level simulation of the Mininet topologies with common/netsim.c,
+ * for queueing effects that the flow-level tools average away: buffer
+ * build-up, drop-tail versus RED, and incast.
+ *
+ * The topology is the leaf-spine fabric of leaf_spine_topology.py or the
+ * binary tree of assignment_13/topo.py, as in throughput.c. The workload
+ * is open-loop, with no congestion control:
+ *   uniform      every host sends Poisson traffic at -L of its link,
+ *                split over four random other hosts,
+ *   permutation  the same, but every host receives from exactly one,
+ *   incast       -i senders burst -k KB each at the same instant to h1,
+ *                like the responses to a partition-aggregate query.
+ *
+ * The report gives the simulation speed, delivered and dropped packets,
+ * latency percentiles, and the ports with the most drops or the deepest
+ * queues.
+ */
+
+enum workload { UNIFORM, PERMUTATION, INCAST };
+
+struct incast {
+    uint64_t *received;        // packets per sender
+    sim_time *done;            // last delivery per sender
+};
+
+double host_gbps(const struct topology *t, uint32_t host) {
+    return t->links[topo_host_uplink(t, host) >> 1].gbps;
+}
+
+uint32_t *shuffle(uint32_t n) {
+    uint32_t *order = malloc(n * sizeof(*order));
+    if (!order) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < n; i++) order[i] = i;
+    for (uint32_t i = n - 1; i > 0; i--) {
+        uint32_t j = sim_below(i + 1), x = order[i];
+        order[i] = order[j];
+        order[j] = x;
+    }
+    return order;
+}
+
+// Random permutation without fixed points (a host that draws itself swaps with the next)
+uint32_t *derangement(uint32_t n) {
+    uint32_t *peer = shuffle(n);
+    for (uint32_t i = 0; i < n; i++) {
+        if (peer[i] != i) continue;
+        uint32_t o = (i + 1) % n, x = peer[o];
+        peer[o] = peer[i];
+        peer[i] = x;
+    }
+    return peer;
+}
+
+/* Poisson sources from every host for `duration`. Uniform traffic splits
+ * each host's load over `fanout` sources to random destinations so that
+ * ECMP sees several flow hashes per host. */
+void add_poisson(struct netsim *s, const struct topology *t, enum workload w, double load, uint32_t bytes,
+                 sim_time duration, int fanout) {
+    uint32_t *peer = w == PERMUTATION ? derangement(t->host_count) : NULL;
+
+    for (uint32_t h = 0; h < t->host_count; h++) {
+        uint32_t src = topo_host_node(t, h);
+        double gbps = load * host_gbps(t, src);
+        for (int k = 0; k < (peer ? 1 : fanout); k++) {
+            uint32_t d = peer ? peer[h] : sim_below(t->host_count - 1);
+            if (!peer && d >= h) d++;
+            if (!netsim_source(s, src, topo_host_node(t, d), bytes, peer ? gbps : gbps / fanout, 0, duration, 1)) {
+                perror("malloc failed");
+                exit(1);
+            }
+        }
+    }
+    free(peer);
+}
+
+void incast_delivered(struct netsim *s, const struct sim_packet *p) {
+    struct incast *in = s->user;
+    in->received[p->flow]++;
+    in->done[p->flow] = s->now;
+}
+
+/* `senders` random hosts other than h1 each send `count` packets back to
+ * back to h1 at time 0. */
+void add_incast(struct netsim *s, const struct topology *t, struct incast *in, uint32_t senders, uint32_t bytes,
+                uint64_t count) {
+    uint32_t *order = shuffle(t->host_count - 1);
+    in->received = calloc(senders, sizeof(*in->received));
+    in->done = calloc(senders, sizeof(*in->done));
+    if (!in->received || !in->done) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < senders; i++) {
+        if (!netsim_burst(s, topo_host_node(t, order[i] + 1), topo_host_node(t, 0), bytes, count, 0)) {
+            perror("malloc failed");
+            exit(1);
+        }
+    }
+    s->user = in;
+    s->on_deliver = incast_delivered;
+    free(order);
+}
+
+void report_incast(const struct incast *in, uint32_t senders, uint64_t count) {
+    uint32_t complete = 0;
+    sim_time first = 0, last = 0;
+    for (uint32_t i = 0; i < senders; i++) {
+        if (in->received[i] == count) complete++;
+        if (in->done[i] > last) last = in->done[i];
+        if (in->done[i] && (!first || in->done[i] < first)) first = in->done[i];
+    }
+    printf("Incast: %u of %u senders got all %llu packets through; first sender done at %.3f ms, last delivery at "
+           "%.3f ms\n", complete, senders, (unsigned long long)count, (double)first / NETSIM_MS,
+           (double)last / NETSIM_MS);
+}
+
+void report_ports(const struct topology *t, const struct netsim *s, int top) {
+    uint32_t busy = 0, dropping = 0;
+    uint8_t *shown = calloc(s->port_count, 1);
+
+    for (uint32_t p = 0; p < s->port_count; p++) {
+        busy += s->ports[p].tx_packets > 0;
+        dropping += s->ports[p].drops > 0;
+    }
+    printf("\n%u of %u ports carried traffic, %u of them dropped packets", busy, s->port_count, dropping);
+    printf(top > 0 && busy ? "; the hottest:\n" : "\n");
+    if (top > 0 && busy) {
+        printf("  %-10s    %-10s %10s %10s %10s %8s %10s\n", "From", "To", "Packets", "Drops", "Max KB", "Mean KB",
+               "Busy");
+    }
+    for (int i = 0; i < top; i++) {
+        // Most drops first, then the deepest queue
+        uint32_t best = UINT32_MAX;
+        for (uint32_t p = 0; p < s->port_count; p++) {
+            const struct sim_port *q = &s->ports[p];
+            if (shown[p] || !q->tx_packets) continue;
+            if (best == UINT32_MAX || q->drops > s->ports[best].drops ||
+                (q->drops == s->ports[best].drops && q->max_queued_bytes > s->ports[best].max_queued_bytes)) best = p;
+        }
+        if (best == UINT32_MAX) break;
+        shown[best] = 1;
+        const struct sim_port *q = &s->ports[best];
+        char a[32], b[32];
+        topo_node_name(t, topo_port_from(t, best), a, sizeof(a));
+        topo_node_name(t, topo_port_to(t, best), b, sizeof(b));
+        printf("  %-10s -> %-10s %10llu %10llu %10.1f %8.1f %9.1f%%\n", a, b, (unsigned long long)q->tx_packets,
+               (unsigned long long)q->drops, q->max_queued_bytes / 1024.0, q->queue_area / s->now / 1024.0,
+               100.0 * q->tx_bytes * q->ps_per_byte / s->now);
+    }
+    free(shown);
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-T leafspine|tree] [-s spines] [-l leaves] [-n hosts] [-r radix] [-d depth]\n"
+                    "       [-w uniform|permutation|incast] [-L load] [-D ms] [-P bytes] [-i senders] [-k KB]\n"
+                    "       [-q droptail|red] [-B buffer_KB] [-S seed] [-t top_ports]\n", prog);
+    fprintf(stderr, "  leafspine: fabric as in leaf_spine_topology.py (defaults 2 spines, 4 leaves, 2 hosts, radix 16)\n");
+    fprintf(stderr, "  tree: binary tree of topo.py (depth 3, h1 on s4, h2 on s7); -n puts hosts on every bottom switch\n");
+    fprintf(stderr, "  uniform, permutation: Poisson traffic at -L of each host link (default 0.5) for -D ms (default 10)\n");
+    fprintf(stderr, "  incast: -i senders (default all other hosts) burst -k KB each (default 64) to h1\n");
+    fprintf(stderr, "  -P packet size (default 1500), -B buffer per port (default 256 KB)\n");
+}
+
+int main(int argc, char *argv[]) {
+    int tree = 0, spines = 2, leaves = 4, hosts = -1, radix = 16, depth = 3, top = 5, senders = -1, opt;
+    enum workload workload = UNIFORM;
+    double load = 0.5, duration_ms = 10, burst_kb = 64;
+    int bytes = 1500, buffer_kb = 256;
+    struct netsim_config cfg = NETSIM_DEFAULTS;
+    uint64_t seed = 1;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "T:s:l:n:r:d:w:L:D:P:i:k:q:B:S:t:")) != -1) {
+        switch (opt) {
+        case 'T':
+            if (strcmp(optarg, "tree") == 0) tree = 1;
+            else if (strcmp(optarg, "leafspine") != 0) { usage(argv[0]); return 1; }
+            break;
+        case 's': spines = atoi(optarg); break;
+        case 'l': leaves = atoi(optarg); break;
+        case 'n': hosts = atoi(optarg); break;
+        case 'r': radix = atoi(optarg); break;
+        case 'd': depth = atoi(optarg); break;
+        case 'w':
+            if (strcmp(optarg, "uniform") == 0) workload = UNIFORM;
+            else if (strcmp(optarg, "permutation") == 0) workload = PERMUTATION;
+            else if (strcmp(optarg, "incast") == 0) workload = INCAST;
+            else { usage(argv[0]); return 1; }
+            break;
+        case 'L': load = atof(optarg); break;
+        case 'D': duration_ms = atof(optarg); break;
+        case 'P': bytes = atoi(optarg); break;
+        case 'i': senders = atoi(optarg); break;
+        case 'k': burst_kb = atof(optarg); break;
+        case 'q':
+            if (strcmp(optarg, "red") == 0) cfg.queue = NETSIM_RED;
+            else if (strcmp(optarg, "droptail") == 0) cfg.queue = NETSIM_DROPTAIL;
+            else { usage(argv[0]); return 1; }
+            break;
+        case 'B': buffer_kb = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 0); break;
+        case 't': top = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (load <= 0 || duration_ms <= 0 || bytes < 64 || bytes > 65536 || burst_kb <= 0 || buffer_kb < 1 ||
+        buffer_kb > 1 << 20) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct topology t;
+    int built = tree ? topo_binary_tree(&t, depth, hosts < 0 ? 0 : hosts, err, sizeof(err))
+                     : topo_leaf_spine(&t, spines, leaves, hosts < 0 ? 2 : hosts, radix, err, sizeof(err));
+    if (built < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    if (t.host_count < 2) {
+        fprintf(stderr, "Need at least two hosts\n");
+        return 1;
+    }
+    if (senders < 0 || senders > (int)t.host_count - 1) senders = t.host_count - 1;
+    if (tree) printf("Binary tree: depth %d, %u hosts: %u nodes, %u links\n", depth, t.host_count, t.node_count,
+                     t.link_count);
+    else printf("Fabric: %d spines, %d leaves, %u hosts, radix %d: %u nodes, %u links\n", spines, leaves,
+                t.host_count, radix, t.node_count, t.link_count);
+
+    sim_seed(seed);
+
+    struct netsim s;
+    cfg.buffer_bytes = (uint32_t)buffer_kb * 1024;
+    cfg.seed = sim_rand() | 1;
+    if (netsim_init(&s, &t, &cfg, err, sizeof(err)) < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+
+    struct incast in = {NULL, NULL};
+    uint64_t count = (uint64_t)(burst_kb * 1024 / bytes + 0.5);
+    if (count < 1) count = 1;
+    sim_time duration = (sim_time)(duration_ms * NETSIM_MS);
+    if (workload == INCAST) {
+        add_incast(&s, &t, &in, (uint32_t)senders, (uint32_t)bytes, count);
+        printf("Incast: %d senders, %llu packets of %d bytes each to h1, %s queues of %d KB\n", senders,
+               (unsigned long long)count, bytes, cfg.queue == NETSIM_RED ? "RED" : "drop-tail", buffer_kb);
+    } else {
+        add_poisson(&s, &t, workload, load, (uint32_t)bytes, duration, 4);
+        printf("%s Poisson traffic at %.0f%% of each host link for %g ms, %d-byte packets, %s queues of %d KB\n",
+               workload == UNIFORM ? "Uniform" : "Permutation", load * 100, duration_ms, bytes,
+               cfg.queue == NETSIM_RED ? "RED" : "drop-tail", buffer_kb);
+    }
+
+    // Run until every packet is delivered or dropped
+    double t0 = sim_wall_sec();
+    netsim_run(&s, UINT64_MAX);
+    double wall = sim_wall_sec() - t0;
+    printf("Simulated %.3f ms in %.3f s: %llu events (%.2f M/s), %.2f M packets/s, peak %llu packets in flight\n\n",
+           (double)s.now / NETSIM_MS, wall, (unsigned long long)s.events_run, s.events_run / wall / 1e6,
+           s.sent / wall / 1e6, (unsigned long long)s.packets.peak);
+
+    printf("Packets: %llu sent, %llu delivered, %llu dropped (%.2f%%)\n", (unsigned long long)s.sent,
+           (unsigned long long)s.delivered, (unsigned long long)s.dropped,
+           s.sent ? 100.0 * s.dropped / s.sent : 0.0);
+    if (workload != INCAST) {
+        printf("Delivered throughput: %.3f Gbit/s over %g ms\n", s.delivered_bytes * 8.0 / (duration / 1000.0),
+               duration_ms);
+    }
+    if (s.delivered) {
+        printf("Latency (us): mean %.1f, p50 %.1f, p90 %.1f, p99 %.1f, p99.9 %.1f, max %.1f\n",
+               s.latency_sum / s.delivered / 1e6, netsim_latency_ns(&s, 0.5) / 1e3, netsim_latency_ns(&s, 0.9) / 1e3,
+               netsim_latency_ns(&s, 0.99) / 1e3, netsim_latency_ns(&s, 0.999) / 1e3,
+               netsim_latency_ns(&s, 1.0) / 1e3);
+    }
+    if (workload == INCAST) report_incast(&in, (uint32_t)senders, count);
+    report_ports(&t, &s, top);
+
+    free(in.received);
+    free(in.done);
+    netsim_free(&s);
+    topo_free(&t);
+    return 0;
+}
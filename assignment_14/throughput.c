@@ -0,0 +1,378 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../common/maxmin.h"
+#include "../common/simutil.h"
+#include "../common/topology.h"
+
+/**
+ * Throughput prediction for a traffic matrix without running iperf in
+ * Mininet: long-lived TCP flows converge to roughly max-min fair shares, so
+ * the flows are routed over the topology (shortest-path ECMP, one random
+ * hash per flow like distinct source ports) and their max-min fair rates
+ * computed with common/maxmin.c.
+ *
+ * The topology is the leaf-spine fabric of leaf_spine_topology.py or the
+ * binary tree of assignment_13/topo.py (h1 on s4, h2 on s7), or a deeper
+ * tree with hosts on every bottom switch. The matrix comes from a file of
+ * "src dst [flows] [Mbit/s]" lines using the Mininet host names (no rate
+ * means an elastic flow, '#' starts a comment) or is generated: -f flows
+ * between random pairs, a permutation or a stride pattern.
+ *
+ * The report gives the solve time, aggregate throughput, the spread of
+ * per-flow rates with Jain's fairness index, each matrix row's throughput,
+ * and the ports that bottleneck the most flows. -c replays random
+ * departures and arrivals through the incremental update.
+ */
+
+enum pattern { UNIFORM, PERMUTATION, STRIDE };
+
+struct row {
+    uint32_t src, dst;         // host nodes
+    int flows;
+    double demand;             // per flow, Gbit/s; 0 for elastic
+    int first;                 // first flow id of the row
+};
+
+uint32_t find_host(const struct topology *t, const char *name) {
+    char buf[32];
+    for (uint32_t i = 0; i < t->host_count; i++) {
+        topo_node_name(t, topo_host_node(t, i), buf, sizeof(buf));
+        if (strcmp(buf, name) == 0) return topo_host_node(t, i);
+    }
+    return UINT32_MAX;
+}
+
+/* Reads "src dst [flows] [Mbit/s]" lines. Exits with the line number on
+ * unknown hosts or malformed lines. */
+struct row *read_matrix(const struct topology *t, const char *path, uint32_t *count) {
+    FILE *fp = fopen(path, "r");
+    if (!fp) {
+        perror("Failed to open traffic matrix");
+        exit(1);
+    }
+    struct row *rows = NULL;
+    uint32_t n = 0, cap = 0;
+    char line[256], src[64], dst[64];
+    int lineno = 0;
+
+    while (fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *hash = strchr(line, '#');
+        if (hash) *hash = '\0';
+        int flows = 1;
+        double mbps = 0;
+        int fields = sscanf(line, "%63s %63s %d %lf", src, dst, &flows, &mbps);
+        if (fields <= 0) continue;
+        if (fields < 2 || flows < 1 || mbps < 0) {
+            fprintf(stderr, "%s:%d: expected \"src dst [flows] [Mbit/s]\"\n", path, lineno);
+            exit(1);
+        }
+        uint32_t s = find_host(t, src), d = find_host(t, dst);
+        if (s == UINT32_MAX || d == UINT32_MAX || s == d) {
+            fprintf(stderr, "%s:%d: unknown host or host to itself: %s %s\n", path, lineno, src, dst);
+            exit(1);
+        }
+        if (n == cap) {
+            cap = cap ? 2 * cap : 64;
+            rows = realloc(rows, cap * sizeof(*rows));
+            if (!rows) {
+                perror("realloc failed");
+                exit(1);
+            }
+        }
+        rows[n++] = (struct row){s, d, flows, mbps / 1000, 0};
+    }
+    fclose(fp);
+    *count = n;
+    return rows;
+}
+
+struct row *make_rows(const struct topology *t, uint32_t count, enum pattern p, double demand) {
+    struct row *rows = malloc(count * sizeof(*rows));
+    uint32_t hosts = t->host_count, *perm = NULL;
+    uint32_t per_switch = 0;
+
+    // Stride skips to the same host on the next switch
+    uint32_t first_switch = t->nodes[topo_host_node(t, 0)].uplink;
+    while (per_switch < hosts && t->nodes[topo_host_node(t, per_switch)].uplink == first_switch) per_switch++;
+
+    if (!rows) {
+        perror("malloc failed");
+        exit(1);
+    }
+    if (p == PERMUTATION) {
+        // Sattolo's shuffle: one cycle, so no host sends to itself
+        perm = malloc(hosts * sizeof(*perm));
+        for (uint32_t i = 0; i < hosts; i++) perm[i] = i;
+        for (uint32_t i = hosts - 1; i > 0; i--) {
+            uint32_t j = sim_below(i), tmp = perm[i];
+            perm[i] = perm[j];
+            perm[j] = tmp;
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t s, d;
+        switch (p) {
+        case PERMUTATION:
+            s = i % hosts;
+            d = perm[s];
+            break;
+        case STRIDE:
+            s = i % hosts;
+            d = (s + per_switch) % hosts;
+            if (d == s) d = (s + 1) % hosts;
+            break;
+        default:
+            s = sim_below(hosts);
+            d = sim_below(hosts - 1);
+            if (d >= s) d++;
+            break;
+        }
+        rows[i] = (struct row){topo_host_node(t, s), topo_host_node(t, d), 1, demand, 0};
+    }
+    free(perm);
+    return rows;
+}
+
+/* Routes every flow of the rows and adds it to the solver; rows are routed
+ * grouped by destination switch so each BFS serves a whole group. */
+void add_flows(const struct topology *t, struct topo_router *r, struct maxmin *m, struct row *rows, uint32_t count) {
+    uint32_t *start = calloc(t->node_count + 1, sizeof(*start)), *order = malloc(count * sizeof(*order));
+    uint32_t ports[MAXMIN_MAX_HOPS];
+
+    if (!start || !order) {
+        perror("malloc failed");
+        exit(1);
+    }
+    for (uint32_t i = 0; i < count; i++) start[t->nodes[rows[i].dst].uplink + 1]++;
+    for (uint32_t n = 0; n < t->node_count; n++) start[n + 1] += start[n];
+    for (uint32_t i = 0; i < count; i++) order[start[t->nodes[rows[i].dst].uplink]++] = i;
+
+    for (uint32_t k = 0; k < count; k++) {
+        struct row *row = &rows[order[k]];
+        for (int f = 0; f < row->flows; f++) {
+            int hops = topo_route(r, row->src, row->dst, (uint32_t)sim_rand(), ports, MAXMIN_MAX_HOPS);
+            int id = hops < 0 ? -1 : maxmin_add(m, ports, hops, row->demand);
+            if (id < 0) {
+                fprintf(stderr, "Failed to add a flow (no route, path too long or out of memory)\n");
+                exit(1);
+            }
+            // Ids are handed out in order while nothing has departed
+            if (f == 0) row->first = id;
+        }
+    }
+    free(start);
+    free(order);
+}
+
+int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+void report(const struct topology *t, const struct maxmin *m, const struct row *rows, uint32_t count, int list,
+            int top) {
+    uint32_t n = m->live;
+    double *rates = malloc(n * sizeof(*rates));
+    double total = 0, squares = 0;
+    uint32_t k = 0;
+
+    for (uint32_t f = 0; f < m->flow_slots; f++) {
+        if (!m->flows[f].hop_count) continue;
+        rates[k++] = m->flows[f].rate;
+        total += m->flows[f].rate;
+        squares += m->flows[f].rate * m->flows[f].rate;
+    }
+    qsort(rates, n, sizeof(*rates), cmp_double);
+    printf("Aggregate throughput: %.3f Gbit/s over %u flows\n", total, n);
+    printf("Per flow (Mbit/s): min %.3f, median %.3f, mean %.3f, p99 %.3f, max %.3f\n", rates[0] * 1e3,
+           rates[n / 2] * 1e3, total / n * 1e3, rates[(uint32_t)(n * 0.99)] * 1e3, rates[n - 1] * 1e3);
+    printf("Jain's fairness index: %.4f\n", squares > 0 ? total * total / (n * squares) : 1.0);
+    free(rates);
+
+    if (list) {
+        char a[32], b[32];
+        printf("\n%-10s    %-10s %6s %14s %14s\n", "Source", "Destination", "Flows", "Mbit/s", "Per flow");
+        for (uint32_t i = 0; i < count; i++) {
+            double sum = 0;
+            for (int f = 0; f < rows[i].flows; f++) sum += m->flows[rows[i].first + f].rate;
+            topo_node_name(t, rows[i].src, a, sizeof(a));
+            topo_node_name(t, rows[i].dst, b, sizeof(b));
+            printf("%-10s -> %-10s %6d %14.3f %14.3f\n", a, b, rows[i].flows, sum * 1e3, sum / rows[i].flows * 1e3);
+        }
+    }
+
+    // Ports by the number of flows they hold back
+    uint32_t ports = m->port_count, *held = calloc(ports, sizeof(*held)), full = 0;
+    double *level = malloc(ports * sizeof(*level));
+    for (uint32_t f = 0; f < m->flow_slots; f++) {
+        const struct maxmin_flow *fl = &m->flows[f];
+        if (!fl->hop_count || fl->bottleneck == MAXMIN_DEMAND) continue;
+        held[fl->bottleneck]++;
+        level[fl->bottleneck] = fl->rate;   // the same for all flows it holds
+    }
+    for (uint32_t p = 0; p < ports; p++) full += held[p] > 0;
+    printf("\n%u of %u ports are bottlenecks", full, ports);
+    printf(top > 0 && full ? "; the busiest:\n" : "\n");
+    for (int i = 0; i < top; i++) {
+        uint32_t best = UINT32_MAX;
+        for (uint32_t p = 0; p < ports; p++) {
+            if (held[p] && (best == UINT32_MAX || held[p] > held[best])) best = p;
+        }
+        if (best == UINT32_MAX) break;
+        char a[32], b[32];
+        topo_node_name(t, topo_port_from(t, best), a, sizeof(a));
+        topo_node_name(t, topo_port_to(t, best), b, sizeof(b));
+        printf("  %-10s -> %-10s %8u flows at %.3f Mbit/s  (%g Gbit/s link)\n", a, b, held[best], level[best] * 1e3,
+               t->links[best >> 1].gbps);
+        held[best] = 0;
+    }
+    free(held);
+    free(level);
+}
+
+// Random departures, each followed by an arrival between a random host pair
+void churn(const struct topology *t, struct topo_router *r, struct maxmin *m, int events) {
+    uint32_t ports[MAXMIN_MAX_HOPS];
+    double arrive = 0, depart = 0;
+    uint64_t refilled = 0;
+
+    for (int e = 0; e < events; e++) {
+        uint32_t f;
+        do f = sim_below(m->flow_slots);
+        while (!m->flows[f].hop_count);
+        double demand = m->flows[f].demand, t0 = sim_wall_sec();
+        maxmin_depart(m, f);
+        depart += sim_wall_sec() - t0;
+        refilled += m->last_flows;
+
+        uint32_t s = sim_below(t->host_count), d = sim_below(t->host_count - 1);
+        if (d >= s) d++;
+        int hops = topo_route(r, topo_host_node(t, s), topo_host_node(t, d), (uint32_t)sim_rand(), ports,
+                              MAXMIN_MAX_HOPS);
+        t0 = sim_wall_sec();
+        maxmin_arrive(m, ports, hops, demand);
+        arrive += sim_wall_sec() - t0;
+        refilled += m->last_flows;
+    }
+    printf("\n%d departures and arrivals: %.1f us and %.1f us per update, %.0f flows refilled on average\n", events,
+           depart / events * 1e6, arrive / events * 1e6, (double)refilled / (2.0 * events));
+}
+
+void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-T leafspine|tree] [-s spines] [-l leaves] [-n hosts] [-r radix] [-d depth]\n"
+                    "       [-m matrix.txt | -f flows [-p uniform|permutation|stride] [-b Mbit/s]]\n"
+                    "       [-c churn_events] [-S seed] [-t top_ports]\n", prog);
+    fprintf(stderr, "  leafspine: fabric as in leaf_spine_topology.py (defaults 2 spines, 4 leaves, 2 hosts, radix 16)\n");
+    fprintf(stderr, "  tree: binary tree of topo.py (depth 3, h1 on s4, h2 on s7); -n puts hosts on every bottom switch\n");
+    fprintf(stderr, "  -m lines of \"src dst [flows] [Mbit/s]\" with Mininet host names, e.g. \"h1 h2 4\"\n");
+    fprintf(stderr, "  -f generated flows (default 100000), each limited to -b Mbit/s (default elastic)\n");
+    fprintf(stderr, "  -c replay random departures and arrivals through incremental updates\n");
+}
+
+int main(int argc, char *argv[]) {
+    int tree = 0, spines = 2, leaves = 4, hosts = -1, radix = 16, depth = 3, events = 0, top = 5, opt;
+    long flow_count = 100000;
+    enum pattern pattern = UNIFORM;
+    double demand_mbps = 0;
+    const char *matrix_path = NULL;
+    uint64_t seed = 1;
+    char err[128];
+
+    while ((opt = getopt(argc, argv, "T:s:l:n:r:d:m:f:p:b:c:S:t:")) != -1) {
+        switch (opt) {
+        case 'T':
+            if (strcmp(optarg, "tree") == 0) tree = 1;
+            else if (strcmp(optarg, "leafspine") != 0) { usage(argv[0]); return 1; }
+            break;
+        case 's': spines = atoi(optarg); break;
+        case 'l': leaves = atoi(optarg); break;
+        case 'n': hosts = atoi(optarg); break;
+        case 'r': radix = atoi(optarg); break;
+        case 'd': depth = atoi(optarg); break;
+        case 'm': matrix_path = optarg; break;
+        case 'f': flow_count = atol(optarg); break;
+        case 'p':
+            if (strcmp(optarg, "permutation") == 0) pattern = PERMUTATION;
+            else if (strcmp(optarg, "stride") == 0) pattern = STRIDE;
+            else if (strcmp(optarg, "uniform") == 0) pattern = UNIFORM;
+            else { usage(argv[0]); return 1; }
+            break;
+        case 'b': demand_mbps = atof(optarg); break;
+        case 'c': events = atoi(optarg); break;
+        case 'S': seed = strtoull(optarg, NULL, 0); break;
+        case 't': top = atoi(optarg); break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (flow_count < 1 || flow_count > INT32_MAX || demand_mbps < 0 || events < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    struct topology t;
+    int built = tree ? topo_binary_tree(&t, depth, hosts < 0 ? 0 : hosts, err, sizeof(err))
+                     : topo_leaf_spine(&t, spines, leaves, hosts < 0 ? 2 : hosts, radix, err, sizeof(err));
+    if (built < 0) {
+        fprintf(stderr, "%s\n", err);
+        return 1;
+    }
+    if (t.host_count < 2) {
+        fprintf(stderr, "Need at least two hosts\n");
+        return 1;
+    }
+    if (tree) printf("Binary tree: depth %d, %u hosts: %u nodes, %u links\n", depth, t.host_count, t.node_count,
+                     t.link_count);
+    else printf("Fabric: %d spines, %d leaves, %u hosts, radix %d: %u nodes, %u links\n", spines, leaves,
+                t.host_count, radix, t.node_count, t.link_count);
+
+    sim_seed(seed);
+
+    uint32_t count;
+    struct row *rows;
+    if (matrix_path) {
+        rows = read_matrix(&t, matrix_path, &count);
+        if (count == 0) {
+            fprintf(stderr, "%s: no flows\n", matrix_path);
+            return 1;
+        }
+    } else {
+        count = (uint32_t)flow_count;
+        rows = make_rows(&t, count, pattern, demand_mbps / 1000);
+    }
+
+    uint32_t ports = 2 * t.link_count;
+    double *capacity = malloc(ports * sizeof(*capacity));
+    struct topo_router r;
+    struct maxmin m;
+    if (!capacity || topo_router_init(&r, &t) < 0) {
+        perror("malloc failed");
+        return 1;
+    }
+    for (uint32_t l = 0; l < t.link_count; l++) capacity[2 * l] = capacity[2 * l + 1] = t.links[l].gbps;
+    if (maxmin_init(&m, ports, capacity) < 0) {
+        perror("malloc failed");
+        return 1;
+    }
+
+    double t0 = sim_wall_sec();
+    add_flows(&t, &r, &m, rows, count);
+    double routed = sim_wall_sec() - t0;
+    t0 = sim_wall_sec();
+    maxmin_solve(&m);
+    double solved = sim_wall_sec() - t0;
+    printf("Flows: %u routed in %.3f s, max-min rates solved in %.3f s (%.2f M flows/s)\n\n", m.live, routed, solved,
+           m.live / solved / 1e6);
+
+    report(&t, &m, rows, count, matrix_path != NULL, top);
+    if (events) churn(&t, &r, &m, events);
+
+    maxmin_free(&m);
+    topo_router_free(&r);
+    topo_free(&t);
+    free(capacity);
+    free(rows);
+    return 0;
+}
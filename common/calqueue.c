@@ -0,0 +1,164 @@
+#include "calqueue.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#define MIN_BUCKETS 16
+#define WIDTH_SAMPLE 25
+
+static int alloc_buckets(struct calq *q, uint32_t nbuckets) {
+    struct cq_node **head = calloc(nbuckets, sizeof(*head)), **tail = calloc(nbuckets, sizeof(*tail));
+    if (!head || !tail) {
+        free(head);
+        free(tail);
+        return -1;
+    }
+    free(q->head);
+    free(q->tail);
+    q->head = head;
+    q->tail = tail;
+    q->nbuckets = nbuckets;
+    return 0;
+}
+
+int calq_init(struct calq *q) {
+    memset(q, 0, sizeof(*q));
+    if (alloc_buckets(q, MIN_BUCKETS) < 0) return -1;
+    q->width = 1;
+    q->bucket_top = 1;
+    return 0;
+}
+
+static void insert(struct calq *q, struct cq_node *n) {
+    uint32_t b = (uint32_t)(n->time / q->width) & (q->nbuckets - 1);
+    struct cq_node *t = q->tail[b];
+
+    if (!t || t->time <= n->time) {
+        // After everything in the bucket, which is the usual case
+        n->next = NULL;
+        if (t) t->next = n;
+        else q->head[b] = n;
+        q->tail[b] = n;
+        return;
+    }
+    struct cq_node **link = &q->head[b];
+    while ((*link)->time <= n->time) link = &(*link)->next;
+    n->next = *link;
+    *link = n;
+}
+
+static void place(struct calq *q, uint64_t time) {
+    uint64_t slot = time / q->width;
+    q->cur = (uint32_t)slot & (q->nbuckets - 1);
+    q->bucket_top = (slot + 1) * q->width;
+}
+
+/* Rebuilds with `nbuckets` buckets and a width of three times the average
+ * gap between the earliest entries, ignoring gaps over twice the average
+ * (Brown's estimate). Keeps the old layout if memory runs out. */
+static void resize(struct calq *q, uint32_t nbuckets) {
+    struct cq_node *all = NULL, **end = &all;
+    uint64_t sample[WIDTH_SAMPLE + 1];
+    size_t size = q->size;
+    uint64_t last = q->last;
+    int k = 0;
+
+    /* Pop the earliest entries for the estimate, then chain the buckets
+     * after them. Equal times share a bucket, so reinserting in this order
+     * keeps them first in, first out. */
+    q->resizing = 1;
+    while (k <= WIDTH_SAMPLE && k < (int)size) {
+        struct cq_node *n = calq_pop(q);
+        sample[k++] = n->time;
+        *end = n;
+        end = &n->next;
+    }
+    q->resizing = 0;
+    for (uint32_t b = 0; b < q->nbuckets; b++) {
+        if (!q->head[b]) continue;
+        *end = q->head[b];
+        end = &q->tail[b]->next;
+    }
+    *end = NULL;
+
+    if (k > 1) {
+        uint64_t total = sample[k - 1] - sample[0], sum = 0;
+        int used = 0;
+        double avg = (double)total / (k - 1);
+        for (int i = 1; i < k; i++) {
+            uint64_t gap = sample[i] - sample[i - 1];
+            if (gap <= 2 * avg) {
+                sum += gap;
+                used++;
+            }
+        }
+        uint64_t width = used && sum ? 3 * sum / used : 0;
+        if (width) q->width = width;
+    }
+    if (alloc_buckets(q, nbuckets) < 0) memset(q->head, 0, q->nbuckets * sizeof(*q->head));
+    memset(q->tail, 0, q->nbuckets * sizeof(*q->tail));
+    // The sampled entries go back in, so the walk restarts at the earliest
+    q->size = size;
+    q->last = last;
+    place(q, k ? sample[0] : last);
+    while (all) {
+        struct cq_node *next = all->next;
+        insert(q, all);
+        all = next;
+    }
+}
+
+void calq_push(struct calq *q, struct cq_node *n) {
+    if (n->time < q->last) n->time = q->last;
+    // A peek may have moved the walk past this entry's slot
+    if (n->time < q->bucket_top - q->width) place(q, n->time);
+    insert(q, n);
+    q->size++;
+    if (q->size > 2 * (size_t)q->nbuckets && !q->resizing) resize(q, q->nbuckets * 2);
+}
+
+/* Finds the earliest entry and moves the walk to its bucket. */
+static struct cq_node *find(struct calq *q) {
+    uint32_t mask = q->nbuckets - 1, b = q->cur;
+    uint64_t top = q->bucket_top;
+    for (uint32_t lap = 0; lap < q->nbuckets; lap++) {
+        struct cq_node *h = q->head[b];
+        if (h && h->time < top) {
+            q->cur = b;
+            q->bucket_top = top;
+            return h;
+        }
+        b = (b + 1) & mask;
+        top += q->width;
+    }
+    // Nothing within a year: jump to the earliest entry
+    struct cq_node *n = NULL;
+    for (uint32_t i = 0; i < q->nbuckets; i++) {
+        if (q->head[i] && (!n || q->head[i]->time < n->time)) n = q->head[i];
+    }
+    place(q, n->time);
+    return n;
+}
+
+struct cq_node *calq_peek(struct calq *q) {
+    return q->size ? find(q) : NULL;
+}
+
+struct cq_node *calq_pop(struct calq *q) {
+    if (!q->size) return NULL;
+
+    struct cq_node *n = find(q);
+    uint32_t b = q->cur;
+    q->head[b] = n->next;
+    if (!n->next) q->tail[b] = NULL;
+    q->size--;
+    q->last = n->time;
+    if (q->size < q->nbuckets / 2 && q->nbuckets > MIN_BUCKETS && !q->resizing) resize(q, q->nbuckets / 2);
+    return n;
+}
+
+void calq_free(struct calq *q) {
+    free(q->head);
+    free(q->tail);
+    memset(q, 0, sizeof(*q));
+}
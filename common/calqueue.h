@@ -0,0 +1,61 @@
+#ifndef CALQUEUE_H
+#define CALQUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Calendar queue (R. Brown, CACM 1988): a priority queue of timestamped
+ * entries with O(1) expected insert and pop for the event sets of
+ * discrete-event simulators.
+ *
+ * Time is split into buckets `width` long; bucket i holds the entries whose
+ * time / width is i modulo the bucket count, as a list sorted by time. Pop
+ * walks the buckets from the current one, taking an entry only if it falls
+ * in the bucket's slot of the current "year"; after a full lap without one
+ * it jumps straight to the earliest entry. The bucket count doubles or
+ * halves with the number of entries and the width is re-estimated from the
+ * gaps between the earliest entries, so buckets hold a few entries each.
+ *
+ * Entries are intrusive: embed a struct cq_node at the start of the event.
+ * Entries with equal times pop in insertion order, and a tail pointer per
+ * bucket makes the common case of inserting after everything in the bucket
+ * O(1), including bursts at one timestamp.
+ *
+ *     struct calq q;
+ *     calq_init(&q);
+ *     ev->node.time = now + delay;
+ *     calq_push(&q, &ev->node);
+ *     struct cq_node *next = calq_pop(&q);
+ */
+
+struct cq_node {
+    uint64_t time;
+    struct cq_node *next;
+};
+
+struct calq {
+    struct cq_node **head, **tail;
+    uint32_t nbuckets;         // power of two
+    uint64_t width;
+    uint32_t cur;              // bucket of the last pop
+    uint64_t bucket_top;       // end of the current bucket's slot in this year
+    uint64_t last;             // time of the last pop; pushes may not go earlier
+    size_t size;
+    int resizing;
+};
+
+int calq_init(struct calq *q);
+
+/* Inserts an entry; its time must not be before the last popped time. */
+void calq_push(struct calq *q, struct cq_node *n);
+
+/* Returns the earliest entry without removing it, or NULL when empty. */
+struct cq_node *calq_peek(struct calq *q);
+
+/* Removes and returns the earliest entry, or NULL when empty. */
+struct cq_node *calq_pop(struct calq *q);
+
+void calq_free(struct calq *q);
+
+#endif
@@ -0,0 +1,172 @@
+#include "capindex.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define CAPIDX_MAGIC "CAPIDX1"
+
+struct capidx_header {
+    char magic[8];
+    uint32_t interval;
+    uint32_t reserved;
+    uint64_t capture_size;
+    int64_t capture_mtime;
+    uint64_t packets;
+    int64_t first_ts_ns;
+    uint64_t count;
+};
+
+static int64_t file_mtime(const char *path, uint64_t *size) {
+    struct stat st;
+    if (stat(path, &st) < 0) return -1;
+    *size = st.st_size;
+    return (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+// End offset of block `k`
+static uint64_t block_end(const struct cap_index *idx, size_t k) {
+    return k + 1 < idx->count ? idx->entries[k + 1].offset : idx->capture_size;
+}
+
+int capidx_build(struct capture *c, const char *capture_path, uint32_t interval, struct cap_index *idx,
+                 char *err, size_t err_size) {
+    struct cap_packet pkt;
+    size_t cap = 1024;
+    int rc;
+
+    memset(idx, 0, sizeof(*idx));
+    if (c->stream) {
+        snprintf(err, err_size, "compressed captures cannot be indexed");
+        return -1;
+    }
+    idx->interval = interval ? interval : CAPIDX_DEFAULT_INTERVAL;
+    idx->capture_mtime = file_mtime(capture_path, &idx->capture_size);
+    idx->entries = malloc(cap * sizeof(struct capidx_entry));
+    if (idx->entries == NULL) {
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+
+    cap_seek(c, c->data_start);
+    while ((rc = cap_next(c, &pkt)) > 0) {
+        if (idx->packets % idx->interval == 0) {
+            if (idx->count == cap) {
+                cap *= 2;
+                struct capidx_entry *grown = realloc(idx->entries, cap * sizeof(struct capidx_entry));
+                if (grown == NULL) {
+                    snprintf(err, err_size, "out of memory");
+                    return -1;
+                }
+                idx->entries = grown;
+            }
+            struct capidx_entry *e = &idx->entries[idx->count++];
+            e->offset = pkt.offset;
+            e->min_ts_ns = e->max_ts_ns = pkt.ts_ns;
+        }
+        struct capidx_entry *e = &idx->entries[idx->count - 1];
+        if (pkt.ts_ns < e->min_ts_ns) e->min_ts_ns = pkt.ts_ns;
+        if (pkt.ts_ns > e->max_ts_ns) e->max_ts_ns = pkt.ts_ns;
+        if (idx->packets == 0) idx->first_ts_ns = pkt.ts_ns;
+        idx->packets++;
+    }
+    if (rc < 0) {
+        snprintf(err, err_size, "%s", c->err);
+        return -1;
+    }
+    if (c->sections > 1) {
+        snprintf(err, err_size, "pcapng files with several sections cannot be indexed");
+        return -1;
+    }
+    return 0;
+}
+
+int capidx_save(const struct cap_index *idx, const char *path) {
+    struct capidx_header h;
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) return -1;
+
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CAPIDX_MAGIC, sizeof(CAPIDX_MAGIC));
+    h.interval = idx->interval;
+    h.capture_size = idx->capture_size;
+    h.capture_mtime = idx->capture_mtime;
+    h.packets = idx->packets;
+    h.first_ts_ns = idx->first_ts_ns;
+    h.count = idx->count;
+
+    int ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+             fwrite(idx->entries, sizeof(struct capidx_entry), idx->count, fp) == idx->count;
+    return fclose(fp) == 0 && ok ? 0 : -1;
+}
+
+int capidx_load(struct cap_index *idx, const char *path, const char *capture_path) {
+    struct capidx_header h;
+    uint64_t size = 0;
+    FILE *fp = fopen(path, "rb");
+
+    memset(idx, 0, sizeof(*idx));
+    if (fp == NULL) return -1;
+    if (fread(&h, sizeof(h), 1, fp) != 1 || memcmp(h.magic, CAPIDX_MAGIC, sizeof(CAPIDX_MAGIC)) != 0 ||
+        h.interval == 0 || h.capture_mtime != file_mtime(capture_path, &size) || h.capture_size != size ||
+        h.count != (h.packets + h.interval - 1) / h.interval) {
+        fclose(fp);
+        return -1;
+    }
+
+    idx->interval = h.interval;
+    idx->capture_size = h.capture_size;
+    idx->capture_mtime = h.capture_mtime;
+    idx->packets = h.packets;
+    idx->first_ts_ns = h.first_ts_ns;
+    idx->count = h.count;
+    idx->entries = malloc((h.count ? h.count : 1) * sizeof(struct capidx_entry));
+    if (idx->entries == NULL || fread(idx->entries, sizeof(struct capidx_entry), h.count, fp) != h.count) {
+        fclose(fp);
+        capidx_free(idx);
+        return -1;
+    }
+    fclose(fp);
+    return 0;
+}
+
+void capidx_free(struct cap_index *idx) {
+    free(idx->entries);
+    idx->entries = NULL;
+    idx->count = 0;
+}
+
+void capidx_path(const char *capture_path, char *out, size_t size) {
+    snprintf(out, size, "%s.idx", capture_path);
+}
+
+int capidx_packet_range(const struct cap_index *idx, uint64_t first, uint64_t last, struct capidx_range *out) {
+    if (first < 1) first = 1;
+    if (last > idx->packets) last = idx->packets;
+    if (first > last) return 0;
+
+    size_t a = (first - 1) / idx->interval, b = (last - 1) / idx->interval;
+    out->start = idx->entries[a].offset;
+    out->end = block_end(idx, b);
+    out->first_packet = (uint64_t)a * idx->interval + 1;
+    return 1;
+}
+
+size_t capidx_time_ranges(const struct cap_index *idx, int64_t t0, int64_t t1, struct capidx_range *out) {
+    size_t n = 0;
+
+    for (size_t k = 0; k < idx->count; k++) {
+        const struct capidx_entry *e = &idx->entries[k];
+        if (e->max_ts_ns < t0 || e->min_ts_ns > t1) continue;
+        if (n > 0 && out[n - 1].end == e->offset) {
+            out[n - 1].end = block_end(idx, k);
+        } else {
+            out[n].start = e->offset;
+            out[n].end = block_end(idx, k);
+            out[n].first_packet = (uint64_t)k * idx->interval + 1;
+            n++;
+        }
+    }
+    return n;
+}
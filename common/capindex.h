@@ -0,0 +1,75 @@
+#ifndef CAPINDEX_H
+#define CAPINDEX_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "capture.h"
+
+/**
+ * Sidecar time/packet index for a capture file ("<capture>.idx").
+ *
+ * Packets are grouped into blocks of `interval` consecutive packets. For each
+ * block the index keeps the file offset of its first record and the smallest
+ * and largest timestamp inside it, so both "packets 1000000-1000100" and
+ * "everything between t=3600 s and t=3601 s" map to a few byte ranges that can
+ * be decoded directly, even if timestamps are not perfectly ordered.
+ *
+ * File layout (native byte order):
+ *   header   magic "CAPIDX1\0", interval, capture size and mtime, packet
+ *            count, first timestamp, entry count
+ *   entries  { uint64 offset; int64 min_ts_ns; int64 max_ts_ns; } per block
+ *
+ * The size and mtime of the capture are recorded so a stale index is
+ * rejected. Multi-section pcapng files cannot be indexed, because decoding
+ * from the middle of a later section needs that section's header.
+ */
+
+#define CAPIDX_DEFAULT_INTERVAL 1024
+
+struct capidx_entry {
+    uint64_t offset;       // first record of the block
+    int64_t min_ts_ns;
+    int64_t max_ts_ns;
+};
+
+struct cap_index {
+    uint32_t interval;     // packets per entry
+    uint64_t capture_size;
+    int64_t capture_mtime;
+    uint64_t packets;
+    int64_t first_ts_ns;   // timestamp of packet 1
+    size_t count;
+    struct capidx_entry *entries;
+};
+
+/* A byte range of the capture and the number of its first packet (1-based) */
+struct capidx_range {
+    uint64_t start;
+    uint64_t end;
+    uint64_t first_packet;
+};
+
+/* Index the capture open in `c`, which is read from its first packet.
+ * Returns 0, or -1 with a message in `err`. */
+int capidx_build(struct capture *c, const char *capture_path, uint32_t interval, struct cap_index *idx,
+                 char *err, size_t err_size);
+int capidx_save(const struct cap_index *idx, const char *path);
+
+/* Load `path` if it exists and matches `capture_path`. Returns 0, or -1 if it
+ * is missing, corrupt or stale. */
+int capidx_load(struct cap_index *idx, const char *path, const char *capture_path);
+void capidx_free(struct cap_index *idx);
+
+/* "<capture_path>.idx" */
+void capidx_path(const char *capture_path, char *out, size_t size);
+
+/* Byte range holding packets first..last (1-based, inclusive). Returns 0 if
+ * the range is empty. */
+int capidx_packet_range(const struct cap_index *idx, uint64_t first, uint64_t last, struct capidx_range *out);
+
+/* Byte ranges of the blocks that may hold packets with t0 <= ts <= t1
+ * (absolute ns). Adjacent blocks are merged. Returns the number of ranges
+ * written to `out` (an array of at least idx->count entries). */
+size_t capidx_time_ranges(const struct cap_index *idx, int64_t t0, int64_t t1, struct capidx_range *out);
+
+#endif
@@ -0,0 +1,320 @@
+#include "capstream.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <zlib.h>
+#ifdef CAPTURE_ZSTD
+#include <zstd.h>
+#endif
+
+struct chunk {
+    uint8_t *data;
+    size_t len;
+};
+
+struct cap_stream {
+    int fd;
+    enum capstream_codec codec;
+    pthread_t thread;
+
+    // Ring of decompressed chunks: [head, tail) are filled, the rest are free
+    pthread_mutex_t lock;
+    pthread_cond_t filled, freed;
+    struct chunk ring[CAPSTREAM_SLOTS];
+    uint64_t head, tail;
+    int done;              // the decompression thread has finished (end of input or error)
+    int stop;              // capstream_close() is waiting for it
+    char error[96];
+
+    // Decompression thread only
+    uint8_t *in;
+    size_t in_len, in_pos;
+    int in_eof;
+    int in_frame;          // inside a compressed frame / gzip member
+    uint64_t in_total;
+    z_stream zs;
+#ifdef CAPTURE_ZSTD
+    ZSTD_DStream *zds;
+#endif
+
+    // Reader only
+    uint8_t *window;
+    size_t window_len, window_cap;
+    uint64_t window_off;
+
+    struct capstream_stats st;   // in_bytes, busy and blocked are published by the thread under `lock`
+    double start;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+enum capstream_codec capstream_codec(const uint8_t *head, size_t len) {
+    if (len >= 2 && head[0] == 0x1f && head[1] == 0x8b) return CAPSTREAM_GZIP;
+    if (len >= 4 && head[0] == 0x28 && head[1] == 0xb5 && head[2] == 0x2f && head[3] == 0xfd) return CAPSTREAM_ZSTD;
+    return CAPSTREAM_NONE;
+}
+
+const char *capstream_codec_name(enum capstream_codec codec) {
+    return codec == CAPSTREAM_GZIP ? "gzip" : codec == CAPSTREAM_ZSTD ? "zstd" : "none";
+}
+
+// Refill the compressed input buffer once it is used up. Returns -1 on a read error.
+static int read_input(struct cap_stream *s) {
+    if (s->in_pos < s->in_len || s->in_eof) return 0;
+    ssize_t n;
+    do {
+        n = read(s->fd, s->in, CAPSTREAM_READ);
+    } while (n < 0 && errno == EINTR);
+    if (n < 0) {
+        snprintf(s->error, sizeof(s->error), "read failed: %s", strerror(errno));
+        return -1;
+    }
+    s->in_len = n;
+    s->in_pos = 0;
+    s->in_eof = n == 0;
+    s->in_total += n;
+    return 0;
+}
+
+/* Decompress into `c` until it is full or the input ends. Concatenated gzip
+ * members (pigz, bgzip, cat a.gz b.gz) are read one after another. Returns
+ * -1 on corrupt or truncated input. */
+static int inflate_chunk(struct cap_stream *s, struct chunk *c) {
+    while (c->len < CAPSTREAM_CHUNK) {
+        if (read_input(s) < 0) return -1;
+        if (s->in_eof) break;
+
+        s->zs.next_in = s->in + s->in_pos;
+        s->zs.avail_in = s->in_len - s->in_pos;
+        s->zs.next_out = c->data + c->len;
+        s->zs.avail_out = CAPSTREAM_CHUNK - c->len;
+        int rc = inflate(&s->zs, Z_NO_FLUSH);
+        s->in_pos = s->in_len - s->zs.avail_in;
+        c->len = CAPSTREAM_CHUNK - s->zs.avail_out;
+        s->in_frame = 1;
+
+        if (rc == Z_STREAM_END) {
+            inflateReset(&s->zs);
+            s->in_frame = 0;
+        } else if (rc != Z_OK && rc != Z_BUF_ERROR) {
+            snprintf(s->error, sizeof(s->error), "gzip: %s", s->zs.msg ? s->zs.msg : "corrupt data");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+#ifdef CAPTURE_ZSTD
+static int zstd_chunk(struct cap_stream *s, struct chunk *c) {
+    while (c->len < CAPSTREAM_CHUNK) {
+        if (read_input(s) < 0) return -1;
+        if (s->in_eof) break;
+
+        ZSTD_inBuffer in = {s->in, s->in_len, s->in_pos};
+        ZSTD_outBuffer out = {c->data, CAPSTREAM_CHUNK, c->len};
+        size_t rc = ZSTD_decompressStream(s->zds, &out, &in);
+        if (ZSTD_isError(rc)) {
+            snprintf(s->error, sizeof(s->error), "zstd: %s", ZSTD_getErrorName(rc));
+            return -1;
+        }
+        s->in_pos = in.pos;
+        c->len = out.pos;
+        s->in_frame = rc != 0;   // 0: a frame just ended
+    }
+    return 0;
+}
+#endif
+
+static void *decompress_main(void *arg) {
+    struct cap_stream *s = arg;
+    double blocked = 0, busy = 0;
+    int rc = 0;
+
+    for (;;) {
+        double t0 = now_sec();
+        pthread_mutex_lock(&s->lock);
+        while (s->tail - s->head == CAPSTREAM_SLOTS && !s->stop) pthread_cond_wait(&s->freed, &s->lock);
+        int stop = s->stop;
+        pthread_mutex_unlock(&s->lock);
+        double t1 = now_sec();
+        blocked += t1 - t0;
+        if (stop) break;
+
+        // Only this thread touches the slot at `tail` until it is published
+        struct chunk *c = &s->ring[s->tail % CAPSTREAM_SLOTS];
+        c->len = 0;
+#ifdef CAPTURE_ZSTD
+        if (s->codec == CAPSTREAM_ZSTD) rc = zstd_chunk(s, c);
+        else
+#endif
+            rc = inflate_chunk(s, c);
+        if (rc == 0 && s->in_eof && s->in_frame) {
+            snprintf(s->error, sizeof(s->error), "%s stream ends in the middle of a frame",
+                     capstream_codec_name(s->codec));
+            rc = -1;
+        }
+        busy += now_sec() - t1;
+
+        pthread_mutex_lock(&s->lock);
+        s->st.in_bytes = s->in_total;
+        s->st.busy_sec = busy;
+        s->st.blocked_sec = blocked;
+        if (c->len > 0) s->tail++;
+        if (rc < 0 || s->in_eof) s->done = 1;
+        pthread_cond_signal(&s->filled);
+        pthread_mutex_unlock(&s->lock);
+        if (rc < 0 || s->in_eof) break;
+    }
+    return NULL;
+}
+
+static void free_stream(struct cap_stream *s) {
+    for (int i = 0; i < CAPSTREAM_SLOTS; i++) free(s->ring[i].data);
+    free(s->in);
+    free(s->window);
+    free(s);
+}
+
+struct cap_stream *capstream_open(int fd, enum capstream_codec codec, char *err, size_t err_size) {
+#ifndef CAPTURE_ZSTD
+    if (codec == CAPSTREAM_ZSTD) {
+        snprintf(err, err_size, "zstd archives need a build with -DCAPTURE_ZSTD ... -lzstd");
+        return NULL;
+    }
+#endif
+    if (codec == CAPSTREAM_NONE) {
+        snprintf(err, err_size, "not a compressed file");
+        return NULL;
+    }
+
+    struct cap_stream *s = calloc(1, sizeof(*s));
+    if (s == NULL) {
+        snprintf(err, err_size, "out of memory");
+        return NULL;
+    }
+    s->fd = fd;
+    s->codec = codec;
+    s->in = malloc(CAPSTREAM_READ);
+    int ok = s->in != NULL;
+    for (int i = 0; i < CAPSTREAM_SLOTS; i++) {
+        s->ring[i].data = malloc(CAPSTREAM_CHUNK);
+        ok = ok && s->ring[i].data != NULL;
+    }
+    if (!ok) {
+        snprintf(err, err_size, "out of memory");
+        free_stream(s);
+        return NULL;
+    }
+
+#ifdef CAPTURE_ZSTD
+    if (codec == CAPSTREAM_ZSTD) {
+        s->zds = ZSTD_createDStream();
+        if (s->zds == NULL) {
+            snprintf(err, err_size, "zstd: cannot create a decompression context");
+            free_stream(s);
+            return NULL;
+        }
+    }
+#endif
+    if (codec == CAPSTREAM_GZIP && inflateInit2(&s->zs, 15 + 16) != Z_OK) {
+        snprintf(err, err_size, "gzip: cannot initialize zlib");
+        free_stream(s);
+        return NULL;
+    }
+
+    pthread_mutex_init(&s->lock, NULL);
+    pthread_cond_init(&s->filled, NULL);
+    pthread_cond_init(&s->freed, NULL);
+    s->start = now_sec();
+    if (pthread_create(&s->thread, NULL, decompress_main, s) != 0) {
+        snprintf(err, err_size, "cannot start the decompression thread");
+        if (codec == CAPSTREAM_GZIP) inflateEnd(&s->zs);
+        free_stream(s);
+        return NULL;
+    }
+    return s;
+}
+
+int capstream_fill(struct cap_stream *s, size_t consumed, const uint8_t **base, size_t *size, char *err, size_t err_size) {
+    double t0 = now_sec();
+    pthread_mutex_lock(&s->lock);
+    while (s->head == s->tail && !s->done) pthread_cond_wait(&s->filled, &s->lock);
+    int empty = s->head == s->tail;
+    pthread_mutex_unlock(&s->lock);
+    s->st.starved_sec += now_sec() - t0;
+
+    if (empty) {
+        if (s->error[0] == '\0') return 0;
+        snprintf(err, err_size, "%s", s->error);
+        return -1;
+    }
+
+    // The chunk at `head` stays ours until `head` moves on
+    const struct chunk *c = &s->ring[s->head % CAPSTREAM_SLOTS];
+    size_t keep = s->window_len - consumed;
+    if (keep + c->len > s->window_cap) {
+        size_t cap = s->window_cap ? s->window_cap : CAPSTREAM_CHUNK;
+        while (cap < keep + c->len) cap *= 2;
+        uint8_t *grown = malloc(cap);
+        if (grown == NULL) {
+            snprintf(err, err_size, "out of memory");
+            return -1;
+        }
+        if (keep) memcpy(grown, s->window + consumed, keep);
+        free(s->window);
+        s->window = grown;
+        s->window_cap = cap;
+    } else if (keep) {
+        memmove(s->window, s->window + consumed, keep);
+    }
+    memcpy(s->window + keep, c->data, c->len);
+    s->window_len = keep + c->len;
+    s->window_off += consumed;
+    s->st.out_bytes += c->len;
+
+    pthread_mutex_lock(&s->lock);
+    s->head++;
+    pthread_cond_signal(&s->freed);
+    pthread_mutex_unlock(&s->lock);
+
+    *base = s->window;
+    *size = s->window_len;
+    return 1;
+}
+
+uint64_t capstream_offset(const struct cap_stream *s) {
+    return s->window_off;
+}
+
+void capstream_stats(struct cap_stream *s, struct capstream_stats *st) {
+    pthread_mutex_lock(&s->lock);
+    *st = s->st;
+    pthread_mutex_unlock(&s->lock);
+    st->wall_sec = now_sec() - s->start;
+}
+
+void capstream_close(struct cap_stream *s) {
+    pthread_mutex_lock(&s->lock);
+    s->stop = 1;
+    pthread_cond_signal(&s->freed);
+    pthread_mutex_unlock(&s->lock);
+    pthread_join(s->thread, NULL);
+
+    if (s->codec == CAPSTREAM_GZIP) inflateEnd(&s->zs);
+#ifdef CAPTURE_ZSTD
+    if (s->zds) ZSTD_freeDStream(s->zds);
+#endif
+    pthread_mutex_destroy(&s->lock);
+    pthread_cond_destroy(&s->filled);
+    pthread_cond_destroy(&s->freed);
+    free_stream(s);
+}
@@ -0,0 +1,66 @@
+#ifndef CAPSTREAM_H
+#define CAPSTREAM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Streaming decompression of compressed capture archives (.pcap.gz,
+ * .pcapng.gz, and .pcap.zst when built with -DCAPTURE_ZSTD ... -lzstd).
+ *
+ * cap_open() switches to a stream when the file starts with a gzip or zstd
+ * magic number, so every tool that reads captures through common/capture.c
+ * accepts archives as they are, without a temporary decompressed copy.
+ *
+ * A thread reads and decompresses the file into a ring of CAPSTREAM_SLOTS
+ * chunks of CAPSTREAM_CHUNK bytes. The ring is a bounded queue: when the
+ * decoder falls behind, the decompression thread waits for a free chunk
+ * instead of buffering the capture in memory. The reader appends each chunk
+ * to a window holding the records it has not consumed yet (a record split
+ * across two chunks is carried over whole), and decodes from the window in
+ * place exactly as it does from a mapped file.
+ */
+
+#define CAPSTREAM_CHUNK (1 << 20)
+#define CAPSTREAM_SLOTS 4
+#define CAPSTREAM_READ (256 * 1024)   // compressed bytes per read()
+
+enum capstream_codec { CAPSTREAM_NONE, CAPSTREAM_GZIP, CAPSTREAM_ZSTD };
+
+struct capstream_stats {
+    uint64_t in_bytes;     // compressed bytes read
+    uint64_t out_bytes;    // decompressed bytes handed to the reader
+    double busy_sec;       // decompression thread reading and inflating
+    double blocked_sec;    // decompression thread waiting for a free chunk (decoder is the bottleneck)
+    double starved_sec;    // reader waiting for a chunk (decompression is the bottleneck)
+    double wall_sec;       // since capstream_open()
+};
+
+struct cap_stream;
+
+/* Codec of a file starting with `head`, or CAPSTREAM_NONE */
+enum capstream_codec capstream_codec(const uint8_t *head, size_t len);
+
+const char *capstream_codec_name(enum capstream_codec codec);
+
+/* Start decompressing `fd` (which stays owned by the caller and must stay
+ * open until capstream_close()). Returns NULL with `err` set on failure,
+ * e.g. for zstd input in a build without CAPTURE_ZSTD. */
+struct cap_stream *capstream_open(int fd, enum capstream_codec codec, char *err, size_t err_size);
+
+/* Drop the first `consumed` bytes of the window and append the next chunk,
+ * waiting for it if necessary. `*base` and `*size` are set to the new window;
+ * pointers into the old one are invalid afterwards. Returns 1, 0 at the end
+ * of the stream (the window is unchanged), or -1 with `err` set if the input
+ * is corrupt or ends in the middle of a compressed frame. */
+int capstream_fill(struct cap_stream *s, size_t consumed, const uint8_t **base, size_t *size, char *err, size_t err_size);
+
+/* Offset in the decompressed stream of the first byte of the window */
+uint64_t capstream_offset(const struct cap_stream *s);
+
+void capstream_stats(struct cap_stream *s, struct capstream_stats *st);
+
+/* Stop the decompression thread and free the window */
+void capstream_close(struct cap_stream *s);
+
+#endif
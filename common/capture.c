@@ -0,0 +1,475 @@
+#define _GNU_SOURCE   // mremap
+#include "capture.h"
+#include "capstream.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define PCAP_MAGIC_USEC 0xa1b2c3d4u
+#define PCAP_MAGIC_NSEC 0xa1b23c4du
+#define PCAP_MAGIC_MODIFIED 0xa1b2cd34u
+#define PCAPNG_BOM 0x1a2b3c4du
+
+#define BLOCK_SHB 0x0a0d0d0au
+#define BLOCK_IDB 0x00000001u
+#define BLOCK_OPB 0x00000002u   // obsolete Packet Block
+#define BLOCK_SPB 0x00000003u
+#define BLOCK_EPB 0x00000006u
+
+#define OPT_ENDOFOPT 0
+#define OPT_IF_TSRESOL 9
+#define OPT_IF_TSOFFSET 14
+
+#define RESYNC_CHAIN 8                // consecutive records that must look valid
+#define RESYNC_MAX_LEN 262144         // largest plausible packet
+#define RESYNC_MAX_GAP 86400u         // largest plausible gap between pcap records (s)
+#define MAX_BLOCK_LEN (16u << 20)     // larger pcapng blocks are corrupt, not still being written
+
+static uint16_t rd16(const struct capture *c, const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, sizeof(v));
+    return c->swapped ? __builtin_bswap16(v) : v;
+}
+
+static uint32_t rd32(const struct capture *c, const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, sizeof(v));
+    return c->swapped ? __builtin_bswap32(v) : v;
+}
+
+static uint64_t rd64(const struct capture *c, const uint8_t *p) {
+    uint64_t v;
+    memcpy(&v, p, sizeof(v));
+    return c->swapped ? __builtin_bswap64(v) : v;
+}
+
+static int fail(struct capture *c, const char *msg, size_t offset) {
+    uint64_t off = offset + (c->stream ? capstream_offset(c->stream) : 0);
+    snprintf(c->err, sizeof(c->err), "%s at offset %lu", msg, (unsigned long)off);
+    return -1;
+}
+
+// A record that runs past the end of the file, which may still be growing
+static int cut_off(struct capture *c, const char *msg, size_t offset) {
+    c->truncated = 1;
+    return fail(c, msg, offset);
+}
+
+// Convert a raw pcapng timestamp in interface units to nanoseconds since the epoch
+static int64_t iface_ts_ns(const struct cap_iface *ifc, uint64_t ts) {
+    int64_t ns;
+    uint8_t n = ifc->tsresol & 0x7f;
+
+    if (n > 63) n = 63;
+
+    if (ifc->tsresol & 0x80) {
+        // 2^-n seconds per unit
+        ns = (int64_t)((ts >> n) * 1000000000ull + (uint64_t)(((unsigned __int128)(ts & ((1ull << n) - 1)) * 1000000000u) >> n));
+    } else if (n <= 9) {
+        static const uint64_t scale[10] = {1000000000, 100000000, 10000000, 1000000, 100000,
+                                           10000, 1000, 100, 10, 1};
+        ns = (int64_t)(ts * scale[n]);
+    } else {
+        uint64_t div = 1;
+        for (int i = 9; i < n && i < 28; i++) div *= 10;
+        ns = (int64_t)(ts / div);
+    }
+    return ns + ifc->tsoffset * 1000000000ll;
+}
+
+static int open_pcap(struct capture *c) {
+    const uint8_t *h = c->base;
+    uint32_t magic;
+
+    if (c->size < 24) return fail(c, "truncated pcap header", 0);
+    memcpy(&magic, h, sizeof(magic));
+    if (magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC) ||
+        magic == __builtin_bswap32(PCAP_MAGIC_MODIFIED)) {
+        c->swapped = 1;
+        magic = __builtin_bswap32(magic);
+    }
+    c->format = CAP_PCAP;
+    c->nsec = magic == PCAP_MAGIC_NSEC;
+    c->rec_hdr_len = magic == PCAP_MAGIC_MODIFIED ? 24 : 16;
+    c->ifaces[0].snaplen = rd32(c, h + 16);
+    c->ifaces[0].linktype = rd32(c, h + 20) & 0xffff;  // upper bits carry FCS information
+    c->iface_count = 1;
+    c->data_start = c->pos = 24;
+    return 0;
+}
+
+static int pcap_next(struct capture *c, struct cap_packet *p) {
+    const uint8_t *r = c->base + c->pos;
+
+    if (c->pos == c->size) return 0;
+    if (c->size - c->pos < c->rec_hdr_len) return cut_off(c, "truncated record header", c->pos);
+
+    uint32_t caplen = rd32(c, r + 8);
+    // A length no writer could produce would otherwise look like a record still being appended
+    uint32_t max_len = c->ifaces[0].snaplen > RESYNC_MAX_LEN ? c->ifaces[0].snaplen : RESYNC_MAX_LEN;
+    if (caplen > max_len) return fail(c, "record longer than the snap length", c->pos);
+    if (caplen > c->size - c->pos - c->rec_hdr_len) return cut_off(c, "truncated record", c->pos);
+
+    uint32_t frac = rd32(c, r + 4);
+    p->ts_ns = (int64_t)rd32(c, r) * 1000000000ll + (c->nsec ? frac : frac * 1000ll);
+    p->data = r + c->rec_hdr_len;
+    p->caplen = caplen;
+    p->len = rd32(c, r + 12);
+    p->iface = 0;
+    p->linktype = c->ifaces[0].linktype;
+    p->offset = c->pos;
+    c->pos += c->rec_hdr_len + caplen;
+    return 1;
+}
+
+/* Section Header Block: fixes the byte order of everything up to the next
+ * SHB. The caller starts a fresh interface list once the block is complete. */
+static int parse_shb(struct capture *c, const uint8_t *b, size_t avail) {
+    uint32_t bom;
+
+    if (avail < 28) return cut_off(c, "truncated section header", c->pos);
+    memcpy(&bom, b + 8, sizeof(bom));
+    if (bom == PCAPNG_BOM) c->swapped = 0;
+    else if (bom == __builtin_bswap32(PCAPNG_BOM)) c->swapped = 1;
+    else return fail(c, "bad pcapng byte-order magic", c->pos);
+    return 0;
+}
+
+static int parse_idb(struct capture *c, const uint8_t *b, uint32_t blen) {
+    if (blen < 20) return fail(c, "short interface block", c->pos);
+    if (c->iface_count == CAP_MAX_IFACES) return fail(c, "too many interfaces", c->pos);
+
+    struct cap_iface *ifc = &c->ifaces[c->iface_count++];
+    ifc->linktype = rd16(c, b + 8);
+    ifc->snaplen = rd32(c, b + 12);
+    ifc->tsresol = 6;
+    ifc->tsoffset = 0;
+
+    // Options: code, length, value padded to 32 bits
+    const uint8_t *opt = b + 16, *end = b + blen - 4;
+    while (opt + 4 <= end) {
+        uint16_t code = rd16(c, opt), olen = rd16(c, opt + 2);
+        const uint8_t *val = opt + 4;
+        if (code == OPT_ENDOFOPT || val + olen > end) break;
+        if (code == OPT_IF_TSRESOL && olen >= 1) ifc->tsresol = val[0];
+        if (code == OPT_IF_TSOFFSET && olen >= 8) ifc->tsoffset = (int64_t)rd64(c, val);
+        opt = val + ((olen + 3u) & ~3u);
+    }
+    return 0;
+}
+
+/* Consume the block at c->pos. Returns 1 for a packet, 0 for any other
+ * block, -1 on error. */
+static int pcapng_block(struct capture *c, struct cap_packet *p) {
+    if (c->size - c->pos < 12) return cut_off(c, "truncated block header", c->pos);
+
+    const uint8_t *b = c->base + c->pos;
+    size_t avail = c->size - c->pos;
+    uint32_t type;
+    memcpy(&type, b, sizeof(type));  // palindromic for SHB, so byte order doesn't matter yet
+
+    if (type == BLOCK_SHB && parse_shb(c, b, avail) < 0) return -1;
+    type = rd32(c, b);
+    uint32_t blen = rd32(c, b + 4);
+    if (blen < 12 || (blen & 3) != 0 || blen > MAX_BLOCK_LEN) return fail(c, "bad block length", c->pos);
+    if (blen > avail) return cut_off(c, "truncated block", c->pos);
+
+    size_t block_off = c->pos;
+    c->pos += blen;
+
+    switch (type) {
+    case BLOCK_SHB:
+        c->iface_count = 0;
+        c->sections++;
+        break;
+
+    case BLOCK_IDB:
+        if (parse_idb(c, b, blen) < 0) return -1;
+        break;
+
+    case BLOCK_EPB:
+    case BLOCK_OPB: {
+        if (blen < 32) return fail(c, "short packet block", block_off);
+        uint32_t id = type == BLOCK_EPB ? rd32(c, b + 8) : rd16(c, b + 8);
+        uint32_t caplen = rd32(c, b + 20);
+        if (id >= (uint32_t)c->iface_count) return fail(c, "packet for unknown interface", block_off);
+        if (caplen > blen - 32) return fail(c, "packet exceeds its block", block_off);
+
+        const struct cap_iface *ifc = &c->ifaces[id];
+        uint64_t ts = (uint64_t)rd32(c, b + 12) << 32 | rd32(c, b + 16);
+        p->data = b + 28;
+        p->caplen = caplen;
+        p->len = rd32(c, b + 24);
+        p->ts_ns = iface_ts_ns(ifc, ts);
+        p->iface = id;
+        p->linktype = ifc->linktype;
+        p->offset = block_off;
+        return 1;
+    }
+
+    case BLOCK_SPB: {
+        // Simple Packet Block: interface 0, no timestamp, caplen implied by the block size
+        if (blen < 16) return fail(c, "short packet block", block_off);
+        if (c->iface_count == 0) return fail(c, "packet for unknown interface", block_off);
+        uint32_t len = rd32(c, b + 8), caplen = len;
+        if (caplen > blen - 16) caplen = blen - 16;
+        if (c->ifaces[0].snaplen && caplen > c->ifaces[0].snaplen) caplen = c->ifaces[0].snaplen;
+        p->data = b + 12;
+        p->caplen = caplen;
+        p->len = len;
+        p->ts_ns = 0;
+        p->iface = 0;
+        p->linktype = c->ifaces[0].linktype;
+        p->offset = block_off;
+        return 1;
+    }
+
+    default:
+        break;  // statistics, name resolution, custom blocks...
+    }
+    return 0;
+}
+
+static int pcapng_next(struct capture *c, struct cap_packet *p) {
+    int rc = 0;
+    while (rc == 0 && c->pos < c->size) rc = pcapng_block(c, p);
+    return rc;
+}
+
+// Peek at the type of the block at `off` in the current byte order
+static uint32_t block_type(const struct capture *c, size_t off) {
+    uint32_t type;
+    memcpy(&type, c->base + off, sizeof(type));
+    return type == BLOCK_SHB ? type : c->swapped ? __builtin_bswap32(type) : type;
+}
+
+/* Read the section header and interface blocks in front of the first
+ * packet, so that a copy of the capture can start decoding anywhere in the
+ * first section. */
+static int pcapng_preamble(struct capture *c) {
+    struct cap_packet unused;
+
+    c->pos = 0;
+    c->sections = 0;
+    while (c->size - c->pos >= 12) {
+        uint32_t type = block_type(c, c->pos);
+        if (type == BLOCK_EPB || type == BLOCK_OPB || type == BLOCK_SPB) break;
+        if (pcapng_block(c, &unused) < 0) return -1;
+    }
+    c->data_start = c->pos;
+    return 0;
+}
+
+/* End of a plausible pcap record at `off`, or 0. A stray offset inside
+ * packet data rarely passes these checks several records in a row. */
+static size_t pcap_record_end(const struct capture *c, size_t off, uint32_t *sec) {
+    if (c->size - off < c->rec_hdr_len) return 0;
+    const uint8_t *r = c->base + off;
+    uint32_t frac = rd32(c, r + 4), caplen = rd32(c, r + 8), len = rd32(c, r + 12);
+
+    if (frac >= (c->nsec ? 1000000000u : 1000000u)) return 0;
+    if (caplen > len || len > RESYNC_MAX_LEN) return 0;
+    if (c->ifaces[0].snaplen && caplen > c->ifaces[0].snaplen) return 0;
+    if (caplen > c->size - off - c->rec_hdr_len) return 0;
+    *sec = rd32(c, r);
+    return off + c->rec_hdr_len + caplen;
+}
+
+// End of a plausible pcapng block at `off` (length repeated at both ends), or 0
+static size_t pcapng_block_end(const struct capture *c, size_t off) {
+    if (c->size - off < 12) return 0;
+    uint32_t type = block_type(c, off);
+    if (type == BLOCK_SHB) {
+        uint32_t bom;
+        memcpy(&bom, c->base + off + 8, sizeof(bom));
+        return bom == PCAPNG_BOM || bom == __builtin_bswap32(PCAPNG_BOM) ? off : 0;
+    }
+    if (type == 0 || (type > 0x0a && type != 0x00000bad && type != 0x40000bad)) return 0;
+    uint32_t blen = rd32(c, c->base + off + 4);
+    if (blen < 12 || (blen & 3) != 0 || blen > c->size - off) return 0;
+    if (rd32(c, c->base + off + blen - 4) != blen) return 0;
+    return off + blen;
+}
+
+static int plausible_boundary(const struct capture *c, size_t off) {
+    uint32_t sec = 0, prev_sec = 0;
+    for (int i = 0; i < RESYNC_CHAIN && off < c->size; i++) {
+        size_t next = c->format == CAP_PCAP ? pcap_record_end(c, off, &sec) : pcapng_block_end(c, off);
+        if (next == 0) return 0;
+        if (next == off) return 1;  // a section header is unambiguous
+        if (c->format == CAP_PCAP && i > 0 && (sec - prev_sec + RESYNC_MAX_GAP) > 2 * RESYNC_MAX_GAP) return 0;
+        prev_sec = sec;
+        off = next;
+    }
+    return 1;
+}
+
+uint64_t cap_resync(const struct capture *c, uint64_t offset) {
+    size_t off = offset < c->data_start ? c->data_start : offset;
+    size_t step = c->format == CAP_PCAP ? 1 : 4;
+
+    off = (off + step - 1) / step * step;
+    for (; off < c->size; off += step) {
+        if (plausible_boundary(c, off)) return off;
+    }
+    return c->size;
+}
+
+int cap_open(struct capture *c, const char *path) {
+    struct stat st;
+    uint32_t magic;
+
+    memset(c, 0, sizeof(*c));
+    c->fd = open(path, O_RDONLY);
+    if (c->fd < 0 || fstat(c->fd, &st) < 0) {
+        snprintf(c->err, sizeof(c->err), "%s: %s", path, strerror(errno));
+        if (c->fd >= 0) close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    c->size = st.st_size;
+    if (c->size < 4) {
+        cap_close(c);
+        snprintf(c->err, sizeof(c->err), "%s: not a capture file", path);
+        return -1;
+    }
+    void *map = mmap(NULL, c->size, PROT_READ, MAP_PRIVATE, c->fd, 0);
+    if (map == MAP_FAILED) {
+        snprintf(c->err, sizeof(c->err), "%s: mmap failed", path);
+        close(c->fd);
+        c->fd = -1;
+        return -1;
+    }
+    c->base = map;
+    madvise(map, c->size, MADV_SEQUENTIAL);
+
+    // A compressed archive: decode from a window over the decompressed stream instead
+    enum capstream_codec codec = capstream_codec(c->base, c->size);
+    if (codec != CAPSTREAM_NONE) {
+        munmap(map, c->size);
+        c->base = NULL;
+        c->size = 0;
+        char err[sizeof(c->err)] = "not a capture file";
+        c->stream = capstream_open(c->fd, codec, err, sizeof(err));
+        if (c->stream == NULL || capstream_fill(c->stream, 0, &c->base, &c->size, err, sizeof(err)) < 0 ||
+            c->size < 4) {
+            cap_close(c);
+            snprintf(c->err, sizeof(c->err), "%s: %s", path, err);
+            return -1;
+        }
+    }
+
+    memcpy(&magic, c->base, sizeof(magic));
+    int rc;
+    for (;;) {
+        if (magic == BLOCK_SHB) {
+            c->format = CAP_PCAPNG;
+            rc = pcapng_preamble(c);
+        } else if (magic == PCAP_MAGIC_USEC || magic == PCAP_MAGIC_NSEC || magic == PCAP_MAGIC_MODIFIED ||
+                   magic == __builtin_bswap32(PCAP_MAGIC_USEC) || magic == __builtin_bswap32(PCAP_MAGIC_NSEC) ||
+                   magic == __builtin_bswap32(PCAP_MAGIC_MODIFIED)) {
+            rc = open_pcap(c);
+        } else {
+            snprintf(c->err, sizeof(c->err), "%s: not a pcap or pcapng file", path);
+            rc = -1;
+        }
+        // Headers larger than the first decompressed chunk: read on and parse them again
+        if (rc == 0 || !c->truncated || c->stream == NULL) break;
+        if (capstream_fill(c->stream, 0, &c->base, &c->size, c->err, sizeof(c->err)) <= 0) break;
+        c->truncated = 0;
+    }
+    if (rc < 0) {
+        char err[sizeof(c->err)];
+        memcpy(err, c->err, sizeof(err));
+        cap_close(c);
+        memcpy(c->err, err, sizeof(err));
+    }
+    return rc;
+}
+
+int cap_next(struct capture *c, struct cap_packet *p) {
+    for (;;) {
+        c->truncated = 0;
+        int rc = c->format == CAP_PCAP ? pcap_next(c, p) : pcapng_next(c, p);
+        if (c->stream == NULL) return rc;
+        if (rc > 0) {
+            p->offset += capstream_offset(c->stream);
+            return rc;
+        }
+        if (rc < 0 && !c->truncated) return rc;
+
+        // The window is used up or ends inside a record: slide it on to the next chunk
+        char err[sizeof(c->err)];
+        int more = capstream_fill(c->stream, c->pos, &c->base, &c->size, err, sizeof(err));
+        if (more == 0) return rc;
+        if (more < 0) {
+            memcpy(c->err, err, sizeof(err));
+            return -1;
+        }
+        c->pos = 0;
+    }
+}
+
+void cap_seek(struct capture *c, uint64_t offset) {
+    if (c->stream) {
+        uint64_t first = capstream_offset(c->stream);
+        offset = offset < first ? first : offset;
+        c->pos = offset - first > c->size ? c->size : offset - first;
+        return;
+    }
+    // Rewinding past a later section header must restore the first section
+    if (offset <= c->data_start && c->format == CAP_PCAPNG && c->sections > 1) pcapng_preamble(c);
+    c->pos = offset < c->data_start ? c->data_start : offset > c->size ? c->size : offset;
+}
+
+int cap_refresh(struct capture *c) {
+    struct stat st;
+
+    if (c->stream) {
+        snprintf(c->err, sizeof(c->err), "compressed captures cannot be followed");
+        return -1;
+    }
+    if (fstat(c->fd, &st) < 0) {
+        snprintf(c->err, sizeof(c->err), "fstat failed: %s", strerror(errno));
+        return -1;
+    }
+    if ((size_t)st.st_size == c->size) return 0;
+    if ((size_t)st.st_size < c->size) {
+        snprintf(c->err, sizeof(c->err), "file shrank from %zu to %zu bytes", c->size, (size_t)st.st_size);
+        return -1;
+    }
+    void *map = mremap((void *)c->base, c->size, st.st_size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        snprintf(c->err, sizeof(c->err), "mremap failed: %s", strerror(errno));
+        return -1;
+    }
+    c->base = map;
+    c->size = st.st_size;
+    return 1;
+}
+
+void cap_close(struct capture *c) {
+    if (c->stream) capstream_close(c->stream);   // owns the window at c->base
+    else if (c->base) munmap((void *)c->base, c->size);
+    if (c->fd >= 0) close(c->fd);
+    c->base = NULL;
+    c->stream = NULL;
+    c->fd = -1;
+}
+
+const char *cap_linktype_name(uint16_t linktype) {
+    switch (linktype) {
+    case CAP_LINK_NULL: return "BSD loopback";
+    case CAP_LINK_ETHERNET: return "Ethernet";
+    case CAP_LINK_RAW: return "Raw IP";
+    case CAP_LINK_LINUX_SLL: return "Linux cooked";
+    case CAP_LINK_IPV4: return "Raw IPv4";
+    case CAP_LINK_IPV6: return "Raw IPv6";
+    default: return "unknown";
+    }
+}
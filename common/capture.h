@@ -0,0 +1,114 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Capture file reader for classic pcap and pcapng, without libpcap.
+ *
+ * The file is mmap()ed and records are decoded in place: cap_next() fills a
+ * struct cap_packet whose `data` points straight into the mapping, so no
+ * packet bytes are copied. Both byte orders, microsecond and nanosecond pcap
+ * files, and pcapng files with several sections and interfaces (each with its
+ * own link type, if_tsresol and if_tsoffset) are supported. Timestamps are
+ * always returned as nanoseconds since the epoch.
+ *
+ * Compressed archives (.pcap.gz, .pcapng.gz, .zst with CAPTURE_ZSTD) are
+ * recognized by their magic number and decompressed on a separate thread
+ * while they are read (see capstream.h). Their packets point into a sliding
+ * window instead of a mapping and are only valid until the next cap_next();
+ * offsets are positions in the decompressed stream, and the file cannot be
+ * split, indexed or followed.
+ *
+ *     struct capture cap;
+ *     struct cap_packet pkt;
+ *     if (cap_open(&cap, "trace.pcapng") < 0) { fprintf(stderr, "%s\n", cap.err); exit(1); }
+ *     while (cap_next(&cap, &pkt) > 0) handle(pkt.data, pkt.caplen);
+ *     cap_close(&cap);
+ */
+
+#define CAP_MAX_IFACES 64
+
+/* Link types (LINKTYPE_* values from the tcpdump.org registry) */
+#define CAP_LINK_NULL 0
+#define CAP_LINK_ETHERNET 1
+#define CAP_LINK_RAW 101
+#define CAP_LINK_LINUX_SLL 113
+#define CAP_LINK_IPV4 228
+#define CAP_LINK_IPV6 229
+
+enum cap_format { CAP_PCAP, CAP_PCAPNG };
+
+struct cap_packet {
+    const uint8_t *data;   // captured bytes, inside the mapping
+    uint32_t caplen;       // bytes available at `data`
+    uint32_t len;          // original length on the wire
+    int64_t ts_ns;         // nanoseconds since the epoch
+    uint32_t iface;        // pcapng interface id, 0 for pcap
+    uint16_t linktype;
+    uint64_t offset;       // file offset of the record / block
+};
+
+struct cap_iface {
+    uint16_t linktype;
+    uint32_t snaplen;
+    uint8_t tsresol;       // pcapng if_tsresol: 10^-n, or 2^-n if the top bit is set
+    int64_t tsoffset;      // seconds added to every timestamp
+};
+
+struct capture {
+    int fd;
+    const uint8_t *base;   // the whole file
+    size_t size;
+    size_t pos;            // offset of the next record / block
+    size_t data_start;     // offset of the first record (pcap) or packet block (pcapng)
+    enum cap_format format;
+    int swapped;           // file (or current pcapng section) is in the other byte order
+    int nsec;              // pcap: nanosecond timestamps
+    size_t rec_hdr_len;    // pcap: 16, or 24 for the "modified" Kuznetzov format
+    struct cap_iface ifaces[CAP_MAX_IFACES];
+    int iface_count;       // pcap: 1, the file header acts as the only interface
+    int sections;          // pcapng section headers read so far
+    int truncated;         // the last cap_next() error is a record cut off by the end of the file
+    struct cap_stream *stream;   // decompressor of a compressed archive, or NULL for a mapped file
+    char err[128];
+};
+
+/* Map `path` and read its file header. Returns 0, or -1 with `c->err` set. */
+int cap_open(struct capture *c, const char *path);
+
+/* Next packet. Returns 1 with `p` filled in, 0 at end of file, -1 on a
+ * malformed or truncated record (with `c->err` set). Non-packet pcapng blocks
+ * are consumed internally. A truncated record sets `c->truncated` and leaves
+ * the position on it, so a file that is still being written can be read
+ * again from there after cap_refresh(). A record length beyond the snap
+ * length is reported as corruption instead, since waiting cannot fix it. */
+int cap_next(struct capture *c, struct cap_packet *p);
+
+/* Pick up data appended to the file since it was opened or last refreshed.
+ * Returns 1 if the file grew, 0 if not, -1 if it shrank or could not be
+ * remapped. Packets returned before a refresh that grew the file must not
+ * be used afterwards: the mapping may have moved. */
+int cap_refresh(struct capture *c);
+
+/* Continue reading at `offset`, which must be a record / block boundary
+ * previously reported in cap_packet.offset (or c->data_start). For pcapng
+ * the byte order and interfaces of the current section stay in effect. A
+ * compressed capture can only go back as far as its window still reaches,
+ * e.g. to c->data_start right after reading the first packet. */
+void cap_seek(struct capture *c, uint64_t offset);
+
+/* First record / block boundary at or after `offset`, or the file size if
+ * there is none. Used to split a file into ranges that can be decoded
+ * independently: each range is read by a copy of the opened capture that is
+ * cap_seek()ed to its start. pcap boundaries are found heuristically (several
+ * consecutive plausible record headers), so callers should confirm that the
+ * previous range ends exactly there. */
+uint64_t cap_resync(const struct capture *c, uint64_t offset);
+
+void cap_close(struct capture *c);
+
+const char *cap_linktype_name(uint16_t linktype);
+
+#endif
@@ -0,0 +1,257 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <zlib.h>
+#include "capture.h"
+#include "capstream.h"
+
+/**
+ * Capture reader benchmark.
+ * Writes the same synthetic traffic as a microsecond pcap, a byte-swapped
+ * nanosecond pcap and a two-interface pcapng whose second section is
+ * big-endian, plus a gzip copy of the pcapng, checks that all four decode to
+ * identical packets, then reports how fast each is parsed from the page cache
+ * (GB/s of decoded capture and Mpps; a compressed file is read once, with its
+ * decompression throughput). A real capture can be timed instead by passing
+ * its path.
+ *
+ * Build: gcc -O2 capture_bench.c capture.c capstream.c -o capture_bench -lz -lpthread
+ */
+
+#define DEFAULT_PACKETS 200000
+
+struct synth {
+    uint32_t len;
+    int64_t ts_ns;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void put16(FILE *fp, uint16_t v, int swap) {
+    if (swap) v = __builtin_bswap16(v);
+    fwrite(&v, sizeof(v), 1, fp);
+}
+
+static void put32(FILE *fp, uint32_t v, int swap) {
+    if (swap) v = __builtin_bswap32(v);
+    fwrite(&v, sizeof(v), 1, fp);
+}
+
+// Deterministic packet bytes: the index is stored in the first four bytes
+static void fill_packet(uint8_t *buf, uint32_t len, uint32_t idx) {
+    for (uint32_t i = 0; i < len; i++) buf[i] = (uint8_t)(idx * 31 + i);
+    memcpy(buf, &idx, len < 4 ? len : 4);
+}
+
+static void write_pcap(const char *path, const struct synth *pk, int n, int swap, int nsec) {
+    static uint8_t buf[2048];
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror("Cannot create benchmark file");
+        exit(1);
+    }
+    put32(fp, nsec ? 0xa1b23c4d : 0xa1b2c3d4, swap);
+    put16(fp, 2, swap);
+    put16(fp, 4, swap);
+    put32(fp, 0, swap);
+    put32(fp, 0, swap);
+    put32(fp, 65535, swap);
+    put32(fp, CAP_LINK_ETHERNET, swap);
+    for (int i = 0; i < n; i++) {
+        fill_packet(buf, pk[i].len, i);
+        put32(fp, pk[i].ts_ns / 1000000000, swap);
+        put32(fp, nsec ? pk[i].ts_ns % 1000000000 : pk[i].ts_ns % 1000000000 / 1000, swap);
+        put32(fp, pk[i].len, swap);
+        put32(fp, pk[i].len, swap);
+        fwrite(buf, 1, pk[i].len, fp);
+    }
+    fclose(fp);
+}
+
+static void write_shb(FILE *fp, int swap) {
+    put32(fp, 0x0a0d0d0a, swap);
+    put32(fp, 28, swap);
+    put32(fp, 0x1a2b3c4d, swap);
+    put16(fp, 1, swap);
+    put16(fp, 0, swap);
+    put32(fp, 0xffffffff, swap);   // section length unknown
+    put32(fp, 0xffffffff, swap);
+    put32(fp, 28, swap);
+}
+
+// Interface with an if_tsresol option (9 = nanoseconds, 6 = microseconds)
+static void write_idb(FILE *fp, int swap, uint8_t tsresol) {
+    put32(fp, 1, swap);
+    put32(fp, 32, swap);
+    put16(fp, CAP_LINK_ETHERNET, swap);
+    put16(fp, 0, swap);
+    put32(fp, 65535, swap);
+    put16(fp, 9, swap);
+    put16(fp, 1, swap);
+    uint8_t opt[4] = {tsresol, 0, 0, 0};
+    fwrite(opt, 1, 4, fp);
+    put32(fp, 0, swap);           // opt_endofopt
+    put32(fp, 32, swap);
+}
+
+static void write_pcapng(const char *path, const struct synth *pk, int n) {
+    static uint8_t buf[2048];
+    static const uint8_t pad[4];
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror("Cannot create benchmark file");
+        exit(1);
+    }
+    int swap = 0;
+    for (int i = 0; i < n; i++) {
+        // Second half of the file is a new, big-endian section
+        if (i == 0 || i == n / 2) {
+            swap = i != 0;
+            write_shb(fp, swap);
+            write_idb(fp, swap, 9);
+            write_idb(fp, swap, 6);
+        }
+        uint32_t iface = i & 1;
+        uint64_t ts = iface ? (uint64_t)pk[i].ts_ns / 1000 : (uint64_t)pk[i].ts_ns;
+        uint32_t padded = (pk[i].len + 3) & ~3u;
+        fill_packet(buf, pk[i].len, i);
+        put32(fp, 6, swap);
+        put32(fp, 32 + padded, swap);
+        put32(fp, iface, swap);
+        put32(fp, ts >> 32, swap);
+        put32(fp, (uint32_t)ts, swap);
+        put32(fp, pk[i].len, swap);
+        put32(fp, pk[i].len, swap);
+        fwrite(buf, 1, pk[i].len, fp);
+        fwrite(pad, 1, padded - pk[i].len, fp);
+        put32(fp, 32 + padded, swap);
+    }
+    fclose(fp);
+}
+
+// Compress `path` into `gz_path` as an archive tool would
+static void write_gzip(const char *path, const char *gz_path) {
+    static char buf[1 << 16];
+    FILE *in = fopen(path, "rb");
+    gzFile out = gzopen(gz_path, "wb6");
+    size_t n;
+
+    if (in == NULL || out == NULL) {
+        perror(gz_path);
+        exit(1);
+    }
+    while ((n = fread(buf, 1, sizeof(buf), in)) > 0) {
+        if (gzwrite(out, buf, n) != (int)n) {
+            fprintf(stderr, "%s: write failed\n", gz_path);
+            exit(1);
+        }
+    }
+    fclose(in);
+    gzclose(out);
+}
+
+// Check every decoded packet against what was written
+static int verify(const char *path, const struct synth *pk, int n, int usec) {
+    static uint8_t want[2048];
+    struct capture cap;
+    struct cap_packet p;
+    int count = 0, failures = 0, rc;
+
+    if (cap_open(&cap, path) < 0) {
+        printf("%s\n", cap.err);
+        return 1;
+    }
+    while ((rc = cap_next(&cap, &p)) > 0) {
+        int64_t ts = pk[count].ts_ns;
+        if (usec || (cap.format == CAP_PCAPNG && (count & 1))) ts -= ts % 1000;
+        fill_packet(want, pk[count].len, count);
+        if (p.caplen != pk[count].len || p.ts_ns != ts || memcmp(p.data, want, p.caplen) != 0) {
+            if (failures++ < 5) printf("MISMATCH %s packet %d\n", path, count);
+        }
+        if (++count == n) break;
+    }
+    if (rc < 0) printf("%s: %s\n", path, cap.err);
+    if (count != n) printf("%s: read %d of %d packets\n", path, count, n);
+    cap_close(&cap);
+    return failures + (rc < 0) + (count != n);
+}
+
+// Parse the whole file repeatedly, touching the L2/L3 headers like an analyzer would
+static void bench(const char *path, double target) {
+    struct capture cap;
+    struct cap_packet p;
+    uint64_t packets = 0, bytes = 0, passes = 0;
+    volatile uint64_t sink = 0;
+
+    if (cap_open(&cap, path) < 0) {
+        printf("%s\n", cap.err);
+        return;
+    }
+    double start = now_sec(), elapsed;
+    do {
+        cap_seek(&cap, cap.data_start);
+        while (cap_next(&cap, &p) > 0) {
+            if (p.caplen >= 24) sink += p.data[12] + p.data[23];
+            packets++;
+        }
+        bytes += cap.size;
+        passes++;
+        elapsed = now_sec() - start;
+    } while (elapsed < target && cap.stream == NULL);   // a stream cannot be rewound
+
+    struct capstream_stats st;
+    if (cap.stream) {
+        capstream_stats(cap.stream, &st);
+        bytes = st.out_bytes;
+    }
+    printf("%-38s %6s %10.2f GB/s %10.2f Mpps   (%lu passes)\n", path,
+           cap.format == CAP_PCAP ? "pcap" : "pcapng", bytes / elapsed / 1e9, packets / elapsed / 1e6,
+           (unsigned long)passes);
+    if (cap.stream) {
+        printf("%-38s %6s %10.2f MB/s compressed in, decoder waited %.3f s, decompressor waited %.3f s\n", "", "",
+               st.in_bytes / st.wall_sec / 1e6, st.starved_sec, st.blocked_sec);
+    }
+    cap_close(&cap);
+}
+
+int main(int argc, char *argv[]) {
+    static const uint32_t sizes[] = {60, 60, 60, 60, 60, 60, 60, 590, 590, 590, 590, 1514};
+    const char *files[] = {"/tmp/capture_bench_usec.pcap", "/tmp/capture_bench_nsec_swapped.pcap",
+                           "/tmp/capture_bench.pcapng", "/tmp/capture_bench.pcapng.gz"};
+
+    if (argc > 1) {
+        bench(argv[1], 1.0);
+        return 0;
+    }
+
+    int n = DEFAULT_PACKETS;
+    struct synth *pk = malloc(n * sizeof(*pk));
+    int64_t ts = 1700000000ll * 1000000000ll;
+    srand(1);
+    for (int i = 0; i < n; i++) {
+        ts += 1 + rand() % 100000;
+        pk[i].ts_ns = ts;
+        pk[i].len = sizes[rand() % 12];
+    }
+
+    write_pcap(files[0], pk, n, 0, 0);
+    write_pcap(files[1], pk, n, 1, 1);
+    write_pcapng(files[2], pk, n);
+    write_gzip(files[2], files[3]);
+
+    int failures = verify(files[0], pk, n, 1) + verify(files[1], pk, n, 0) + verify(files[2], pk, n, 0) +
+                   verify(files[3], pk, n, 0);
+    printf("Equivalence check: %s\n\n",
+           failures ? "FAILED" : "pcap, swapped pcap, pcapng and gzipped pcapng decode identically");
+    if (failures) return 1;
+
+    for (int f = 0; f < 4; f++) bench(files[f], 0.5);
+    for (int f = 0; f < 4; f++) remove(files[f]);
+    free(pk);
+    return 0;
+}
@@ -0,0 +1,229 @@
+#include <string.h>
+#include "checksum.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CSUM_X86 1
+#endif
+
+typedef uint64_t (*csum_fn)(const void *, size_t, uint64_t);
+
+static csum_fn active_impl = NULL;
+static const char *active_name = NULL;
+
+/**
+ * Reference implementation: one 16-bit word per iteration, exactly like the
+ * original per-tool checksum() loops, but with a 64-bit accumulator.
+ */
+uint64_t csum_partial_scalar(const void *buf, size_t len, uint64_t sum) {
+    const uint8_t *p = buf;
+    uint16_t word;
+
+    while (len > 1) {
+        memcpy(&word, p, 2);
+        sum += word;
+        p += 2;
+        len -= 2;
+    }
+    if (len == 1) {
+        word = 0;
+        *(uint8_t *)&word = *p;
+        sum += word;
+    }
+    return sum;
+}
+
+/* Sums the remaining (< 8) bytes; shared by the wide implementations. */
+static uint64_t csum_tail(const uint8_t *p, size_t len, uint64_t sum) {
+    uint32_t w32;
+    uint16_t w16;
+
+    if (len >= 4) {
+        memcpy(&w32, p, 4);
+        sum += w32;
+        p += 4;
+        len -= 4;
+    }
+    if (len >= 2) {
+        memcpy(&w16, p, 2);
+        sum += w16;
+        p += 2;
+        len -= 2;
+    }
+    if (len == 1) {
+        w16 = 0;
+        *(uint8_t *)&w16 = *p;
+        sum += w16;
+    }
+    return sum;
+}
+
+/**
+ * Portable fast path: 32 bytes per iteration, each 64-bit load split into two
+ * 32-bit halves. Summing 32-bit words is equivalent to summing 16-bit words
+ * modulo 0xffff, and the 64-bit accumulators cannot overflow below 2^32 loads.
+ */
+uint64_t csum_partial_unrolled(const void *buf, size_t len, uint64_t sum) {
+    const uint8_t *p = buf;
+    uint64_t a = 0, b = 0, c = 0, d = 0;
+    uint64_t w0, w1, w2, w3;
+
+    while (len >= 32) {
+        memcpy(&w0, p, 8);
+        memcpy(&w1, p + 8, 8);
+        memcpy(&w2, p + 16, 8);
+        memcpy(&w3, p + 24, 8);
+        a += (w0 & 0xffffffffu) + (w0 >> 32);
+        b += (w1 & 0xffffffffu) + (w1 >> 32);
+        c += (w2 & 0xffffffffu) + (w2 >> 32);
+        d += (w3 & 0xffffffffu) + (w3 >> 32);
+        p += 32;
+        len -= 32;
+    }
+    while (len >= 8) {
+        memcpy(&w0, p, 8);
+        a += (w0 & 0xffffffffu) + (w0 >> 32);
+        p += 8;
+        len -= 8;
+    }
+
+    /* Fold the lanes once so the final additions cannot overflow */
+    sum = csum_fold(sum) + csum_fold(a) + csum_fold(b) + csum_fold(c) + csum_fold(d);
+    return csum_tail(p, len, sum);
+}
+
+#ifdef CSUM_X86
+/* Widens 32-bit lanes to 64 bits and adds them into the accumulators. */
+uint64_t csum_partial_sse2(const void *buf, size_t len, uint64_t sum) {
+    const uint8_t *p = buf;
+    if (len < 128) return csum_partial_unrolled(buf, len, sum);
+
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc0 = _mm_setzero_si128(), acc1 = _mm_setzero_si128();
+    uint64_t lanes[2];
+
+    while (len >= 32) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+        __m128i v1 = _mm_loadu_si128((const __m128i *)(p + 16));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v1, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v1, zero));
+        p += 32;
+        len -= 32;
+    }
+    if (len >= 16) {
+        __m128i v0 = _mm_loadu_si128((const __m128i *)p);
+        acc0 = _mm_add_epi64(acc0, _mm_unpacklo_epi32(v0, zero));
+        acc1 = _mm_add_epi64(acc1, _mm_unpackhi_epi32(v0, zero));
+        p += 16;
+        len -= 16;
+    }
+
+    _mm_storeu_si128((__m128i *)lanes, _mm_add_epi64(acc0, acc1));
+    sum = csum_fold(sum) + csum_fold(lanes[0]) + csum_fold(lanes[1]);
+    return csum_partial_unrolled(p, len, sum);
+}
+
+/**
+ * The AVX2 loop lives in its own function so the compiler's vzeroupper on
+ * return runs before any SSE code in the callers (no transition stalls).
+ * Returns the folded sum of `blocks` 64-byte blocks.
+ */
+__attribute__((target("avx2")))
+static uint64_t csum_avx2_blocks(const uint8_t *p, size_t blocks) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i acc0 = _mm256_setzero_si256(), acc1 = _mm256_setzero_si256();
+
+    for (; blocks > 0; blocks--, p += 64) {
+        __m256i v0 = _mm256_loadu_si256((const __m256i *)p);
+        __m256i v1 = _mm256_loadu_si256((const __m256i *)(p + 32));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v0, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v0, zero));
+        acc0 = _mm256_add_epi64(acc0, _mm256_unpacklo_epi32(v1, zero));
+        acc1 = _mm256_add_epi64(acc1, _mm256_unpackhi_epi32(v1, zero));
+    }
+
+    __m256i acc = _mm256_add_epi64(acc0, acc1);
+    __m128i half = _mm_add_epi64(_mm256_castsi256_si128(acc), _mm256_extracti128_si256(acc, 1));
+    return (uint64_t)csum_fold((uint64_t)_mm_cvtsi128_si64(half)) +
+           csum_fold((uint64_t)_mm_extract_epi64(half, 1));
+}
+
+uint64_t csum_partial_avx2(const void *buf, size_t len, uint64_t sum) {
+    const uint8_t *p = buf;
+    size_t blocks = len / 64;
+
+    // Short buffers are faster without the vector setup
+    if (blocks < 2) return csum_partial_unrolled(buf, len, sum);
+    sum = csum_fold(sum) + csum_avx2_blocks(p, blocks);
+    return csum_partial_unrolled(p + blocks * 64, len % 64, sum);
+}
+#else
+uint64_t csum_partial_sse2(const void *buf, size_t len, uint64_t sum) {
+    return csum_partial_unrolled(buf, len, sum);
+}
+
+uint64_t csum_partial_avx2(const void *buf, size_t len, uint64_t sum) {
+    return csum_partial_unrolled(buf, len, sum);
+}
+#endif
+
+/* Picks the widest implementation the running CPU supports. Runs as a
+ * constructor, before main() can start threads, so csum_partial() needs
+ * neither a lock nor a first-call check. */
+__attribute__((constructor)) static void csum_dispatch(void) {
+#ifdef CSUM_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        active_impl = csum_partial_avx2;
+        active_name = "avx2";
+        return;
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        active_impl = csum_partial_sse2;
+        active_name = "sse2";
+        return;
+    }
+#endif
+    active_impl = csum_partial_unrolled;
+    active_name = "unrolled";
+}
+
+int csum_select(const char *name) {
+#ifdef CSUM_X86
+    __builtin_cpu_init();
+#endif
+    if (strcmp(name, "scalar") == 0) {
+        active_impl = csum_partial_scalar;
+    } else if (strcmp(name, "unrolled") == 0) {
+        active_impl = csum_partial_unrolled;
+#ifdef CSUM_X86
+    } else if (strcmp(name, "sse2") == 0 && __builtin_cpu_supports("sse2")) {
+        active_impl = csum_partial_sse2;
+    } else if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")) {
+        active_impl = csum_partial_avx2;
+#endif
+    } else {
+        return -1;
+    }
+    active_name = name;
+    return 0;
+}
+
+const char *csum_impl_name(void) {
+    return active_name;
+}
+
+uint64_t csum_partial(const void *buf, size_t len, uint64_t sum) {
+    return active_impl(buf, len, sum);
+}
+
+uint16_t csum_fold(uint64_t sum) {
+    while (sum >> 16) sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+uint16_t inet_checksum(const void *buf, size_t len) {
+    return (uint16_t)~csum_fold(csum_partial(buf, len, 0));
+}
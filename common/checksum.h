@@ -0,0 +1,61 @@
+#ifndef CHECKSUM_H
+#define CHECKSUM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Internet checksum (RFC 1071) shared by the raw socket tools.
+ *
+ * The checksum is computed over native-endian 16-bit words, so the value
+ * returned by inet_checksum() can be stored straight into a header field
+ * without htons(). Partial sums are kept in a 64-bit accumulator and only
+ * folded to 16 bits at the end.
+ */
+
+/* Add `len` bytes at `buf` to the running partial sum `sum`.
+ * When chaining calls, every chunk except the last must have an even length. */
+uint64_t csum_partial(const void *buf, size_t len, uint64_t sum);
+
+/* Fold a 64-bit partial sum down to 16 bits (end-around carry, not inverted). */
+uint16_t csum_fold(uint64_t sum);
+
+/* Complete checksum of a buffer: ~fold(partial). */
+uint16_t inet_checksum(const void *buf, size_t len);
+
+/* Individual implementations, exposed for the benchmark. */
+uint64_t csum_partial_scalar(const void *buf, size_t len, uint64_t sum);
+uint64_t csum_partial_unrolled(const void *buf, size_t len, uint64_t sum);
+uint64_t csum_partial_sse2(const void *buf, size_t len, uint64_t sum);
+uint64_t csum_partial_avx2(const void *buf, size_t len, uint64_t sum);
+
+/* Name of the implementation picked by runtime CPU dispatch. */
+const char *csum_impl_name(void);
+
+/* Force a specific implementation ("scalar", "unrolled", "sse2", "avx2").
+ * Returns 0 on success, -1 if unknown or unsupported by this CPU. Call it
+ * before starting threads that checksum. */
+int csum_select(const char *name);
+
+/**
+ * Incremental update (RFC 1624, eqn. 3): HC' = ~(~HC + ~m + m').
+ * `check` is the stored checksum field, `from`/`to` are the raw 16-bit or
+ * 32-bit field contents exactly as they sit in the packet (network order).
+ */
+static inline uint16_t csum_replace2(uint16_t check, uint16_t from, uint16_t to) {
+    uint32_t sum = (uint16_t)~check + (uint32_t)(uint16_t)~from + to;
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+static inline uint16_t csum_replace4(uint16_t check, uint32_t from, uint32_t to) {
+    uint32_t sum = (uint16_t)~check;
+    sum += (uint16_t)~(from >> 16) + (uint32_t)(uint16_t)~(from & 0xffff);
+    sum += (to >> 16) + (to & 0xffff);
+    sum = (sum & 0xffff) + (sum >> 16);
+    sum = (sum & 0xffff) + (sum >> 16);
+    return (uint16_t)~sum;
+}
+
+#endif
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "checksum.h"
+
+/**
+ * Checksum microbenchmark.
+ * Before timing anything, every implementation is checked against the scalar
+ * reference for all lengths 0..MAX_CHECK_LEN at every start offset 0..31,
+ * for chained partial sums, and for the all-0x00 / all-0xff corner cases.
+ *
+ * Build: gcc -O2 checksum_bench.c checksum.c -o checksum_bench
+ */
+
+#define MAX_CHECK_LEN 2048
+#define MAX_OFFSET 32
+
+struct impl {
+    const char *name;
+    uint64_t (*fn)(const void *, size_t, uint64_t);
+};
+
+static struct impl impls[] = {
+    {"scalar", csum_partial_scalar},
+    {"unrolled", csum_partial_unrolled},
+    {"sse2", csum_partial_sse2},
+    {"avx2", csum_partial_avx2},
+};
+#define NUM_IMPLS (sizeof(impls) / sizeof(impls[0]))
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// csum_select() refuses implementations the CPU cannot run
+static int supported(const char *name) {
+    return csum_select(name) == 0;
+}
+
+// Compares one implementation against the scalar reference on one buffer
+static int check_one(const struct impl *im, const uint8_t *buf, size_t len) {
+    uint16_t want = csum_fold(csum_partial_scalar(buf, len, 0));
+    uint16_t got = csum_fold(im->fn(buf, len, 0));
+    if (want != got) {
+        printf("MISMATCH %s len=%zu offset=%lu: want %04x got %04x\n",
+               im->name, len, (unsigned long)((uintptr_t)buf % MAX_OFFSET), want, got);
+        return 1;
+    }
+
+    // Chained partial sums over an even split must agree as well
+    size_t half = (len / 2) & ~(size_t)1;
+    got = csum_fold(im->fn(buf + half, len - half, im->fn(buf, half, 0)));
+    if (want != got) {
+        printf("MISMATCH %s (chained) len=%zu split=%zu\n", im->name, len, half);
+        return 1;
+    }
+    return 0;
+}
+
+static int verify(void) {
+    uint8_t *buf = malloc(MAX_CHECK_LEN + MAX_OFFSET);
+    int failures = 0;
+
+    for (size_t i = 0; i < MAX_CHECK_LEN + MAX_OFFSET; i++) buf[i] = rand() & 0xff;
+
+    for (size_t k = 1; k < NUM_IMPLS; k++) {
+        if (!supported(impls[k].name)) continue;
+        for (size_t off = 0; off < MAX_OFFSET; off++)
+            for (size_t len = 0; len <= MAX_CHECK_LEN; len++)
+                failures += check_one(&impls[k], buf + off, len);
+
+        for (int fill = 0; fill <= 0xff; fill += 0xff) {
+            memset(buf, fill, MAX_CHECK_LEN + MAX_OFFSET);
+            for (size_t len = 0; len <= MAX_CHECK_LEN; len++)
+                failures += check_one(&impls[k], buf, len);
+            for (size_t i = 0; i < MAX_CHECK_LEN + MAX_OFFSET; i++) buf[i] = rand() & 0xff;
+        }
+    }
+
+    free(buf);
+    return failures;
+}
+
+int main(int argc, char *argv[]) {
+    size_t sizes[] = {20, 40, 64, 576, 1500, 9000, 65536};
+    double target = argc > 1 ? atof(argv[1]) : 0.2; // seconds per measurement
+
+    const char *dispatched = csum_impl_name();
+
+    srand(1);
+    int failures = verify();
+    printf("Equivalence check: %s\n", failures ? "FAILED" : "all implementations match scalar");
+    if (failures) return 1;
+
+    printf("Dispatch selects: %s\n\n", dispatched);
+    printf("%-10s", "Size");
+    for (size_t k = 0; k < NUM_IMPLS; k++) printf("%14s", impls[k].name);
+    printf("   (GB/s)\n");
+
+    uint8_t *buf = malloc(65536);
+    for (size_t i = 0; i < 65536; i++) buf[i] = rand() & 0xff;
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        printf("%-10zu", sizes[s]);
+        for (size_t k = 0; k < NUM_IMPLS; k++) {
+            if (!supported(impls[k].name)) {
+                printf("%14s", "n/a");
+                continue;
+            }
+            volatile uint64_t sink = 0;
+            uint64_t iters = 0;
+            double start = now_sec(), elapsed;
+            do {
+                for (int r = 0; r < 1024; r++) sink += impls[k].fn(buf, sizes[s], 0);
+                iters += 1024;
+                elapsed = now_sec() - start;
+            } while (elapsed < target);
+            printf("%14.2f", (double)iters * sizes[s] / elapsed / 1e9);
+        }
+        printf("\n");
+    }
+
+    free(buf);
+    return 0;
+}
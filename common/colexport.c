@@ -0,0 +1,110 @@
+#include "colexport.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define COL_MAGIC "COLCAP1"
+#define COL_END_MAGIC "COLEND1"
+
+static const uint8_t widths[] = {[COL_U8] = 1, [COL_U16] = 2, [COL_U32] = 4, [COL_U64] = 8, [COL_I64] = 8,
+                                 [COL_BYTES16] = 16};
+
+// The format is little-endian; x86 and ARM Linux already are
+static void put32(struct col_writer *w, uint32_t v) {
+    if (fwrite(&v, sizeof(v), 1, w->fp) != 1) w->error = 1;
+}
+
+static void put64(struct col_writer *w, uint64_t v) {
+    if (fwrite(&v, sizeof(v), 1, w->fp) != 1) w->error = 1;
+}
+
+int col_open(struct col_writer *w, const char *path, const struct col_def *defs, int ncols, uint32_t group_rows) {
+    memset(w, 0, sizeof(*w));
+    if (ncols < 1 || ncols > COL_MAX_COLUMNS) {
+        errno = EINVAL;
+        return -1;
+    }
+    w->ncols = ncols;
+    w->group_rows = group_rows ? group_rows : COL_DEFAULT_GROUP_ROWS;
+    for (int c = 0; c < ncols; c++) {
+        snprintf(w->cols[c].name, COL_NAME_LEN, "%s", defs[c].name);
+        w->cols[c].type = defs[c].type;
+        w->cols[c].width = widths[defs[c].type];
+        w->cols[c].buf = calloc(w->group_rows, w->cols[c].width);
+        if (w->cols[c].buf == NULL) {
+            col_close(w);
+            return -1;
+        }
+    }
+
+    w->fp = fopen(path, "wb");
+    if (w->fp == NULL) {
+        int saved = errno;
+        col_close(w);
+        errno = saved;
+        return -1;
+    }
+    static const uint8_t zero[6];
+    if (fwrite(COL_MAGIC, 1, 8, w->fp) != 8) w->error = 1;
+    put32(w, ncols);
+    put32(w, w->group_rows);
+    for (int c = 0; c < ncols; c++) {
+        if (fwrite(w->cols[c].name, 1, COL_NAME_LEN, w->fp) != COL_NAME_LEN ||
+            fwrite(&w->cols[c].type, 1, 1, w->fp) != 1 || fwrite(&w->cols[c].width, 1, 1, w->fp) != 1 ||
+            fwrite(zero, 1, sizeof(zero), w->fp) != sizeof(zero)) {
+            w->error = 1;
+        }
+    }
+    return 0;
+}
+
+static void flush_group(struct col_writer *w) {
+    static const uint8_t pad[8];
+
+    if (w->rows == 0) return;
+    if (w->groups == w->groups_cap) {
+        size_t cap = w->groups_cap ? w->groups_cap * 2 : 64;
+        uint64_t *grown = realloc(w->group_offsets, cap * sizeof(uint64_t));
+        if (grown == NULL) {
+            w->error = 1;
+            return;
+        }
+        w->group_offsets = grown;
+        w->groups_cap = cap;
+    }
+    w->group_offsets[w->groups++] = ftello(w->fp);
+
+    if (fwrite("RGRP", 1, 4, w->fp) != 4) w->error = 1;
+    put32(w, w->rows);
+    for (int c = 0; c < w->ncols; c++) {
+        size_t bytes = (size_t)w->rows * w->cols[c].width;
+        if (fwrite(w->cols[c].buf, 1, bytes, w->fp) != bytes) w->error = 1;
+        if (bytes % 8 && fwrite(pad, 1, 8 - bytes % 8, w->fp) != 8 - bytes % 8) w->error = 1;
+        memset(w->cols[c].buf, 0, bytes);
+    }
+    w->total_rows += w->rows;
+    w->rows = 0;
+}
+
+void col_commit(struct col_writer *w) {
+    if (++w->rows == w->group_rows) flush_group(w);
+}
+
+int col_close(struct col_writer *w) {
+    int rc = 0;
+
+    if (w->fp) {
+        flush_group(w);
+        for (size_t g = 0; g < w->groups; g++) put64(w, w->group_offsets[g]);
+        put64(w, w->groups);
+        put64(w, w->total_rows);
+        if (fwrite(COL_END_MAGIC, 1, 8, w->fp) != 8) w->error = 1;
+        if (fclose(w->fp) != 0) w->error = 1;
+        rc = w->error ? -1 : 0;
+    }
+    for (int c = 0; c < w->ncols; c++) free(w->cols[c].buf);
+    free(w->group_offsets);
+    memset(w, 0, sizeof(*w));
+    return rc;
+}
@@ -0,0 +1,79 @@
+#ifndef COLEXPORT_H
+#define COLEXPORT_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/**
+ * Streaming writer for a simple columnar file ("column chunks"), so decoded
+ * packets and flows can be loaded into notebooks without parsing text.
+ *
+ * Rows are buffered per column and written as row groups of at most
+ * `group_rows` rows, so memory stays bounded whatever the capture size.
+ * Every column of a group is one contiguous little-endian array, which a
+ * reader can hand to numpy.frombuffer() (or array.frombytes()) without
+ * per-row work. common/colreader.py reads the format.
+ *
+ * File layout (all integers little-endian):
+ *   header    "COLCAP1\0", uint32 column count, uint32 group_rows,
+ *             then per column: char name[24], uint8 type, uint8 width, 6 x 0
+ *   groups    "RGRP", uint32 rows, then per column rows * width bytes,
+ *             zero-padded to a multiple of 8
+ *   footer    uint64 offset of each group, uint64 group count,
+ *             uint64 total rows, "COLEND1\0"
+ *
+ * The footer lets a reader seek to any group; a file without one (the
+ * writer was interrupted) can still be read group by group from the start.
+ */
+
+#define COL_MAX_COLUMNS 32
+#define COL_NAME_LEN 24
+#define COL_DEFAULT_GROUP_ROWS 65536
+
+enum col_type {
+    COL_U8 = 1,
+    COL_U16,
+    COL_U32,
+    COL_U64,
+    COL_I64,
+    COL_BYTES16,   // e.g. an IPv6 address, or an IPv4 address in the first 4 bytes
+};
+
+struct col_def {
+    const char *name;
+    uint8_t type;
+};
+
+struct col_writer {
+    FILE *fp;
+    int ncols;
+    struct {
+        char name[COL_NAME_LEN];
+        uint8_t type;
+        uint8_t width;
+        uint8_t *buf;
+    } cols[COL_MAX_COLUMNS];
+    uint32_t group_rows;
+    uint32_t rows;             // rows buffered in the current group
+    uint64_t total_rows;
+    uint64_t *group_offsets;
+    size_t groups, groups_cap;
+    int error;
+};
+
+/* Create `path` with the given columns. Returns 0, or -1 (errno is set). */
+int col_open(struct col_writer *w, const char *path, const struct col_def *defs, int ncols, uint32_t group_rows);
+
+/* Address of column `col` in the row being built; fill every column, then
+ * call col_commit(). Unfilled cells are zero. */
+static inline void *col_cell(struct col_writer *w, int col) {
+    return w->cols[col].buf + (size_t)w->rows * w->cols[col].width;
+}
+
+/* Finish the current row, writing out the group when it is full. */
+void col_commit(struct col_writer *w);
+
+/* Flush the last group and write the footer. Returns 0, or -1 if any write failed. */
+int col_close(struct col_writer *w);
+
+#endif
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""
+Column Chunk Reader
+===================
+
+Reads the columnar files written by common/colexport.c (for example
+`analyzer -x packets.col` or `-X flows.col`). Each column comes back as one
+array: a numpy array when numpy is installed, otherwise an `array.array`.
+Address columns (16 bytes per row) come back as a bytes-like buffer of
+16 * rows bytes (an (rows, 16) uint8 array with numpy); `format_addr()`
+turns one entry into text.
+
+    from colreader import read_columns
+    cols = read_columns("packets.col")
+    print(len(cols["ts_ns"]), cols["dport"][:10])
+
+Run as a script to print the schema and the first rows of a file.
+"""
+
+import array
+import ipaddress
+import struct
+import sys
+
+try:
+    import numpy
+except ImportError:
+    numpy = None
+
+MAGIC = b"COLCAP1\0"
+END_MAGIC = b"COLEND1\0"
+
+# type code -> (array typecode, numpy dtype)
+TYPES = {
+    1: ("B", "<u1"),
+    2: ("H", "<u2"),
+    3: ("I", "<u4"),
+    4: ("Q", "<u8"),
+    5: ("q", "<i8"),
+    6: (None, None),   # 16 raw bytes
+}
+
+
+def read_schema(data):
+    """Return [(name, type, width)] and the offset of the first row group"""
+    if data[:8] != MAGIC:
+        raise ValueError("not a column chunk file")
+    ncols, _group_rows = struct.unpack_from("<II", data, 8)
+    schema = []
+    off = 16
+    for _ in range(ncols):
+        name, ctype, width = struct.unpack_from("<24sBB6x", data, off)
+        schema.append((name.split(b"\0", 1)[0].decode(), ctype, width))
+        off += 32
+    return schema, off
+
+
+def group_offsets(data, schema, first):
+    """Offsets of all row groups, from the footer if the file has one"""
+    if len(data) >= first + 24 and data[-8:] == END_MAGIC:
+        count, _rows = struct.unpack_from("<QQ", data, len(data) - 24)
+        return list(struct.unpack_from("<%dQ" % count, data, len(data) - 24 - 8 * count))
+    # No footer (the writer was interrupted): walk the complete groups
+    offsets = []
+    off = first
+    while off + 8 <= len(data) and data[off:off + 4] == b"RGRP":
+        rows = struct.unpack_from("<I", data, off + 4)[0]
+        size = 8 + sum((rows * w + 7) // 8 * 8 for _, _, w in schema)
+        if off + size > len(data):
+            break
+        offsets.append(off)
+        off += size
+    return offsets
+
+
+def read_columns(path):
+    """Read a whole file into {column name: array}"""
+    with open(path, "rb") as f:
+        data = f.read()
+    schema, first = read_schema(data)
+    chunks = {name: [] for name, _, _ in schema}
+
+    for off in group_offsets(data, schema, first):
+        rows = struct.unpack_from("<I", data, off + 4)[0]
+        pos = off + 8
+        for name, ctype, width in schema:
+            size = rows * width
+            chunks[name].append(memoryview(data)[pos:pos + size])
+            pos += (size + 7) // 8 * 8
+
+    columns = {}
+    for name, ctype, width in schema:
+        typecode, dtype = TYPES[ctype]
+        raw = b"".join(chunks[name])
+        if numpy is not None:
+            col = numpy.frombuffer(raw, dtype=dtype or "u1")
+            columns[name] = col.reshape(-1, 16) if dtype is None else col
+        elif typecode is None:
+            columns[name] = raw
+        else:
+            col = array.array(typecode)
+            col.frombytes(raw)
+            if sys.byteorder != "little":
+                col.byteswap()
+            columns[name] = col
+    return columns
+
+
+def column_rows(column):
+    """Number of rows in a column returned by read_columns()"""
+    return len(column) // 16 if isinstance(column, bytes) else len(column)
+
+
+def format_addr(column, row, family):
+    """Text form of the address in `row` of a 16-byte column"""
+    raw = bytes(column[row]) if numpy is not None else column[row * 16:(row + 1) * 16]
+    if family == 4:
+        return str(ipaddress.IPv4Address(raw[:4]))
+    if family == 6:
+        return str(ipaddress.IPv6Address(raw))
+    return "-"
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(f"Usage: {sys.argv[0]} <file.col> [rows]")
+        sys.exit(1)
+    limit = int(sys.argv[2]) if len(sys.argv) > 2 else 10
+    cols = read_columns(sys.argv[1])
+    names = list(cols)
+    rows = column_rows(cols[names[0]])
+    print(f"{rows} rows, columns: {', '.join(names)}")
+
+    for r in range(min(rows, limit)):
+        values = []
+        for name in names:
+            col = cols[name]
+            if isinstance(col, bytes) or getattr(col, "ndim", 1) == 2:
+                values.append(format_addr(col, r, int(cols["family"][r]) if "family" in cols else 6))
+            else:
+                values.append(str(col[r]))
+        print("  ".join(values))
+
+
+if __name__ == "__main__":
+    main()
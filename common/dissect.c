@@ -0,0 +1,288 @@
+#include "dissect.h"
+
+#include <string.h>
+#include <netinet/in.h>
+#include <net/ethernet.h>
+#include "capture.h"
+
+#define MAX_L3_HANDLERS 16
+#define ETHERTYPE_QINQ 0x88a8
+
+static inline uint16_t get16(const uint8_t *p) {
+    return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t get32(const uint8_t *p) {
+    return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static int dissect_arp(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    // Only Ethernet/IPv4 ARP carries addresses we decode
+    if (d->caplen < off + 28) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    d->layers |= DISSECT_ARP;
+    d->arp_opcode = get16(pkt + off + 6);
+    if (get16(pkt + off + 2) == ETHERTYPE_IP && pkt[off + 4] == 6 && pkt[off + 5] == 4) {
+        memcpy(d->saddr, pkt + off + 14, 4);
+        memcpy(d->daddr, pkt + off + 24, 4);
+    }
+    return -1;
+}
+
+static int dissect_ipv4(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    const uint8_t *ip = pkt + off;
+    if (d->caplen < off + 20 || (ip[0] >> 4) != 4) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    uint32_t ihl = (ip[0] & 0x0f) * 4;
+    d->layers |= DISSECT_IPV4;
+    d->family = 4;
+    d->ip_len = get16(ip + 2);
+    d->ttl = ip[8];
+    d->l4_proto = ip[9];
+    memcpy(d->saddr, ip + 12, 4);
+    memcpy(d->daddr, ip + 16, 4);
+
+    if (get16(ip + 6) & 0x1fff) {
+        d->layers |= DISSECT_FRAGMENT;
+        return -1;
+    }
+    if (ihl < 20 || d->caplen < off + ihl) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    return off + ihl;
+}
+
+static int dissect_ipv6(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    const uint8_t *ip = pkt + off;
+    if (d->caplen < off + 40 || (ip[0] >> 4) != 6) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    d->layers |= DISSECT_IPV6;
+    d->family = 6;
+    d->ip_len = get16(ip + 4) + 40;
+    d->ttl = ip[7];
+    memcpy(d->saddr, ip + 8, 16);
+    memcpy(d->daddr, ip + 24, 16);
+
+    uint8_t next = ip[6];
+    off += 40;
+    for (;;) {
+        switch (next) {
+        case IPPROTO_HOPOPTS:
+        case IPPROTO_ROUTING:
+        case IPPROTO_DSTOPTS:
+        case IPPROTO_AH: {
+            uint8_t hdr = next;
+            if (d->caplen < off + 8) {
+                d->layers |= DISSECT_TRUNCATED;
+                return -1;
+            }
+            next = pkt[off];
+            off += hdr == IPPROTO_AH ? (pkt[off + 1] + 2) * 4 : (pkt[off + 1] + 1) * 8;
+            break;
+        }
+        case IPPROTO_FRAGMENT:
+            if (d->caplen < off + 8) {
+                d->layers |= DISSECT_TRUNCATED;
+                return -1;
+            }
+            if (get16(pkt + off + 2) & 0xfff8) {
+                d->l4_proto = pkt[off];
+                d->layers |= DISSECT_FRAGMENT;
+                return -1;
+            }
+            next = pkt[off];
+            off += 8;
+            break;
+        default:
+            d->l4_proto = next;
+            return off;
+        }
+    }
+}
+
+static int dissect_tcp(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    const uint8_t *t = pkt + off;
+    if (d->caplen < off + 20) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    d->layers |= DISSECT_TCP;
+    d->sport = get16(t);
+    d->dport = get16(t + 2);
+    d->tcp_seq = get32(t + 4);
+    d->tcp_ack = get32(t + 8);
+    d->tcp_flags = t[13];
+    uint32_t hlen = (t[12] >> 4) * 4;
+    if (hlen < 20 || d->caplen < off + hlen) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    return off + hlen;
+}
+
+static int dissect_udp(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    if (d->caplen < off + 8) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    d->layers |= DISSECT_UDP;
+    d->sport = get16(pkt + off);
+    d->dport = get16(pkt + off + 2);
+    d->udp_len = get16(pkt + off + 4);
+    return off + 8;
+}
+
+// ICMP and ICMPv6 share the type/code/checksum/id/seq layout
+static int dissect_icmp(struct dissection *d, const uint8_t *pkt, uint32_t off) {
+    if (d->caplen < off + 8) {
+        d->layers |= DISSECT_TRUNCATED;
+        return -1;
+    }
+    d->layers |= d->l4_proto == IPPROTO_ICMPV6 ? DISSECT_ICMPV6 : DISSECT_ICMP;
+    d->icmp_type = pkt[off];
+    d->icmp_code = pkt[off + 1];
+    d->echo_id = get16(pkt + off + 4);
+    d->echo_seq = get16(pkt + off + 6);
+    return off + 8;
+}
+
+static struct {
+    uint16_t ethertype;
+    dissect_l3_fn fn;
+} l3_table[MAX_L3_HANDLERS] = {
+    {ETHERTYPE_IP, dissect_ipv4},
+    {ETHERTYPE_IPV6, dissect_ipv6},
+    {ETHERTYPE_ARP, dissect_arp},
+};
+static int l3_count = 3;
+
+static dissect_l4_fn l4_table[256] = {
+    [IPPROTO_TCP] = dissect_tcp,
+    [IPPROTO_UDP] = dissect_udp,
+    [IPPROTO_ICMP] = dissect_icmp,
+    [IPPROTO_ICMPV6] = dissect_icmp,
+};
+
+int dissect_register_l3(uint16_t ethertype, dissect_l3_fn fn) {
+    for (int i = 0; i < l3_count; i++) {
+        if (l3_table[i].ethertype == ethertype) {
+            l3_table[i].fn = fn;
+            return 0;
+        }
+    }
+    if (l3_count == MAX_L3_HANDLERS) return -1;
+    l3_table[l3_count].ethertype = ethertype;
+    l3_table[l3_count].fn = fn;
+    l3_count++;
+    return 0;
+}
+
+void dissect_register_l4(uint8_t proto, dissect_l4_fn fn) {
+    l4_table[proto] = fn;
+}
+
+static void reset(struct dissection *d, uint32_t caplen) {
+    memset(d, 0, sizeof(*d));
+    d->caplen = caplen;
+    d->l2_off = d->l3_off = d->l4_off = d->payload_off = DISSECT_NONE;
+}
+
+// Run the L3 and L4 handlers for the header at `off`
+static void dispatch_l3(struct dissection *d, const uint8_t *pkt, uint32_t off, uint16_t ethertype) {
+    dissect_l3_fn l3 = NULL;
+
+    d->ethertype = ethertype;
+    for (int i = 0; i < l3_count; i++) {
+        if (l3_table[i].ethertype == ethertype) {
+            l3 = l3_table[i].fn;
+            break;
+        }
+    }
+    if (l3 == NULL || off >= d->caplen) return;
+
+    d->l3_off = off;
+    int l4_off = l3(d, pkt, off);
+    if (l4_off < 0) return;
+
+    d->l4_off = l4_off;
+    dissect_l4_fn l4 = l4_table[d->l4_proto];
+    int payload_off = l4 ? l4(d, pkt, l4_off) : l4_off;
+    if (payload_off < 0) return;
+
+    // Ethernet pads short frames; the IP length says where the payload ends
+    uint32_t end = d->caplen;
+    if (d->ip_len && d->l3_off + d->ip_len < end) end = d->l3_off + d->ip_len;
+    d->payload_off = payload_off;
+    d->payload_len = end > (uint32_t)payload_off ? end - payload_off : 0;
+}
+
+void dissect_l3(struct dissection *d, const uint8_t *pkt, uint32_t caplen, uint16_t ethertype) {
+    reset(d, caplen);
+    dispatch_l3(d, pkt, 0, ethertype);
+}
+
+void dissect_packet(struct dissection *d, const uint8_t *pkt, uint32_t caplen, uint16_t linktype) {
+    uint32_t off;
+    uint16_t ethertype;
+
+    reset(d, caplen);
+    switch (linktype) {
+    case CAP_LINK_ETHERNET:
+        if (caplen < 14) {
+            d->layers |= DISSECT_TRUNCATED;
+            return;
+        }
+        d->layers |= DISSECT_ETH;
+        d->l2_off = 0;
+        ethertype = get16(pkt + 12);
+        off = 14;
+        while ((ethertype == ETHERTYPE_VLAN || ethertype == ETHERTYPE_QINQ) && caplen >= off + 4) {
+            if (d->vlan_count++ == 0) d->vlan_id = get16(pkt + off) & 0x0fff;
+            d->layers |= DISSECT_VLAN;
+            ethertype = get16(pkt + off + 2);
+            off += 4;
+        }
+        break;
+    case CAP_LINK_LINUX_SLL:
+        if (caplen < 16) {
+            d->layers |= DISSECT_TRUNCATED;
+            return;
+        }
+        d->layers |= DISSECT_SLL;
+        d->l2_off = 0;
+        ethertype = get16(pkt + 14);
+        off = 16;
+        break;
+    case CAP_LINK_NULL: {
+        // Address family in the capturing host's byte order
+        uint32_t family;
+        if (caplen < 4) {
+            d->layers |= DISSECT_TRUNCATED;
+            return;
+        }
+        memcpy(&family, pkt, 4);
+        if (family > 0xffff) family = __builtin_bswap32(family);
+        ethertype = family == 2 ? ETHERTYPE_IP : ETHERTYPE_IPV6;   // 24, 28 and 30 are AF_INET6 on BSDs
+        d->l2_off = 0;
+        off = 4;
+        break;
+    }
+    case CAP_LINK_RAW:
+    case CAP_LINK_IPV4:
+    case CAP_LINK_IPV6:
+        if (caplen < 1) return;
+        ethertype = (pkt[0] >> 4) == 6 ? ETHERTYPE_IPV6 : ETHERTYPE_IP;
+        off = 0;
+        break;
+    default:
+        return;
+    }
+    dispatch_l3(d, pkt, off, ethertype);
+}
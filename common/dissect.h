@@ -0,0 +1,83 @@
+#ifndef DISSECT_H
+#define DISSECT_H
+
+#include <stdint.h>
+
+/**
+ * Table-driven packet dissector shared by the sniffer and the capture tools.
+ *
+ * dissect_packet() walks a frame layer by layer: the link type selects the
+ * L2 decoder, the ethertype selects an L3 handler from a registration table
+ * and the IP protocol number selects an L4 handler. Each handler validates
+ * its header against the captured length, records its offset and key fields
+ * in the caller's struct dissection and hands over to the next layer.
+ * Nothing is allocated and the packet bytes are never copied.
+ *
+ * Built-in handlers cover Ethernet (with 802.1Q/802.1ad tags), Linux cooked,
+ * BSD loopback and raw IP link types, ARP, IPv4, IPv6 (skipping extension
+ * headers), TCP, UDP, ICMP and ICMPv6. More can be added at run time with
+ * dissect_register_l3() and dissect_register_l4().
+ *
+ *     struct dissection d;
+ *     dissect_packet(&d, pkt.data, pkt.caplen, pkt.linktype);
+ *     if (d.layers & DISSECT_TCP) printf("%u -> %u\n", d.sport, d.dport);
+ */
+
+/* Bits in dissection.layers */
+#define DISSECT_ETH (1u << 0)
+#define DISSECT_VLAN (1u << 1)
+#define DISSECT_SLL (1u << 2)
+#define DISSECT_ARP (1u << 3)
+#define DISSECT_IPV4 (1u << 4)
+#define DISSECT_IPV6 (1u << 5)
+#define DISSECT_TCP (1u << 6)
+#define DISSECT_UDP (1u << 7)
+#define DISSECT_ICMP (1u << 8)
+#define DISSECT_ICMPV6 (1u << 9)
+#define DISSECT_FRAGMENT (1u << 10)   // non-first IP fragment: no L4 header
+#define DISSECT_TRUNCATED (1u << 11)  // a header announced by the previous layer is cut off
+
+#define DISSECT_NONE UINT32_MAX       // offset of a layer that is not present
+
+struct dissection {
+    uint32_t layers;          // DISSECT_* bits
+    uint32_t caplen;
+    uint32_t l2_off, l3_off, l4_off, payload_off;   // frames may exceed 64 KiB (jumbo, GRO)
+    uint16_t ethertype;       // innermost ethertype (after VLAN tags)
+    uint8_t vlan_count;
+    uint8_t family;           // 4 or 6 when an IP layer is present
+    uint8_t l4_proto;         // IP protocol / IPv6 next header of the L4 layer
+    uint8_t ttl;              // TTL / hop limit
+    uint32_t ip_len;          // IP total length (IPv4) or payload length + 40 (IPv6)
+    uint16_t vlan_id;         // outermost VLAN id
+    uint8_t saddr[16];        // IPv4 uses the first 4 bytes; ARP sender / target IP
+    uint8_t daddr[16];
+    uint16_t sport, dport;    // TCP / UDP ports, host order
+    uint16_t udp_len;         // UDP length field (header + payload as sent)
+    uint8_t tcp_flags;
+    uint8_t icmp_type, icmp_code;
+    uint16_t echo_id, echo_seq;   // ICMP echo request / reply, host order
+    uint16_t arp_opcode;
+    uint32_t tcp_seq, tcp_ack;
+    uint32_t payload_len;
+};
+
+/* An L3 handler decodes the header at `off` and returns the offset of the L4
+ * header (setting d->l4_proto), or -1 if there is nothing further to decode.
+ * An L4 handler returns the payload offset, or -1. */
+typedef int (*dissect_l3_fn)(struct dissection *d, const uint8_t *pkt, uint32_t off);
+typedef int (*dissect_l4_fn)(struct dissection *d, const uint8_t *pkt, uint32_t off);
+
+/* Register (or replace) the handler for an ethertype / IP protocol.
+ * Returns -1 if the L3 table is full. Not thread-safe: register at start-up. */
+int dissect_register_l3(uint16_t ethertype, dissect_l3_fn fn);
+void dissect_register_l4(uint8_t proto, dissect_l4_fn fn);
+
+/* Decode `caplen` bytes captured on `linktype` (CAP_LINK_* in capture.h). */
+void dissect_packet(struct dissection *d, const uint8_t *pkt, uint32_t caplen, uint16_t linktype);
+
+/* Decode starting at an L3 header with the given ethertype, e.g. for packets
+ * from raw IP sockets. */
+void dissect_l3(struct dissection *d, const uint8_t *pkt, uint32_t caplen, uint16_t ethertype);
+
+#endif
@@ -0,0 +1,269 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include "capture.h"
+#include "dissect.h"
+#include "packet.h"
+
+/**
+ * Dissector benchmark.
+ * Builds a pool of Ethernet frames (TCP SYN with options, VLAN-tagged UDP
+ * over IPv6 with a destination options header, ICMP echo and ARP), checks
+ * that dissect_packet() recovers every field they were built with (and the
+ * offsets of a frame over 64 KiB), then reports how many frames per second
+ * it decodes (Mpps and GB/s of frames).
+ * Passing a capture (e.g. a gencorpus file) times the first POOL_SIZE
+ * Ethernet frames of it instead, cut to FRAME_CAP bytes like a short snaplen.
+ *
+ * Build: gcc -O2 dissect_bench.c dissect.c packet.c pkt_template.c checksum.c capture.c capstream.c -o dissect_bench -lz -lpthread
+ */
+
+#define POOL_SIZE 4096
+#define FRAME_CAP 256
+#define L2_ROOM 18                // Ethernet header plus one VLAN tag
+
+enum shape { SHAPE_TCP, SHAPE_UDP6_VLAN, SHAPE_ICMP, SHAPE_ARP, SHAPE_COUNT };
+static const char *shape_names[SHAPE_COUNT] = {"tcp", "udp6+vlan", "icmp", "arp"};
+
+struct frame {
+    uint8_t data[FRAME_CAP];
+    uint32_t len;
+    uint32_t shape;
+    uint32_t idx;
+};
+
+static uint8_t payload[128];
+static struct in6_addr src6, dst6;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Write the Ethernet header (and optional VLAN tag) in front of the L3 packet at L2_ROOM
+static uint8_t *link_header(uint8_t *frame, uint16_t ethertype, int vlan, uint16_t vlan_id) {
+    uint8_t *p = frame + L2_ROOM - (vlan ? 18 : 14);
+    memset(p, 0xaa, 6);
+    memset(p + 6, 0xbb, 6);
+    if (vlan) {
+        p[12] = ETHERTYPE_VLAN >> 8;
+        p[13] = ETHERTYPE_VLAN & 0xff;
+        p[14] = vlan_id >> 8;
+        p[15] = vlan_id & 0xff;
+        p[16] = ethertype >> 8;
+        p[17] = ethertype & 0xff;
+    } else {
+        p[12] = ethertype >> 8;
+        p[13] = ethertype & 0xff;
+    }
+    return p;
+}
+
+static void build_frame(struct frame *f, uint32_t shape, uint32_t i) {
+    uint8_t tmp[FRAME_CAP];
+    uint8_t *l3 = tmp + L2_ROOM, *start;
+    struct pkt_builder b;
+    size_t len = 0;
+
+    pkt_init(&b, l3, sizeof(tmp) - L2_ROOM);
+    switch (shape) {
+    case SHAPE_TCP:
+        pkt_ipv4(&b, htonl(0x0a000001 + i), htonl(0x0a000002), 64);
+        pkt_tcp(&b, 40000 + (i & 0xfff), 80, i, 0, TH_SYN, 64240);
+        pkt_tcp_mss(&b, 1460);
+        pkt_tcp_sack_perm(&b);
+        pkt_tcp_timestamp(&b, i, 0);
+        pkt_tcp_option(&b, TCPOPT_NOP, NULL, 0);
+        pkt_tcp_wscale(&b, 7);
+        len = pkt_finalize(&b, NULL);
+        start = link_header(tmp, ETHERTYPE_IP, 0, 0);
+        break;
+    case SHAPE_UDP6_VLAN: {
+        static const uint8_t opts[4] = {1, 2, 0, 0}; // PadN
+        pkt_ipv6(&b, &src6, &dst6, 64);
+        pkt_ipv6_ext(&b, IPPROTO_DSTOPTS, opts, sizeof(opts));
+        pkt_udp(&b, 5000, 6000 + (i & 0xff));
+        pkt_payload(&b, payload, 64);
+        len = pkt_finalize(&b, NULL);
+        start = link_header(tmp, ETHERTYPE_IPV6, 1, i & 0xfff);
+        break;
+    }
+    case SHAPE_ICMP: {
+        pkt_ipv4(&b, htonl(0x0a000001), htonl(0x0a000002 + i), 64);
+        struct icmphdr *icmph = pkt_icmp(&b, ICMP_ECHO, 0);
+        if (icmph) {
+            icmph->un.echo.id = htons(1234);
+            icmph->un.echo.sequence = htons((uint16_t)i);
+        }
+        pkt_payload(&b, payload, 56);
+        len = pkt_finalize(&b, NULL);
+        start = link_header(tmp, ETHERTYPE_IP, 0, 0);
+        break;
+    }
+    default: {
+        // Ethernet/IPv4 who-has
+        static const uint8_t hdr[8] = {0, 1, 8, 0, 6, 4, 0, 1};
+        uint32_t spa = htonl(0xc0a80001), tpa = htonl(0xc0a80000 + (i & 0xff));
+        memcpy(l3, hdr, 8);
+        memset(l3 + 8, 0xbb, 6);
+        memcpy(l3 + 14, &spa, 4);
+        memset(l3 + 18, 0, 6);
+        memcpy(l3 + 24, &tpa, 4);
+        len = 28;
+        start = link_header(tmp, ETHERTYPE_ARP, 0, 0);
+        break;
+    }
+    }
+    if (len == 0) {
+        fprintf(stderr, "Cannot build %s frame\n", shape_names[shape]);
+        exit(1);
+    }
+    f->len = (tmp + L2_ROOM - start) + len;
+    f->shape = shape;
+    f->idx = i;
+    memcpy(f->data, start, f->len);
+}
+
+// Compare the dissection with the values the frame was built from
+static int verify(const struct frame *f) {
+    struct dissection d;
+    uint32_t i = f->idx, a4;
+    int ok;
+
+    dissect_packet(&d, f->data, f->len, CAP_LINK_ETHERNET);
+    if (d.layers & DISSECT_TRUNCATED) return 0;
+    switch (f->shape) {
+    case SHAPE_TCP:
+        a4 = htonl(0x0a000001 + i);
+        ok = (d.layers & (DISSECT_ETH | DISSECT_IPV4 | DISSECT_TCP)) == (DISSECT_ETH | DISSECT_IPV4 | DISSECT_TCP) &&
+             d.l3_off == 14 && d.l4_off == 34 && d.payload_off == 34 + 40 && d.payload_len == 0 &&
+             memcmp(d.saddr, &a4, 4) == 0 && d.ttl == 64 && d.sport == 40000 + (i & 0xfff) && d.dport == 80 &&
+             d.tcp_seq == i && d.tcp_flags == TH_SYN;
+        break;
+    case SHAPE_UDP6_VLAN:
+        ok = (d.layers & (DISSECT_VLAN | DISSECT_IPV6 | DISSECT_UDP)) == (DISSECT_VLAN | DISSECT_IPV6 | DISSECT_UDP) &&
+             d.vlan_count == 1 && d.vlan_id == (i & 0xfff) && d.l3_off == 18 && d.l4_off == 18 + 48 &&
+             d.l4_proto == IPPROTO_UDP && memcmp(d.saddr, &src6, 16) == 0 && memcmp(d.daddr, &dst6, 16) == 0 &&
+             d.sport == 5000 && d.dport == 6000 + (i & 0xff) && d.udp_len == 72 && d.payload_len == 64;
+        break;
+    case SHAPE_ICMP:
+        a4 = htonl(0x0a000002 + i);
+        ok = (d.layers & DISSECT_ICMP) && memcmp(d.daddr, &a4, 4) == 0 && d.icmp_type == ICMP_ECHO &&
+             d.echo_id == 1234 && d.echo_seq == (uint16_t)i && d.payload_len == 56;
+        break;
+    default:
+        a4 = htonl(0xc0a80000 + (i & 0xff));
+        ok = (d.layers & DISSECT_ARP) && d.arp_opcode == 1 && d.l3_off == 14 && memcmp(d.daddr, &a4, 4) == 0;
+        break;
+    }
+    // A frame cut anywhere inside its headers must never be decoded past the cut
+    for (uint32_t cut = 0; ok && cut < f->len; cut += 7) {
+        struct dissection t;
+        dissect_packet(&t, f->data, cut, CAP_LINK_ETHERNET);
+        if (t.payload_off != DISSECT_NONE && t.payload_off > cut) ok = 0;
+    }
+    return ok;
+}
+
+/* Offsets past 64 KiB: a GRO-sized Ethernet/IPv6 frame whose UDP header sits
+ * behind 33 destination options headers of 2 KiB each. */
+static int check_jumbo(void) {
+    enum { EXT = 2048, EXT_COUNT = 33, L4 = 14 + 40 + EXT_COUNT * EXT, LEN = L4 + 8 + 1000 };
+    static uint8_t f[LEN];
+    struct dissection d;
+
+    memset(f, 0, sizeof(f));
+    f[12] = 0x86, f[13] = 0xdd;
+    f[14] = 0x60;
+    f[14 + 6] = IPPROTO_DSTOPTS;                     // payload length 0: a jumbogram
+    for (int i = 0; i < EXT_COUNT; i++) {
+        uint8_t *h = f + 14 + 40 + i * EXT;
+        h[0] = i + 1 < EXT_COUNT ? IPPROTO_DSTOPTS : IPPROTO_UDP;
+        h[1] = EXT / 8 - 1;
+    }
+    f[L4] = 0x13, f[L4 + 1] = 0x88;                  // port 5000
+    f[L4 + 2] = 0x17, f[L4 + 3] = 0x70;              // port 6000
+    dissect_packet(&d, f, LEN, CAP_LINK_ETHERNET);
+    return (d.layers & DISSECT_UDP) && d.l4_off == L4 && d.payload_off == L4 + 8 && d.sport == 5000 &&
+           d.dport == 6000;
+}
+
+// Fill the pool from the Ethernet frames of a capture; returns the number loaded
+static int load_pool(const char *path, struct frame *pool) {
+    struct capture cap;
+    struct cap_packet p;
+    int n = 0;
+
+    if (cap_open(&cap, path) < 0) {
+        fprintf(stderr, "%s\n", cap.err);
+        exit(1);
+    }
+    while (n < POOL_SIZE && cap_next(&cap, &p) > 0) {
+        if (p.linktype != CAP_LINK_ETHERNET) continue;
+        pool[n].len = p.caplen < FRAME_CAP ? p.caplen : FRAME_CAP;
+        memcpy(pool[n].data, p.data, pool[n].len);
+        n++;
+    }
+    cap_close(&cap);
+    return n;
+}
+
+// Decode the pool over and over for `target` seconds
+static void bench(const struct frame *pool, int n, const char *label, double target) {
+    struct dissection d;
+    uint64_t packets = 0, bytes = 0;
+    volatile uint64_t sink = 0;
+
+    double start = now_sec(), elapsed;
+    do {
+        for (int i = 0; i < n; i++) {
+            dissect_packet(&d, pool[i].data, pool[i].len, CAP_LINK_ETHERNET);
+            sink += d.layers + d.sport + d.payload_len;
+            bytes += pool[i].len;
+        }
+        packets += n;
+        elapsed = now_sec() - start;
+    } while (elapsed < target);
+
+    printf("%-12s %10.2f Mpps %10.2f GB/s   (%.1f ns/packet)\n", label, packets / elapsed / 1e6,
+           bytes / elapsed / 1e9, elapsed * 1e9 / packets);
+}
+
+int main(int argc, char *argv[]) {
+    static struct frame pool[POOL_SIZE], single[POOL_SIZE];
+    int failures = 0;
+
+    if (argc > 1) {
+        int n = load_pool(argv[1], pool);
+        if (n == 0) {
+            fprintf(stderr, "%s: no Ethernet frames\n", argv[1]);
+            return 1;
+        }
+        bench(pool, n, "corpus", 1.0);
+        return 0;
+    }
+
+    for (size_t i = 0; i < sizeof(payload); i++) payload[i] = (uint8_t)i;
+    inet_pton(AF_INET6, "2001:db8::1", &src6);
+    inet_pton(AF_INET6, "2001:db8::2", &dst6);
+
+    srand(1);
+    for (int i = 0; i < POOL_SIZE; i++) build_frame(&pool[i], rand() % SHAPE_COUNT, i);
+    for (int i = 0; i < POOL_SIZE; i++) {
+        if (!verify(&pool[i]) && failures++ < 5) printf("MISMATCH frame %d (%s)\n", i, shape_names[pool[i].shape]);
+    }
+    if (!check_jumbo() && failures++ < 5) printf("MISMATCH frame with offsets past 64 KiB\n");
+    printf("Field check: %s\n\n", failures ? "FAILED" : "all frames decode to the values they were built with");
+    if (failures) return 1;
+
+    bench(pool, POOL_SIZE, "mixed", 0.5);
+    for (int s = 0; s < SHAPE_COUNT; s++) {
+        for (int i = 0; i < POOL_SIZE; i++) build_frame(&single[i], s, i);
+        bench(single, POOL_SIZE, shape_names[s], 0.5);
+    }
+    return 0;
+}
@@ -0,0 +1,609 @@
+#include "ecmp_table.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EPS 1e-9
+
+static void *grow(void *p, size_t *cap, size_t need, size_t size) {
+    if (need <= *cap) return p;
+    size_t n = *cap ? 2 * *cap : 4096;
+    while (n < need) n *= 2;
+    void *grown = realloc(p, n * size);
+    if (grown) *cap = n;
+    return grown;
+}
+
+// Logged writes, so ecmp_restore() can undo them
+static int set_word(struct ecmp_table *e, size_t at, uint64_t value) {
+    if (e->bits[at] == value) return 0;
+    if (e->word_log_len == e->word_log_cap) {
+        struct ecmp_word_undo *log = grow(e->word_log, &e->word_log_cap, e->word_log_len + 1, sizeof(*log));
+        if (!log) return -1;
+        e->word_log = log;
+    }
+    e->word_log[e->word_log_len++] = (struct ecmp_word_undo){at, e->bits[at]};
+    e->bits[at] = value;
+    return 0;
+}
+
+static int set_bit(struct ecmp_table *e, uint32_t row, uint32_t d, int on) {
+    size_t at = (size_t)row * e->words + d / 64;
+    uint64_t mask = 1ull << (d % 64);
+    return set_word(e, at, on ? e->bits[at] | mask : e->bits[at] & ~mask);
+}
+
+// Also remembers the pair, whose ports' bits need checking afterwards
+static int set_hop(struct ecmp_table *e, uint32_t v, uint32_t d, uint16_t value) {
+    uint32_t at = v * e->switch_count + d;
+    if (e->hops[at] == value) return 0;
+    if (e->hop_log_len == e->hop_log_cap) {
+        struct ecmp_hop_undo *log = grow(e->hop_log, &e->hop_log_cap, e->hop_log_len + 1, sizeof(*log));
+        if (!log) return -1;
+        e->hop_log = log;
+    }
+    if (e->changed_len + 2 > e->changed_cap) {
+        uint32_t *changed = grow(e->changed, &e->changed_cap, e->changed_len + 2, sizeof(*changed));
+        if (!changed) return -1;
+        e->changed = changed;
+    }
+    e->hop_log[e->hop_log_len++] = (struct ecmp_hop_undo){at, e->hops[at]};
+    e->hops[at] = value;
+    e->changed[e->changed_len++] = v;
+    e->changed[e->changed_len++] = d;
+    return 0;
+}
+
+static int switch_up(const struct ecmp_table *e, uint32_t v) {
+    return e->node_up[e->switch_node[v]];
+}
+
+static int port_up(const struct ecmp_table *e, uint32_t a) {
+    return e->link_up[e->nbr_port[a] >> 1];
+}
+
+/* BFS from `count` switches at once (e->sources), bit i of a switch's words
+ * standing for source i. With `full`, the sources are all switches in
+ * order and the table starts empty, so hop counts are written directly and
+ * the port bits built alongside; otherwise hop counts go through set_hop(). */
+static int spread(struct ecmp_table *e, uint32_t count, int full) {
+    uint32_t n = e->switch_count, w = (count + 63) / 64, words = e->words;
+
+    memset(e->visited, 0, (size_t)n * w * sizeof(*e->visited));
+    memset(e->frontier, 0, (size_t)n * w * sizeof(*e->frontier));
+    memset(e->next, 0, (size_t)n * w * sizeof(*e->next));
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t s = e->sources[i];
+        e->visited[(size_t)s * w + i / 64] |= 1ull << (i % 64);
+        e->frontier[(size_t)s * w + i / 64] |= 1ull << (i % 64);
+        if (full) e->hops[s * n + s] = 0;
+    }
+
+    for (uint32_t level = 1;; level++) {
+        int any = 0;
+        for (uint32_t v = 0; v < n; v++) {
+            if (!switch_up(e, v)) continue;
+            uint64_t *next = e->next + (size_t)v * w, *seen = e->visited + (size_t)v * w;
+            memset(next, 0, w * sizeof(*next));
+            for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+                if (!port_up(e, a)) continue;
+                const uint64_t *f = e->frontier + (size_t)e->nbr[a] * w;
+                for (uint32_t j = 0; j < w; j++) next[j] |= f[j];
+            }
+            for (uint32_t j = 0; j < w; j++) {
+                next[j] &= ~seen[j];
+                seen[j] |= next[j];
+                any |= next[j] != 0;
+            }
+        }
+        if (!any) break;
+
+        for (uint32_t v = 0; v < n; v++) {
+            if (!switch_up(e, v)) continue;
+            const uint64_t *next = e->next + (size_t)v * w;
+            uint64_t found = 0;
+            for (uint32_t j = 0; j < w; j++) found |= next[j];
+            if (!found) continue;
+            // Ports towards neighbours that reached these destinations one hop earlier
+            for (uint32_t a = e->adj_start[v]; full && a < e->adj_start[v + 1]; a++) {
+                if (!port_up(e, a)) continue;
+                uint64_t *row = e->bits + (size_t)e->nbr_row[a] * words;
+                const uint64_t *f = e->frontier + (size_t)e->nbr[a] * w;
+                for (uint32_t j = 0; j < w; j++) row[j] |= next[j] & f[j];
+            }
+            for (uint32_t j = 0; j < w; j++) {
+                for (uint64_t m = next[j]; m; m &= m - 1) {
+                    uint32_t i = j * 64 + (uint32_t)__builtin_ctzll(m);
+                    if (full) e->hops[v * n + i] = (uint16_t)level;
+                    else if (set_hop(e, v, e->sources[i], (uint16_t)level) < 0) return -1;
+                }
+            }
+        }
+        uint64_t *swap = e->frontier;
+        e->frontier = e->next;
+        e->next = swap;
+    }
+
+    // Whatever was not reached is in another component; updates leave that be
+    for (uint32_t v = 0; full && v < n; v++) {
+        const uint64_t *seen = e->visited + (size_t)v * w;
+        for (uint32_t i = 0; i < count; i++) {
+            if (!(seen[i / 64] >> (i % 64) & 1)) e->hops[v * n + i] = ECMP_UNREACHABLE;
+        }
+    }
+    return 0;
+}
+
+// Connected components of the live switches
+static void label_components(struct ecmp_table *e) {
+    uint32_t n = e->switch_count, count = 0;
+
+    for (uint32_t v = 0; v < n; v++) e->component[v] = UINT32_MAX;
+    for (uint32_t s = 0; s < n; s++) {
+        if (!switch_up(e, s) || e->component[s] != UINT32_MAX) continue;
+        uint32_t head = 0, tail = 0;
+        e->component[s] = count;
+        e->queue[tail++] = s;
+        while (head < tail) {
+            uint32_t v = e->queue[head++];
+            for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+                uint32_t u = e->nbr[a];
+                if (!port_up(e, a) || e->component[u] != UINT32_MAX) continue;
+                e->component[u] = count;
+                e->queue[tail++] = u;
+            }
+        }
+        count++;
+    }
+    e->component_count = count;
+}
+
+int ecmp_init(struct ecmp_table *e, const struct topology *t, char *err, size_t err_size) {
+    uint32_t n = 0, rows = 0, entries = 0;
+
+    memset(e, 0, sizeof(*e));
+    e->t = t;
+    for (uint32_t i = 0; i < t->node_count; i++) n += t->nodes[i].role != TOPO_HOST;
+    if (n == 0 || n > 65535) {
+        snprintf(err, err_size, "Need 1 to 65535 switches, topology has %u", n);
+        return -1;
+    }
+    e->switch_count = n;
+    e->words = (n + 63) / 64;
+
+    e->switch_node = malloc(n * sizeof(*e->switch_node));
+    e->switch_of = malloc(t->node_count * sizeof(*e->switch_of));
+    e->row_of = malloc((t->link_count + 1) * sizeof(*e->row_of));
+    e->adj_start = calloc(n + 1, sizeof(*e->adj_start));
+    e->link_up = malloc(t->link_count + 1);
+    e->node_up = malloc(t->node_count);
+    e->failed_in = calloc(t->link_count + 1, sizeof(*e->failed_in));
+    if (!e->switch_node || !e->switch_of || !e->row_of || !e->adj_start || !e->link_up || !e->node_up ||
+        !e->failed_in) {
+        goto oom;
+    }
+    memset(e->link_up, 1, t->link_count + 1);
+    memset(e->node_up, 1, t->node_count);
+    for (uint32_t i = 0, v = 0; i < t->node_count; i++) {
+        e->switch_of[i] = UINT32_MAX;
+        if (t->nodes[i].role == TOPO_HOST) continue;
+        e->switch_node[v] = i;
+        e->switch_of[i] = v++;
+    }
+    for (uint32_t l = 0; l < t->link_count; l++) {
+        uint32_t a = e->switch_of[t->links[l].a], b = e->switch_of[t->links[l].b];
+        e->row_of[l] = UINT32_MAX;
+        if (a == UINT32_MAX || b == UINT32_MAX) continue;
+        e->row_of[l] = rows;
+        rows += 2;
+        e->adj_start[a + 1]++;
+        e->adj_start[b + 1]++;
+        entries += 2;
+    }
+    for (uint32_t v = 0; v < n; v++) e->adj_start[v + 1] += e->adj_start[v];
+
+    e->nbr = malloc((entries + 1) * sizeof(*e->nbr));
+    e->nbr_port = malloc((entries + 1) * sizeof(*e->nbr_port));
+    e->nbr_row = malloc((entries + 1) * sizeof(*e->nbr_row));
+    e->bits = calloc((size_t)rows * e->words + 1, sizeof(*e->bits));
+    e->hops = malloc((size_t)n * n * sizeof(*e->hops));
+    e->visited = malloc((size_t)n * e->words * sizeof(*e->visited));
+    e->frontier = malloc((size_t)n * e->words * sizeof(*e->frontier));
+    e->next = malloc((size_t)n * e->words * sizeof(*e->next));
+    e->redo = malloc(e->words * sizeof(*e->redo));
+    e->component = malloc(n * sizeof(*e->component));
+    e->first_component = malloc(n * sizeof(*e->first_component));
+    e->sources = malloc(n * sizeof(*e->sources));
+    e->queue = malloc(n * sizeof(*e->queue));
+    e->stamp = calloc(n, sizeof(*e->stamp));
+    if (!e->nbr || !e->nbr_port || !e->nbr_row || !e->bits || !e->hops || !e->visited || !e->frontier ||
+        !e->next || !e->redo || !e->component || !e->first_component || !e->sources || !e->queue || !e->stamp) {
+        goto oom;
+    }
+
+    // Switch neighbours in topology order
+    for (uint32_t v = 0, k = 0; v < n; v++) {
+        uint32_t node = e->switch_node[v];
+        for (uint32_t a = t->adj_start[node]; a < t->adj_start[node + 1]; a++) {
+            uint32_t u = e->switch_of[t->adj[a].node], port = t->adj[a].port;
+            if (u == UINT32_MAX) continue;
+            e->nbr[k] = u;
+            e->nbr_port[k] = port;
+            e->nbr_row[k++] = e->row_of[port >> 1] + (port & 1);
+        }
+    }
+
+    for (uint32_t v = 0; v < n; v++) e->sources[v] = v;
+    spread(e, n, 1);
+    label_components(e);
+    memcpy(e->first_component, e->component, n * sizeof(*e->component));
+    e->first_component_count = e->component_count;
+    return 0;
+
+oom:
+    ecmp_free(e);
+    snprintf(err, err_size, "out of memory");
+    return -1;
+}
+
+static int take_link(struct ecmp_table *e, uint32_t l) {
+    if (!e->link_up[l]) return 0;
+    e->failed_in[l] = e->epoch;
+    uint32_t *failed = grow(e->failed_links, &e->failed_link_cap, e->failed_link_count + 1, sizeof(*failed));
+    if (!failed) return -1;
+    e->failed_links = failed;
+    e->failed_links[e->failed_link_count++] = l;
+    e->link_up[l] = 0;
+    return 0;
+}
+
+// Switches at the links failed from `first` on, once each, into e->sources
+static uint32_t touched_switches(struct ecmp_table *e, uint32_t first) {
+    const struct topology *t = e->t;
+    uint32_t count = 0;
+
+    for (uint32_t i = first; i < e->failed_link_count; i++) {
+        uint32_t l = e->failed_links[i];
+        if (e->row_of[l] == UINT32_MAX) continue;
+        uint32_t ends[2] = {e->switch_of[t->links[l].a], e->switch_of[t->links[l].b]};
+        for (int k = 0; k < 2; k++) {
+            uint32_t v = ends[k];
+            if (!switch_up(e, v) || e->stamp[v] == e->epoch) continue;
+            e->stamp[v] = e->epoch;
+            e->sources[count++] = v;
+        }
+    }
+    return count;
+}
+
+int ecmp_fail(struct ecmp_table *e, const uint32_t *links, uint32_t link_count, const uint32_t *nodes,
+              uint32_t node_count) {
+    const struct topology *t = e->t;
+    uint32_t n = e->switch_count, words = e->words, first_link = e->failed_link_count;
+    size_t words_before = e->word_log_len;
+
+    e->changed_len = 0;
+    e->epoch++;
+    for (uint32_t i = 0; i < node_count; i++) {
+        uint32_t node = nodes[i];
+        if (!e->node_up[node]) continue;
+        uint32_t *failed = grow(e->failed_nodes, &e->failed_node_cap, e->failed_node_count + 1, sizeof(*failed));
+        if (!failed) return -1;
+        e->failed_nodes = failed;
+        e->failed_nodes[e->failed_node_count++] = node;
+        e->node_up[node] = 0;
+        for (uint32_t a = t->adj_start[node]; a < t->adj_start[node + 1]; a++) {
+            if (take_link(e, t->adj[a].port >> 1) < 0) return -1;
+        }
+    }
+    for (uint32_t i = 0; i < link_count; i++) {
+        if (take_link(e, links[i]) < 0) return -1;
+    }
+    label_components(e);
+
+    /* A destination in the same component needs a new BFS when a switch
+     * has lost every port of its group towards it: set in a port failed
+     * now, in none of the ports it has left. */
+    uint32_t touched = touched_switches(e, first_link);
+    uint64_t *lost = e->next, *kept = e->next + words;
+    memset(e->redo, 0, words * sizeof(*e->redo));
+    for (uint32_t i = 0; i < touched; i++) {
+        uint32_t v = e->sources[i];
+        memset(lost, 0, 2 * words * sizeof(*lost));
+        for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+            int up = port_up(e, a);
+            if (!up && e->failed_in[e->nbr_port[a] >> 1] != e->epoch) continue;
+            const uint64_t *row = e->bits + (size_t)e->nbr_row[a] * words;
+            uint64_t *into = up ? kept : lost;
+            for (uint32_t j = 0; j < words; j++) into[j] |= row[j];
+        }
+        for (uint32_t j = 0; j < words; j++) {
+            for (uint64_t m = lost[j] & ~kept[j]; m; m &= m - 1) {
+                uint32_t d = j * 64 + (uint32_t)__builtin_ctzll(m);
+                if (e->component[d] == e->component[v]) e->redo[j] |= 1ull << (d % 64);
+            }
+        }
+    }
+
+    uint32_t count = 0;
+    for (uint32_t j = 0; j < words; j++) {
+        for (uint64_t m = e->redo[j]; m; m &= m - 1) e->sources[count++] = j * 64 + (uint32_t)__builtin_ctzll(m);
+    }
+    if (count && spread(e, count, 0) < 0) return -1;
+
+    // Group membership of the ports around every changed hop count
+    for (size_t c = 0; c < e->changed_len; c += 2) {
+        uint32_t v = e->changed[c], d = e->changed[c + 1], hv = e->hops[v * n + d];
+        for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+            if (!port_up(e, a)) continue;
+            uint32_t hu = e->hops[e->nbr[a] * n + d];
+            if (set_bit(e, e->nbr_row[a], d, hu + 1 == hv) < 0 || set_bit(e, e->nbr_row[a] ^ 1, d, hv + 1 == hu) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    e->last_destinations = count;
+    e->last_hops_changed = e->changed_len / 2;
+    e->last_words_changed = e->word_log_len - words_before;
+    return (int)count;
+}
+
+void ecmp_restore(struct ecmp_table *e) {
+    for (size_t i = e->word_log_len; i-- > 0;) e->bits[e->word_log[i].at] = e->word_log[i].old;
+    for (size_t i = e->hop_log_len; i-- > 0;) e->hops[e->hop_log[i].at] = e->hop_log[i].old;
+    for (uint32_t i = 0; i < e->failed_link_count; i++) e->link_up[e->failed_links[i]] = 1;
+    for (uint32_t i = 0; i < e->failed_node_count; i++) e->node_up[e->failed_nodes[i]] = 1;
+    memcpy(e->component, e->first_component, e->switch_count * sizeof(*e->component));
+    e->component_count = e->first_component_count;
+    e->word_log_len = e->hop_log_len = 0;
+    e->failed_link_count = e->failed_node_count = 0;
+}
+
+uint32_t ecmp_group(const struct ecmp_table *e, uint32_t node, uint32_t dst, uint32_t *ports, uint32_t max) {
+    const struct topology *t = e->t;
+    uint32_t v = e->switch_of[node], target = dst, count = 0;
+
+    if (t->nodes[dst].role == TOPO_HOST) {
+        if (!e->node_up[dst] || !e->link_up[topo_host_uplink(t, dst) >> 1]) return 0;
+        target = t->nodes[dst].uplink;
+        if (target == node) {
+            if (max) ports[0] = topo_host_downlink(t, dst);
+            return e->node_up[node];
+        }
+    }
+    if (v == UINT32_MAX || !e->node_up[node] || target == node) return 0;
+    uint32_t d = e->switch_of[target];
+    if (e->component[d] != e->component[v]) return 0;
+    for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+        if (!port_up(e, a) || !(e->bits[(size_t)e->nbr_row[a] * e->words + d / 64] >> (d % 64) & 1)) continue;
+        if (count < max) ports[count] = e->nbr_port[a];
+        count++;
+    }
+    return count;
+}
+
+// Switch number a host hangs off, or UINT32_MAX if it is cut off
+static uint32_t live_switch(const struct ecmp_table *e, uint32_t host) {
+    const struct topology *t = e->t;
+    uint32_t sw = t->nodes[host].uplink;
+    if (!e->node_up[host] || !e->link_up[topo_host_uplink(t, host) >> 1] || !e->node_up[sw]) return UINT32_MAX;
+    return e->switch_of[sw];
+}
+
+uint64_t ecmp_unreachable(struct ecmp_table *e) {
+    const struct topology *t = e->t;
+    uint64_t hosts = t->host_count, reachable = 0;
+    uint32_t *attached = e->queue;     // per component
+
+    memset(attached, 0, e->switch_count * sizeof(*attached));
+    for (uint32_t i = 0; i < t->node_count; i++) {
+        if (t->nodes[i].role != TOPO_HOST) continue;
+        uint32_t v = live_switch(e, i);
+        if (v != UINT32_MAX) attached[e->component[v]]++;
+    }
+    for (uint32_t c = 0; c < e->switch_count; c++) reachable += (uint64_t)attached[c] * (attached[c] - 1) / 2;
+    return hosts * (hosts - 1) / 2 - reachable;
+}
+
+/* Max flow (Dinic) between the two host halves: a source feeding each
+ * switch with its hosts' links on one side, a sink draining those on the
+ * other, and the ports in a group towards a switch on the sink side. */
+struct flow_net {
+    uint32_t source, sink, edges;
+    uint32_t *head, *iter, *level, *queue;
+    uint32_t *next_edge, *to;
+    double *cap;
+    double *host_gbps[2];      // per switch, links of the hosts of each half
+    uint64_t *mask[2];         // switches with hosts of each half
+    uint8_t *towards;          // per bitset row: bit h if in a group towards half h
+};
+
+static void add_edge(struct flow_net *g, uint32_t from, uint32_t to, double cap) {
+    uint32_t k = g->edges;
+    g->to[k] = to;
+    g->cap[k] = cap;
+    g->next_edge[k] = g->head[from];
+    g->head[from] = k;
+    g->to[k + 1] = from;
+    g->cap[k + 1] = 0;
+    g->next_edge[k + 1] = g->head[to];
+    g->head[to] = k + 1;
+    g->edges += 2;
+}
+
+// Sends up to `limit` from v towards the sink along the level graph, over as many paths as it takes
+static double augment(struct flow_net *g, uint32_t v, double limit) {
+    if (v == g->sink) return limit;
+    double sent = 0;
+    for (; g->iter[v] != UINT32_MAX; g->iter[v] = g->next_edge[g->iter[v]]) {
+        uint32_t k = g->iter[v], u = g->to[k];
+        if (g->cap[k] <= EPS || g->level[u] != g->level[v] + 1) continue;
+        double pushed = augment(g, u, fmin(limit - sent, g->cap[k]));
+        g->cap[k] -= pushed;
+        g->cap[k ^ 1] += pushed;
+        sent += pushed;
+        if (limit - sent <= EPS) return sent;
+    }
+    return sent;
+}
+
+static double max_flow(struct flow_net *g, uint32_t nodes) {
+    double total = 0;
+    for (;;) {
+        uint32_t head = 0, tail = 0;
+        for (uint32_t v = 0; v < nodes; v++) g->level[v] = UINT32_MAX;
+        g->level[g->source] = 0;
+        g->queue[tail++] = g->source;
+        while (head < tail) {
+            uint32_t v = g->queue[head++];
+            for (uint32_t k = g->head[v]; k != UINT32_MAX; k = g->next_edge[k]) {
+                if (g->cap[k] <= EPS || g->level[g->to[k]] != UINT32_MAX) continue;
+                g->level[g->to[k]] = g->level[v] + 1;
+                g->queue[tail++] = g->to[k];
+            }
+        }
+        if (g->level[g->sink] == UINT32_MAX) return total;
+        memcpy(g->iter, g->head, nodes * sizeof(*g->iter));
+        double pushed = augment(g, g->source, INFINITY);
+        if (pushed <= EPS) return total;
+        total += pushed;
+    }
+}
+
+// Whether any destination of `bits` is in v's component
+static int in_component(const struct ecmp_table *e, uint32_t v, const uint64_t *row, const uint64_t *mask,
+                        uint32_t first, uint32_t last) {
+    for (uint32_t j = first; j <= last; j++) {
+        for (uint64_t m = row[j] & mask[j]; m; m &= m - 1) {
+            if (e->component[j * 64 + __builtin_ctzll(m)] == e->component[v]) return 1;
+        }
+    }
+    return 0;
+}
+
+/* Which half each port leads towards, in one pass over the bits in
+ * memory order: the rows are most of the table. */
+static void classify_ports(const struct ecmp_table *e, struct flow_net *g) {
+    const struct topology *t = e->t;
+    uint32_t words = e->words, first = 0, last = 0;
+
+    while (first < words - 1 && !(g->mask[0][first] | g->mask[1][first])) first++;
+    for (uint32_t j = first; j < words; j++) {
+        if (g->mask[0][j] | g->mask[1][j]) last = j;
+    }
+    for (uint32_t l = 0; l < t->link_count; l++) {
+        if (e->row_of[l] == UINT32_MAX) continue;
+        for (uint32_t r = e->row_of[l], end = r + 2; r < end; r++) {
+            uint32_t v = e->switch_of[r & 1 ? t->links[l].b : t->links[l].a];
+            g->towards[r] = 0;
+            if (!e->link_up[l] || !switch_up(e, v)) continue;
+            const uint64_t *row = e->bits + (size_t)r * words;
+            uint64_t any[2] = {0, 0};
+            for (uint32_t j = first; j <= last; j++) {
+                any[0] |= row[j] & g->mask[0][j];
+                any[1] |= row[j] & g->mask[1][j];
+            }
+            for (int h = 0; h < 2; h++) {
+                // Bits towards other components are left over from before a partition
+                if (any[h] && (e->component_count == 1 || in_component(e, v, row, g->mask[h], first, last))) {
+                    g->towards[r] |= 1 << h;
+                }
+            }
+        }
+    }
+}
+
+static double one_way(const struct ecmp_table *e, struct flow_net *g, int from) {
+    uint32_t n = e->switch_count, to = 1 - from;
+
+    g->source = n;
+    g->sink = n + 1;
+    g->edges = 0;
+    for (uint32_t v = 0; v < n + 2; v++) g->head[v] = UINT32_MAX;
+    for (uint32_t v = 0; v < n; v++) {
+        if (g->host_gbps[from][v] > 0) add_edge(g, g->source, v, g->host_gbps[from][v]);
+        if (g->host_gbps[to][v] > 0) add_edge(g, v, g->sink, g->host_gbps[to][v]);
+        for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+            if (g->towards[e->nbr_row[a]] >> to & 1) add_edge(g, v, e->nbr[a], e->t->links[e->nbr_port[a] >> 1].gbps);
+        }
+    }
+    return max_flow(g, n + 2);
+}
+
+double ecmp_bisection(const struct ecmp_table *e) {
+    const struct topology *t = e->t;
+    uint32_t n = e->switch_count, nodes = n + 2, half = t->host_count / 2;
+    size_t edges = 2 * ((size_t)e->adj_start[n] + 2 * n);
+    struct flow_net g;
+
+    if (t->host_count < 2) return 0;
+    g.head = malloc(nodes * sizeof(*g.head));
+    g.iter = malloc(nodes * sizeof(*g.iter));
+    g.level = malloc(nodes * sizeof(*g.level));
+    g.queue = malloc(nodes * sizeof(*g.queue));
+    g.next_edge = malloc(edges * sizeof(*g.next_edge));
+    g.to = malloc(edges * sizeof(*g.to));
+    g.cap = malloc(edges * sizeof(*g.cap));
+    g.host_gbps[0] = calloc(2 * (size_t)n, sizeof(*g.host_gbps[0]));
+    g.host_gbps[1] = g.host_gbps[0] ? g.host_gbps[0] + n : NULL;
+    g.mask[0] = calloc(2 * (size_t)e->words, sizeof(*g.mask[0]));
+    g.mask[1] = g.mask[0] ? g.mask[0] + e->words : NULL;
+    g.towards = malloc(e->adj_start[n] + 1);
+    double gbps = -1;
+    if (g.head && g.iter && g.level && g.queue && g.next_edge && g.to && g.cap && g.host_gbps[0] && g.mask[0] &&
+        g.towards) {
+        for (uint32_t i = 0; i < t->node_count; i++) {
+            if (t->nodes[i].role != TOPO_HOST) continue;
+            uint32_t v = live_switch(e, i), h = t->nodes[i].index >= half;
+            if (v == UINT32_MAX) continue;
+            g.host_gbps[h][v] += t->links[topo_host_uplink(t, i) >> 1].gbps;
+            g.mask[h][v / 64] |= 1ull << (v % 64);
+        }
+        classify_ports(e, &g);
+        gbps = fmin(one_way(e, &g, 0), one_way(e, &g, 1));
+    }
+    free(g.head);
+    free(g.iter);
+    free(g.level);
+    free(g.queue);
+    free(g.next_edge);
+    free(g.to);
+    free(g.cap);
+    free(g.host_gbps[0]);
+    free(g.mask[0]);
+    free(g.towards);
+    return gbps;
+}
+
+void ecmp_free(struct ecmp_table *e) {
+    free(e->switch_node);
+    free(e->switch_of);
+    free(e->row_of);
+    free(e->adj_start);
+    free(e->nbr);
+    free(e->nbr_port);
+    free(e->nbr_row);
+    free(e->bits);
+    free(e->hops);
+    free(e->component);
+    free(e->first_component);
+    free(e->link_up);
+    free(e->node_up);
+    free(e->failed_in);
+    free(e->failed_links);
+    free(e->failed_nodes);
+    free(e->word_log);
+    free(e->hop_log);
+    free(e->visited);
+    free(e->frontier);
+    free(e->next);
+    free(e->redo);
+    free(e->sources);
+    free(e->queue);
+    free(e->stamp);
+    free(e->changed);
+    memset(e, 0, sizeof(*e));
+}
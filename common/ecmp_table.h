@@ -0,0 +1,145 @@
+#ifndef ECMP_TABLE_H
+#define ECMP_TABLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "topology.h"
+
+/**
+ * All-pairs ECMP next-hop groups between the switches of a topology, kept
+ * current as links and switches fail.
+ *
+ * The table is stored transposed. Each directed switch-to-switch port has
+ * a bitset over the destination switches: bit d is set when the port
+ * leads one hop closer to d, so it is in the sending switch's ECMP group
+ * towards d. A hop-count matrix sits next to it. Hosts are reached
+ * through their uplink switch. The bitsets take links * switches / 4
+ * bytes and the hop counts 2 * switches^2 bytes, e.g. 70 MB and 9 MB for
+ * 64 spines and 2048 leaves.
+ *
+ * ecmp_init() runs a BFS from every switch at once with bitsets. At hop k,
+ * a switch's newly reached destinations are the union of its neighbours'
+ * frontiers minus those it has seen, 64 destinations per word operation.
+ * A port gets the destinations its far end reached one hop earlier.
+ *
+ * ecmp_fail() takes links and switches out incrementally. Failed ports
+ * are never read again, and switches are labelled with their connected
+ * component (failed ones with none), so a partition only relabels: hop
+ * counts and bits towards another component are left as they were and do
+ * not count. Within a component, a destination's hop counts change only if
+ * some switch loses every port of its group towards it. The switches at
+ * the failed links show this directly: the destinations set in their lost
+ * ports' bits and in none of their remaining ports' bits. The BFS is rerun
+ * from those destinations only, and the bits of ports next to switches
+ * whose hop count changed are recomputed. Every change is logged, so
+ * ecmp_restore() returns to the full topology in time proportional to the
+ * changes, ready for the next failure scenario.
+ *
+ * ecmp_bisection() gives the capacity between the two halves of the hosts
+ * (h1 .. h(H/2) and the rest, as the topology builders number them) over
+ * the ports ECMP uses. It is the max flow from one half to the other
+ * through ports that are in a group towards a switch of the other half,
+ * the smaller of the two directions. For a whole leaf-spine fabric this is
+ * the bisection of common/topo_design.h.
+ *
+ *     struct ecmp_table e;
+ *     if (ecmp_init(&e, &t, err, sizeof(err)) < 0) fprintf(stderr, "%s\n", err);
+ *     uint32_t spine = 0;
+ *     ecmp_fail(&e, NULL, 0, &spine, 1);
+ *     printf("%.0f Gbit/s\n", ecmp_bisection(&e));
+ *     ecmp_restore(&e);
+ */
+
+#define ECMP_UNREACHABLE UINT16_MAX
+
+struct ecmp_word_undo {
+    uint64_t at;               // into bits
+    uint64_t old;
+};
+
+struct ecmp_hop_undo {
+    uint32_t at;               // into hops
+    uint16_t old;
+};
+
+struct ecmp_table {
+    const struct topology *t;
+    uint32_t switch_count;
+    uint32_t words;            // per bitset: one bit per switch
+    uint32_t *switch_node;     // switch number -> node
+    uint32_t *switch_of;       // node -> switch number, UINT32_MAX for hosts
+    uint32_t *row_of;          // link -> bitset row of its port 2l (2l + 1 is the next row), UINT32_MAX for host links
+
+    // Neighbour rows over the switches only
+    uint32_t *adj_start;       // switch_count + 1 entries
+    uint32_t *nbr;             // neighbour switch
+    uint32_t *nbr_port;        // topology port towards it
+    uint32_t *nbr_row;         // bitset row of that port
+
+    uint64_t *bits;            // bitset rows, `words` each
+    uint16_t *hops;            // hops[a * switch_count + b], valid within a component
+    uint32_t *component;       // per switch, UINT32_MAX for failed ones
+    uint32_t *first_component; // as built
+    uint32_t component_count, first_component_count;
+    uint8_t *link_up, *node_up;
+    uint32_t *failed_in;       // per link: the ecmp_fail() call that took it out
+
+    // Failures since ecmp_init() and the changes they made, for ecmp_restore()
+    uint32_t *failed_links, *failed_nodes;
+    uint32_t failed_link_count, failed_node_count;
+    size_t failed_link_cap, failed_node_cap;
+    struct ecmp_word_undo *word_log;
+    size_t word_log_len, word_log_cap;
+    struct ecmp_hop_undo *hop_log;
+    size_t hop_log_len, hop_log_cap;
+
+    // Scratch: BFS bitsets, the destinations to redo, switches touched and
+    // (switch, destination) pairs whose hop count changed
+    uint64_t *visited, *frontier, *next, *redo;
+    uint32_t *sources, *queue;
+    uint32_t *stamp, epoch;
+    uint32_t *changed;
+    size_t changed_len, changed_cap;
+
+    // Size of the last ecmp_fail(), to see how much it redid
+    uint32_t last_destinations;
+    size_t last_hops_changed, last_words_changed;
+};
+
+/* Builds the table for the whole topology. Returns -1 with a message in
+ * `err` if there are more than 65535 switches or memory runs out. */
+int ecmp_init(struct ecmp_table *e, const struct topology *t, char *err, size_t err_size);
+
+/* Takes out links and nodes (a node takes its links with it), on top of
+ * earlier failures, and updates the groups and hop counts. Returns the
+ * number of destination switches whose hop counts were recomputed, or -1
+ * if memory runs out (the table is then only valid after ecmp_restore()). */
+int ecmp_fail(struct ecmp_table *e, const uint32_t *links, uint32_t link_count, const uint32_t *nodes,
+              uint32_t node_count);
+
+/* Brings back everything failed since ecmp_init(). */
+void ecmp_restore(struct ecmp_table *e);
+
+/* Ports of switch `node` in its ECMP group towards node `dst`: the
+ * neighbours one hop closer to dst's switch, or the host's own link from
+ * its switch. Writes up to `max` ports and returns how many there are (0
+ * if dst is unreachable or is the switch itself). */
+uint32_t ecmp_group(const struct ecmp_table *e, uint32_t node, uint32_t dst, uint32_t *ports, uint32_t max);
+
+/* Hops between two switch nodes, ECMP_UNREACHABLE if they are cut off. */
+static inline uint32_t ecmp_hops(const struct ecmp_table *e, uint32_t a, uint32_t b) {
+    uint32_t u = e->switch_of[a], v = e->switch_of[b];
+    if (e->component[u] == UINT32_MAX || e->component[u] != e->component[v]) return ECMP_UNREACHABLE;
+    return e->hops[(size_t)u * e->switch_count + v];
+}
+
+/* Host pairs that can no longer reach each other (a failed host, host
+ * link or switch cuts its hosts off from everyone). */
+uint64_t ecmp_unreachable(struct ecmp_table *e);
+
+/* Bisection bandwidth in Gbit/s as above, or -1 if memory runs out. */
+double ecmp_bisection(const struct ecmp_table *e);
+
+void ecmp_free(struct ecmp_table *e);
+
+#endif
@@ -0,0 +1,290 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "ecmp_table.h"
+
+/**
+ * ECMP table benchmark.
+ * First checks the table against a plain per-destination BFS on small
+ * leaf-spine fabrics and trees: the full build, then random cumulative
+ * link and switch failures (every hop count and every port's group bits),
+ * and that ecmp_restore() gets back the original table bit for bit. The
+ * bisection and unreachable host pairs are checked on cases worked out by
+ * hand.
+ *
+ * The timings build a leaf-spine fabric of 64 spines and 2048 leaves and a
+ * binary tree of 4095 switches, then fail a spine, a leaf, single links and
+ * random link sets, reporting the update, bisection and restore times.
+ *
+ * Build: gcc -O2 ecmp_table_bench.c ecmp_table.c topology.c -o ecmp_table_bench -lm
+ */
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rnd(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint32_t below(uint32_t n) {
+    return (uint32_t)(((rnd() >> 32) * n) >> 32);
+}
+
+static int bit(const struct ecmp_table *e, uint32_t row, uint32_t d) {
+    return e->bits[(size_t)row * e->words + d / 64] >> (d % 64) & 1;
+}
+
+// Hop counts and group bits in use against one BFS per destination switch
+static int check_table(const struct ecmp_table *e, const char *what) {
+    uint32_t n = e->switch_count, *dist = malloc(n * sizeof(*dist)), *queue = malloc(n * sizeof(*queue));
+    int bad = 0;
+
+    for (uint32_t d = 0; d < n && !bad; d++) {
+        for (uint32_t v = 0; v < n; v++) dist[v] = ECMP_UNREACHABLE;
+        uint32_t head = 0, tail = 0;
+        if (e->node_up[e->switch_node[d]]) {
+            dist[d] = 0;
+            queue[tail++] = d;
+        }
+        while (head < tail) {
+            uint32_t v = queue[head++];
+            for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1]; a++) {
+                uint32_t u = e->nbr[a];
+                if (!e->link_up[e->nbr_port[a] >> 1] || dist[u] != ECMP_UNREACHABLE) continue;
+                dist[u] = dist[v] + 1;
+                queue[tail++] = u;
+            }
+        }
+        for (uint32_t v = 0; v < n && !bad; v++) {
+            uint32_t hops = ecmp_hops(e, e->switch_node[v], e->switch_node[d]);
+            if (hops != dist[v]) {
+                printf("%s: %u hops from switch %u to %u, BFS says %u\n", what, hops, v, d, dist[v]);
+                bad = 1;
+            }
+            // Failed ports and destinations in another component are not read
+            if (hops == ECMP_UNREACHABLE) continue;
+            for (uint32_t a = e->adj_start[v]; a < e->adj_start[v + 1] && !bad; a++) {
+                uint32_t u = e->nbr[a];
+                if (!e->link_up[e->nbr_port[a] >> 1]) continue;
+                int want = dist[u] + 1 == dist[v];
+                if (bit(e, e->nbr_row[a], d) != want) {
+                    printf("%s: port %u of switch %u %s the group towards %u\n", what, e->nbr_port[a], v,
+                           want ? "missing from" : "wrongly in", d);
+                    bad = 1;
+                }
+            }
+        }
+    }
+    free(dist);
+    free(queue);
+    return bad;
+}
+
+static uint64_t *copy_bits(const struct ecmp_table *e, size_t *words) {
+    *words = (size_t)e->adj_start[e->switch_count] * e->words;
+    uint64_t *bits = malloc(*words * sizeof(*bits));
+    memcpy(bits, e->bits, *words * sizeof(*bits));
+    return bits;
+}
+
+// Random failure rounds on top of each other, then a restore, a few times over
+static int check_failures(const struct topology *t, const char *name, int scenarios) {
+    struct ecmp_table e;
+    char err[128], what[96];
+    size_t words;
+
+    if (ecmp_init(&e, t, err, sizeof(err)) < 0) {
+        printf("%s: %s\n", name, err);
+        return 1;
+    }
+    snprintf(what, sizeof(what), "%s, full build", name);
+    int bad = check_table(&e, what);
+    uint64_t *bits = copy_bits(&e, &words);
+    size_t hop_bytes = (size_t)e.switch_count * e.switch_count * sizeof(*e.hops);
+    uint16_t *hops = malloc(hop_bytes);
+    memcpy(hops, e.hops, hop_bytes);
+
+    for (int s = 0; s < scenarios && !bad; s++) {
+        for (int round = 0; round < 3 && !bad; round++) {
+            uint32_t links[8], nodes[2], link_count = 1 + below(4), node_count = below(4) == 0;
+            for (uint32_t i = 0; i < link_count; i++) links[i] = below(t->link_count);
+            for (uint32_t i = 0; i < node_count; i++) nodes[i] = below(t->node_count);
+            if (ecmp_fail(&e, links, link_count, nodes, node_count) < 0) {
+                printf("%s: out of memory\n", name);
+                bad = 1;
+                break;
+            }
+            snprintf(what, sizeof(what), "%s, scenario %d round %d", name, s, round);
+            bad = check_table(&e, what);
+        }
+        ecmp_restore(&e);
+        if (!bad && (memcmp(bits, e.bits, words * sizeof(*bits)) || memcmp(hops, e.hops, hop_bytes))) {
+            printf("%s, scenario %d: restore left a different table\n", name, s);
+            bad = 1;
+        }
+    }
+    free(bits);
+    free(hops);
+    ecmp_free(&e);
+    return bad;
+}
+
+static int expect(const char *what, double got, double want) {
+    if (fabs(got - want) < 1e-6) return 0;
+    printf("%s: %g, expected %g\n", what, got, want);
+    return 1;
+}
+
+static int check_capacity(void) {
+    struct topology t;
+    struct ecmp_table e;
+    char err[128];
+    int bad = 0;
+
+    // 8 leaves of 14 hosts on one spine: 4 leaf uplinks of 10 Gbit/s carry less than 56 hosts
+    topo_leaf_spine(&t, 1, 8, 14, 16, err, sizeof(err));
+    ecmp_init(&e, &t, err, sizeof(err));
+    bad |= expect("1x8 leaf-spine bisection", ecmp_bisection(&e), 40);
+    uint32_t link = 0;                 // spine1 - leaf1
+    ecmp_fail(&e, &link, 1, NULL, 0);
+    bad |= expect("1x8 leaf-spine bisection without leaf1's uplink", ecmp_bisection(&e), 30);
+    bad |= expect("1x8 leaf-spine unreachable pairs without leaf1's uplink", (double)ecmp_unreachable(&e), 14 * 98);
+    ecmp_restore(&e);
+    bad |= expect("1x8 leaf-spine unreachable pairs", (double)ecmp_unreachable(&e), 0);
+    ecmp_free(&e);
+    topo_free(&t);
+
+    // 2 spines, 4 leaves of 8 hosts: 16 hosts a side, 40 Gbit/s of uplinks
+    topo_leaf_spine(&t, 2, 4, 8, 16, err, sizeof(err));
+    ecmp_init(&e, &t, err, sizeof(err));
+    bad |= expect("2x4 leaf-spine bisection", ecmp_bisection(&e), 16);
+    uint32_t spine = 0;
+    ecmp_fail(&e, NULL, 0, &spine, 1);
+    bad |= expect("2x4 leaf-spine bisection without spine1", ecmp_bisection(&e), 16);
+    uint32_t leaf = 2;
+    ecmp_fail(&e, NULL, 0, &leaf, 1);
+    bad |= expect("2x4 leaf-spine bisection without spine1 and leaf1", ecmp_bisection(&e), 8);
+    uint32_t ports[4];
+    uint32_t h9 = t.node_count - t.host_count + 8;
+    bad |= expect("2x4 leaf-spine group from leaf3 to h9 without spine1", ecmp_group(&e, 4, h9, ports, 4), 1);
+    // spine2 - leaf3 is link 6, leaf3 towards spine2 its port 13
+    bad |= expect("  and its port", ports[0], 2 * 6 + 1);
+    ecmp_free(&e);
+    topo_free(&t);
+
+    // Tree of 4 bottom switches with 2 hosts each: the halves meet at s1 over 1 Gbit/s
+    topo_binary_tree(&t, 3, 2, err, sizeof(err));
+    ecmp_init(&e, &t, err, sizeof(err));
+    bad |= expect("depth 3 tree bisection", ecmp_bisection(&e), 1);
+    uint32_t s2 = 1;
+    ecmp_fail(&e, NULL, 0, &s2, 1);
+    bad |= expect("depth 3 tree bisection without s2", ecmp_bisection(&e), 0);
+    bad |= expect("depth 3 tree unreachable pairs without s2", (double)ecmp_unreachable(&e), 4 * 4 + 2 * 2);
+    ecmp_free(&e);
+    topo_free(&t);
+    return bad;
+}
+
+static int check(void) {
+    struct topology t;
+    char err[128];
+    int bad = check_capacity();
+
+    int shapes[][4] = {{4, 8, 2, 16}, {3, 5, 1, 16}, {1, 6, 1, 8}, {8, 12, 1, 32}};
+    for (int i = 0; i < 4 && !bad; i++) {
+        char name[64];
+        topo_leaf_spine(&t, shapes[i][0], shapes[i][1], shapes[i][2], shapes[i][3], err, sizeof(err));
+        snprintf(name, sizeof(name), "%dx%d leaf-spine", shapes[i][0], shapes[i][1]);
+        bad = check_failures(&t, name, 200);
+        topo_free(&t);
+    }
+    for (int depth = 2; depth <= 6 && !bad; depth++) {
+        char name[64];
+        topo_binary_tree(&t, depth, 1, err, sizeof(err));
+        snprintf(name, sizeof(name), "depth %d tree", depth);
+        bad = check_failures(&t, name, 200);
+        topo_free(&t);
+    }
+    printf("Check against per-destination BFS: %s\n", bad ? "FAILED" : "same hop counts and groups");
+    return bad;
+}
+
+static void scenario(struct ecmp_table *e, const char *what, const uint32_t *links, uint32_t link_count,
+                     const uint32_t *nodes, uint32_t node_count, double full) {
+    double t0 = now_sec();
+    int redone = ecmp_fail(e, links, link_count, nodes, node_count);
+    double failed = now_sec() - t0;
+    t0 = now_sec();
+    double gbps = ecmp_bisection(e);
+    double cut = now_sec() - t0;
+    t0 = now_sec();
+    ecmp_restore(e);
+    double restored = now_sec() - t0;
+    printf("  %-22s %8.2f ms update (%d destinations redone, %zu words changed), bisection %.0f Gbit/s "
+           "(%.1f%%) in %.1f ms, restore %.2f ms\n", what, failed * 1e3, redone, e->last_words_changed, gbps,
+           100 * gbps / full, cut * 1e3, restored * 1e3);
+}
+
+static void bench(const struct topology *t, const char *name) {
+    struct ecmp_table e;
+    char err[128];
+
+    double t0 = now_sec();
+    if (ecmp_init(&e, t, err, sizeof(err)) < 0) {
+        printf("%s: %s\n", name, err);
+        return;
+    }
+    double built = now_sec() - t0;
+    t0 = now_sec();
+    double full = ecmp_bisection(&e);
+    double cut = now_sec() - t0;
+    size_t bytes = (size_t)e.adj_start[e.switch_count] * e.words * 8 + (size_t)e.switch_count * e.switch_count * 2;
+    printf("%s: %u switches, %u switch links: built in %.1f ms (%.0f MB), bisection %.0f Gbit/s in %.1f ms\n", name,
+           e.switch_count, e.adj_start[e.switch_count] / 2, built * 1e3, bytes / 1e6, full, cut * 1e3);
+
+    uint32_t first = e.switch_node[0], middle = e.switch_node[e.switch_count / 2];
+    char what[64];
+    topo_node_name(t, first, what, sizeof(what));
+    scenario(&e, what, NULL, 0, &first, 1, full);
+    topo_node_name(t, middle, what, sizeof(what));
+    scenario(&e, what, NULL, 0, &middle, 1, full);
+
+    // Switch-to-switch links at random
+    uint32_t links[16];
+    for (int k = 1; k <= 16; k *= 4) {
+        for (int i = 0; i < k; i++) {
+            do links[i] = below(t->link_count);
+            while (e.row_of[links[i]] == UINT32_MAX);
+        }
+        snprintf(what, sizeof(what), "%d random link%s", k, k > 1 ? "s" : "");
+        scenario(&e, what, links, k, NULL, 0, full);
+    }
+    ecmp_free(&e);
+}
+
+int main(void) {
+    struct topology t;
+    char err[128];
+
+    if (check()) return 1;
+    printf("\n");
+    if (topo_leaf_spine(&t, 64, 2048, 8, 4096, err, sizeof(err)) == 0) {
+        bench(&t, "Leaf-spine 64x2048");
+        topo_free(&t);
+    }
+    if (topo_binary_tree(&t, 12, 1, err, sizeof(err)) == 0) {
+        bench(&t, "Binary tree depth 12");
+        topo_free(&t);
+    }
+    return 0;
+}
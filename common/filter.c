@@ -0,0 +1,594 @@
+#include "filter.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#define MAX_NODES 256
+
+enum op { OP_LD, OP_TEST, OP_CMP, OP_NET, OP_NOT, OP_JZ, OP_JNZ, OP_RET };
+static const char *op_names[] = {"ld", "test", "cmp", "net", "not", "jz", "jnz", "ret"};
+
+enum cmp { CMP_EQ, CMP_NE, CMP_LT, CMP_LE, CMP_GT, CMP_GE };
+static const char *cmp_names[] = {"==", "!=", "<", "<=", ">", ">="};
+
+enum field {
+    F_FRAME_LEN, F_FRAME_CAPLEN,   // need no dissection
+    F_ETH_TYPE, F_VLAN_ID,
+    F_IP_PROTO, F_IP_TTL, F_IP_LEN, F_IPV6_NXT, F_IPV6_HLIM, F_IPV6_PLEN,
+    F_TCP_SRCPORT, F_TCP_DSTPORT, F_TCP_SEQ, F_TCP_ACK, F_TCP_FLAGS,
+    F_TCP_FIN, F_TCP_SYN, F_TCP_RST, F_TCP_PUSH, F_TCP_ACKFLAG, F_TCP_URG, F_TCP_LEN,
+    F_UDP_SRCPORT, F_UDP_DSTPORT, F_UDP_LEN,
+    F_ICMP_TYPE, F_ICMP_CODE, F_ICMP_IDENT, F_ICMP_SEQ, F_ICMPV6_TYPE, F_ICMPV6_CODE,
+    F_ARP_OPCODE,
+    F_ADDR,                        // address fields, matched with OP_NET
+};
+
+enum sel { SEL_SRC, SEL_DST, SEL_EITHER };
+
+static const struct field_def {
+    const char *name;
+    uint8_t field;
+    uint8_t either;     // field for the other direction, if this is an "either" field
+    uint8_t sel;        // address fields: which address
+    uint8_t addr_len;   // address fields: 4 or 16
+    uint32_t layers;
+} fields[] = {
+    {"frame.len", F_FRAME_LEN, 0, 0, 0, 0},
+    {"frame.cap_len", F_FRAME_CAPLEN, 0, 0, 0, 0},
+    {"eth.type", F_ETH_TYPE, 0, 0, 0, DISSECT_ETH},
+    {"vlan.id", F_VLAN_ID, 0, 0, 0, DISSECT_VLAN},
+    {"ip.src", F_ADDR, 0, SEL_SRC, 4, DISSECT_IPV4},
+    {"ip.dst", F_ADDR, 0, SEL_DST, 4, DISSECT_IPV4},
+    {"ip.addr", F_ADDR, 0, SEL_EITHER, 4, DISSECT_IPV4},
+    {"ip.proto", F_IP_PROTO, 0, 0, 0, DISSECT_IPV4},
+    {"ip.ttl", F_IP_TTL, 0, 0, 0, DISSECT_IPV4},
+    {"ip.len", F_IP_LEN, 0, 0, 0, DISSECT_IPV4},
+    {"ipv6.src", F_ADDR, 0, SEL_SRC, 16, DISSECT_IPV6},
+    {"ipv6.dst", F_ADDR, 0, SEL_DST, 16, DISSECT_IPV6},
+    {"ipv6.addr", F_ADDR, 0, SEL_EITHER, 16, DISSECT_IPV6},
+    {"ipv6.nxt", F_IPV6_NXT, 0, 0, 0, DISSECT_IPV6},
+    {"ipv6.hlim", F_IPV6_HLIM, 0, 0, 0, DISSECT_IPV6},
+    {"ipv6.plen", F_IPV6_PLEN, 0, 0, 0, DISSECT_IPV6},
+    {"tcp.srcport", F_TCP_SRCPORT, 0, 0, 0, DISSECT_TCP},
+    {"tcp.dstport", F_TCP_DSTPORT, 0, 0, 0, DISSECT_TCP},
+    {"tcp.port", F_TCP_SRCPORT, F_TCP_DSTPORT, 0, 0, DISSECT_TCP},
+    {"tcp.seq", F_TCP_SEQ, 0, 0, 0, DISSECT_TCP},
+    {"tcp.ack", F_TCP_ACK, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags", F_TCP_FLAGS, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.fin", F_TCP_FIN, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.syn", F_TCP_SYN, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.reset", F_TCP_RST, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.push", F_TCP_PUSH, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.ack", F_TCP_ACKFLAG, 0, 0, 0, DISSECT_TCP},
+    {"tcp.flags.urg", F_TCP_URG, 0, 0, 0, DISSECT_TCP},
+    {"tcp.len", F_TCP_LEN, 0, 0, 0, DISSECT_TCP},
+    {"udp.srcport", F_UDP_SRCPORT, 0, 0, 0, DISSECT_UDP},
+    {"udp.dstport", F_UDP_DSTPORT, 0, 0, 0, DISSECT_UDP},
+    {"udp.port", F_UDP_SRCPORT, F_UDP_DSTPORT, 0, 0, DISSECT_UDP},
+    {"udp.len", F_UDP_LEN, 0, 0, 0, DISSECT_UDP},
+    {"icmp.type", F_ICMP_TYPE, 0, 0, 0, DISSECT_ICMP},
+    {"icmp.code", F_ICMP_CODE, 0, 0, 0, DISSECT_ICMP},
+    {"icmp.ident", F_ICMP_IDENT, 0, 0, 0, DISSECT_ICMP},
+    {"icmp.seq", F_ICMP_SEQ, 0, 0, 0, DISSECT_ICMP},
+    {"icmpv6.type", F_ICMPV6_TYPE, 0, 0, 0, DISSECT_ICMPV6},
+    {"icmpv6.code", F_ICMPV6_CODE, 0, 0, 0, DISSECT_ICMPV6},
+    {"arp.opcode", F_ARP_OPCODE, 0, 0, 0, DISSECT_ARP},
+};
+
+static const struct {
+    const char *name;
+    uint32_t layers;
+} protocols[] = {
+    {"eth", DISSECT_ETH}, {"vlan", DISSECT_VLAN}, {"sll", DISSECT_SLL}, {"arp", DISSECT_ARP},
+    {"ip", DISSECT_IPV4}, {"ipv6", DISSECT_IPV6}, {"tcp", DISSECT_TCP}, {"udp", DISSECT_UDP},
+    {"icmp", DISSECT_ICMP}, {"icmpv6", DISSECT_ICMPV6}, {"frag", DISSECT_FRAGMENT},
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/* Parse tree; leaves are protocol tests, numeric comparisons and address matches */
+enum node_kind { N_AND, N_OR, N_NOT, N_TEST, N_CMP, N_NET };
+
+struct node {
+    uint8_t kind;
+    uint8_t field;
+    uint8_t cmp;
+    uint8_t sel;
+    uint32_t layers;
+    uint64_t imm;
+    int a, b;           // children
+};
+
+struct parser {
+    const char *s;
+    int pos;
+    struct node nodes[MAX_NODES];
+    int count;
+    struct filter *f;
+    char *err;
+    size_t err_size;
+    int failed;
+};
+
+static int fail(struct parser *p, const char *msg) {
+    if (!p->failed) snprintf(p->err, p->err_size, "column %d: %s", p->pos + 1, msg);
+    p->failed = 1;
+    return -1;
+}
+
+static int new_node(struct parser *p, int kind, int a, int b) {
+    if (p->count == MAX_NODES) return fail(p, "expression too long");
+    struct node *n = &p->nodes[p->count];
+    memset(n, 0, sizeof(*n));
+    n->kind = kind;
+    n->a = a;
+    n->b = b;
+    return p->count++;
+}
+
+static void skip_space(struct parser *p) {
+    while (isspace((unsigned char)p->s[p->pos])) p->pos++;
+}
+
+// Accept a symbol, or a word that is not followed by more identifier characters
+static int take(struct parser *p, const char *tok) {
+    size_t n = strlen(tok);
+    skip_space(p);
+    if (strncmp(p->s + p->pos, tok, n) != 0) return 0;
+    if (isalpha((unsigned char)tok[0])) {
+        char c = p->s[p->pos + n];
+        if (isalnum((unsigned char)c) || c == '_' || c == '.') return 0;
+    }
+    p->pos += n;
+    return 1;
+}
+
+static int parse_cmp(struct parser *p) {
+    static const char *syms[] = {"==", "!=", "<=", ">=", "<", ">"};
+    static const int sym_cmp[] = {CMP_EQ, CMP_NE, CMP_LE, CMP_GE, CMP_LT, CMP_GT};
+    static const char *words[] = {"eq", "ne", "lt", "le", "gt", "ge"};
+
+    for (size_t i = 0; i < COUNT(syms); i++) {
+        if (take(p, syms[i])) return sym_cmp[i];
+    }
+    for (int i = 0; i < 6; i++) {
+        if (take(p, words[i])) return i;
+    }
+    return -1;
+}
+
+// The literal after a comparison: a number or an address with an optional prefix
+static int read_value(struct parser *p, char *out, size_t size) {
+    size_t n = 0;
+    skip_space(p);
+    while (isalnum((unsigned char)p->s[p->pos]) || (p->s[p->pos] && strchr(".:/", p->s[p->pos]))) {
+        if (n + 1 == size) return fail(p, "value too long");
+        out[n++] = p->s[p->pos++];
+    }
+    out[n] = 0;
+    return n ? 0 : fail(p, "expected a value");
+}
+
+static int parse_net(struct parser *p, const struct field_def *fd, int cmp, const char *text) {
+    struct filter *f = p->f;
+    char addr[64];
+    int prefix = fd->addr_len * 8;
+
+    if (cmp != CMP_EQ && cmp != CMP_NE) return fail(p, "addresses only support == and !=");
+    snprintf(addr, sizeof(addr), "%s", text);
+    char *slash = strchr(addr, '/');
+    if (slash) {
+        char *end;
+        *slash = 0;
+        prefix = strtol(slash + 1, &end, 10);
+        if (*end || end == slash + 1 || prefix < 0 || prefix > fd->addr_len * 8) return fail(p, "bad prefix length");
+    }
+    if (f->const_count == FILTER_MAX_CONSTS) return fail(p, "too many addresses");
+    struct filter_net *net = &f->consts[f->const_count];
+    memset(net, 0, sizeof(*net));
+    if (inet_pton(fd->addr_len == 4 ? AF_INET : AF_INET6, addr, net->addr) != 1) {
+        return fail(p, fd->addr_len == 4 ? "bad IPv4 address" : "bad IPv6 address");
+    }
+    net->len = fd->addr_len;
+    net->prefix = prefix;
+
+    int n = new_node(p, N_NET, -1, -1);
+    if (n < 0) return -1;
+    p->nodes[n].cmp = cmp;
+    p->nodes[n].sel = fd->sel;
+    p->nodes[n].layers = fd->layers;
+    p->nodes[n].imm = f->const_count++;
+    return n;
+}
+
+static int leaf(struct parser *p, int kind, uint8_t field, int cmp, uint64_t imm, uint32_t layers) {
+    int n = new_node(p, kind, -1, -1);
+    if (n < 0) return -1;
+    p->nodes[n].field = field;
+    p->nodes[n].cmp = cmp;
+    p->nodes[n].imm = imm;
+    p->nodes[n].layers = layers;
+    return n;
+}
+
+static int parse_comparison(struct parser *p) {
+    char name[32], value[64];
+    size_t n = 0;
+
+    skip_space(p);
+    int start = p->pos;
+    while (isalnum((unsigned char)p->s[p->pos]) || p->s[p->pos] == '_' || p->s[p->pos] == '.') {
+        if (n + 1 == sizeof(name)) return fail(p, "name too long");
+        name[n++] = p->s[p->pos++];
+    }
+    name[n] = 0;
+    if (n == 0) return fail(p, p->s[p->pos] ? "expected a field or protocol" : "unexpected end of filter");
+
+    for (size_t i = 0; i < COUNT(protocols); i++) {
+        if (strcmp(name, protocols[i].name) == 0) return leaf(p, N_TEST, 0, 0, 0, protocols[i].layers);
+    }
+    const struct field_def *fd = NULL;
+    for (size_t i = 0; i < COUNT(fields); i++) {
+        if (strcmp(name, fields[i].name) == 0) fd = &fields[i];
+    }
+    if (fd == NULL) {
+        p->pos = start;
+        return fail(p, "unknown field or protocol");
+    }
+
+    int cmp = parse_cmp(p);
+    if (cmp < 0) {
+        // A bare field: present and, for numbers, non-zero
+        if (fd->field == F_ADDR) return leaf(p, N_TEST, 0, 0, 0, fd->layers);
+        cmp = CMP_NE;
+        snprintf(value, sizeof(value), "0");
+    } else if (read_value(p, value, sizeof(value)) < 0) {
+        return -1;
+    }
+
+    if (fd->field == F_ADDR) return parse_net(p, fd, cmp, value);
+
+    char *end;
+    errno = 0;
+    uint64_t imm = strtoull(value, &end, 0);
+    if (*end || errno) return fail(p, "bad number");
+    int a = leaf(p, N_CMP, fd->field, cmp, imm, fd->layers);
+    if (a < 0 || !fd->either) return a;
+    // Either direction may match; != means that neither does
+    int b = leaf(p, N_CMP, fd->either, cmp, imm, fd->layers);
+    return b < 0 ? -1 : new_node(p, cmp == CMP_NE ? N_AND : N_OR, a, b);
+}
+
+static int parse_or(struct parser *p);
+
+static int parse_unary(struct parser *p) {
+    if (take(p, "!") || take(p, "not")) {
+        int a = parse_unary(p);
+        return a < 0 ? -1 : new_node(p, N_NOT, a, -1);
+    }
+    if (take(p, "(")) {
+        int a = parse_or(p);
+        if (a < 0) return -1;
+        if (!take(p, ")")) return fail(p, "expected ')'");
+        return a;
+    }
+    return parse_comparison(p);
+}
+
+static int parse_and(struct parser *p) {
+    int a = parse_unary(p);
+    while (a >= 0 && (take(p, "&&") || take(p, "and"))) {
+        int b = parse_unary(p);
+        a = b < 0 ? -1 : new_node(p, N_AND, a, b);
+    }
+    return a;
+}
+
+static int parse_or(struct parser *p) {
+    int a = parse_and(p);
+    while (a >= 0 && (take(p, "||") || take(p, "or"))) {
+        int b = parse_and(p);
+        a = b < 0 ? -1 : new_node(p, N_OR, a, b);
+    }
+    return a;
+}
+
+static int emit(struct parser *p, int op) {
+    struct filter *f = p->f;
+    if (f->insn_count == FILTER_MAX_INSNS) return fail(p, "filter too complex");
+    memset(&f->insns[f->insn_count], 0, sizeof(struct filter_insn));
+    f->insns[f->insn_count].op = op;
+    return f->insn_count++;
+}
+
+// Register holding `field`, loaded in the prologue
+static int field_reg(struct parser *p, uint8_t field) {
+    struct filter *f = p->f;
+    for (int i = 0; i < f->insn_count && f->insns[i].op == OP_LD; i++) {
+        if (f->insns[i].field == field) return f->insns[i].reg;
+    }
+    return -1;
+}
+
+static void emit_loads(struct parser *p, int n) {
+    const struct node *nd = &p->nodes[n];
+    if (nd->kind == N_CMP && field_reg(p, nd->field) < 0) {
+        if (p->f->reg_count == FILTER_MAX_REGS) {
+            fail(p, "too many different fields");
+            return;
+        }
+        int i = emit(p, OP_LD);
+        if (i < 0) return;
+        p->f->insns[i].field = nd->field;
+        p->f->insns[i].reg = p->f->reg_count++;
+    }
+    if (nd->a >= 0) emit_loads(p, nd->a);
+    if (nd->b >= 0) emit_loads(p, nd->b);
+}
+
+static void gen(struct parser *p, int n) {
+    const struct node *nd = &p->nodes[n];
+    struct filter *f = p->f;
+    int i;
+
+    switch (nd->kind) {
+    case N_AND:
+    case N_OR:
+        gen(p, nd->a);
+        if ((i = emit(p, nd->kind == N_AND ? OP_JZ : OP_JNZ)) < 0) return;
+        gen(p, nd->b);
+        f->insns[i].jump = f->insn_count;
+        return;
+    case N_NOT:
+        gen(p, nd->a);
+        emit(p, OP_NOT);
+        return;
+    case N_TEST:
+        if ((i = emit(p, OP_TEST)) >= 0) f->insns[i].layers = nd->layers;
+        return;
+    case N_CMP:
+        if ((i = emit(p, OP_CMP)) < 0) return;
+        f->insns[i].reg = field_reg(p, nd->field);
+        f->insns[i].cmp = nd->cmp;
+        f->insns[i].imm = nd->imm;
+        f->insns[i].layers = nd->layers;
+        return;
+    case N_NET:
+        if ((i = emit(p, OP_NET)) < 0) return;
+        f->insns[i].reg = nd->sel;
+        f->insns[i].cmp = nd->cmp;
+        f->insns[i].imm = nd->imm;
+        f->insns[i].layers = nd->layers;
+        return;
+    }
+}
+
+// Collect the leaves of a pure conjunction into the fast path; 0 if it is not one
+static int collect_fast(struct parser *p, int n) {
+    const struct node *nd = &p->nodes[n];
+    struct filter *f = p->f;
+
+    switch (nd->kind) {
+    case N_AND:
+        return collect_fast(p, nd->a) && collect_fast(p, nd->b);
+    case N_TEST:
+        f->fast_layers |= nd->layers;
+        return 1;
+    case N_CMP:
+        if (f->term_count == FILTER_FAST_TERMS) return 0;
+        f->fast_layers |= nd->layers;
+        f->terms[f->term_count].field = nd->field;
+        f->terms[f->term_count].cmp = nd->cmp;
+        f->terms[f->term_count].imm = nd->imm;
+        f->term_count++;
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+static int uses_dissection(const struct parser *p) {
+    for (int i = 0; i < p->count; i++) {
+        const struct node *nd = &p->nodes[i];
+        if (nd->kind == N_TEST || nd->kind == N_NET || (nd->kind == N_CMP && nd->field > F_FRAME_CAPLEN)) return 1;
+    }
+    return 0;
+}
+
+int filter_compile(struct filter *f, const char *expr, int flags, char *err, size_t err_size) {
+    struct parser p;
+
+    memset(f, 0, sizeof(*f));
+    memset(&p, 0, sizeof(p));
+    p.s = expr;
+    p.f = f;
+    p.err = err;
+    p.err_size = err_size;
+
+    skip_space(&p);
+    if (p.s[p.pos] == 0) {
+        // The empty filter matches everything
+        f->fast = 1;
+        emit(&p, OP_TEST);
+        emit(&p, OP_RET);
+        return 0;
+    }
+    int root = parse_or(&p);
+    skip_space(&p);
+    if (root >= 0 && p.s[p.pos]) fail(&p, "unexpected text after the filter");
+    if (p.failed) return -1;
+
+    emit_loads(&p, root);
+    gen(&p, root);
+    emit(&p, OP_RET);
+    f->needs_dissect = uses_dissection(&p);
+    if (!(flags & FILTER_NO_FAST) && collect_fast(&p, root)) {
+        f->fast = 1;
+    } else {
+        f->fast_layers = 0;
+        f->term_count = 0;
+    }
+    return p.failed ? -1 : 0;
+}
+
+static inline uint64_t field_value(int field, const struct cap_packet *pkt, const struct dissection *d) {
+    switch (field) {
+    case F_FRAME_LEN: return pkt->len;
+    case F_FRAME_CAPLEN: return pkt->caplen;
+    case F_ETH_TYPE: return d->ethertype;
+    case F_VLAN_ID: return d->vlan_id;
+    case F_IP_PROTO: return d->l4_proto;
+    case F_IP_TTL: return d->ttl;
+    case F_IP_LEN: return d->ip_len;
+    case F_IPV6_NXT: return d->l4_proto;
+    case F_IPV6_HLIM: return d->ttl;
+    case F_IPV6_PLEN: return d->ip_len - 40;
+    case F_TCP_SRCPORT: return d->sport;
+    case F_TCP_DSTPORT: return d->dport;
+    case F_TCP_SEQ: return d->tcp_seq;
+    case F_TCP_ACK: return d->tcp_ack;
+    case F_TCP_FLAGS: return d->tcp_flags;
+    case F_TCP_FIN: return d->tcp_flags & 0x01;
+    case F_TCP_SYN: return (d->tcp_flags >> 1) & 1;
+    case F_TCP_RST: return (d->tcp_flags >> 2) & 1;
+    case F_TCP_PUSH: return (d->tcp_flags >> 3) & 1;
+    case F_TCP_ACKFLAG: return (d->tcp_flags >> 4) & 1;
+    case F_TCP_URG: return (d->tcp_flags >> 5) & 1;
+    case F_TCP_LEN: return d->payload_len;
+    case F_UDP_SRCPORT: return d->sport;
+    case F_UDP_DSTPORT: return d->dport;
+    case F_UDP_LEN: return d->udp_len;
+    case F_ICMP_TYPE:
+    case F_ICMPV6_TYPE: return d->icmp_type;
+    case F_ICMP_CODE:
+    case F_ICMPV6_CODE: return d->icmp_code;
+    case F_ICMP_IDENT: return d->echo_id;
+    case F_ICMP_SEQ: return d->echo_seq;
+    case F_ARP_OPCODE: return d->arp_opcode;
+    default: return 0;
+    }
+}
+
+static inline int compare(uint64_t v, int cmp, uint64_t imm) {
+    switch (cmp) {
+    case CMP_EQ: return v == imm;
+    case CMP_NE: return v != imm;
+    case CMP_LT: return v < imm;
+    case CMP_LE: return v <= imm;
+    case CMP_GT: return v > imm;
+    default: return v >= imm;
+    }
+}
+
+static int net_match(const struct filter_net *net, const uint8_t *addr) {
+    int full = net->prefix / 8, rest = net->prefix % 8;
+    if (memcmp(addr, net->addr, full) != 0) return 0;
+    if (rest == 0) return 1;
+    uint8_t mask = (uint8_t)(0xff << (8 - rest));
+    return (addr[full] & mask) == (net->addr[full] & mask);
+}
+
+int filter_match_dissected(const struct filter *f, const struct cap_packet *pkt, const struct dissection *d) {
+    uint32_t layers = d ? d->layers : 0;
+
+    if (f->fast) {
+        if ((layers & f->fast_layers) != f->fast_layers) return 0;
+        for (int i = 0; i < f->term_count; i++) {
+            if (!compare(field_value(f->terms[i].field, pkt, d), f->terms[i].cmp, f->terms[i].imm)) return 0;
+        }
+        return 1;
+    }
+
+    uint64_t r[FILTER_MAX_REGS];
+    int acc = 0, pc = 0;
+    for (;;) {
+        const struct filter_insn *in = &f->insns[pc++];
+        switch (in->op) {
+        case OP_LD:
+            r[in->reg] = field_value(in->field, pkt, d);
+            break;
+        case OP_TEST:
+            acc = (layers & in->layers) == in->layers;
+            break;
+        case OP_CMP:
+            acc = (layers & in->layers) == in->layers && compare(r[in->reg], in->cmp, in->imm);
+            break;
+        case OP_NET: {
+            const struct filter_net *net = &f->consts[in->imm];
+            if ((layers & in->layers) != in->layers) {
+                acc = 0;
+                break;
+            }
+            int hit = (in->reg != SEL_DST && net_match(net, d->saddr)) ||
+                      (in->reg != SEL_SRC && net_match(net, d->daddr));
+            acc = in->cmp == CMP_EQ ? hit : !hit;
+            break;
+        }
+        case OP_NOT:
+            acc = !acc;
+            break;
+        case OP_JZ:
+            if (!acc) pc = in->jump;
+            break;
+        case OP_JNZ:
+            if (acc) pc = in->jump;
+            break;
+        default:
+            return acc;
+        }
+    }
+}
+
+int filter_match(const struct filter *f, const struct cap_packet *pkt) {
+    struct dissection d;
+
+    if (!f->needs_dissect) return filter_match_dissected(f, pkt, NULL);
+    dissect_packet(&d, pkt->data, pkt->caplen, pkt->linktype);
+    return filter_match_dissected(f, pkt, &d);
+}
+
+static const char *field_name(int field) {
+    for (size_t i = 0; i < COUNT(fields); i++) {
+        if (fields[i].field == field && !fields[i].either) return fields[i].name;
+    }
+    return "?";
+}
+
+void filter_dump(const struct filter *f, FILE *out) {
+    static const char *sel_names[] = {"src", "dst", "either"};
+
+    for (int i = 0; i < f->insn_count; i++) {
+        const struct filter_insn *in = &f->insns[i];
+        fprintf(out, "%4d: %-5s", i, op_names[in->op]);
+        switch (in->op) {
+        case OP_LD: fprintf(out, "r%d, %s", in->reg, field_name(in->field)); break;
+        case OP_TEST: fprintf(out, "layers 0x%x", in->layers); break;
+        case OP_CMP:
+            fprintf(out, "r%d %s %lu, layers 0x%x", in->reg, cmp_names[in->cmp], (unsigned long)in->imm, in->layers);
+            break;
+        case OP_NET: {
+            const struct filter_net *net = &f->consts[in->imm];
+            char addr[INET6_ADDRSTRLEN];
+            inet_ntop(net->len == 4 ? AF_INET : AF_INET6, net->addr, addr, sizeof(addr));
+            fprintf(out, "%s %s %s/%d, layers 0x%x", sel_names[in->reg], cmp_names[in->cmp], addr, net->prefix,
+                    in->layers);
+            break;
+        }
+        case OP_JZ:
+        case OP_JNZ: fprintf(out, "%d", in->jump); break;
+        }
+        fprintf(out, "\n");
+    }
+    if (f->fast) {
+        fprintf(out, "fast path: layers 0x%x", f->fast_layers);
+        for (int i = 0; i < f->term_count; i++) {
+            fprintf(out, "%s %s %s %lu", i ? " &&" : ",", field_name(f->terms[i].field), cmp_names[f->terms[i].cmp],
+                    (unsigned long)f->terms[i].imm);
+        }
+        fprintf(out, "\n");
+    }
+    if (!f->needs_dissect) fprintf(out, "no dissection needed\n");
+}
@@ -0,0 +1,95 @@
+#ifndef FILTER_H
+#define FILTER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "capture.h"
+#include "dissect.h"
+
+/**
+ * Compiled packet filters for offline analysis.
+ *
+ * Expressions use Wireshark-style field names:
+ *
+ *     tcp && tcp.flags.syn && !tcp.flags.ack
+ *     ip.src == 10.0.0.0/8 and (udp.port == 53 or frame.len > 1000)
+ *     ipv6.addr == 2001:db8::/32 || icmp.type == 8
+ *
+ * A protocol name (eth, vlan, sll, arp, ip, ipv6, tcp, udp, icmp, icmpv6,
+ * frag) is true when that layer was decoded; a bare field is true when it is
+ * present and non-zero. Comparisons are ==, !=, <, <=, >, >= (or eq, ne, lt,
+ * le, gt, ge) against decimal or 0x numbers, and == / != against IPv4 or IPv6
+ * addresses with an optional /prefix. Comparing a field that is absent from
+ * the packet is false. ip.addr, ipv6.addr, tcp.port and udp.port match
+ * either direction (and != means neither matches). Operators are !, &&, ||
+ * (or not, and, or) with the usual precedence, and parentheses.
+ *
+ * The expression is compiled into a small register bytecode: every field the
+ * filter uses is loaded once into a register, comparisons set an accumulator
+ * and && / || become conditional jumps, so evaluation short-circuits. When
+ * the filter is a plain conjunction of protocol tests and numeric
+ * comparisons it is also specialized into a fast path (one layer-mask test
+ * plus a short list of comparisons) that skips the interpreter; filters on
+ * frame.* fields alone skip dissection entirely.
+ */
+
+#define FILTER_MAX_INSNS 256
+#define FILTER_MAX_REGS 16
+#define FILTER_MAX_CONSTS 32
+#define FILTER_FAST_TERMS 8
+
+#define FILTER_NO_FAST 1   // filter_compile() flag: always use the interpreter
+
+struct filter_insn {
+    uint8_t op;
+    uint8_t reg;        // register (LD, CMP) or address selector (NET)
+    uint8_t cmp;        // comparison for CMP
+    uint8_t field;      // field for LD
+    uint16_t jump;      // target for JZ / JNZ
+    uint32_t layers;    // DISSECT_* bits that must all be present (TEST, CMP, NET)
+    uint64_t imm;       // constant for CMP, constant-pool index for NET
+};
+
+struct filter_net {
+    uint8_t addr[16];
+    uint8_t len;        // 4 or 16 bytes
+    uint8_t prefix;     // in bits
+};
+
+struct filter_term {
+    uint8_t field;
+    uint8_t cmp;
+    uint64_t imm;
+};
+
+struct filter {
+    struct filter_insn insns[FILTER_MAX_INSNS];
+    int insn_count;
+    int reg_count;
+    struct filter_net consts[FILTER_MAX_CONSTS];
+    int const_count;
+    int needs_dissect;  // 0 if only frame.* fields are used
+
+    // Fast path, when fast is set: all `layers` present and every term true
+    int fast;
+    uint32_t fast_layers;
+    struct filter_term terms[FILTER_FAST_TERMS];
+    int term_count;
+};
+
+/* Compile `expr`. Returns 0, or -1 with a message (including the column of
+ * the error) in `err`. */
+int filter_compile(struct filter *f, const char *expr, int flags, char *err, size_t err_size);
+
+/* Evaluate on a packet that has already been dissected (`d` may be NULL if
+ * f->needs_dissect is 0). */
+int filter_match_dissected(const struct filter *f, const struct cap_packet *pkt, const struct dissection *d);
+
+/* Dissect (if the filter needs it) and evaluate. Returns 1 on a match. */
+int filter_match(const struct filter *f, const struct cap_packet *pkt);
+
+/* Print the program in readable form, e.g. for `analyzer -f ... -d`. */
+void filter_dump(const struct filter *f, FILE *out);
+
+#endif
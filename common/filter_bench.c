@@ -0,0 +1,198 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include "capture.h"
+#include "dissect.h"
+#include "filter.h"
+#include "packet.h"
+
+/**
+ * Filter benchmark.
+ * Builds a pool of Ethernet frames (TCP with random flags and ports, UDP,
+ * ICMP echo, over IPv4 and IPv6; a quarter cut short by the snap length),
+ * checks that every test filter gives the same answer through the fast
+ * path, through the bytecode interpreter and as a hand-written C predicate,
+ * then reports filter evaluation speed alone (on packets dissected in
+ * advance) and together with dissection, in Mpps and millions of packets
+ * per minute. Passing a capture (e.g. a gencorpus file) runs the same
+ * checks and timings on its first POOL_SIZE frames, cut to FRAME_CAP bytes.
+ *
+ * Build: gcc -O2 filter_bench.c filter.c dissect.c packet.c pkt_template.c checksum.c capture.c capstream.c -o filter_bench -lz -lpthread
+ */
+
+#define POOL_SIZE 4096
+#define FRAME_CAP 256
+
+struct frame {
+    uint8_t data[FRAME_CAP];
+    struct cap_packet pkt;
+    struct dissection d;
+};
+
+static struct in6_addr src6, dst6;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void build_frame(struct frame *f, uint32_t i) {
+    static const uint16_t ports[] = {22, 53, 80, 443, 8080, 40000};
+    static const uint8_t mac[6] = {0xaa, 0xaa, 0xaa, 0xaa, 0xaa, 0xaa};
+    struct pkt_builder b;
+    int v6 = rand() % 4 == 0, kind = rand() % 3;
+
+    pkt_init(&b, f->data, FRAME_CAP);
+    pkt_eth(&b, mac, mac, 0);
+    if (v6) pkt_ipv6(&b, &src6, &dst6, 64);
+    else pkt_ipv4(&b, htonl(0x0a000000 | (rand() & 0xffff)), htonl(0xc0a80000 | (rand() & 0xff)), 32 + rand() % 64);
+    if (kind == 0) {
+        pkt_tcp(&b, ports[rand() % 6], ports[rand() % 6], i, i, rand() & 0x3f, 65535);
+    } else if (kind == 1) {
+        pkt_udp(&b, ports[rand() % 6], ports[rand() % 6]);
+    } else if (v6) {
+        pkt_icmp6(&b, rand() & 1 ? ICMP6_ECHO_REQUEST : ICMP6_ECHO_REPLY, 0);
+    } else {
+        pkt_icmp(&b, rand() & 1 ? ICMP_ECHO : ICMP_ECHOREPLY, 0);
+    }
+    int payload = rand() % 160;
+    pkt_payload(&b, NULL, payload);
+    size_t len = pkt_finalize(&b, NULL);
+    if (len == 0) {
+        fprintf(stderr, "Cannot build frame %u\n", i);
+        exit(1);
+    }
+    memset(&f->pkt, 0, sizeof(f->pkt));
+    f->pkt.data = f->data;
+    f->pkt.caplen = f->pkt.len = len;
+    // Every fourth frame loses part of its payload to the snap length
+    if (rand() % 4 == 0) f->pkt.caplen -= rand() % (payload + 1);
+    f->pkt.linktype = CAP_LINK_ETHERNET;
+    dissect_packet(&f->d, f->pkt.data, f->pkt.caplen, f->pkt.linktype);
+}
+
+// Fill the pool from a capture instead; returns the number of frames loaded
+static int load_pool(const char *path, struct frame *pool) {
+    struct capture cap;
+    struct cap_packet p;
+    int n = 0;
+
+    if (cap_open(&cap, path) < 0) {
+        fprintf(stderr, "%s\n", cap.err);
+        exit(1);
+    }
+    while (n < POOL_SIZE && cap_next(&cap, &p) > 0) {
+        struct frame *f = &pool[n++];
+        f->pkt = p;
+        f->pkt.caplen = p.caplen < FRAME_CAP ? p.caplen : FRAME_CAP;
+        f->pkt.data = f->data;
+        memcpy(f->data, p.data, f->pkt.caplen);
+        dissect_packet(&f->d, f->pkt.data, f->pkt.caplen, f->pkt.linktype);
+    }
+    cap_close(&cap);
+    return n;
+}
+
+/* The test filters and the same predicates written by hand */
+static int ref_syn(const struct dissection *d, uint32_t len) {
+    (void)len;
+    return (d->layers & DISSECT_TCP) && (d->tcp_flags & 0x02) && !(d->tcp_flags & 0x10);
+}
+static int ref_web(const struct dissection *d, uint32_t len) {
+    (void)len;
+    return (d->layers & DISSECT_TCP) && d->dport == 443;
+}
+static int ref_net(const struct dissection *d, uint32_t len) {
+    return (d->layers & DISSECT_IPV4) && d->saddr[0] == 10 && (((d->layers & DISSECT_UDP) && (d->sport == 53 || d->dport == 53)) || len > 150);
+}
+static int ref_v6(const struct dissection *d, uint32_t len) {
+    (void)len;
+    return ((d->layers & DISSECT_IPV6) && d->daddr[0] == 0x20 && d->daddr[1] == 0x01) ||
+           ((d->layers & DISSECT_ICMP) && d->icmp_type == 8);
+}
+static int ref_len(const struct dissection *d, uint32_t len) {
+    (void)d;
+    return len >= 100 && len <= 200;
+}
+
+static int ref_udp_len(const struct dissection *d, uint32_t len) {
+    // The UDP length as sent, not as captured
+    return (d->layers & DISSECT_UDP) && len - d->l4_off > 100;
+}
+
+static const struct {
+    const char *expr;
+    int (*ref)(const struct dissection *, uint32_t);
+} tests[] = {
+    {"tcp.flags.syn == 1 && tcp.flags.ack == 0", ref_syn},
+    {"tcp and tcp.dstport == 443", ref_web},
+    {"ip.src == 10.0.0.0/8 && (udp.port == 53 || frame.len > 150)", ref_net},
+    {"ipv6.dst == 2001::/16 or icmp.type == 8", ref_v6},
+    {"frame.len >= 100 && frame.len <= 200", ref_len},
+    {"udp.len > 100", ref_udp_len},
+};
+
+#define TEST_COUNT (int)(sizeof(tests) / sizeof(tests[0]))
+
+static void bench(const struct frame *pool, int n, const struct filter *f, const char *label, int dissect, double target) {
+    uint64_t packets = 0, matched = 0;
+
+    double start = now_sec(), elapsed;
+    do {
+        for (int i = 0; i < n; i++) {
+            matched += dissect ? filter_match(f, &pool[i].pkt) : filter_match_dissected(f, &pool[i].pkt, &pool[i].d);
+        }
+        packets += n;
+        elapsed = now_sec() - start;
+    } while (elapsed < target);
+
+    printf("  %-22s %8.1f Mpps %10.0f Mpkt/min   (%.1f%% match)\n", label, packets / elapsed / 1e6,
+           packets / elapsed * 60 / 1e6, 100.0 * matched / packets);
+}
+
+int main(int argc, char *argv[]) {
+    static struct frame pool[POOL_SIZE];
+    int n = POOL_SIZE;
+    static struct filter fast, slow;
+    char err[128];
+    int failures = 0;
+
+    inet_pton(AF_INET6, "2001:db8::1", &src6);
+    inet_pton(AF_INET6, "2001:db8::2", &dst6);
+    srand(1);
+    if (argc > 1) {
+        n = load_pool(argv[1], pool);
+    } else {
+        for (int i = 0; i < n; i++) build_frame(&pool[i], i);
+    }
+
+    for (int t = 0; t < TEST_COUNT; t++) {
+        if (filter_compile(&fast, tests[t].expr, 0, err, sizeof(err)) < 0 ||
+            filter_compile(&slow, tests[t].expr, FILTER_NO_FAST, err, sizeof(err)) < 0) {
+            printf("%s: %s\n", tests[t].expr, err);
+            return 1;
+        }
+        for (int i = 0; i < n; i++) {
+            int want = tests[t].ref(&pool[i].d, pool[i].pkt.len);
+            if (filter_match(&fast, &pool[i].pkt) != want || filter_match(&slow, &pool[i].pkt) != want) {
+                if (failures++ < 5) printf("MISMATCH '%s' frame %d\n", tests[t].expr, i);
+            }
+        }
+    }
+    printf("Equivalence check: %s\n", failures ? "FAILED" : "fast path, interpreter and C predicates agree");
+    if (failures) return 1;
+
+    for (int t = 0; t < TEST_COUNT; t++) {
+        filter_compile(&fast, tests[t].expr, 0, err, sizeof(err));
+        filter_compile(&slow, tests[t].expr, FILTER_NO_FAST, err, sizeof(err));
+        printf("\n%s%s\n", tests[t].expr, fast.fast ? "   [fast path]" : "");
+        if (fast.fast) bench(pool, n, &fast, "fast path", 0, 0.3);
+        bench(pool, n, &slow, "interpreter", 0, 0.3);
+        bench(pool, n, &fast, "dissect + filter", 1, 0.3);
+    }
+    return 0;
+}
@@ -0,0 +1,517 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include "packet.h"
+
+/**
+ * Synthetic capture corpus generator.
+ * Writes Ethernet traffic built with the packet builder to a pcap or pcapng
+ * file, fast enough for multi-GB corpora. Output is a pure function of the
+ * seed and the options, so benchmarks on different machines can regenerate
+ * the exact same files instead of sharing captures.
+ *
+ * Traffic model: `-f` flows are active at any time, each packet comes from
+ * one of them picked at random, and a flow that finishes is replaced by a
+ * new one (flow lengths average `-L` packets). TCP flows do the three-way
+ * handshake, exchange data segments (mostly server to client) with pure
+ * ACKs, and close with FINs; UDP flows send datagrams, and DNS / NTP flows
+ * get replies; ICMP flows are echo request / reply pairs.
+ *   -l  percentage of data segments, datagrams and echo replies missing from
+ *       the capture; a lost TCP segment is retransmitted later by its sender
+ *   -r  percentage of TCP data segments that are retransmitted needlessly
+ *       (seen twice)
+ *   -v  percentage of flows carrying an 802.1Q tag, -6 of flows over IPv6
+ *   -z  frame sizes for data packets: imix (60/590/1514 bytes as 7:4:1),
+ *       a fixed size, or a uniform range A-B
+ *
+ * Build: gcc -O2 gencorpus.c packet.c pkt_template.c checksum.c -o gencorpus
+ */
+
+#define FRAME_CAP 1600
+#define NOISE_SIZE 65536
+#define MSS 1460
+#define START_SEC 1700000000ll     // fixed epoch of the first packet
+
+struct flow {
+    uint8_t proto;         // IPPROTO_TCP, IPPROTO_UDP or IPPROTO_ICMP
+    uint8_t v6;
+    uint8_t state;
+    uint8_t reply_owed;    // UDP / ICMP: the server answers next; TCP: the receiver ACKs next
+    uint16_t vlan;         // 0: untagged
+    uint16_t cport, sport;
+    uint32_t caddr, saddr; // host order; IPv6 flows embed them in 2001:db8::/96
+    uint32_t cseq, sseq;   // TCP: next sequence number in each direction
+    uint32_t left;         // packets until the flow starts closing
+    uint16_t echo_id, echo_seq;
+    struct {               // TCP segment the sender still has to (re)transmit
+        uint8_t pending, from_server;
+        uint32_t seq;
+        uint16_t len;
+    } rexmit;
+};
+
+struct config {
+    uint64_t seed, packets, max_bytes;
+    uint32_t flows, mean_len;
+    uint32_t weight[3];    // tcp, udp, icmp
+    double loss, retrans, vlan, v6;
+    uint32_t size_min, size_max;
+    int imix;
+    double rate;           // packets per second, sets the timestamps
+    int pcapng, nsec;
+};
+
+struct totals {
+    uint64_t packets, bytes, flows, tcp, udp, icmp, lost, retransmitted, tagged, v6;
+};
+
+static uint64_t rng_state;
+static uint8_t noise[NOISE_SIZE + FRAME_CAP];
+static struct totals totals;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// xorshift64*: the same sequence on every platform, unlike rand()
+static uint64_t rnd(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint32_t below(uint32_t n) {
+    return (uint32_t)(((rnd() >> 32) * n) >> 32);
+}
+
+static int chance(double percent) {
+    return below(1000000) < percent * 10000;
+}
+
+static uint32_t frame_size(const struct config *cfg) {
+    if (cfg->imix) {
+        uint32_t r = below(12);
+        return r < 7 ? 60 : r < 11 ? 590 : 1514;
+    }
+    return cfg->size_min + below(cfg->size_max - cfg->size_min + 1);
+}
+
+static void new_flow(const struct config *cfg, struct flow *f) {
+    static const uint16_t tcp_ports[] = {80, 443, 443, 443, 22, 8080, 25, 5201};
+    static const uint16_t udp_ports[] = {53, 53, 123, 443, 5353, 4789};
+    uint32_t total = cfg->weight[0] + cfg->weight[1] + cfg->weight[2];
+    uint32_t pick = below(total);
+
+    memset(f, 0, sizeof(*f));
+    f->proto = pick < cfg->weight[0] ? IPPROTO_TCP : pick < cfg->weight[0] + cfg->weight[1] ? IPPROTO_UDP : IPPROTO_ICMP;
+    f->v6 = chance(cfg->v6);
+    f->vlan = chance(cfg->vlan) ? 1 + below(4094) : 0;
+    f->caddr = 0x0a000000 | below(1 << 16);   // 10.0.0.0/16 clients
+    f->saddr = 0xc0a80000 | below(1 << 10);   // 192.168.0.0/22 servers
+    f->cport = 1024 + below(64512);
+    if (f->proto == IPPROTO_TCP) {
+        f->sport = tcp_ports[below(8)];
+        f->cseq = (uint32_t)rnd();
+        f->sseq = (uint32_t)rnd();
+    } else if (f->proto == IPPROTO_UDP) {
+        f->sport = udp_ports[below(6)];
+    } else {
+        f->echo_id = below(65536);
+    }
+    f->left = 1 + below(2 * cfg->mean_len);
+    if (f->proto == IPPROTO_TCP && f->left < 8) f->left = 8;   // handshake and teardown
+    totals.flows++;
+}
+
+static void put_mac(uint8_t *mac, uint8_t tag, uint32_t addr) {
+    mac[0] = 0x02;   // locally administered
+    mac[1] = tag;
+    mac[2] = addr >> 24;
+    mac[3] = addr >> 16;
+    mac[4] = addr >> 8;
+    mac[5] = addr;
+}
+
+/* Start a frame of `f` in the given direction: link header(s) and IP */
+static void begin_frame(struct pkt_builder *b, uint8_t *buf, const struct flow *f, int from_server) {
+    uint8_t client_mac[6], server_mac[6];
+    uint32_t src = from_server ? f->saddr : f->caddr, dst = from_server ? f->caddr : f->saddr;
+
+    put_mac(client_mac, 0x00, f->caddr);
+    put_mac(server_mac, 0xff, f->saddr);
+    pkt_init(b, buf, FRAME_CAP);
+    pkt_eth(b, from_server ? client_mac : server_mac, from_server ? server_mac : client_mac, 0);
+    if (f->vlan) pkt_vlan(b, f->vlan, 0);
+    if (f->v6) {
+        struct in6_addr s6 = {{{0x20, 0x01, 0x0d, 0xb8}}}, d6 = s6;
+        uint32_t s = htonl(src), d = htonl(dst);
+        memcpy(&s6.s6_addr[12], &s, 4);
+        memcpy(&d6.s6_addr[12], &d, 4);
+        pkt_ipv6(b, &s6, &d6, from_server ? 58 : 64);
+    } else {
+        pkt_ipv4(b, htonl(src), htonl(dst), from_server ? 58 : 64);
+    }
+}
+
+// Payload that brings a data packet to a frame size drawn from -z
+static uint32_t data_len(const struct config *cfg, const struct pkt_builder *b, uint32_t l4_hdr, uint32_t max) {
+    uint32_t size = frame_size(cfg), hdr = b->len + l4_hdr;
+    uint32_t len = size > hdr ? size - hdr : 0;
+    return len > max ? max : len;
+}
+
+static void *payload(struct pkt_builder *b, uint32_t len) {
+    return pkt_payload(b, noise + below(NOISE_SIZE), len);
+}
+
+static size_t tcp_segment(struct pkt_builder *b, uint8_t *buf, const struct flow *f, int from_server,
+                          uint32_t seq, uint32_t ack, uint8_t flags, uint32_t len) {
+    begin_frame(b, buf, f, from_server);
+    pkt_tcp(b, from_server ? f->sport : f->cport, from_server ? f->cport : f->sport, seq, ack, flags, 64240);
+    if (flags & TH_SYN) {
+        pkt_tcp_mss(b, MSS);
+        pkt_tcp_sack_perm(b);
+        pkt_tcp_wscale(b, 7);
+    }
+    if (len) payload(b, len);
+    return pkt_finalize(b, NULL);
+}
+
+/* Next packet of a TCP flow, or 0 when the flow has ended */
+static size_t tcp_next(const struct config *cfg, struct flow *f, struct pkt_builder *b, uint8_t *buf) {
+    for (;;) {
+        switch (f->state) {
+        case 0:
+            f->state = 1;
+            return tcp_segment(b, buf, f, 0, f->cseq++, 0, TH_SYN, 0);
+        case 1:
+            f->state = 2;
+            return tcp_segment(b, buf, f, 1, f->sseq++, f->cseq, TH_SYN | TH_ACK, 0);
+        case 2:
+            f->state = 3;
+            return tcp_segment(b, buf, f, 0, f->cseq, f->sseq, TH_ACK, 0);
+        case 3:
+            if (f->reply_owed) {
+                // Pure ACK from the receiver of the last segment
+                int from_server = f->reply_owed == 2;
+                f->reply_owed = 0;
+                return tcp_segment(b, buf, f, from_server, from_server ? f->sseq : f->cseq,
+                                   from_server ? f->cseq : f->sseq, TH_ACK, 0);
+            }
+            if (f->rexmit.pending) {
+                int from_server = f->rexmit.from_server;
+                f->rexmit.pending = 0;
+                totals.retransmitted++;
+                return tcp_segment(b, buf, f, from_server, f->rexmit.seq, from_server ? f->cseq : f->sseq,
+                                   TH_ACK | TH_PUSH, f->rexmit.len);
+            }
+            if (f->left <= 4) {
+                f->state = 4;
+                continue;
+            }
+            f->left--;
+            {
+                int from_server = below(10) < 7;
+                uint32_t *seq = from_server ? &f->sseq : &f->cseq;
+                begin_frame(b, buf, f, from_server);
+                uint32_t len = data_len(cfg, b, 20, MSS);
+                if (len == 0) len = 1 + below(64);
+                uint32_t this_seq = *seq;
+                *seq += len;
+                if (chance(cfg->loss)) {
+                    // Lost before the tap: the capture sees a gap, then the retransmission
+                    totals.lost++;
+                    f->rexmit.pending = 1;
+                    f->rexmit.from_server = from_server;
+                    f->rexmit.seq = this_seq;
+                    f->rexmit.len = len;
+                    continue;
+                }
+                if (chance(cfg->retrans)) {
+                    f->rexmit.pending = 1;
+                    f->rexmit.from_server = from_server;
+                    f->rexmit.seq = this_seq;
+                    f->rexmit.len = len;
+                }
+                if (below(2)) f->reply_owed = from_server ? 1 : 2;
+                pkt_tcp(b, from_server ? f->sport : f->cport, from_server ? f->cport : f->sport, this_seq,
+                        from_server ? f->cseq : f->sseq, TH_ACK | TH_PUSH, 64240);
+                payload(b, len);
+                return pkt_finalize(b, NULL);
+            }
+        case 4:
+            f->state = 5;
+            return tcp_segment(b, buf, f, 0, f->cseq++, f->sseq, TH_FIN | TH_ACK, 0);
+        case 5:
+            f->state = 6;
+            return tcp_segment(b, buf, f, 1, f->sseq++, f->cseq, TH_FIN | TH_ACK, 0);
+        case 6:
+            f->state = 7;
+            return tcp_segment(b, buf, f, 0, f->cseq, f->sseq, TH_ACK, 0);
+        default:
+            return 0;
+        }
+    }
+}
+
+static size_t udp_next(const struct config *cfg, struct flow *f, struct pkt_builder *b, uint8_t *buf) {
+    for (;;) {
+        if (f->left == 0) return 0;
+        f->left--;
+        int from_server = f->reply_owed;
+        f->reply_owed = !from_server && (f->sport == 53 || f->sport == 123);
+        if (chance(cfg->loss)) {
+            totals.lost++;
+            continue;
+        }
+        begin_frame(b, buf, f, from_server);
+        pkt_udp(b, from_server ? f->sport : f->cport, from_server ? f->cport : f->sport);
+        payload(b, data_len(cfg, b, 8, 1472));
+        return pkt_finalize(b, NULL);
+    }
+}
+
+static size_t icmp_next(const struct config *cfg, struct flow *f, struct pkt_builder *b, uint8_t *buf) {
+    for (;;) {
+        if (f->left == 0) return 0;
+        f->left--;
+        int reply = f->reply_owed;
+        f->reply_owed = !reply;
+        if (reply && chance(cfg->loss)) {
+            totals.lost++;
+            continue;
+        }
+        begin_frame(b, buf, f, reply);
+        if (f->v6) {
+            struct icmp6_hdr *h = pkt_icmp6(b, reply ? ICMP6_ECHO_REPLY : ICMP6_ECHO_REQUEST, 0);
+            if (h) {
+                h->icmp6_id = htons(f->echo_id);
+                h->icmp6_seq = htons(f->echo_seq);
+            }
+        } else {
+            struct icmphdr *h = pkt_icmp(b, reply ? ICMP_ECHOREPLY : ICMP_ECHO, 0);
+            if (h) {
+                h->un.echo.id = htons(f->echo_id);
+                h->un.echo.sequence = htons(f->echo_seq);
+            }
+        }
+        if (reply) f->echo_seq++;
+        payload(b, 56);
+        return pkt_finalize(b, NULL);
+    }
+}
+
+static void put(FILE *fp, const void *p, size_t len) {
+    if (fwrite(p, 1, len, fp) != len) {
+        perror("Write failed");
+        exit(1);
+    }
+}
+
+static void write_header(FILE *fp, const struct config *cfg) {
+    if (cfg->pcapng) {
+        // Section header, then one Ethernet interface with nanosecond timestamps
+        uint32_t shb[7] = {0x0a0d0d0a, 28, 0x1a2b3c4d, 1, 0xffffffff, 0xffffffff, 28};
+        uint32_t idb[8] = {1, 32, 1, 65535, 9 | 1 << 16, 9, 0, 32};   // if_tsresol = 9, end of options
+        put(fp, shb, sizeof(shb));
+        put(fp, idb, sizeof(idb));
+        totals.bytes += sizeof(shb) + sizeof(idb);
+    } else {
+        uint32_t hdr[6] = {cfg->nsec ? 0xa1b23c4d : 0xa1b2c3d4, 2 | 4 << 16, 0, 0, 65535, 1};
+        put(fp, hdr, sizeof(hdr));
+        totals.bytes += sizeof(hdr);
+    }
+}
+
+// Bytes write_record() adds to the file for a frame of `len` bytes
+static uint32_t record_size(const struct config *cfg, uint32_t len) {
+    return cfg->pcapng ? 32 + ((len + 3) & ~3u) : 16 + len;
+}
+
+static void write_record(FILE *fp, const struct config *cfg, int64_t ts_ns, const uint8_t *frame, uint32_t len) {
+    static const uint8_t pad[4];
+    if (cfg->pcapng) {
+        uint32_t padded = (len + 3) & ~3u;
+        uint32_t blen = record_size(cfg, len);
+        uint32_t epb[7] = {6, blen, 0, (uint32_t)((uint64_t)ts_ns >> 32), (uint32_t)ts_ns, len, len};
+        put(fp, epb, sizeof(epb));
+        put(fp, frame, len);
+        if (padded > len) put(fp, pad, padded - len);
+        put(fp, &blen, 4);
+    } else {
+        uint32_t rec[4] = {(uint32_t)(ts_ns / 1000000000), (uint32_t)(ts_ns % 1000000000), len, len};
+        if (!cfg->nsec) rec[1] /= 1000;
+        put(fp, rec, sizeof(rec));
+        put(fp, frame, len);
+    }
+    totals.bytes += record_size(cfg, len);
+}
+
+// "1500000", "512M", "4G"
+static uint64_t parse_size(const char *s) {
+    char *end;
+    double v = strtod(s, &end);
+    switch (*end) {
+    case 'k': case 'K': v *= 1e3; break;
+    case 'm': case 'M': v *= 1e6; break;
+    case 'g': case 'G': v *= 1e9; break;
+    default: break;
+    }
+    return (uint64_t)v;
+}
+
+// "tcp:80,udp:15,icmp:5"
+static int parse_mix(const char *s, uint32_t *weight) {
+    static const char *names[3] = {"tcp", "udp", "icmp"};
+    char copy[128];
+
+    snprintf(copy, sizeof(copy), "%s", s);
+    memset(weight, 0, 3 * sizeof(uint32_t));
+    for (char *tok = strtok(copy, ","); tok; tok = strtok(NULL, ",")) {
+        char *colon = strchr(tok, ':');
+        if (colon == NULL) return -1;
+        *colon = '\0';
+        int p = 0;
+        while (p < 3 && strcmp(tok, names[p]) != 0) p++;
+        if (p == 3) return -1;
+        weight[p] = atoi(colon + 1);
+    }
+    return weight[0] + weight[1] + weight[2] > 0 ? 0 : -1;
+}
+
+// "imix", "590" or "64-1514"
+static int parse_sizes(const char *s, struct config *cfg) {
+    cfg->imix = strcmp(s, "imix") == 0;
+    if (cfg->imix) return 0;
+    const char *dash = strchr(s, '-');
+    cfg->size_min = atoi(s);
+    cfg->size_max = dash ? (uint32_t)atoi(dash + 1) : cfg->size_min;
+    return cfg->size_min >= 60 && cfg->size_max >= cfg->size_min && cfg->size_max <= 1518 ? 0 : -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Usage: %s -o corpus.pcap|corpus.pcapng [-s seed] [-c packets] [-S max_bytes] [-f flows]\n"
+                    "       [-L packets_per_flow] [-m tcp:80,udp:15,icmp:5] [-z imix|N|A-B] [-l loss_%%]\n"
+                    "       [-r retrans_%%] [-v vlan_%%] [-6 ipv6_%%] [-R pps] [-n]\n", prog);
+    fprintf(stderr, "  writes pcapng when the name ends in .pcapng; -n nanosecond pcap timestamps\n");
+    fprintf(stderr, "  -c packets (default 1M) and -S bytes (e.g. 4G) stop at whichever comes first;\n");
+    fprintf(stderr, "  -S caps the file size (no record crosses it) and alone lifts the packet limit\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct config cfg = {.seed = 1, .packets = 1000000, .max_bytes = UINT64_MAX, .flows = 1000, .mean_len = 50,
+                         .weight = {80, 15, 5}, .imix = 1, .rate = 1e6};
+    const char *path = NULL;
+    int opt, count_given = 0;
+
+    while ((opt = getopt(argc, argv, "o:s:c:S:f:L:m:z:l:r:v:6:R:n")) != -1) {
+        switch (opt) {
+        case 'o': path = optarg; break;
+        case 's': cfg.seed = strtoull(optarg, NULL, 0); break;
+        case 'c':
+            cfg.packets = parse_size(optarg);
+            count_given = 1;
+            break;
+        case 'S': cfg.max_bytes = parse_size(optarg); break;
+        case 'f': cfg.flows = atoi(optarg); break;
+        case 'L': cfg.mean_len = atoi(optarg); break;
+        case 'm':
+            if (parse_mix(optarg, cfg.weight) < 0) { usage(argv[0]); return 1; }
+            break;
+        case 'z':
+            if (parse_sizes(optarg, &cfg) < 0) { usage(argv[0]); return 1; }
+            break;
+        case 'l': cfg.loss = atof(optarg); break;
+        case 'r': cfg.retrans = atof(optarg); break;
+        case 'v': cfg.vlan = atof(optarg); break;
+        case '6': cfg.v6 = atof(optarg); break;
+        case 'R': cfg.rate = atof(optarg); break;
+        case 'n': cfg.nsec = 1; break;
+        default: usage(argv[0]); return 1;
+        }
+    }
+    if (path == NULL || cfg.flows == 0 || cfg.mean_len == 0 || cfg.rate <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cfg.max_bytes != UINT64_MAX && !count_given) cfg.packets = UINT64_MAX;
+    size_t plen = strlen(path);
+    cfg.pcapng = plen > 7 && strcmp(path + plen - 7, ".pcapng") == 0;
+
+    // splitmix64 of the seed, so that small seeds still give well-mixed state
+    uint64_t z = cfg.seed + 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    rng_state = (z ^ (z >> 31)) | 1;
+    for (size_t i = 0; i < sizeof(noise); i++) noise[i] = (uint8_t)rnd();
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        perror("Cannot create output");
+        return 1;
+    }
+    static char iobuf[4 << 20];
+    setvbuf(fp, iobuf, _IOFBF, sizeof(iobuf));
+    write_header(fp, &cfg);
+
+    struct flow *flows = malloc(cfg.flows * sizeof(struct flow));
+    if (flows == NULL) {
+        perror("malloc failed");
+        return 1;
+    }
+    for (uint32_t i = 0; i < cfg.flows; i++) new_flow(&cfg, &flows[i]);
+
+    static uint8_t frame[FRAME_CAP];
+    struct pkt_builder b;
+    int64_t ts_ns = START_SEC * 1000000000ll;
+    uint64_t gap_ns = (uint64_t)(1e9 / cfg.rate);
+    double start = now_sec();
+
+    while (totals.packets < cfg.packets) {
+        struct flow *f = &flows[below(cfg.flows)];
+        size_t len;
+        for (;;) {
+            len = f->proto == IPPROTO_TCP ? tcp_next(&cfg, f, &b, frame)
+                : f->proto == IPPROTO_UDP ? udp_next(&cfg, f, &b, frame)
+                                          : icmp_next(&cfg, f, &b, frame);
+            if (len) break;
+            new_flow(&cfg, f);
+        }
+        if (len < 60) {
+            memset(frame + len, 0, 60 - len);   // Ethernet minimum frame, as a NIC would pad it
+            len = 60;
+        }
+
+        // -S is a hard limit on the file size: stop before the record that would cross it
+        if (totals.bytes + record_size(&cfg, len) > cfg.max_bytes) break;
+        ts_ns += gap_ns ? 2 * below(gap_ns) + 1 : 1;   // uniform inter-arrival, mean 1/rate
+        write_record(fp, &cfg, ts_ns, frame, len);
+        totals.packets++;
+        totals.tcp += f->proto == IPPROTO_TCP;
+        totals.udp += f->proto == IPPROTO_UDP;
+        totals.icmp += f->proto == IPPROTO_ICMP;
+        totals.tagged += f->vlan != 0;
+        totals.v6 += f->v6;
+    }
+    if (fclose(fp) != 0) {
+        perror("Write failed");
+        return 1;
+    }
+    free(flows);
+
+    double secs = now_sec() - start;
+    printf("%s: %lu packets, %.1f MB in %.2f s (%.2f Mpps, %.0f MB/s)\n", path, (unsigned long)totals.packets,
+           totals.bytes / 1e6, secs, totals.packets / secs / 1e6, totals.bytes / secs / 1e6);
+    printf("  flows %lu   tcp %lu  udp %lu  icmp %lu   ipv6 %lu  vlan-tagged %lu\n", (unsigned long)totals.flows,
+           (unsigned long)totals.tcp, (unsigned long)totals.udp, (unsigned long)totals.icmp,
+           (unsigned long)totals.v6, (unsigned long)totals.tagged);
+    printf("  lost before the tap %lu, TCP retransmissions %lu\n", (unsigned long)totals.lost,
+           (unsigned long)totals.retransmitted);
+    return 0;
+}
@@ -0,0 +1,456 @@
+#include "maxmin.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Relative slack when comparing rates with levels and capacity left
+#define EPS 1e-9
+
+int maxmin_init(struct maxmin *m, uint32_t port_count, const double *capacity) {
+    memset(m, 0, sizeof(*m));
+    m->port_count = port_count;
+    m->capacity = malloc(port_count * sizeof(*m->capacity));
+    m->ports = calloc(port_count, sizeof(*m->ports));
+    m->residual = malloc(port_count * sizeof(*m->residual));
+    m->used = malloc(port_count * sizeof(*m->used));
+    m->top = malloc(port_count * sizeof(*m->top));
+    m->unfrozen = malloc(port_count * sizeof(*m->unfrozen));
+    m->heap = malloc(port_count * sizeof(*m->heap));
+    m->heap_pos = malloc(port_count * sizeof(*m->heap_pos));
+    m->port_mark = calloc(port_count, sizeof(*m->port_mark));
+    m->comp_ports = malloc(port_count * sizeof(*m->comp_ports));
+    if (!m->capacity || !m->ports || !m->residual || !m->used || !m->top || !m->unfrozen || !m->heap || !m->heap_pos || !m->port_mark ||
+        !m->comp_ports) {
+        maxmin_free(m);
+        return -1;
+    }
+    memcpy(m->capacity, capacity, port_count * sizeof(*capacity));
+    return 0;
+}
+
+// Grows every array indexed by flow id together
+static int grow_flows(struct maxmin *m) {
+    uint32_t cap = m->flow_cap ? 2 * m->flow_cap : 1024;
+    struct maxmin_flow *flows = realloc(m->flows, cap * sizeof(*flows));
+    if (flows) m->flows = flows;
+    uint32_t *free_slots = realloc(m->free_slots, cap * sizeof(*free_slots));
+    if (free_slots) m->free_slots = free_slots;
+    uint32_t *flow_mark = realloc(m->flow_mark, cap * sizeof(*flow_mark));
+    if (flow_mark) m->flow_mark = flow_mark;
+    uint32_t *comp_flows = realloc(m->comp_flows, cap * sizeof(*comp_flows));
+    if (comp_flows) m->comp_flows = comp_flows;
+    struct maxmin_demand *by_demand = realloc(m->by_demand, cap * sizeof(*by_demand));
+    if (by_demand) m->by_demand = by_demand;
+    if (!flows || !free_slots || !flow_mark || !comp_flows || !by_demand) return -1;
+
+    memset(m->flow_mark + m->flow_cap, 0, (cap - m->flow_cap) * sizeof(*flow_mark));
+    m->flow_cap = cap;
+    return 0;
+}
+
+static int port_push(struct maxmin_port *p, uint32_t flow) {
+    if (p->count == p->cap) {
+        uint32_t cap = p->cap ? 2 * p->cap : 8;
+        uint32_t *flows = realloc(p->flows, cap * sizeof(*flows));
+        if (!flows) return -1;
+        p->flows = flows;
+        p->cap = cap;
+    }
+    p->flows[p->count++] = flow;
+    return 0;
+}
+
+static void port_remove(struct maxmin_port *p, uint32_t flow) {
+    for (uint32_t i = 0; i < p->count; i++) {
+        if (p->flows[i] == flow) {
+            p->flows[i] = p->flows[--p->count];
+            return;
+        }
+    }
+}
+
+int maxmin_add(struct maxmin *m, const uint32_t *ports, int hops, double demand) {
+    if (hops < 1 || hops > MAXMIN_MAX_HOPS) return -1;
+    for (int i = 0; i < hops; i++) {
+        if (ports[i] >= m->port_count) return -1;
+    }
+    uint32_t id;
+    if (m->free_count) {
+        id = m->free_slots[--m->free_count];
+    } else {
+        if (m->flow_slots == m->flow_cap && grow_flows(m) < 0) return -1;
+        id = m->flow_slots++;
+    }
+
+    struct maxmin_flow *f = &m->flows[id];
+    memcpy(f->hops, ports, hops * sizeof(*ports));
+    f->hop_count = hops;
+    f->demand = demand > 0 ? demand : 0;
+    f->rate = 0;
+    for (int i = 0; i < hops; i++) {
+        if (port_push(&m->ports[ports[i]], id) < 0) {
+            while (i--) port_remove(&m->ports[ports[i]], id);
+            f->hop_count = 0;
+            m->free_slots[m->free_count++] = id;
+            return -1;
+        }
+    }
+    m->live++;
+    return id;
+}
+
+// Ports are ordered by capacity left per unfrozen flow
+static double share(const struct maxmin *m, uint32_t port) {
+    return m->residual[port] / m->unfrozen[port];
+}
+
+static void heap_swap(struct maxmin *m, uint32_t i, uint32_t j) {
+    uint32_t a = m->heap[i], b = m->heap[j];
+    m->heap[i] = b;
+    m->heap[j] = a;
+    m->heap_pos[a] = j;
+    m->heap_pos[b] = i;
+}
+
+static void sift_up(struct maxmin *m, uint32_t i) {
+    while (i > 0) {
+        uint32_t parent = (i - 1) / 2;
+        if (share(m, m->heap[parent]) <= share(m, m->heap[i])) break;
+        heap_swap(m, i, parent);
+        i = parent;
+    }
+}
+
+static void sift_down(struct maxmin *m, uint32_t i) {
+    for (;;) {
+        uint32_t l = 2 * i + 1, r = l + 1, min = i;
+        if (l < m->heap_len && share(m, m->heap[l]) < share(m, m->heap[min])) min = l;
+        if (r < m->heap_len && share(m, m->heap[r]) < share(m, m->heap[min])) min = r;
+        if (min == i) break;
+        heap_swap(m, i, min);
+        i = min;
+    }
+}
+
+static void heap_remove(struct maxmin *m, uint32_t port) {
+    uint32_t i = m->heap_pos[port];
+    m->heap_len--;
+    if (i == m->heap_len) return;
+    heap_swap(m, i, m->heap_len);
+    sift_up(m, i);
+    sift_down(m, i);
+}
+
+/* Fixes the rate of an unfrozen flow and takes it out of its ports. Flows
+ * being filled are marked with the epoch while unfrozen, epoch + 1 after. */
+static void freeze(struct maxmin *m, uint32_t id, double rate, uint32_t bottleneck) {
+    struct maxmin_flow *f = &m->flows[id];
+    f->rate = rate;
+    f->bottleneck = bottleneck;
+    m->flow_mark[id] = m->epoch + 1;
+    for (int i = 0; i < f->hop_count; i++) {
+        uint32_t p = f->hops[i];
+        m->residual[p] -= rate;
+        if (m->residual[p] < 0) m->residual[p] = 0;
+        if (--m->unfrozen[p] == 0) {
+            heap_remove(m, p);
+        } else {
+            // Shares only grow, except by rounding
+            uint32_t pos = m->heap_pos[p];
+            sift_down(m, pos);
+            sift_up(m, m->heap_pos[p]);
+        }
+    }
+}
+
+static int by_demand_cmp(const void *a, const void *b) {
+    double x = ((const struct maxmin_demand *)a)->demand, y = ((const struct maxmin_demand *)b)->demand;
+    return x < y ? -1 : x > y;
+}
+
+/* Progressive filling of the flows in comp_flows (marked with the current
+ * epoch) over the ports in comp_ports, which must hold every port those
+ * flows cross. Flows outside the set keep their rates and use up capacity. */
+static void fill(struct maxmin *m, uint32_t nflows, uint32_t nports) {
+    uint32_t epoch = m->epoch, demands = 0;
+
+    m->heap_len = 0;
+    for (uint32_t i = 0; i < nports; i++) {
+        uint32_t p = m->comp_ports[i];
+        const struct maxmin_port *port = &m->ports[p];
+        double residual = m->capacity[p];
+        uint32_t unfrozen = 0;
+        for (uint32_t j = 0; j < port->count; j++) {
+            uint32_t f = port->flows[j];
+            if (m->flow_mark[f] == epoch) unfrozen++;
+            else residual -= m->flows[f].rate;
+        }
+        m->residual[p] = residual > 0 ? residual : 0;
+        m->unfrozen[p] = unfrozen;
+        if (unfrozen) {
+            m->heap_pos[p] = m->heap_len;
+            m->heap[m->heap_len++] = p;
+        }
+    }
+    for (uint32_t i = m->heap_len / 2; i-- > 0;) sift_down(m, i);
+
+    for (uint32_t i = 0; i < nflows; i++) {
+        uint32_t f = m->comp_flows[i];
+        if (m->flows[f].demand > 0) m->by_demand[demands++] = (struct maxmin_demand){m->flows[f].demand, f};
+    }
+    if (demands > 1) qsort(m->by_demand, demands, sizeof(*m->by_demand), by_demand_cmp);
+
+    uint32_t next = 0;
+    while (m->heap_len) {
+        uint32_t p = m->heap[0];
+        double level = share(m, p);
+        while (next < demands && m->flow_mark[m->by_demand[next].flow] != epoch) next++;
+        if (next < demands && m->by_demand[next].demand <= level) {
+            freeze(m, m->by_demand[next].flow, m->by_demand[next].demand, MAXMIN_DEMAND);
+            next++;
+            continue;
+        }
+        // p is the bottleneck of all its unfrozen flows; the last freeze pops it
+        const struct maxmin_port *port = &m->ports[p];
+        for (uint32_t j = 0; j < port->count && m->unfrozen[p]; j++) {
+            uint32_t f = port->flows[j];
+            if (m->flow_mark[f] == epoch) freeze(m, f, level, p);
+        }
+    }
+    m->last_flows = nflows;
+    m->last_ports = nports;
+}
+
+void maxmin_solve(struct maxmin *m) {
+    uint32_t nflows = 0, nports = 0, epoch = m->epoch += 2;
+
+    for (uint32_t f = 0; f < m->flow_slots; f++) {
+        if (!m->flows[f].hop_count) continue;
+        m->flow_mark[f] = epoch;
+        m->comp_flows[nflows++] = f;
+    }
+    for (uint32_t p = 0; p < m->port_count; p++) {
+        if (m->ports[p].count) m->comp_ports[nports++] = p;
+    }
+    fill(m, nflows, nports);
+}
+
+static void join(struct maxmin *m, uint32_t f, uint32_t *nflows) {
+    m->flow_mark[f] = m->epoch + 1;
+    m->comp_flows[(*nflows)++] = f;
+}
+
+static int joined(const struct maxmin *m, uint32_t f) {
+    return m->flow_mark[f] == m->epoch || m->flow_mark[f] == m->epoch + 1;
+}
+
+// Adds the ports of flows from comp_flows[first] on that are not in yet
+static void join_ports(struct maxmin *m, uint32_t first, uint32_t nflows, uint32_t *nports) {
+    for (uint32_t i = first; i < nflows; i++) {
+        const struct maxmin_flow *fl = &m->flows[m->comp_flows[i]];
+        for (int k = 0; k < fl->hop_count; k++) {
+            uint32_t q = fl->hops[k];
+            if (m->port_mark[q] == m->epoch) continue;
+            m->port_mark[q] = m->epoch;
+            m->comp_ports[(*nports)++] = q;
+        }
+    }
+}
+
+/* After a fill, finds the flows outside the filled set that lost their
+ * bottleneck on a port it touched (or cross a port now over capacity), and
+ * those that keep a filled flow from being the largest at its bottleneck.
+ * They join the set; returns how many did. */
+static uint32_t check(struct maxmin *m, uint32_t *nflows, uint32_t *nports) {
+    uint32_t before = *nflows, ports = *nports;
+
+    for (uint32_t i = 0; i < ports; i++) {
+        uint32_t q = m->comp_ports[i];
+        const struct maxmin_port *port = &m->ports[q];
+        double used = 0, top = 0;
+        for (uint32_t j = 0; j < port->count; j++) {
+            double r = m->flows[port->flows[j]].rate;
+            used += r;
+            if (r > top) top = r;
+        }
+        m->used[q] = used;
+        m->top[q] = top;
+    }
+    for (uint32_t i = 0; i < ports; i++) {
+        uint32_t q = m->comp_ports[i];
+        const struct maxmin_port *port = &m->ports[q];
+        int over = m->used[q] > m->capacity[q] * (1 + EPS);
+        double low = INFINITY;   // smallest filled flow short of the top at its bottleneck q
+        for (uint32_t j = 0; j < port->count; j++) {
+            uint32_t f = port->flows[j];
+            const struct maxmin_flow *fl = &m->flows[f];
+            if (joined(m, f)) {
+                if (fl->bottleneck == q && fl->rate < m->top[q] * (1 - EPS) && fl->rate < low) low = fl->rate;
+                continue;
+            }
+            uint32_t b = fl->bottleneck;
+            if (over) {
+                join(m, f, nflows);
+            } else if (b != MAXMIN_DEMAND && m->port_mark[b] == m->epoch) {
+                if (m->used[b] < m->capacity[b] * (1 - EPS) || fl->rate < m->top[b] * (1 - EPS)) join(m, f, nflows);
+            }
+        }
+        if (low == INFINITY) continue;
+        // Flows outside that get more at that bottleneck
+        for (uint32_t j = 0; j < port->count; j++) {
+            uint32_t f = port->flows[j];
+            if (!joined(m, f) && m->flows[f].rate * (1 - EPS) > low) join(m, f, nflows);
+        }
+    }
+    join_ports(m, before, *nflows, nports);
+    return *nflows - before;
+}
+
+/* Fills again the flows at or above `level` on the ports of `path` (plus
+ * `extra` if it is a flow id) with every other rate fixed, then widens the
+ * set until the allocation passes check(). */
+static void refill(struct maxmin *m, const uint32_t *path, int hops, double level, int extra) {
+    uint32_t nflows = 0, nports = 0;
+    double threshold = level - EPS * level;
+
+    m->epoch += 2;
+    for (int i = 0; i < hops; i++) {
+        if (m->port_mark[path[i]] == m->epoch) continue;
+        m->port_mark[path[i]] = m->epoch;
+        m->comp_ports[nports++] = path[i];
+    }
+    if (extra >= 0) join(m, extra, &nflows);
+    for (int i = 0; i < hops; i++) {
+        const struct maxmin_port *port = &m->ports[path[i]];
+        for (uint32_t j = 0; j < port->count; j++) {
+            uint32_t f = port->flows[j];
+            if (!joined(m, f) && m->flows[f].rate >= threshold) join(m, f, &nflows);
+        }
+    }
+    join_ports(m, 0, nflows, &nports);
+
+    uint64_t work = 0;
+    for (;;) {
+        for (uint32_t i = 0; i < nflows; i++) m->flow_mark[m->comp_flows[i]] = m->epoch;
+        fill(m, nflows, nports);
+        work += nflows;
+        if (!check(m, &nflows, &nports)) break;
+        // Another round would cost more than solving everything
+        if (work + nflows > m->live || nports > m->port_count / 2) {
+            maxmin_solve(m);
+            return;
+        }
+        // Start over with the larger set under a new epoch
+        m->epoch += 2;
+        for (uint32_t i = 0; i < nports; i++) m->port_mark[m->comp_ports[i]] = m->epoch;
+    }
+}
+
+static int rate_cmp(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/* Level at which `port` saturates once flow `id` (currently at rate 0) is
+ * added: the smallest t with sum(min(rate, t)) + t >= capacity over the
+ * other flows crossing it. */
+static double saturation_level(struct maxmin *m, uint32_t port, uint32_t id) {
+    const struct maxmin_port *p = &m->ports[port];
+    if (p->count > m->sort_cap) {
+        size_t cap = p->count * 2;
+        double *buf = realloc(m->sort_buf, cap * sizeof(*buf));
+        if (!buf) return 0;   // forces a larger refill, which is still exact
+        m->sort_buf = buf;
+        m->sort_cap = cap;
+    }
+    uint32_t k = 0;
+    double total = 0, top = 0;
+    for (uint32_t j = 0; j < p->count; j++) {
+        if (p->flows[j] == id) continue;
+        double r = m->flows[p->flows[j]].rate;
+        m->sort_buf[k++] = r;
+        total += r;
+        if (r > top) top = r;
+    }
+    double capacity = m->capacity[port];
+    // Usually the new flow's level is above every current rate
+    if (capacity - total >= top) return capacity - total;
+
+    qsort(m->sort_buf, k, sizeof(*m->sort_buf), rate_cmp);
+    double below = 0;
+    for (uint32_t j = 0; j < k; j++) {
+        double t = (capacity - below) / (k - j + 1);
+        if (t <= m->sort_buf[j]) return t > 0 ? t : 0;
+        below += m->sort_buf[j];
+    }
+    return 0;
+}
+
+int maxmin_arrive(struct maxmin *m, const uint32_t *ports, int hops, double demand) {
+    int id = maxmin_add(m, ports, hops, demand);
+    if (id < 0) return -1;
+
+    double level = demand > 0 ? demand : INFINITY;
+    for (int i = 0; i < hops; i++) {
+        double t = saturation_level(m, ports[i], id);
+        if (t < level) level = t;
+    }
+    refill(m, ports, hops, level, id);
+    return id;
+}
+
+void maxmin_depart(struct maxmin *m, int flow) {
+    struct maxmin_flow *f = &m->flows[flow];
+    uint32_t hops[MAXMIN_MAX_HOPS];
+    int count = f->hop_count;
+    if (!count) return;
+    memcpy(hops, f->hops, count * sizeof(*hops));
+
+    // Only flows at or above the lowest saturated level on the path can gain
+    double level = INFINITY;
+    for (int i = 0; i < count; i++) {
+        const struct maxmin_port *p = &m->ports[hops[i]];
+        double used = 0, top = 0;
+        for (uint32_t j = 0; j < p->count; j++) {
+            double r = m->flows[p->flows[j]].rate;
+            used += r;
+            if (r > top) top = r;
+        }
+        if (used >= m->capacity[hops[i]] * (1 - EPS) && top < level) level = top;
+    }
+
+    for (int i = 0; i < count; i++) port_remove(&m->ports[hops[i]], flow);
+    f->hop_count = 0;
+    f->rate = 0;
+    m->free_slots[m->free_count++] = flow;
+    m->live--;
+    if (level == INFINITY) {
+        m->last_flows = m->last_ports = 0;
+        return;
+    }
+    refill(m, hops, count, level, -1);
+}
+
+void maxmin_free(struct maxmin *m) {
+    if (m->ports) {
+        for (uint32_t p = 0; p < m->port_count; p++) free(m->ports[p].flows);
+    }
+    free(m->capacity);
+    free(m->ports);
+    free(m->flows);
+    free(m->free_slots);
+    free(m->residual);
+    free(m->used);
+    free(m->top);
+    free(m->unfrozen);
+    free(m->heap);
+    free(m->heap_pos);
+    free(m->port_mark);
+    free(m->flow_mark);
+    free(m->comp_flows);
+    free(m->comp_ports);
+    free(m->by_demand);
+    free(m->sort_buf);
+    memset(m, 0, sizeof(*m));
+}
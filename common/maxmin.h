@@ -0,0 +1,119 @@
+#ifndef MAXMIN_H
+#define MAXMIN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Max-min fair bandwidth allocation over the ports of a topology.
+ *
+ * Each flow follows a fixed path (a list of directed ports, as in
+ * topology.h) and may have a demand; flows without one are elastic, like
+ * long TCP transfers. maxmin_solve() runs progressive filling: all
+ * unfrozen flows grow together, and whenever a port runs out of capacity
+ * (the port with the smallest capacity left per unfrozen flow, kept in an
+ * indexed heap) or a flow reaches its demand, those flows are frozen at the
+ * current rate. Each flow is frozen once and each port's flow list scanned
+ * once, so a solve costs O(hops log ports) per flow.
+ *
+ * Arrivals and departures are recomputed incrementally. Flows below the
+ * first level at which the change can matter (where a port on the changed
+ * path saturates, computed from the current rates) keep their rate; the
+ * flows above it on the path are filled again against the capacity the
+ * others leave. An allocation is max-min fair exactly when every flow is at
+ * its demand or has a full bottleneck port where no flow gets more, so the
+ * ports the refill touched are checked for that, flows that no longer
+ * satisfy it join the refilled set, and this repeats until none are left.
+ * Each flow remembers the port that froze it, which makes the check cheap.
+ *
+ * Updates are cheap when the effect stays local (demand-limited flows,
+ * lightly loaded or partitioned traffic). When most flows are elastic and
+ * bottlenecked at host links, a change ripples through most of the fabric
+ * in ever smaller steps; once the refills of an update add up to a full
+ * solve, or it has touched half the ports, a full solve is done instead.
+ *
+ *     struct maxmin m;
+ *     maxmin_init(&m, port_count, capacity);
+ *     for (...) maxmin_add(&m, path, hops, 0);
+ *     maxmin_solve(&m);
+ *     int f = maxmin_arrive(&m, path, hops, 0);  // rates are current again
+ *     maxmin_depart(&m, f);
+ *
+ * Rates use the unit of the capacities (Gbit/s for topology links).
+ */
+
+#define MAXMIN_MAX_HOPS 8      // host-to-host across a 3-tier Clos is 6
+#define MAXMIN_DEMAND UINT32_MAX
+
+struct maxmin_flow {
+    uint32_t hops[MAXMIN_MAX_HOPS];
+    uint8_t hop_count;         // 0 for a free slot
+    double demand;             // 0 for elastic
+    double rate;
+    uint32_t bottleneck;       // port that froze the flow, MAXMIN_DEMAND if its demand did
+};
+
+struct maxmin_port {
+    uint32_t *flows;           // flows crossing the port, unordered
+    uint32_t count, cap;
+};
+
+struct maxmin_demand {
+    double demand;
+    uint32_t flow;
+};
+
+struct maxmin {
+    uint32_t port_count;
+    double *capacity;
+    struct maxmin_port *ports;
+
+    struct maxmin_flow *flows;
+    uint32_t flow_slots;       // slots in use or freed
+    uint32_t flow_cap;
+    uint32_t live;             // flows in the allocation
+    uint32_t *free_slots;
+    uint32_t free_count;
+
+    // Scratch for a fill: residual capacity and unfrozen flows per port,
+    // the port heap, and epoch marks for the flows and ports involved
+    double *residual;
+    double *used, *top;        // load and largest rate per port, for checks
+    uint32_t *unfrozen;
+    uint32_t *heap, *heap_pos;
+    uint32_t heap_len;
+    uint32_t *port_mark, *flow_mark;
+    uint32_t epoch;
+    uint32_t *comp_flows, *comp_ports;
+    struct maxmin_demand *by_demand;
+    double *sort_buf;
+    size_t sort_cap;
+
+    // Size of the last fill, to see how much an incremental update redid
+    uint32_t last_flows, last_ports;
+};
+
+/* Copies the per-port capacities. Returns -1 if memory runs out. */
+int maxmin_init(struct maxmin *m, uint32_t port_count, const double *capacity);
+
+/* Adds a flow without updating rates (for bulk loading before
+ * maxmin_solve()). Returns the flow id, or -1 if the path is empty, longer
+ * than MAXMIN_MAX_HOPS or memory runs out. Ids of departed flows are reused. */
+int maxmin_add(struct maxmin *m, const uint32_t *ports, int hops, double demand);
+
+/* Recomputes every rate from scratch. */
+void maxmin_solve(struct maxmin *m);
+
+/* Adds a flow and updates the rates it affects; rates must be current. */
+int maxmin_arrive(struct maxmin *m, const uint32_t *ports, int hops, double demand);
+
+/* Removes a flow and updates the rates it affected; rates must be current. */
+void maxmin_depart(struct maxmin *m, int flow);
+
+static inline double maxmin_rate(const struct maxmin *m, int flow) {
+    return m->flows[flow].rate;
+}
+
+void maxmin_free(struct maxmin *m);
+
+#endif
@@ -0,0 +1,334 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "maxmin.h"
+#include "topology.h"
+
+/**
+ * Max-min fair solver benchmark.
+ * First checks maxmin_solve() against a plain progressive-filling reference
+ * (raising every unfrozen flow step by step, no heap) on small random
+ * leaf-spine and binary tree instances with and without demands, and
+ * checks that every flow is at its demand or has a saturated bottleneck
+ * port where no flow gets more. Then runs random arrivals and departures
+ * and compares every incremental update with a full solve.
+ *
+ * The timings route 10^5 and 10^6 random host pairs over a 32-spine,
+ * 63-leaf fabric (ECMP) and over a binary tree, then report the full solve
+ * time and the mean time and size of incremental updates, with all flows
+ * elastic and with 90% of them rate-limited.
+ *
+ * Build: gcc -O2 maxmin_bench.c maxmin.c topology.c -o maxmin_bench -lm
+ */
+
+#define CHECK_ROUNDS 200
+#define CHURN_EVENTS 100
+#define TOL 1e-6
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rnd(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint32_t below(uint32_t n) {
+    return (uint32_t)(((rnd() >> 32) * n) >> 32);
+}
+
+struct path {
+    uint32_t ports[MAXMIN_MAX_HOPS];
+    int hops;
+    double demand;
+};
+
+static double uniform01(void) {
+    return (rnd() >> 11) / 9007199254740992.0;
+}
+
+/* Random distinct host pairs, routed with a random ECMP hash per flow.
+ * Pairs are routed grouped by destination switch so the router keeps its
+ * BFS for the whole group. */
+static void make_paths(const struct topology *t, struct topo_router *r, struct path *paths, uint32_t count,
+                       double demand_share, double max_demand) {
+    uint32_t *src = malloc(count * sizeof(*src)), *dst = malloc(count * sizeof(*dst));
+    uint32_t *order = malloc(count * sizeof(*order)), *start = calloc(t->node_count + 1, sizeof(*start));
+
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t s = below(t->host_count), d = below(t->host_count - 1);
+        if (d >= s) d++;
+        src[i] = topo_host_node(t, s);
+        dst[i] = topo_host_node(t, d);
+        start[t->nodes[dst[i]].uplink + 1]++;
+        paths[i].demand = uniform01() < demand_share ? max_demand * (uniform01() + 0.01) : 0;
+    }
+    for (uint32_t n = 0; n < t->node_count; n++) start[n + 1] += start[n];
+    for (uint32_t i = 0; i < count; i++) order[start[t->nodes[dst[i]].uplink]++] = i;
+    for (uint32_t k = 0; k < count; k++) {
+        uint32_t i = order[k];
+        paths[i].hops = topo_route(r, src[i], dst[i], (uint32_t)rnd(), paths[i].ports, MAXMIN_MAX_HOPS);
+    }
+    free(src);
+    free(dst);
+    free(order);
+    free(start);
+}
+
+static double *capacities(const struct topology *t) {
+    double *c = malloc(2 * (size_t)t->link_count * sizeof(*c));
+    for (uint32_t l = 0; l < t->link_count; l++) c[2 * l] = c[2 * l + 1] = t->links[l].gbps;
+    return c;
+}
+
+/* Reference: raise the common level of the unfrozen flows to the next point
+ * where a port fills or a demand is met, freeze those flows, repeat. */
+static void reference(const struct path *paths, uint32_t n, const double *cap, uint32_t ports, double *rate) {
+    char *frozen = calloc(n, 1);
+    double *used = malloc(ports * sizeof(*used));
+    uint32_t *count = malloc(ports * sizeof(*count));
+    double level = 0;
+    uint32_t left = n;
+
+    while (left) {
+        memset(used, 0, ports * sizeof(*used));
+        memset(count, 0, ports * sizeof(*count));
+        for (uint32_t i = 0; i < n; i++) {
+            for (int h = 0; h < paths[i].hops; h++) {
+                if (frozen[i]) used[paths[i].ports[h]] += rate[i];
+                else count[paths[i].ports[h]]++;
+            }
+        }
+        double next = INFINITY;
+        for (uint32_t p = 0; p < ports; p++) {
+            if (count[p] && (cap[p] - used[p]) / count[p] < next) next = (cap[p] - used[p]) / count[p];
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (!frozen[i] && paths[i].demand > 0 && paths[i].demand < next) next = paths[i].demand;
+        }
+        level = next > level ? next : level;
+        for (uint32_t i = 0; i < n; i++) {
+            if (frozen[i]) continue;
+            int stop = paths[i].demand > 0 && paths[i].demand <= level * (1 + 1e-12);
+            for (int h = 0; h < paths[i].hops && !stop; h++) {
+                uint32_t p = paths[i].ports[h];
+                stop = cap[p] - used[p] - level * count[p] <= 1e-12 * cap[p];
+            }
+            if (stop) {
+                rate[i] = level;
+                frozen[i] = 1;
+                left--;
+            }
+        }
+    }
+    free(frozen);
+    free(used);
+    free(count);
+}
+
+// Every flow is at its demand or the largest on a full port, and no port is over
+static int is_max_min(const struct maxmin *m) {
+    double *used = calloc(m->port_count, sizeof(*used)), *top = calloc(m->port_count, sizeof(*top));
+    int ok = 1;
+
+    for (uint32_t f = 0; f < m->flow_slots; f++) {
+        const struct maxmin_flow *fl = &m->flows[f];
+        for (int h = 0; h < fl->hop_count; h++) {
+            used[fl->hops[h]] += fl->rate;
+            if (fl->rate > top[fl->hops[h]]) top[fl->hops[h]] = fl->rate;
+        }
+    }
+    for (uint32_t p = 0; p < m->port_count; p++) ok &= used[p] <= m->capacity[p] * (1 + TOL);
+    for (uint32_t f = 0; f < m->flow_slots && ok; f++) {
+        const struct maxmin_flow *fl = &m->flows[f];
+        if (!fl->hop_count || (fl->demand > 0 && fl->rate >= fl->demand * (1 - TOL))) continue;
+        int bottleneck = 0;
+        for (int h = 0; h < fl->hop_count && !bottleneck; h++) {
+            uint32_t p = fl->hops[h];
+            bottleneck = used[p] >= m->capacity[p] * (1 - TOL) && fl->rate >= top[p] * (1 - TOL);
+        }
+        ok = bottleneck;
+    }
+    free(used);
+    free(top);
+    return ok;
+}
+
+static int same_rates(const struct maxmin *a, const struct maxmin *b, const int *ids, uint32_t n) {
+    for (uint32_t i = 0; i < n; i++) {
+        if (ids[i] < 0) continue;
+        double x = a->flows[ids[i]].rate, y = b->flows[ids[i]].rate;
+        if (fabs(x - y) > TOL * (1 + fabs(y))) return 0;
+    }
+    return 1;
+}
+
+static int check(const struct topology *t, const char *name) {
+    uint32_t ports = 2 * t->link_count;
+    double *cap = capacities(t);
+    struct topo_router r;
+    int failures = 0;
+
+    topo_router_init(&r, t);
+    for (int round = 0; round < CHECK_ROUNDS; round++) {
+        uint32_t n = 1 + below(300);
+        struct path *paths = malloc(n * sizeof(*paths));
+        double *want = malloc(n * sizeof(*want));
+        int *ids = malloc(n * sizeof(*ids));
+        struct maxmin m, fresh;
+
+        make_paths(t, &r, paths, n, round % 2 ? 0.3 : 0, 0.05);
+        reference(paths, n, cap, ports, want);
+        maxmin_init(&m, ports, cap);
+        for (uint32_t i = 0; i < n; i++) ids[i] = maxmin_add(&m, paths[i].ports, paths[i].hops, paths[i].demand);
+        maxmin_solve(&m);
+        for (uint32_t i = 0; i < n; i++) {
+            if (fabs(m.flows[ids[i]].rate - want[i]) > TOL * (1 + want[i])) {
+                if (failures++ < 5) printf("MISMATCH %s round %d flow %u: %g, reference %g\n", name, round, i,
+                                           m.flows[ids[i]].rate, want[i]);
+                break;
+            }
+        }
+        if (!is_max_min(&m) && failures++ < 5) printf("NOT MAX-MIN %s round %d\n", name, round);
+
+        // Churn: depart a random flow or arrive a new one, compare with a full solve
+        for (int e = 0; e < 40; e++) {
+            uint32_t i = below(n);
+            if (ids[i] >= 0) {
+                maxmin_depart(&m, ids[i]);
+                ids[i] = -1;
+            } else {
+                make_paths(t, &r, &paths[i], 1, round % 2 ? 0.3 : 0, 0.05);
+                ids[i] = maxmin_arrive(&m, paths[i].ports, paths[i].hops, paths[i].demand);
+            }
+            // Same ids in a fresh solver: freed slots get a placeholder, dropped before solving
+            maxmin_init(&fresh, ports, cap);
+            for (uint32_t f = 0; f < m.flow_slots; f++) {
+                const struct maxmin_flow *fl = &m.flows[f];
+                if (fl->hop_count) maxmin_add(&fresh, fl->hops, fl->hop_count, fl->demand);
+                else maxmin_add(&fresh, paths[0].ports, paths[0].hops, 0);
+            }
+            for (uint32_t f = 0; f < m.flow_slots; f++) {
+                if (!m.flows[f].hop_count) maxmin_depart(&fresh, f);
+            }
+            maxmin_solve(&fresh);
+            if ((!same_rates(&m, &fresh, ids, n) || !is_max_min(&m)) && failures++ < 5) {
+                printf("INCREMENTAL MISMATCH %s round %d event %d\n", name, round, e);
+            }
+            maxmin_free(&fresh);
+        }
+        maxmin_free(&m);
+        free(paths);
+        free(want);
+        free(ids);
+    }
+    topo_router_free(&r);
+    free(cap);
+    return failures;
+}
+
+/* Alternates departures of random flows with arrivals on new paths, then
+ * reports the mean update time and the largest deviation from a full
+ * solve. */
+static void churn(struct maxmin *m, const struct path *arrivals, int *ids, uint32_t n, int events) {
+    double arrive = 0, depart = 0, t0;
+    uint64_t arrive_flows = 0, depart_flows = 0;
+
+    for (int e = 0; e < events; e++) {
+        uint32_t i = below(n);
+        t0 = now_sec();
+        maxmin_depart(m, ids[i]);
+        depart += now_sec() - t0;
+        depart_flows += m->last_flows;
+        t0 = now_sec();
+        ids[i] = maxmin_arrive(m, arrivals[e].ports, arrivals[e].hops, 0);
+        arrive += now_sec() - t0;
+        arrive_flows += m->last_flows;
+    }
+
+    double *rate = malloc(n * sizeof(*rate)), worst = 0;
+    for (uint32_t i = 0; i < n; i++) rate[i] = m->flows[ids[i]].rate;
+    maxmin_solve(m);
+    for (uint32_t i = 0; i < n; i++) {
+        double exact = m->flows[ids[i]].rate, err = fabs(rate[i] - exact) / exact;
+        if (err > worst) worst = err;
+    }
+    free(rate);
+    printf("%-12s %8s incremental: arrival %9.1f us (%7.0f flows refilled), departure %9.1f us (%7.0f), off by %.1e\n",
+           "", "", arrive / events * 1e6, (double)arrive_flows / events, depart / events * 1e6,
+           (double)depart_flows / events, worst);
+}
+
+/* `demand_share` of the flows are rate-limited (up to 10 Mbit/s), the
+ * others elastic. */
+static void bench(const struct topology *t, const char *name, uint32_t n, double demand_share) {
+    uint32_t ports = 2 * t->link_count;
+    double *cap = capacities(t);
+    struct path *paths = malloc((n + CHURN_EVENTS) * sizeof(*paths));
+    int *ids = malloc(n * sizeof(*ids));
+    struct topo_router r;
+    struct maxmin m;
+
+    topo_router_init(&r, t);
+    make_paths(t, &r, paths, n + CHURN_EVENTS, demand_share, 0.01);
+    maxmin_init(&m, ports, cap);
+    for (uint32_t i = 0; i < n; i++) ids[i] = maxmin_add(&m, paths[i].ports, paths[i].hops, paths[i].demand);
+
+    double t0 = now_sec();
+    maxmin_solve(&m);
+    double solve = now_sec() - t0;
+
+    double total = 0, low = INFINITY;
+    for (uint32_t i = 0; i < n; i++) {
+        total += m.flows[ids[i]].rate;
+        if (m.flows[ids[i]].rate < low) low = m.flows[ids[i]].rate;
+    }
+    printf("%-12s %8u flows, %3.0f%% limited: solve %8.1f ms (%5.2f M flows/s), total %7.1f Gbit/s, min %.3f Mbit/s\n",
+           name, n, demand_share * 100, solve * 1e3, n / solve / 1e6, total, low * 1e3);
+
+    churn(&m, paths + n, ids, n, n > 200000 ? CHURN_EVENTS / 5 : CHURN_EVENTS);
+
+    maxmin_free(&m);
+    topo_router_free(&r);
+    free(paths);
+    free(ids);
+    free(cap);
+}
+
+int main(void) {
+    struct topology small_fabric, small_tree, fabric, tree;
+    char err[128];
+
+    if (topo_leaf_spine(&small_fabric, 3, 5, 4, 16, err, sizeof(err)) < 0 ||
+        topo_binary_tree(&small_tree, 4, 3, err, sizeof(err)) < 0 ||
+        topo_leaf_spine(&fabric, 32, 63, 31, 64, err, sizeof(err)) < 0 ||
+        topo_binary_tree(&tree, 4, 256, err, sizeof(err)) < 0) {
+        printf("%s\n", err);
+        return 1;
+    }
+    int failures = check(&small_fabric, "leaf-spine") + check(&small_tree, "tree");
+    printf("Reference check: %s\n", failures ? "FAILED" : "solver, incremental updates and reference agree");
+    if (failures) return 1;
+
+    printf("\n");
+    bench(&fabric, "leaf-spine", 100000, 0);
+    bench(&fabric, "leaf-spine", 1000000, 0);
+    bench(&fabric, "leaf-spine", 100000, 0.9);
+    bench(&fabric, "leaf-spine", 1000000, 0.9);
+    bench(&tree, "tree", 100000, 0);
+    bench(&tree, "tree", 1000000, 0);
+    topo_free(&small_fabric);
+    topo_free(&small_tree);
+    topo_free(&fabric);
+    topo_free(&tree);
+    return 0;
+}
@@ -0,0 +1,397 @@
+#include "netsim.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POOL_CHUNK 4096
+
+static void pool_init(struct sim_pool *p, size_t size) {
+    memset(p, 0, sizeof(*p));
+    p->size = size;
+}
+
+static void *pool_get(struct sim_pool *p) {
+    void *obj = p->free;
+    if (obj) {
+        p->free = *(void **)obj;
+    } else {
+        if (!p->chunk_count || p->used_in_chunk == POOL_CHUNK) {
+            void **chunks = realloc(p->chunks, (p->chunk_count + 1) * sizeof(*chunks));
+            if (!chunks) return NULL;
+            p->chunks = chunks;
+            if (!(chunks[p->chunk_count] = malloc(POOL_CHUNK * p->size))) return NULL;
+            p->chunk_count++;
+            p->used_in_chunk = 0;
+        }
+        obj = (char *)p->chunks[p->chunk_count - 1] + p->used_in_chunk++ * p->size;
+    }
+    if (++p->live > p->peak) p->peak = p->live;
+    return obj;
+}
+
+// The first word of a free object links the free list
+static void pool_put(struct sim_pool *p, void *obj) {
+    *(void **)obj = p->free;
+    p->free = obj;
+    p->live--;
+}
+
+static void pool_free(struct sim_pool *p) {
+    for (size_t i = 0; i < p->chunk_count; i++) free(p->chunks[i]);
+    free(p->chunks);
+    memset(p, 0, sizeof(*p));
+}
+
+// xorshift64*
+static uint64_t rnd(struct netsim *s) {
+    s->rng ^= s->rng >> 12;
+    s->rng ^= s->rng << 25;
+    s->rng ^= s->rng >> 27;
+    return s->rng * 2685821657736338717ull;
+}
+
+static double uniform01(struct netsim *s) {
+    return ((rnd(s) >> 11) + 0.5) / 9007199254740992.0;
+}
+
+static void schedule(struct netsim *s, struct sim_event *ev, sim_time at) {
+    ev->node.time = at;
+    calq_push(&s->events, &ev->node);
+}
+
+static int build_fib(struct netsim *s, char *err, size_t err_size) {
+    const struct topology *t = s->t;
+    struct topo_router r;
+    uint32_t *edge_node;
+
+    s->edge_of = malloc(t->node_count * sizeof(*s->edge_of));
+    edge_node = malloc(t->node_count * sizeof(*edge_node));
+    if (!s->edge_of || !edge_node || topo_router_init(&r, t) < 0) {
+        free(edge_node);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+    for (uint32_t n = 0; n < t->node_count; n++) s->edge_of[n] = UINT32_MAX;
+    for (uint32_t n = 0; n < t->node_count; n++) {
+        if (t->nodes[n].role != TOPO_HOST) continue;
+        uint32_t sw = t->nodes[n].uplink;
+        if (s->edge_of[sw] == UINT32_MAX) {
+            s->edge_of[sw] = s->edges;
+            edge_node[s->edges++] = sw;
+        }
+    }
+
+    size_t cells = (size_t)t->node_count * s->edges, used = 0, cap = cells + 1;
+    s->fib_start = malloc(cells * sizeof(*s->fib_start));
+    s->fib_len = calloc(cells, sizeof(*s->fib_len));
+    s->fib = malloc(cap * sizeof(*s->fib));
+    int rc = 0;
+    if (!s->fib_start || !s->fib_len || !s->fib) {
+        snprintf(err, err_size, "out of memory");
+        rc = -1;
+    }
+    for (uint32_t e = 0; e < s->edges && rc == 0; e++) {
+        topo_router_target(&r, edge_node[e]);
+        for (uint32_t n = 0; n < t->node_count && rc == 0; n++) {
+            if (t->nodes[n].role == TOPO_HOST) continue;
+            uint32_t len;
+            const uint32_t *group = topo_router_group(&r, n, &len);
+            if (len > 255) {
+                snprintf(err, err_size, "more than 255 equal-cost next hops");
+                rc = -1;
+                break;
+            }
+            if (used + len > cap) {
+                cap = 2 * (used + len);
+                uint32_t *fib = realloc(s->fib, cap * sizeof(*fib));
+                if (!fib) {
+                    snprintf(err, err_size, "out of memory");
+                    rc = -1;
+                    break;
+                }
+                s->fib = fib;
+            }
+            size_t cell = (size_t)n * s->edges + e;
+            s->fib_start[cell] = (uint32_t)used;
+            s->fib_len[cell] = (uint8_t)len;
+            memcpy(s->fib + used, group, len * sizeof(*group));
+            used += len;
+        }
+    }
+    topo_router_free(&r);
+    free(edge_node);
+    return rc;
+}
+
+int netsim_init(struct netsim *s, const struct topology *t, const struct netsim_config *cfg, char *err,
+                size_t err_size) {
+    memset(s, 0, sizeof(*s));
+    s->t = t;
+    s->cfg = *cfg;
+    s->rng = cfg->seed ? cfg->seed : 1;
+    s->port_count = 2 * t->link_count;
+    s->ports = calloc(s->port_count, sizeof(*s->ports));
+    if (!s->ports || calq_init(&s->events) < 0) {
+        netsim_free(s);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+    for (uint32_t p = 0; p < s->port_count; p++) {
+        const struct topo_link *l = &t->links[p >> 1];
+        s->ports[p].arrival.type = EV_ARRIVAL;
+        s->ports[p].ps_per_byte = 8000.0 / l->gbps;
+        s->ports[p].delay = (sim_time)(l->delay_ms * NETSIM_MS + 0.5);
+    }
+    pool_init(&s->packets, sizeof(struct sim_packet));
+    pool_init(&s->sources, sizeof(struct sim_source));
+    pool_init(&s->timers, sizeof(struct sim_timer));
+    if (build_fib(s, err, err_size) < 0) {
+        netsim_free(s);
+        return -1;
+    }
+    return 0;
+}
+
+// Log-linear: 64 buckets per power of two
+static uint32_t latency_bucket(uint64_t ns) {
+    if (ns < 64) return (uint32_t)ns;
+    int e = 63 - __builtin_clzll(ns);
+    return (uint32_t)((e - 5) * 64 + ((ns >> (e - 6)) & 63));
+}
+
+double netsim_latency_ns(const struct netsim *s, double q) {
+    uint64_t want = (uint64_t)ceil(q * s->delivered), seen = 0;
+    if (!s->delivered) return 0;
+    if (want < 1) want = 1;
+    for (uint32_t b = 0; b < NETSIM_LATENCY_BUCKETS; b++) {
+        seen += s->latency[b];
+        if (seen < want) continue;
+        if (b < 64) return b;
+        int e = b / 64 + 5;
+        return (double)((64 + (b & 63) + 1) * (1ull << (e - 6)));
+    }
+    return 0;
+}
+
+/* Adds the backlog curve since the last change to the queue area: the
+ * unsent work falls at the link rate until the port is idle. */
+static void queue_changed(struct netsim *s, struct sim_port *q) {
+    if (q->free_at > q->last_change) {
+        double w = (double)(q->free_at - q->last_change), dt = (double)(s->now - q->last_change);
+        double area = dt >= w ? w * w / 2 : (2 * w - dt) * dt / 2;
+        q->queue_area += area / q->ps_per_byte;
+    }
+    q->last_change = s->now;
+}
+
+/* RED drop decision on arrival (Floyd and Jacobson 1993): the average
+ * decays over idle time as if small packets had been sent meanwhile. */
+static int red_drop(struct netsim *s, struct sim_port *q, uint32_t backlog) {
+    const struct netsim_config *c = &s->cfg;
+    if (q->free_at < s->now) {
+        double m = (s->now - q->free_at) / (1500 * q->ps_per_byte);
+        q->avg *= pow(1 - c->red_weight, m);
+    } else {
+        q->avg += c->red_weight * (backlog - q->avg);
+    }
+    if (q->avg < c->red_min) {
+        q->count = -1;
+        return 0;
+    }
+    if (q->avg >= c->red_max) {
+        q->count = 0;
+        return 1;
+    }
+    q->count++;
+    double pb = c->red_max_p * (q->avg - c->red_min) / (c->red_max - c->red_min);
+    double pa = q->count * pb < 1 ? pb / (1 - q->count * pb) : 1;
+    if (uniform01(s) < pa) {
+        q->count = 0;
+        return 1;
+    }
+    return 0;
+}
+
+static void enqueue(struct netsim *s, uint32_t port, struct sim_packet *p) {
+    struct sim_port *q = &s->ports[port];
+    uint32_t backlog = netsim_backlog(q, s->now);
+
+    if (backlog + p->bytes > s->cfg.buffer_bytes || (s->cfg.queue == NETSIM_RED && red_drop(s, q, backlog))) {
+        q->drops++;
+        s->dropped++;
+        if (s->on_drop) s->on_drop(s, p, port);
+        pool_put(&s->packets, p);
+        return;
+    }
+    queue_changed(s, q);
+    if (backlog + p->bytes > q->max_queued_bytes) q->max_queued_bytes = backlog + p->bytes;
+    q->tx_packets++;
+    q->tx_bytes += p->bytes;
+
+    sim_time start = q->free_at > s->now ? q->free_at : s->now;
+    q->free_at = start + (sim_time)(p->bytes * q->ps_per_byte + 0.5);
+    p->due = q->free_at + q->delay;
+    p->next = NULL;
+    if (q->tail) {
+        q->tail->next = p;
+    } else {
+        q->head = p;
+        schedule(s, &q->arrival, p->due);
+    }
+    q->tail = p;
+}
+
+static void arrive(struct netsim *s, uint32_t port) {
+    const struct topology *t = s->t;
+    struct sim_port *q = &s->ports[port];
+    struct sim_packet *p = q->head;
+    uint32_t n = topo_port_to(t, port);
+
+    q->head = p->next;
+    if (q->head) schedule(s, &q->arrival, q->head->due);
+    else q->tail = NULL;
+
+    if (n == p->dst) {
+        sim_time latency = s->now - p->sent;
+        s->delivered++;
+        s->delivered_bytes += p->bytes;
+        s->latency_sum += latency;
+        s->latency[latency_bucket(latency / 1000)]++;
+        if (s->on_deliver) s->on_deliver(s, p);
+        pool_put(&s->packets, p);
+        return;
+    }
+    uint32_t last = t->nodes[p->dst].uplink;
+    if (n == last) {
+        port = topo_host_downlink(t, p->dst);
+    } else {
+        size_t cell = (size_t)n * s->edges + s->edge_of[last];
+        port = s->fib[s->fib_start[cell] + p->hash % s->fib_len[cell]];
+    }
+    enqueue(s, port, p);
+}
+
+// Injects the source's next packet at its host and schedules the one after
+static void emit(struct netsim *s, struct sim_source *src) {
+    struct sim_packet *p = pool_get(&s->packets);
+    uint32_t uplink = topo_host_uplink(s->t, src->src);
+
+    if (p) {
+        p->src = src->src;
+        p->dst = src->dst;
+        p->bytes = src->bytes;
+        p->hash = src->hash;
+        p->flow = src->flow;
+        p->sent = s->now;
+        s->sent++;
+        enqueue(s, uplink, p);
+    }
+    if (src->remaining != UINT64_MAX && --src->remaining == 0) {
+        pool_put(&s->sources, src);
+        return;
+    }
+    double gap = src->gap;
+    if (gap == 0) gap = src->bytes * s->ports[uplink].ps_per_byte;
+    else if (src->poisson) gap *= -log(uniform01(s));
+    sim_time next = s->now + (sim_time)(gap + 0.5);
+    if (src->remaining == UINT64_MAX && next >= src->stop) {
+        pool_put(&s->sources, src);
+        return;
+    }
+    schedule(s, &src->ev, next);
+}
+
+static struct sim_source *new_source(struct netsim *s, uint32_t src, uint32_t dst, uint32_t bytes) {
+    struct sim_source *so = pool_get(&s->sources);
+    if (!so) return NULL;
+    memset(so, 0, sizeof(*so));
+    so->ev.type = EV_SOURCE;
+    so->src = src;
+    so->dst = dst;
+    so->bytes = bytes;
+    so->hash = (uint32_t)(rnd(s) >> 32);
+    so->flow = s->source_count++;
+    return so;
+}
+
+struct sim_source *netsim_source(struct netsim *s, uint32_t src, uint32_t dst, uint32_t bytes, double gbps,
+                                 sim_time start, sim_time stop, int poisson) {
+    struct sim_source *so = new_source(s, src, dst, bytes);
+    if (!so) return NULL;
+    so->gap = bytes * 8000.0 / gbps;
+    so->poisson = poisson;
+    so->remaining = UINT64_MAX;
+    so->stop = stop;
+    // Poisson sources start at a random point of their first gap
+    sim_time first = start + (poisson ? (sim_time)(so->gap * -log(uniform01(s))) : 0);
+    if (first >= stop) {
+        pool_put(&s->sources, so);
+        return so;
+    }
+    schedule(s, &so->ev, first);
+    return so;
+}
+
+struct sim_source *netsim_burst(struct netsim *s, uint32_t src, uint32_t dst, uint32_t bytes, uint64_t count,
+                                sim_time start) {
+    struct sim_source *so = new_source(s, src, dst, bytes);
+    if (!so) return NULL;
+    so->remaining = count ? count : 1;
+    schedule(s, &so->ev, start);
+    return so;
+}
+
+int netsim_at(struct netsim *s, sim_time at, netsim_fn fn, void *arg) {
+    struct sim_timer *tm = pool_get(&s->timers);
+    if (!tm) return -1;
+    tm->ev.type = EV_TIMER;
+    tm->fn = fn;
+    tm->arg = arg;
+    schedule(s, &tm->ev, at);
+    return 0;
+}
+
+void netsim_run(struct netsim *s, sim_time until) {
+    struct cq_node *n;
+
+    while ((n = calq_peek(&s->events)) && n->time <= until) {
+        calq_pop(&s->events);
+        s->now = n->time;
+        s->events_run++;
+        struct sim_event *ev = (struct sim_event *)n;
+        switch (ev->type) {
+        case EV_ARRIVAL:
+            arrive(s, (uint32_t)((struct sim_port *)((char *)ev - offsetof(struct sim_port, arrival)) - s->ports));
+            break;
+        case EV_SOURCE:
+            emit(s, (struct sim_source *)ev);
+            break;
+        case EV_TIMER: {
+            struct sim_timer *tm = (struct sim_timer *)ev;
+            netsim_fn fn = tm->fn;
+            void *arg = tm->arg;
+            pool_put(&s->timers, tm);
+            fn(s, arg);
+            break;
+        }
+        }
+    }
+    if (s->now < until && until != UINT64_MAX) s->now = until;
+    for (uint32_t p = 0; p < s->port_count; p++) queue_changed(s, &s->ports[p]);
+}
+
+void netsim_free(struct netsim *s) {
+    free(s->ports);
+    free(s->edge_of);
+    free(s->fib_start);
+    free(s->fib_len);
+    free(s->fib);
+    calq_free(&s->events);
+    pool_free(&s->packets);
+    pool_free(&s->sources);
+    pool_free(&s->timers);
+    memset(s, 0, sizeof(*s));
+}
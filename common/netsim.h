@@ -0,0 +1,188 @@
+#ifndef NETSIM_H
+#define NETSIM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "calqueue.h"
+#include "topology.h"
+
+/**
+ * Packet-level discrete-event simulator for the topologies of topology.h.
+ *
+ * Every directed port has a FIFO output queue (drop-tail or RED) drained at
+ * the link rate, then the link delay. Switches forward with precomputed
+ * shortest-path ECMP tables, picking group[hash % size] with the packet's
+ * flow hash; hosts only send and receive. There is no transport: sources
+ * emit packets at a constant or Poisson rate, or back to back at the NIC
+ * rate for a given count (a burst, e.g. one sender of an incast).
+ *
+ * A FIFO port at a fixed rate sends each accepted packet at a time known on
+ * enqueue: when the port frees up, or at once if idle. So a port keeps only
+ * `free_at`, the end of its last accepted transmission, and the backlog at
+ * any moment is the unsent work (free_at - now) in bytes, counting what is
+ * left of the packet on the wire. Accepted packets go straight into the
+ * port's in-order list of packets waiting or in flight, stamped with their
+ * arrival at the far end, and only the first is scheduled. A packet hop is
+ * thus one event, with no separate end-of-transmission events.
+ *
+ * The event set is a calendar queue (calqueue.h) ordered by time in
+ * picoseconds. Events are intrusive: each port carries the event for the
+ * next arrival off its link and each source the event for its next packet,
+ * so the event set holds at most one entry per port and per source however
+ * many packets are in flight, and the hot path allocates nothing. Packets,
+ * sources and timers (callbacks at a given time) come from pools that
+ * recycle freed objects.
+ *
+ *     struct netsim s;
+ *     struct netsim_config cfg = NETSIM_DEFAULTS;
+ *     netsim_init(&s, &topo, &cfg, err, sizeof(err));
+ *     netsim_source(&s, src, dst, 1500, 0.5, 0, NETSIM_MS, 1);   // 0.5 Gbit/s Poisson for 1 ms
+ *     netsim_run(&s, 2 * NETSIM_MS);
+ *     printf("%llu delivered\n", (unsigned long long)s.delivered);
+ */
+
+typedef uint64_t sim_time;     // picoseconds
+
+#define NETSIM_US 1000000ull
+#define NETSIM_MS 1000000000ull
+
+enum netsim_queue { NETSIM_DROPTAIL, NETSIM_RED };
+
+struct netsim_config {
+    enum netsim_queue queue;
+    uint32_t buffer_bytes;     // per port
+    // RED (Floyd and Jacobson): thresholds on the average queue in bytes,
+    // drop probability at max_th, and the averaging weight
+    uint32_t red_min, red_max;
+    double red_max_p, red_weight;
+    uint64_t seed;
+};
+
+#define NETSIM_DEFAULTS {NETSIM_DROPTAIL, 256 * 1024, 30 * 1024, 90 * 1024, 0.1, 0.002, 1}
+
+enum netsim_event_type { EV_ARRIVAL, EV_SOURCE, EV_TIMER };
+
+struct sim_event {
+    struct cq_node node;
+    uint8_t type;              // enum netsim_event_type
+};
+
+struct sim_packet {
+    struct sim_packet *next;   // in a port's list
+    sim_time due;              // arrival at the far end of the link
+    uint32_t src, dst;         // hosts
+    uint32_t bytes;
+    uint32_t hash;             // flow hash for ECMP
+    uint32_t flow;             // caller's id, e.g. a source or a burst
+    sim_time sent;
+};
+
+struct sim_port {
+    struct sim_event arrival;
+    struct sim_packet *head, *tail;   // accepted and not yet arrived, in order
+    sim_time free_at;          // end of the last accepted transmission
+    double ps_per_byte;
+    sim_time delay;
+    // RED state
+    double avg;
+    int count;
+    // Statistics
+    uint64_t tx_packets, tx_bytes, drops;
+    uint32_t max_queued_bytes;
+    double queue_area;         // backlog integrated over time (byte * ps)
+    sim_time last_change;
+};
+
+/* Bytes accepted by the port and not yet sent at time `now`. */
+static inline uint32_t netsim_backlog(const struct sim_port *q, sim_time now) {
+    return q->free_at > now ? (uint32_t)((q->free_at - now) / q->ps_per_byte + 0.5) : 0;
+}
+
+struct sim_source {
+    struct sim_event ev;
+    uint32_t src, dst, bytes, hash, flow;
+    double gap;                // mean picoseconds between packets; 0 for back to back
+    int poisson;
+    uint64_t remaining;        // packets left, UINT64_MAX while before `stop`
+    sim_time stop;
+};
+
+struct netsim;
+typedef void (*netsim_fn)(struct netsim *s, void *arg);
+
+struct sim_timer {
+    struct sim_event ev;
+    netsim_fn fn;
+    void *arg;
+};
+
+// Chunked allocator with a free list
+struct sim_pool {
+    size_t size;               // object size
+    void *free;
+    void **chunks;
+    size_t chunk_count, used_in_chunk;
+    uint64_t live, peak;
+};
+
+#define NETSIM_LATENCY_BUCKETS (64 * 64)
+
+struct netsim {
+    const struct topology *t;
+    struct netsim_config cfg;
+    struct calq events;
+    sim_time now;
+    struct sim_port *ports;
+    uint32_t port_count;
+
+    // Forwarding: for switch n and edge switch e, ports fib[fib_start[n * edges + e] ...] of length fib_len
+    uint32_t *edge_of;         // node -> edge switch index, UINT32_MAX if it has no hosts
+    uint32_t edges;
+    uint32_t *fib_start;
+    uint8_t *fib_len;
+    uint32_t *fib;
+
+    struct sim_pool packets, sources, timers;
+    uint32_t source_count;
+    uint64_t rng;
+
+    // Called for every delivered or dropped packet before it is freed (optional)
+    void (*on_deliver)(struct netsim *s, const struct sim_packet *p);
+    void (*on_drop)(struct netsim *s, const struct sim_packet *p, uint32_t port);
+    void *user;
+
+    // Totals
+    uint64_t events_run, sent, delivered, delivered_bytes, dropped;
+    uint64_t latency[NETSIM_LATENCY_BUCKETS];   // log-linear histogram in nanoseconds
+    double latency_sum;        // picoseconds
+};
+
+/* Builds the ports and forwarding tables. Returns -1 with a message in `err`
+ * if a switch has more than 255 equal-cost next hops or memory runs out. */
+int netsim_init(struct netsim *s, const struct topology *t, const struct netsim_config *cfg, char *err,
+                size_t err_size);
+
+/* Packets of `bytes` from host src to host dst at `gbps` (Poisson or
+ * constant spacing) from `start` until `stop`. Returns the source, or NULL
+ * if memory runs out; sources are numbered from 0 in `flow`, which their
+ * packets carry, and each gets a random flow hash. */
+struct sim_source *netsim_source(struct netsim *s, uint32_t src, uint32_t dst, uint32_t bytes, double gbps,
+                                 sim_time start, sim_time stop, int poisson);
+
+/* `count` packets back to back at the sender's NIC rate from `start`. */
+struct sim_source *netsim_burst(struct netsim *s, uint32_t src, uint32_t dst, uint32_t bytes, uint64_t count,
+                                sim_time start);
+
+/* Calls fn(s, arg) at time `at`. Returns -1 if memory runs out. */
+int netsim_at(struct netsim *s, sim_time at, netsim_fn fn, void *arg);
+
+/* Runs events until the queue is empty or the next one is after `until`. */
+void netsim_run(struct netsim *s, sim_time until);
+
+/* Latency below which a fraction q of the delivered packets arrived, in ns
+ * (histogram bucket upper bound, within 1/64 of the value). */
+double netsim_latency_ns(const struct netsim *s, double q);
+
+void netsim_free(struct netsim *s);
+
+#endif
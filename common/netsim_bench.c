@@ -0,0 +1,339 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "calqueue.h"
+#include "netsim.h"
+#include "topology.h"
+
+/**
+ * Calendar queue and packet simulator benchmark.
+ * First checks the calendar queue against a binary heap ordered by
+ * (time, insertion number) through random hold operations with many equal
+ * times, growth and shrinkage, and peeks followed by earlier pushes. Then
+ * checks the simulator: a constant-rate flow below capacity must arrive
+ * complete with exactly the serialization plus propagation delay, two
+ * hosts at line rate into one must get about one link of goodput and lose
+ * about half, and sent packets must equal delivered plus dropped.
+ *
+ * The timings run the classic hold model (pop the earliest, push it back a
+ * random exponential time later) on the calendar queue and on a binary
+ * heap at several queue sizes, then simulate Poisson traffic between random
+ * host pairs on a leaf-spine fabric and a binary tree and report simulated
+ * packets and events per wall-clock second.
+ *
+ * Build: gcc -O2 netsim_bench.c netsim.c calqueue.c topology.c -o netsim_bench -lm
+ */
+
+#define CHECK_OPS 2000000
+#define HOLD_OPS 5000000
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ull;
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static uint64_t rnd(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+static uint32_t below(uint32_t n) {
+    return (uint32_t)(((rnd() >> 32) * n) >> 32);
+}
+
+static double exponential(double mean) {
+    return -mean * log(((rnd() >> 11) + 0.5) / 9007199254740992.0);
+}
+
+struct item {
+    struct cq_node node;
+    uint64_t seq;
+};
+
+// Binary min-heap of items by (time, seq)
+struct heap {
+    struct item **a;
+    size_t n;
+};
+
+static int before(const struct item *x, const struct item *y) {
+    return x->node.time < y->node.time || (x->node.time == y->node.time && x->seq < y->seq);
+}
+
+static void heap_push(struct heap *h, struct item *it) {
+    size_t i = h->n++;
+    while (i && before(it, h->a[(i - 1) / 2])) {
+        h->a[i] = h->a[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    h->a[i] = it;
+}
+
+static struct item *heap_pop(struct heap *h) {
+    struct item *top = h->a[0], *last = h->a[--h->n];
+    size_t i = 0;
+    for (;;) {
+        size_t c = 2 * i + 1;
+        if (c >= h->n) break;
+        if (c + 1 < h->n && before(h->a[c + 1], h->a[c])) c++;
+        if (!before(h->a[c], last)) break;
+        h->a[i] = h->a[c];
+        i = c;
+    }
+    if (h->n) h->a[i] = last;
+    return top;
+}
+
+/* Random pushes and pops with the queue growing to `peak` and draining
+ * again; times are coarse so that about a third collide. Every pop must
+ * match the heap, ties included. */
+static int check_calq(uint32_t peak, uint64_t grain) {
+    struct item *items = malloc(peak * sizeof(*items));
+    struct item **free_items = malloc(peak * sizeof(*free_items));
+    struct heap h = {malloc(peak * sizeof(*h.a)), 0};
+    struct calq q;
+    uint64_t now = 0, seq = 0;
+    uint32_t free_count = peak;
+    int failures = 0;
+
+    calq_init(&q);
+    for (uint32_t i = 0; i < peak; i++) free_items[i] = &items[peak - 1 - i];
+    for (int op = 0; op < CHECK_OPS && !failures; op++) {
+        // Grow for the first half of each cycle, drain for the second
+        int growing = (op / (4 * peak)) % 2 == 0 ? below(4) != 0 : below(4) == 0;
+        if (free_count && (growing || !h.n)) {
+            struct item *it = free_items[--free_count];
+            it->node.time = now + grain * below(64) + (below(8) ? 0 : below(grain));
+            it->seq = seq++;
+            calq_push(&q, &it->node);
+            heap_push(&h, it);
+        } else if (h.n) {
+            if (below(16) == 0) {
+                // Peek, then push something between now and the peeked time
+                struct item *p = (struct item *)calq_peek(&q);
+                if (p != h.a[0]) {
+                    printf("PEEK MISMATCH at op %d\n", op);
+                    failures++;
+                    break;
+                }
+                if (free_count && p->node.time > now) {
+                    struct item *it = free_items[--free_count];
+                    it->node.time = now + below((uint32_t)(p->node.time - now));
+                    it->seq = seq++;
+                    calq_push(&q, &it->node);
+                    heap_push(&h, it);
+                }
+            }
+            struct item *want = heap_pop(&h), *got = (struct item *)calq_pop(&q);
+            if (got != want) {
+                printf("POP MISMATCH at op %d: time %llu seq %llu, expected time %llu seq %llu\n", op,
+                       (unsigned long long)got->node.time, (unsigned long long)got->seq,
+                       (unsigned long long)want->node.time, (unsigned long long)want->seq);
+                failures++;
+            }
+            now = want->node.time;
+            free_items[free_count++] = want;
+        }
+        if (q.size != h.n && !failures) {
+            printf("SIZE MISMATCH at op %d\n", op);
+            failures++;
+        }
+    }
+    calq_free(&q);
+    free(items);
+    free(free_items);
+    free(h.a);
+    return failures;
+}
+
+static void hold(uint32_t size) {
+    struct item *items = malloc(size * sizeof(*items));
+    struct heap h = {malloc(size * sizeof(*h.a)), 0};
+    struct calq q;
+    double t0, cq_time, heap_time;
+
+    calq_init(&q);
+    for (uint32_t i = 0; i < size; i++) {
+        items[i].node.time = (uint64_t)exponential(1e6);
+        items[i].seq = i;
+        calq_push(&q, &items[i].node);
+    }
+    t0 = now_sec();
+    for (int op = 0; op < HOLD_OPS; op++) {
+        struct cq_node *n = calq_pop(&q);
+        n->time += (uint64_t)exponential(1e6);
+        calq_push(&q, n);
+    }
+    cq_time = now_sec() - t0;
+    calq_free(&q);
+
+    for (uint32_t i = 0; i < size; i++) {
+        items[i].node.time = (uint64_t)exponential(1e6);
+        heap_push(&h, &items[i]);
+    }
+    t0 = now_sec();
+    for (int op = 0; op < HOLD_OPS; op++) {
+        struct item *it = heap_pop(&h);
+        it->node.time += (uint64_t)exponential(1e6);
+        heap_push(&h, it);
+    }
+    heap_time = now_sec() - t0;
+
+    printf("hold %8u entries: calendar queue %6.1f M ops/s, binary heap %6.1f M ops/s\n", size,
+           HOLD_OPS / cq_time / 1e6, HOLD_OPS / heap_time / 1e6);
+    free(items);
+    free(h.a);
+}
+
+static sim_time expected_latency;
+static int latency_errors;
+
+static void exact_latency(struct netsim *s, const struct sim_packet *p) {
+    if (s->now - p->sent != expected_latency) latency_errors++;
+}
+
+static sim_time first_delivery;
+
+static void note_first(struct netsim *s, const struct sim_packet *p) {
+    (void)p;
+    if (!first_delivery) first_delivery = s->now;
+}
+
+static int check_netsim(void) {
+    struct topology tree, fabric;
+    struct netsim s;
+    struct netsim_config cfg = NETSIM_DEFAULTS;
+    char err[128];
+    int failures = 0;
+
+    if (topo_binary_tree(&tree, 2, 0, err, sizeof(err)) < 0 ||
+        topo_leaf_spine(&fabric, 2, 3, 2, 16, err, sizeof(err)) < 0) {
+        printf("%s\n", err);
+        return 1;
+    }
+
+    // h1 to h2 over the tree: four 1 Gbit/s hops without delay, never queued
+    if (netsim_init(&s, &tree, &cfg, err, sizeof(err)) < 0) {
+        printf("%s\n", err);
+        return 1;
+    }
+    s.on_deliver = exact_latency;
+    expected_latency = 4 * 1500 * 8000ull;
+    netsim_source(&s, topo_host_node(&tree, 0), topo_host_node(&tree, 1), 1500, 0.5, 0, 10 * NETSIM_MS, 0);
+    netsim_run(&s, UINT64_MAX);
+    if (s.sent != 417 || s.delivered != s.sent || s.dropped || latency_errors) {
+        printf("CBR: sent %llu, delivered %llu, dropped %llu, %d wrong latencies\n", (unsigned long long)s.sent,
+               (unsigned long long)s.delivered, (unsigned long long)s.dropped, latency_errors);
+        failures++;
+    }
+    netsim_free(&s);
+
+    /* Two hosts on other leaves into one at 1 Gbit/s each for 20 ms, run
+     * until the queues drain. Hops: 1 Gbit/s + 0.5 ms, 10 Gbit/s + 1 ms,
+     * 10 Gbit/s + 1 ms, then the shared 1 Gbit/s downlink + 0.5 ms. */
+    for (int red = 0; red < 2; red++) {
+        cfg.queue = red ? NETSIM_RED : NETSIM_DROPTAIL;
+        if (netsim_init(&s, &fabric, &cfg, err, sizeof(err)) < 0) {
+            printf("%s\n", err);
+            return 1;
+        }
+        sim_time duration = 20 * NETSIM_MS;
+        s.on_deliver = note_first;
+        first_delivery = 0;
+        netsim_source(&s, topo_host_node(&fabric, 2), topo_host_node(&fabric, 0), 1500, 1, 0, duration, 0);
+        netsim_source(&s, topo_host_node(&fabric, 4), topo_host_node(&fabric, 0), 1500, 1, 0, duration, 0);
+        netsim_run(&s, UINT64_MAX);
+        double goodput = s.delivered_bytes * 8.0 / ((s.now - first_delivery) / 1000.0);
+        double loss = (double)s.dropped / s.sent;
+        uint32_t downlink = topo_host_downlink(&fabric, topo_host_node(&fabric, 0));
+        if (goodput < 0.95 || goodput > 1.01 || loss < 0.4 || loss > 0.6 || s.ports[downlink].drops != s.dropped ||
+            s.sent != s.delivered + s.dropped || s.packets.live) {
+            printf("INCAST %s: goodput %.3f Gbit/s, loss %.3f, sent %llu, delivered %llu, dropped %llu\n",
+                   red ? "red" : "droptail", goodput, loss, (unsigned long long)s.sent,
+                   (unsigned long long)s.delivered, (unsigned long long)s.dropped);
+            failures++;
+        }
+        netsim_free(&s);
+    }
+    topo_free(&tree);
+    topo_free(&fabric);
+    return failures;
+}
+
+/* Every host sends Poisson traffic of 1500-byte packets at `load` of its
+ * link for `ms` milliseconds to another host, each receiving from one. */
+static void bench(const struct topology *t, const char *name, double load, int ms) {
+    struct netsim s;
+    struct netsim_config cfg = NETSIM_DEFAULTS;
+    char err[128];
+
+    if (netsim_init(&s, t, &cfg, err, sizeof(err)) < 0) {
+        printf("%s\n", err);
+        return;
+    }
+    // Random permutation; a host drawn as its own peer swaps with a neighbour
+    uint32_t *peer = malloc(t->host_count * sizeof(*peer));
+    for (uint32_t h = 0; h < t->host_count; h++) peer[h] = h;
+    for (uint32_t h = t->host_count - 1; h > 0; h--) {
+        uint32_t j = below(h + 1), x = peer[h];
+        peer[h] = peer[j];
+        peer[j] = x;
+    }
+    for (uint32_t h = 0; h < t->host_count; h++) {
+        if (peer[h] != h) continue;
+        uint32_t o = (h + 1) % t->host_count, x = peer[o];
+        peer[o] = peer[h];
+        peer[h] = x;
+    }
+    for (uint32_t h = 0; h < t->host_count; h++) {
+        uint32_t src = topo_host_node(t, h);
+        double gbps = t->links[topo_host_uplink(t, src) >> 1].gbps;
+        netsim_source(&s, src, topo_host_node(t, peer[h]), 1500, load * gbps, 0, (sim_time)ms * NETSIM_MS, 1);
+    }
+    free(peer);
+    double t0 = now_sec();
+    netsim_run(&s, UINT64_MAX);
+    double wall = now_sec() - t0;
+    printf("%-10s %5u hosts, load %.1f, %3d ms: %9llu packets, %5.2f%% dropped, p50/p99 latency %6.1f/%6.1f us, "
+           "%5.2f M packets/s, %5.1f M events/s\n",
+           name, t->host_count, load, ms, (unsigned long long)s.sent, 100.0 * s.dropped / s.sent,
+           netsim_latency_ns(&s, 0.5) / 1e3, netsim_latency_ns(&s, 0.99) / 1e3, s.sent / wall / 1e6,
+           s.events_run / wall / 1e6);
+    netsim_free(&s);
+}
+
+int main(void) {
+    struct topology fabric, tree;
+    char err[128];
+
+    int failures = check_calq(64, 1000) + check_calq(5000, 1000) + check_calq(5000, 1) + check_calq(100000, 37);
+    printf("Calendar queue check: %s\n", failures ? "FAILED" : "same order as the heap, ties first in first out");
+    int sim_failures = check_netsim();
+    printf("Simulator check: %s\n", sim_failures ? "FAILED" : "latency, goodput, loss and packet counts as expected");
+    if (failures || sim_failures) return 1;
+
+    printf("\n");
+    hold(1000);
+    hold(100000);
+    hold(1000000);
+
+    if (topo_leaf_spine(&fabric, 8, 16, 24, 64, err, sizeof(err)) < 0 ||
+        topo_binary_tree(&tree, 5, 8, err, sizeof(err)) < 0) {
+        printf("%s\n", err);
+        return 1;
+    }
+    printf("\n");
+    bench(&fabric, "leaf-spine", 0.5, 20);
+    bench(&fabric, "leaf-spine", 0.9, 20);
+    bench(&tree, "tree", 0.2, 20);
+    topo_free(&fabric);
+    topo_free(&tree);
+    return 0;
+}
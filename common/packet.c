@@ -0,0 +1,351 @@
+#include <string.h>
+#include <arpa/inet.h>
+#include <net/ethernet.h>
+#include "checksum.h"
+#include "packet.h"
+
+// Builder stages, in wire order
+#define STAGE_EMPTY 0
+#define STAGE_L2 1
+#define STAGE_L3 2
+#define STAGE_L3_OPT 3
+#define STAGE_L4 4
+#define STAGE_L4_OPT 5
+#define STAGE_PAYLOAD 6
+
+/* Reserve `len` zeroed bytes at the end of the packet, NULL if they do not fit. */
+static uint8_t *reserve(struct pkt_builder *b, size_t len) {
+    if (b->error || b->len + len > b->cap) {
+        b->error = 1;
+        return NULL;
+    }
+    uint8_t *p = b->buf + b->len;
+    memset(p, 0, len);
+    b->len += len;
+    return p;
+}
+
+static int fail(struct pkt_builder *b) {
+    b->error = 1;
+    return -1;
+}
+
+/* Pad IPv4 options to a 32-bit boundary and set IHL. */
+static void close_l3(struct pkt_builder *b) {
+    if (b->stage != STAGE_L3_OPT || b->l3 != 4) return;
+    size_t pad = (4 - (b->len - b->l3_off) % 4) % 4;
+    if (reserve(b, pad) == NULL) return;   // EOL padding is all zeros
+    size_t hlen = b->len - b->l3_off;
+    if (hlen > 60) {
+        b->error = 1;
+        return;
+    }
+    b->buf[b->l3_off] = 0x40 | (uint8_t)(hlen / 4);
+}
+
+/* Pad TCP options to a 32-bit boundary and set the data offset. */
+static void close_l4(struct pkt_builder *b) {
+    if (b->l4 != IPPROTO_TCP || (b->stage != STAGE_L4 && b->stage != STAGE_L4_OPT)) return;
+    size_t pad = (4 - (b->len - b->l4_off) % 4) % 4;
+    if (reserve(b, pad) == NULL) return;
+    size_t hlen = b->len - b->l4_off;
+    if (hlen > 60) {
+        b->error = 1;
+        return;
+    }
+    b->buf[b->l4_off + 12] = (uint8_t)(hlen / 4) << 4;
+}
+
+/* Record the protocol of the L4 header in the IP header (or last extension header). */
+static void link_l4(struct pkt_builder *b, uint8_t proto) {
+    if (b->l3 == 4) b->buf[b->l3_off + 9] = proto;
+    else if (b->l3 == 6) b->buf[b->next_hdr_off] = proto;
+    b->l4 = proto;
+}
+
+/* Common preamble for L4 headers: check ordering and close the L3 layer. */
+static uint8_t *begin_l4(struct pkt_builder *b, uint8_t proto, size_t hlen) {
+    if (b->error || (b->stage != STAGE_EMPTY && b->stage != STAGE_L3 && b->stage != STAGE_L3_OPT)) {
+        b->error = 1;
+        return NULL;
+    }
+    close_l3(b);
+    size_t off = b->len;
+    uint8_t *p = reserve(b, hlen);
+    if (p == NULL) return NULL;
+    b->l4_off = off;
+    link_l4(b, proto);
+    b->stage = STAGE_L4;
+    return p;
+}
+
+/* Common preamble for L3 headers: check ordering and point the EtherType of
+ * the link header, if any, at the new layer. */
+static uint8_t *begin_l3(struct pkt_builder *b, uint16_t ethertype, size_t hlen) {
+    if (b->stage != STAGE_EMPTY && b->stage != STAGE_L2) {
+        b->error = 1;
+        return NULL;
+    }
+    size_t off = b->len;
+    uint8_t *p = reserve(b, hlen);
+    if (p == NULL) return NULL;
+    if (b->stage == STAGE_L2) {
+        b->buf[b->type_off] = ethertype >> 8;
+        b->buf[b->type_off + 1] = ethertype & 0xff;
+    }
+    b->l3_off = off;
+    b->stage = STAGE_L3;
+    return p;
+}
+
+void pkt_init(struct pkt_builder *b, void *buf, size_t cap) {
+    memset(b, 0, sizeof(*b));
+    b->buf = buf;
+    b->cap = cap;
+}
+
+struct ether_header *pkt_eth(struct pkt_builder *b, const uint8_t *dst, const uint8_t *src, uint16_t ethertype) {
+    if (b->stage != STAGE_EMPTY) {
+        b->error = 1;
+        return NULL;
+    }
+    struct ether_header *eth = (struct ether_header *)reserve(b, sizeof(struct ether_header));
+    if (eth == NULL) return NULL;
+    memcpy(eth->ether_dhost, dst, ETH_ALEN);
+    memcpy(eth->ether_shost, src, ETH_ALEN);
+    eth->ether_type = htons(ethertype);
+    b->type_off = offsetof(struct ether_header, ether_type);
+    b->stage = STAGE_L2;
+    return eth;
+}
+
+int pkt_vlan(struct pkt_builder *b, uint16_t vlan_id, uint8_t pcp) {
+    if (b->stage != STAGE_L2) return fail(b);
+
+    // The tag goes in front of the EtherType it now encloses, which ends the packet
+    uint8_t *tag = b->buf + b->type_off;
+    uint8_t inner[2] = {tag[0], tag[1]};
+    if (reserve(b, 4) == NULL) return -1;
+    uint16_t tci = (uint16_t)(pcp & 7) << 13 | (vlan_id & 0x0fff);
+    tag[0] = ETHERTYPE_VLAN >> 8;
+    tag[1] = ETHERTYPE_VLAN & 0xff;
+    tag[2] = tci >> 8;
+    tag[3] = tci & 0xff;
+    tag[4] = inner[0];
+    tag[5] = inner[1];
+    b->type_off += 4;
+    return 0;
+}
+
+struct iphdr *pkt_ipv4(struct pkt_builder *b, in_addr_t src, in_addr_t dst, uint8_t ttl) {
+    struct iphdr *iph = (struct iphdr *)begin_l3(b, ETHERTYPE_IP, sizeof(struct iphdr));
+    if (iph == NULL) return NULL;
+    iph->version = 4;
+    iph->ihl = 5;
+    iph->ttl = ttl;
+    iph->saddr = src;
+    iph->daddr = dst;
+    b->l3 = 4;
+    return iph;
+}
+
+int pkt_ipv4_option(struct pkt_builder *b, const void *opt, size_t len) {
+    if (b->l3 != 4 || (b->stage != STAGE_L3 && b->stage != STAGE_L3_OPT)) return fail(b);
+    uint8_t *p = reserve(b, len);
+    if (p == NULL) return -1;
+    memcpy(p, opt, len);
+    b->stage = STAGE_L3_OPT;
+    return 0;
+}
+
+struct ip6_hdr *pkt_ipv6(struct pkt_builder *b, const struct in6_addr *src,
+                         const struct in6_addr *dst, uint8_t hop_limit) {
+    struct ip6_hdr *ip6 = (struct ip6_hdr *)begin_l3(b, ETHERTYPE_IPV6, sizeof(struct ip6_hdr));
+    if (ip6 == NULL) return NULL;
+    ip6->ip6_flow = htonl(6u << 28);
+    ip6->ip6_hlim = hop_limit;
+    ip6->ip6_nxt = IPPROTO_NONE;
+    ip6->ip6_src = *src;
+    ip6->ip6_dst = *dst;
+    b->l3 = 6;
+    b->next_hdr_off = b->l3_off + offsetof(struct ip6_hdr, ip6_nxt);
+    return ip6;
+}
+
+int pkt_ipv6_ext(struct pkt_builder *b, uint8_t type, const void *data, size_t len) {
+    if (b->l3 != 6 || (b->stage != STAGE_L3 && b->stage != STAGE_L3_OPT)) return fail(b);
+    if (type != IPPROTO_HOPOPTS && type != IPPROTO_ROUTING && type != IPPROTO_DSTOPTS) return fail(b);
+
+    size_t total = (2 + len + 7) & ~(size_t)7;
+    if (total / 8 - 1 > 255) return fail(b);
+    size_t off = b->len;
+    uint8_t *p = reserve(b, total);
+    if (p == NULL) return -1;
+
+    p[0] = IPPROTO_NONE;
+    p[1] = (uint8_t)(total / 8 - 1);
+    memcpy(p + 2, data, len);
+
+    // Option headers are padded with Pad1 / PadN; routing headers with zeros
+    size_t pad = total - 2 - len;
+    if (type != IPPROTO_ROUTING && pad >= 2) {
+        p[2 + len] = 1;
+        p[3 + len] = (uint8_t)(pad - 2);
+    }
+
+    b->buf[b->next_hdr_off] = type;
+    b->next_hdr_off = off;
+    b->stage = STAGE_L3_OPT;
+    return 0;
+}
+
+struct tcphdr *pkt_tcp(struct pkt_builder *b, uint16_t sport, uint16_t dport,
+                       uint32_t seq, uint32_t ack, uint8_t flags, uint16_t window) {
+    if (b->l3 == 0) {
+        b->error = 1;   // the TCP checksum needs the IP pseudo-header
+        return NULL;
+    }
+    struct tcphdr *tcph = (struct tcphdr *)begin_l4(b, IPPROTO_TCP, sizeof(struct tcphdr));
+    if (tcph == NULL) return NULL;
+    tcph->source = htons(sport);
+    tcph->dest = htons(dport);
+    tcph->seq = htonl(seq);
+    tcph->ack_seq = htonl(ack);
+    tcph->doff = 5;
+    ((uint8_t *)tcph)[13] = flags;
+    tcph->window = htons(window);
+    return tcph;
+}
+
+int pkt_tcp_option(struct pkt_builder *b, uint8_t kind, const void *data, size_t len) {
+    if (b->l4 != IPPROTO_TCP || (b->stage != STAGE_L4 && b->stage != STAGE_L4_OPT)) return fail(b);
+
+    // End-of-list and NOP are single bytes without a length field
+    size_t total = (kind == TCPOPT_EOL || kind == TCPOPT_NOP) ? 1 : 2 + len;
+    uint8_t *p = reserve(b, total);
+    if (p == NULL) return -1;
+    p[0] = kind;
+    if (total > 1) {
+        p[1] = (uint8_t)total;
+        memcpy(p + 2, data, len);
+    }
+    b->stage = STAGE_L4_OPT;
+    return 0;
+}
+
+int pkt_tcp_mss(struct pkt_builder *b, uint16_t mss) {
+    uint16_t v = htons(mss);
+    return pkt_tcp_option(b, TCPOPT_MAXSEG, &v, 2);
+}
+
+int pkt_tcp_wscale(struct pkt_builder *b, uint8_t shift) {
+    return pkt_tcp_option(b, TCPOPT_WINDOW, &shift, 1);
+}
+
+int pkt_tcp_sack_perm(struct pkt_builder *b) {
+    return pkt_tcp_option(b, TCPOPT_SACK_PERMITTED, NULL, 0);
+}
+
+int pkt_tcp_timestamp(struct pkt_builder *b, uint32_t tsval, uint32_t tsecr) {
+    uint32_t v[2] = {htonl(tsval), htonl(tsecr)};
+    return pkt_tcp_option(b, TCPOPT_TIMESTAMP, v, 8);
+}
+
+struct udphdr *pkt_udp(struct pkt_builder *b, uint16_t sport, uint16_t dport) {
+    if (b->l3 == 0) {
+        b->error = 1;
+        return NULL;
+    }
+    struct udphdr *udph = (struct udphdr *)begin_l4(b, IPPROTO_UDP, sizeof(struct udphdr));
+    if (udph == NULL) return NULL;
+    udph->source = htons(sport);
+    udph->dest = htons(dport);
+    return udph;
+}
+
+struct icmphdr *pkt_icmp(struct pkt_builder *b, uint8_t type, uint8_t code) {
+    if (b->l3 == 6) {
+        b->error = 1;
+        return NULL;
+    }
+    struct icmphdr *icmph = (struct icmphdr *)begin_l4(b, IPPROTO_ICMP, sizeof(struct icmphdr));
+    if (icmph == NULL) return NULL;
+    icmph->type = type;
+    icmph->code = code;
+    return icmph;
+}
+
+struct icmp6_hdr *pkt_icmp6(struct pkt_builder *b, uint8_t type, uint8_t code) {
+    if (b->l3 != 6) {
+        b->error = 1;
+        return NULL;
+    }
+    struct icmp6_hdr *icmp6 = (struct icmp6_hdr *)begin_l4(b, IPPROTO_ICMPV6, sizeof(struct icmp6_hdr));
+    if (icmp6 == NULL) return NULL;
+    icmp6->icmp6_type = type;
+    icmp6->icmp6_code = code;
+    return icmp6;
+}
+
+void *pkt_payload(struct pkt_builder *b, const void *data, size_t len) {
+    if (b->stage == STAGE_EMPTY) {
+        b->error = 1;
+        return NULL;
+    }
+    close_l3(b);
+    close_l4(b);
+    uint8_t *p = reserve(b, len);
+    if (p == NULL) return NULL;
+    if (data != NULL) memcpy(p, data, len);
+    b->stage = STAGE_PAYLOAD;
+    return p;
+}
+
+size_t pkt_finalize(struct pkt_builder *b, struct pkt_template *t) {
+    struct pkt_template local;
+    uint16_t v;
+
+    close_l3(b);
+    close_l4(b);
+    if (b->error || b->stage == STAGE_EMPTY) return 0;
+    b->stage = STAGE_PAYLOAD;
+
+    size_t l3_len = b->len - b->l3_off;
+    if (b->l3 == 4) {
+        if (l3_len > 0xffff) return 0;
+        v = htons((uint16_t)l3_len);
+        memcpy(b->buf + b->l3_off + 2, &v, 2);
+    } else if (b->l3 == 6) {
+        if (l3_len - 40 > 0xffff) return 0;
+        v = htons((uint16_t)(l3_len - 40));
+        memcpy(b->buf + b->l3_off + 4, &v, 2);
+    }
+    if (b->l4 == IPPROTO_UDP) {
+        v = htons((uint16_t)(b->len - b->l4_off));
+        memcpy(b->buf + b->l4_off + 4, &v, 2);
+    }
+
+    if (t == NULL) t = &local;
+    if (b->l3 == 0 && b->l4 == 0) {
+        memset(t, 0, sizeof(*t));   // link header and raw payload, e.g. ARP
+    } else if (b->l3 == 0) {
+        // Bare ICMP: no pseudo-header, the kernel supplies the IP header
+        memset(t, 0, sizeof(*t));
+        memset(b->buf + b->l4_off + 2, 0, 2);
+        v = inet_checksum(b->buf + b->l4_off, b->len - b->l4_off);
+        memcpy(b->buf + b->l4_off + 2, &v, 2);
+    } else if (b->l4 == 0) {
+        memset(t, 0, sizeof(*t));
+        if (b->l3 == 4) {
+            uint8_t *iph = b->buf + b->l3_off;
+            size_t hlen = (iph[0] & 0x0f) * 4;
+            memset(iph + 10, 0, 2);
+            v = inet_checksum(iph, hlen);
+            memcpy(iph + 10, &v, 2);
+        }
+    } else {
+        if (tmpl_init(t, b->buf + b->l3_off, l3_len) < 0) return 0;
+        tmpl_finalize(t);
+    }
+    return b->len;
+}
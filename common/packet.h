@@ -0,0 +1,87 @@
+#ifndef PACKET_H
+#define PACKET_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+#include <net/ethernet.h>
+#include <netinet/ip.h>
+#include <netinet/ip6.h>
+#include <netinet/tcp.h>
+#include <netinet/udp.h>
+#include <netinet/ip_icmp.h>
+#include <netinet/icmp6.h>
+#include "pkt_template.h"
+
+/**
+ * Layered packet builder writing into a caller-provided buffer.
+ *
+ * Layers are appended in wire order (optionally Ethernet and VLAN tags,
+ * IPv4/IPv6, options or extension headers, TCP/UDP/ICMP, payload). Each call returns a typed pointer to the header it
+ * wrote so the caller can tweak fields, or NULL if the buffer is too small or
+ * the layer is out of order; the error is sticky and pkt_finalize() then
+ * fails too. All multi-byte fields are written in network byte order.
+ * Lengths, TCP data offset and every checksum are filled in once by
+ * pkt_finalize(), as is the EtherType in front of the IP header. Nothing is
+ * allocated.
+ *
+ *     struct pkt_builder b;
+ *     pkt_init(&b, buf, sizeof(buf));
+ *     pkt_ipv4(&b, src, dst, 64);
+ *     pkt_tcp(&b, 12345, 80, seq, 0, TH_SYN, 5840);
+ *     pkt_tcp_mss(&b, 1460);
+ *     size_t len = pkt_finalize(&b, NULL);
+ */
+struct pkt_builder {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    size_t l3_off;         // offset of the IP header (0 without a link header)
+    size_t l4_off;         // offset of the L4 header
+    size_t next_hdr_off;   // IPv6: byte holding the "next header" of the last header
+    size_t type_off;       // Ethernet: the innermost EtherType field
+    uint8_t l3;            // 0, 4 or 6
+    uint8_t l4;            // 0 or IPPROTO_*
+    uint8_t stage;         // last layer written, enforces wire order
+    int error;
+};
+
+void pkt_init(struct pkt_builder *b, void *buf, size_t cap);
+
+/* Ethernet header. `ethertype` is kept for a raw payload (e.g. ARP) and
+ * replaced when an IP layer follows. */
+struct ether_header *pkt_eth(struct pkt_builder *b, const uint8_t *dst, const uint8_t *src, uint16_t ethertype);
+/* 802.1Q tag after the Ethernet header (or an outer tag, for QinQ) */
+int pkt_vlan(struct pkt_builder *b, uint16_t vlan_id, uint8_t pcp);
+
+struct iphdr *pkt_ipv4(struct pkt_builder *b, in_addr_t src, in_addr_t dst, uint8_t ttl);
+int pkt_ipv4_option(struct pkt_builder *b, const void *opt, size_t len);
+
+struct ip6_hdr *pkt_ipv6(struct pkt_builder *b, const struct in6_addr *src,
+                         const struct in6_addr *dst, uint8_t hop_limit);
+/* Hop-by-hop (0), routing (43) or destination options (60) header.
+ * `data` is the body after the next-header/length bytes; it is padded to 8 bytes. */
+int pkt_ipv6_ext(struct pkt_builder *b, uint8_t type, const void *data, size_t len);
+
+struct tcphdr *pkt_tcp(struct pkt_builder *b, uint16_t sport, uint16_t dport,
+                       uint32_t seq, uint32_t ack, uint8_t flags, uint16_t window);
+int pkt_tcp_option(struct pkt_builder *b, uint8_t kind, const void *data, size_t len);
+int pkt_tcp_mss(struct pkt_builder *b, uint16_t mss);
+int pkt_tcp_wscale(struct pkt_builder *b, uint8_t shift);
+int pkt_tcp_sack_perm(struct pkt_builder *b);
+int pkt_tcp_timestamp(struct pkt_builder *b, uint32_t tsval, uint32_t tsecr);
+
+struct udphdr *pkt_udp(struct pkt_builder *b, uint16_t sport, uint16_t dport);
+
+/* ICMP over IPv4 (or with no IP layer, for kernel-built IP headers) */
+struct icmphdr *pkt_icmp(struct pkt_builder *b, uint8_t type, uint8_t code);
+struct icmp6_hdr *pkt_icmp6(struct pkt_builder *b, uint8_t type, uint8_t code);
+
+/* Append payload bytes; `data` may be NULL to reserve zeroed space. */
+void *pkt_payload(struct pkt_builder *b, const void *data, size_t len);
+
+/* Fill in lengths and checksums. If `t` is not NULL it is initialized as a
+ * template for incremental updates. Returns the packet length, 0 on error. */
+size_t pkt_finalize(struct pkt_builder *b, struct pkt_template *t);
+
+#endif
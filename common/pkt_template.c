@@ -0,0 +1,200 @@
+#include <string.h>
+#include <arpa/inet.h>
+#include "checksum.h"
+#include "pkt_template.h"
+
+static uint16_t load16(const uint8_t *p) {
+    uint16_t v;
+    memcpy(&v, p, 2);
+    return v;
+}
+
+static void store16(uint8_t *p, uint16_t v) {
+    memcpy(p, &v, 2);
+}
+
+static uint32_t load32(const uint8_t *p) {
+    uint32_t v;
+    memcpy(&v, p, 4);
+    return v;
+}
+
+// TCP, UDP and ICMPv6 checksums cover the IP addresses through the pseudo-header
+static int l4_has_pseudo(const struct pkt_template *t) {
+    return t->proto != IPPROTO_ICMP;
+}
+
+// A zero UDP checksum over IPv4 means "not computed" and must stay zero
+static int l4_active(const struct pkt_template *t) {
+    if (t->l4_check == NULL) return 0;
+    if (t->proto == IPPROTO_UDP && t->version == 4 && load16(t->l4_check) == 0) return 0;
+    return 1;
+}
+
+static void store_l4_check(struct pkt_template *t, uint16_t check) {
+    if (t->proto == IPPROTO_UDP && check == 0) check = 0xffff;
+    store16(t->l4_check, check);
+}
+
+/* Rewrite a 16-bit field and patch whichever checksums cover it. */
+static void patch16(struct pkt_template *t, uint8_t *field, uint16_t to, int in_ip, int in_l4) {
+    uint16_t from = load16(field);
+    if (from == to) return;
+    if (in_ip && t->ip_check)
+        store16(t->ip_check, csum_replace2(load16(t->ip_check), from, to));
+    if (in_l4 && l4_active(t))
+        store_l4_check(t, csum_replace2(load16(t->l4_check), from, to));
+    store16(field, to);
+}
+
+static void patch32(struct pkt_template *t, uint8_t *field, uint32_t to, int in_ip, int in_l4) {
+    uint32_t from = load32(field);
+    if (from == to) return;
+    if (in_ip && t->ip_check)
+        store16(t->ip_check, csum_replace4(load16(t->ip_check), from, to));
+    if (in_l4 && l4_active(t))
+        store_l4_check(t, csum_replace4(load16(t->l4_check), from, to));
+    memcpy(field, &to, 4);
+}
+
+int tmpl_init(struct pkt_template *t, uint8_t *buf, size_t len) {
+    size_t off;
+    uint8_t proto;
+
+    memset(t, 0, sizeof(*t));
+    if (len < 20) return -1;
+    t->buf = buf;
+    t->len = len;
+    t->version = buf[0] >> 4;
+
+    if (t->version == 4) {
+        off = (buf[0] & 0x0f) * 4;
+        proto = buf[9];
+        t->ip_check = buf + 10;
+    } else if (t->version == 6) {
+        if (len < 40) return -1;
+        off = 40;
+        proto = buf[6];
+        // Skip hop-by-hop, routing, fragment and destination options headers
+        while (proto == 0 || proto == 43 || proto == 44 || proto == 60) {
+            if (off + 8 > len) return -1;
+            uint8_t next = buf[off];
+            off += proto == 44 ? 8 : (size_t)(buf[off + 1] + 1) * 8;
+            proto = next;
+        }
+    } else {
+        return -1;
+    }
+
+    t->l4_off = off;
+    t->proto = proto;
+    switch (proto) {
+    case IPPROTO_TCP:
+        if (off + 20 > len) return -1;
+        t->l4_check = buf + off + 16;
+        break;
+    case IPPROTO_UDP:
+        if (off + 8 > len) return -1;
+        t->l4_check = buf + off + 6;
+        break;
+    case IPPROTO_ICMP:
+    case IPPROTO_ICMPV6:
+        if (off + 8 > len) return -1;
+        t->l4_check = buf + off + 2;
+        break;
+    default:
+        return -1;
+    }
+    return 0;
+}
+
+void tmpl_finalize(struct pkt_template *t) {
+    uint8_t *buf = t->buf;
+    size_t l4_len = t->len - t->l4_off;
+    uint64_t sum = 0;
+
+    if (t->version == 4) {
+        store16(t->ip_check, 0);
+        store16(t->ip_check, inet_checksum(buf, (buf[0] & 0x0f) * 4));
+    }
+
+    if (l4_has_pseudo(t)) {
+        if (t->version == 4) {
+            sum = csum_partial(buf + 12, 8, 0);
+            sum += htons(t->proto) + htons((uint16_t)l4_len);
+        } else {
+            sum = csum_partial(buf + 8, 32, 0);
+            sum += htons((uint16_t)(l4_len >> 16)) + htons((uint16_t)l4_len) + htons(t->proto);
+        }
+    }
+
+    store16(t->l4_check, 0);
+    store_l4_check(t, (uint16_t)~csum_fold(csum_partial(buf + t->l4_off, l4_len, sum)));
+}
+
+void tmpl_set_saddr(struct pkt_template *t, in_addr_t addr) {
+    if (t->version == 4) patch32(t, t->buf + 12, addr, 1, l4_has_pseudo(t));
+}
+
+void tmpl_set_daddr(struct pkt_template *t, in_addr_t addr) {
+    if (t->version == 4) patch32(t, t->buf + 16, addr, 1, l4_has_pseudo(t));
+}
+
+// IPv6 addresses are patched as four 32-bit words; only the L4 checksum covers them
+static void set_addr6(struct pkt_template *t, uint8_t *field, const struct in6_addr *addr) {
+    uint32_t word;
+    for (int i = 0; i < 4; i++) {
+        memcpy(&word, addr->s6_addr + 4 * i, 4);
+        patch32(t, field + 4 * i, word, 0, 1);
+    }
+}
+
+void tmpl_set_saddr6(struct pkt_template *t, const struct in6_addr *addr) {
+    if (t->version == 6) set_addr6(t, t->buf + 8, addr);
+}
+
+void tmpl_set_daddr6(struct pkt_template *t, const struct in6_addr *addr) {
+    if (t->version == 6) set_addr6(t, t->buf + 24, addr);
+}
+
+void tmpl_set_ip_id(struct pkt_template *t, uint16_t id) {
+    if (t->version == 4) patch16(t, t->buf + 4, htons(id), 1, 0);
+}
+
+void tmpl_set_ttl(struct pkt_template *t, uint8_t ttl) {
+    if (t->version == 6) {
+        t->buf[7] = ttl;
+        return;
+    }
+    // TTL shares a checksum word with the protocol byte
+    uint8_t word[2] = {ttl, t->buf[9]};
+    patch16(t, t->buf + 8, load16(word), 1, 0);
+}
+
+void tmpl_set_sport(struct pkt_template *t, uint16_t port) {
+    if (t->proto == IPPROTO_TCP || t->proto == IPPROTO_UDP)
+        patch16(t, t->buf + t->l4_off, htons(port), 0, 1);
+}
+
+void tmpl_set_dport(struct pkt_template *t, uint16_t port) {
+    if (t->proto == IPPROTO_TCP || t->proto == IPPROTO_UDP)
+        patch16(t, t->buf + t->l4_off + 2, htons(port), 0, 1);
+}
+
+void tmpl_set_tcp_seq(struct pkt_template *t, uint32_t seq) {
+    if (t->proto == IPPROTO_TCP) patch32(t, t->buf + t->l4_off + 4, htonl(seq), 0, 1);
+}
+
+void tmpl_set_tcp_ack(struct pkt_template *t, uint32_t ack) {
+    if (t->proto == IPPROTO_TCP) patch32(t, t->buf + t->l4_off + 8, htonl(ack), 0, 1);
+}
+
+void tmpl_set_icmp_id(struct pkt_template *t, uint16_t id) {
+    if (t->proto == IPPROTO_ICMP || t->proto == IPPROTO_ICMPV6)
+        patch16(t, t->buf + t->l4_off + 4, htons(id), 0, 1);
+}
+
+void tmpl_set_icmp_seq(struct pkt_template *t, uint16_t seq) {
+    if (t->proto == IPPROTO_ICMP || t->proto == IPPROTO_ICMPV6)
+        patch16(t, t->buf + t->l4_off + 6, htons(seq), 0, 1);
+}
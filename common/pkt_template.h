@@ -0,0 +1,49 @@
+#ifndef PKT_TEMPLATE_H
+#define PKT_TEMPLATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+/**
+ * Packet template: a fully built IPv4/IPv6 + TCP/UDP/ICMP packet whose
+ * individual fields are then rewritten in place. Every setter patches the
+ * IP header checksum and the L4 checksum with RFC 1624 incremental updates,
+ * so producing the next packet costs a few instructions instead of a full
+ * rescan of the pseudo-header and payload.
+ *
+ * Ports, ids and sequence numbers are passed in host byte order; addresses
+ * are passed in network byte order (as returned by inet_addr / inet_pton).
+ */
+struct pkt_template {
+    uint8_t *buf;          // start of the IP header
+    size_t len;            // total packet length
+    size_t l4_off;         // offset of the TCP/UDP/ICMP header
+    uint8_t version;       // 4 or 6
+    uint8_t proto;         // IPPROTO_TCP, IPPROTO_UDP, IPPROTO_ICMP, IPPROTO_ICMPV6
+    uint8_t *ip_check;     // IPv4 header checksum field, NULL for IPv6
+    uint8_t *l4_check;     // L4 checksum field, NULL if the protocol has none
+};
+
+/* Locate the headers of an already assembled packet in `buf`.
+ * Returns 0 on success, -1 if the packet is not IPv4/IPv6 + TCP/UDP/ICMP. */
+int tmpl_init(struct pkt_template *t, uint8_t *buf, size_t len);
+
+/* Compute the IP and L4 checksums from scratch (once, after tmpl_init). */
+void tmpl_finalize(struct pkt_template *t);
+
+void tmpl_set_saddr(struct pkt_template *t, in_addr_t addr);
+void tmpl_set_daddr(struct pkt_template *t, in_addr_t addr);
+void tmpl_set_saddr6(struct pkt_template *t, const struct in6_addr *addr);
+void tmpl_set_daddr6(struct pkt_template *t, const struct in6_addr *addr);
+void tmpl_set_ip_id(struct pkt_template *t, uint16_t id);
+void tmpl_set_ttl(struct pkt_template *t, uint8_t ttl);
+
+void tmpl_set_sport(struct pkt_template *t, uint16_t port);
+void tmpl_set_dport(struct pkt_template *t, uint16_t port);
+void tmpl_set_tcp_seq(struct pkt_template *t, uint32_t seq);
+void tmpl_set_tcp_ack(struct pkt_template *t, uint32_t ack);
+void tmpl_set_icmp_id(struct pkt_template *t, uint16_t id);
+void tmpl_set_icmp_seq(struct pkt_template *t, uint16_t seq);
+
+#endif
@@ -0,0 +1,34 @@
+#include "simutil.h"
+
+#include <time.h>
+
+static uint64_t rng_state = 1;
+
+void sim_seed(uint64_t seed) {
+    rng_state = seed + 0x9e3779b97f4a7c15ull;
+    rng_state = (rng_state ^ rng_state >> 30) * 0xbf58476d1ce4e5b9ull;
+    rng_state = (rng_state ^ rng_state >> 27) * 0x94d049bb133111ebull;
+    rng_state ^= rng_state >> 31;
+    if (rng_state == 0) rng_state = 1;
+}
+
+uint64_t sim_rand(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return rng_state * 2685821657736338717ull;
+}
+
+uint32_t sim_below(uint32_t n) {
+    return (uint32_t)(((sim_rand() >> 32) * n) >> 32);
+}
+
+double sim_uniform(void) {
+    return ((sim_rand() >> 11) + 0.5) / 9007199254740992.0;
+}
+
+double sim_wall_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
@@ -0,0 +1,33 @@
+#ifndef SIMUTIL_H
+#define SIMUTIL_H
+
+#include <stdint.h>
+
+/**
+ * Random numbers and wall-clock timing shared by the assignment 14 simulators.
+ *
+ * There is one xorshift64* stream per process. sim_seed() mixes the -S seed
+ * with splitmix64 so nearby seeds give unrelated streams, and the same seed
+ * gives the same flows, matrices and failures on every platform (unlike
+ * rand()). The stream is not thread-safe; the simulators draw from it on the
+ * main thread only.
+ *
+ *     sim_seed(seed);
+ *     uint32_t dst = sim_below(t.host_count);
+ */
+
+void sim_seed(uint64_t seed);
+
+/* Next 64 random bits. */
+uint64_t sim_rand(void);
+
+/* Uniform in [0, n), by multiply-shift instead of a modulo. */
+uint32_t sim_below(uint32_t n);
+
+/* Uniform in (0, 1), never exactly 0 or 1, so log() of it is finite. */
+double sim_uniform(void);
+
+/* Monotonic wall clock in seconds, for timing the solvers themselves. */
+double sim_wall_sec(void);
+
+#endif
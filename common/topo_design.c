@@ -0,0 +1,253 @@
+#include "topo_design.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_RADIX 4096
+#define EPS 1e-9
+
+/* Candidates with an open-addressing index by key: designs with the same
+ * switch-to-switch link count have the same bisection and port cost, so
+ * only the one with the fewest switches is kept. A single leaf is keyed
+ * apart, as its bisection does not depend on the links. */
+struct candidates {
+    struct topo_design *d;
+    size_t count, cap;
+    uint32_t *slot;            // index into d, UINT32_MAX if free
+    size_t slots;              // power of two
+};
+
+static uint64_t design_key(const struct topo_design *d) {
+    return (uint64_t)d->links << 1 | (d->tiers == 2 && d->leaves == 1);
+}
+
+static size_t slot_of(const struct candidates *c, uint64_t key) {
+    size_t mask = c->slots - 1, i = (size_t)((key * 0x9e3779b97f4a7c15ull) >> 20) & mask;
+    while (c->slot[i] != UINT32_MAX && design_key(&c->d[c->slot[i]]) != key) i = (i + 1) & mask;
+    return i;
+}
+
+static int grow_index(struct candidates *c) {
+    size_t slots = c->slots ? 2 * c->slots : 4096;
+    uint32_t *slot = malloc(slots * sizeof(*slot));
+    if (!slot) return -1;
+    free(c->slot);
+    c->slot = slot;
+    c->slots = slots;
+    memset(slot, 0xff, slots * sizeof(*slot));
+    for (size_t i = 0; i < c->count; i++) c->slot[slot_of(c, design_key(&c->d[i]))] = (uint32_t)i;
+    return 0;
+}
+
+static int push(struct candidates *c, const struct topo_design *d) {
+    if (2 * (c->count + 1) > c->slots && grow_index(c) < 0) return -1;
+    size_t i = slot_of(c, design_key(d));
+    if (c->slot[i] != UINT32_MAX) {
+        struct topo_design *old = &c->d[c->slot[i]];
+        if (d->switches < old->switches) *old = *d;
+        return 0;
+    }
+    if (c->count == c->cap) {
+        size_t cap = c->cap ? 2 * c->cap : 1024;
+        struct topo_design *grown = realloc(c->d, cap * sizeof(*grown));
+        if (!grown) return -1;
+        c->d = grown;
+        c->cap = cap;
+    }
+    c->slot[i] = (uint32_t)c->count;
+    c->d[c->count++] = *d;
+    return 0;
+}
+
+static void price(const struct topo_design_query *q, struct topo_design *d) {
+    d->cost = d->switches * q->switch_cost + (2 * (double)d->links + (double)q->hosts) * q->port_cost;
+}
+
+// Fewest spines (per pod) that keep h hosts per leaf within the oversubscription limit
+static int64_t min_spines(const struct topo_design_query *q, int64_t h, int64_t links_per_spine) {
+    if (q->max_oversubscription <= 0) return 1;
+    double need = h * q->host_gbps / (links_per_spine * q->fabric_gbps * q->max_oversubscription);
+    int64_t s = (int64_t)ceil(need - EPS);
+    return s < 1 ? 1 : s;
+}
+
+static int leaf_spine(const struct topo_design_query *q, int64_t ports, struct candidates *c) {
+    int64_t hosts = (int64_t)q->hosts;
+    double host_cap = hosts * q->host_gbps;
+
+    for (int64_t leaves = 1; leaves <= ports; leaves++) {
+        int64_t h = (hosts + leaves - 1) / leaves;
+        if (h > ports - 1) continue;
+        if ((leaves - 1) * h >= hosts) {
+            // A leaf would be empty; with one host per leaf, for good
+            if (h == 1) break;
+            continue;
+        }
+        int64_t max_k = q->max_parallel_links ? q->max_parallel_links : ports;
+        for (int64_t k = 1; k <= max_k && leaves * k <= ports && h + k <= ports; k++) {
+            for (int64_t s = min_spines(q, h, k); h + s * k <= ports; s++) {
+                double uplinks = (double)leaves * s * k * q->fabric_gbps;
+                struct topo_design d = {2, 1, (int)leaves, (int)s, 0, (int)h, (int)k, (int)(leaves + s),
+                                        leaves * s * k, 0, 0, h * q->host_gbps / (s * k * q->fabric_gbps)};
+                d.bisection_gbps = (leaves == 1 ? host_cap : fmin(host_cap, uplinks)) / 2;
+                price(q, &d);
+                if (push(c, &d) < 0) return -1;
+                if (leaves == 1 || uplinks >= host_cap - EPS) break;
+            }
+        }
+    }
+    return 0;
+}
+
+static int three_tier(const struct topo_design_query *q, int64_t ports, struct candidates *c) {
+    int64_t hosts = (int64_t)q->hosts;
+    double host_cap = hosts * q->host_gbps;
+
+    for (int64_t e = 1; 2 * e <= ports; e++) {
+        for (int64_t pods = 2; pods <= ports; pods++) {
+            int64_t h = (hosts + pods * e - 1) / (pods * e);
+            if (h > ports - 1) continue;
+            if ((pods - 1) * e * h >= hosts) {
+                // A pod would be empty
+                if (h == 1) break;
+                continue;
+            }
+            for (int64_t a = min_spines(q, h, 1); h + a <= ports; a++) {
+                double uplinks = (double)pods * e * a * q->fabric_gbps;
+                struct topo_design d = {3, (int)pods, (int)e, (int)a, (int)(a * e), (int)h, 1,
+                                        (int)(pods * (e + a) + a * e), 2 * pods * e * a, 0,
+                                        fmin(host_cap, uplinks) / 2, h * q->host_gbps / (a * q->fabric_gbps)};
+                price(q, &d);
+                if (push(c, &d) < 0) return -1;
+                if (uplinks >= host_cap - EPS) break;
+            }
+        }
+    }
+    return 0;
+}
+
+struct key {
+    double cost, bisection;
+    int switches;
+    uint32_t index;
+};
+
+static int by_cost(const void *x, const void *y) {
+    const struct key *a = x, *b = y;
+    if (a->cost != b->cost) return a->cost < b->cost ? -1 : 1;
+    if (a->bisection != b->bisection) return a->bisection > b->bisection ? -1 : 1;
+    return 0;
+}
+
+/* Counting sort by switch count, which is small, then by cost within
+ * each count. */
+static int sort_keys(const struct candidates *c, struct key *keys) {
+    int most = 0;
+    for (size_t i = 0; i < c->count; i++) {
+        if (c->d[i].switches > most) most = c->d[i].switches;
+    }
+    size_t *start = calloc((size_t)most + 2, sizeof(*start));
+    if (!start) return -1;
+    for (size_t i = 0; i < c->count; i++) start[c->d[i].switches + 1]++;
+    for (int s = 0; s <= most; s++) start[s + 1] += start[s];
+    for (size_t i = 0; i < c->count; i++) {
+        const struct topo_design *d = &c->d[i];
+        keys[start[d->switches]++] = (struct key){d->cost, d->bisection_gbps, d->switches, (uint32_t)i};
+    }
+    // start[s] now ends count s
+    for (int s = 0, from = 0; s <= most; from = (int)start[s++]) {
+        if (start[s] - from > 1) qsort(keys + from, start[s] - from, sizeof(*keys), by_cost);
+    }
+    free(start);
+    return 0;
+}
+
+/* Keeps the designs no other design beats or matches on all three counts.
+ * In switch order, a design survives if every design before it with no
+ * higher cost has less bisection. The survivors so far form a staircase of
+ * rising cost and rising bisection, so the test is one binary search for
+ * the last step at or below the cost. `keys` come in sorted by switches,
+ * then cost; the survivors' are left at the front. */
+static size_t pareto(struct key *keys, size_t n, double *step_cost, double *step_bisection) {
+    size_t steps = 0, kept = 0;
+
+    for (size_t i = 0; i < n; i++) {
+        double cost = keys[i].cost, bisection = keys[i].bisection;
+        size_t lo = 0, hi = steps;
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (step_cost[mid] <= cost) lo = mid + 1;
+            else hi = mid;
+        }
+        if (lo > 0 && step_bisection[lo - 1] >= bisection - EPS) continue;
+        keys[kept++] = keys[i];
+
+        // Drop the steps this design now covers: no cheaper and no more bisection
+        size_t end = lo;
+        while (end < steps && step_bisection[end] <= bisection) end++;
+        if (lo > 0 && step_cost[lo - 1] == cost) lo--;
+        memmove(step_cost + lo + 1, step_cost + end, (steps - end) * sizeof(*step_cost));
+        memmove(step_bisection + lo + 1, step_bisection + end, (steps - end) * sizeof(*step_bisection));
+        steps += lo + 1 - end;
+        step_cost[lo] = cost;
+        step_bisection[lo] = bisection;
+    }
+    return kept;
+}
+
+int topo_design_pareto(const struct topo_design_query *q, struct topo_design *out, int max_designs, char *err,
+                       size_t err_size) {
+    struct candidates c = {NULL, 0, 0, NULL, 0};
+    int64_t ports = (int64_t)q->radix - q->reserved_ports;
+
+    if (q->radix < 2 || q->radix > MAX_RADIX || q->reserved_ports < 0 || ports < 2) {
+        snprintf(err, err_size, "Radix must be 2..%d with at least two ports left after %d reserved", MAX_RADIX,
+                 q->reserved_ports);
+        return -1;
+    }
+    if (q->hosts < 1) {
+        snprintf(err, err_size, "Need at least one host");
+        return -1;
+    }
+    if (q->host_gbps <= 0 || q->fabric_gbps <= 0 || q->max_oversubscription < 0 || q->switch_cost < 0 ||
+        q->port_cost < 0 || q->max_tiers < 2 || q->max_tiers > 3 || q->max_parallel_links < 0 || max_designs < 0) {
+        snprintf(err, err_size, "Invalid link speeds, oversubscription, costs, tier count or link limit");
+        return -1;
+    }
+
+    // Beyond what three tiers of this radix can hold (and what int64 can count)
+    if (q->hosts > (uint64_t)ports * ports * ports) return 0;
+
+    int rc = leaf_spine(q, ports, &c);
+    if (rc == 0 && q->max_tiers >= 3) rc = three_tier(q, ports, &c);
+    struct key *keys = c.count ? malloc(c.count * sizeof(*keys)) : NULL;
+    double *step_cost = c.count ? malloc(c.count * sizeof(*step_cost)) : NULL;
+    double *step_bisection = c.count ? malloc(c.count * sizeof(*step_bisection)) : NULL;
+    free(c.slot);
+    if (rc < 0 || (c.count && (!keys || !step_cost || !step_bisection))) {
+        free(c.d);
+        free(keys);
+        free(step_cost);
+        free(step_bisection);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+
+    if (sort_keys(&c, keys) < 0) {
+        free(c.d);
+        free(keys);
+        free(step_cost);
+        free(step_bisection);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+    size_t n = pareto(keys, c.count, step_cost, step_bisection);
+    for (size_t i = 0; i < n && i < (size_t)max_designs; i++) out[i] = c.d[keys[i].index];
+    free(c.d);
+    free(keys);
+    free(step_cost);
+    free(step_bisection);
+    return (int)n;
+}
@@ -0,0 +1,81 @@
+#ifndef TOPO_DESIGN_H
+#define TOPO_DESIGN_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Fabric sizing: every leaf-spine and three-tier Clos design that connects
+ * a number of hosts with switches of a given radix, reduced to the Pareto
+ * set over (switch count, cost, bisection bandwidth).
+ *
+ * Two-tier designs are the fabric of assignment_14/leaf_spine_topology.py:
+ * L leaves of h hosts, each leaf with k parallel links to each of S spines.
+ * A leaf needs h + S * k ports and a spine L * k.
+ *
+ * Three-tier designs (the folded Clos of fat trees) join P pods, each a
+ * leaf-spine of E leaves and A spines with single links, through A * E
+ * super-spines: spine i of every pod has one link to each super-spine of
+ * group i. A leaf needs h + A ports, a spine E down and E up, a super-spine
+ * P. The k-ary fat tree is the case h = A = E = radix / 2, P = radix.
+ *
+ * Oversubscription (host capacity over uplink capacity) is limited at the
+ * leaves only; the tiers above are non-blocking, as is usual. Bisection
+ * bandwidth is the capacity out of half the hosts: the smaller of the
+ * hosts' own links and the leaf uplinks of half the leaves, each over two
+ * (the spines of a non-blocking three-tier design carry as much, and a
+ * single leaf switches everything itself). Cost is per switch plus per
+ * used switch port, host ports included.
+ *
+ * The search walks leaf counts (or pods and leaves per pod) with the fewest
+ * hosts per leaf that fit, so no leaf or pod is left empty, and for each
+ * raises the spine count from the oversubscription limit until the
+ * bisection reaches the host limit; designs past that point cost more for
+ * nothing. Bisection and port cost depend only on the number of links
+ * between switches, so of the designs with equal link counts only the one
+ * with the fewest switches is kept. The rest are sorted by switch count and
+ * filtered against a staircase of the best bisection per cost, which takes
+ * milliseconds up to radix 256.
+ *
+ *     struct topo_design_query q = TOPO_DESIGN_DEFAULTS;
+ *     struct topo_design d[256];
+ *     q.hosts = 4096;
+ *     q.radix = 64;
+ *     int n = topo_design_pareto(&q, d, 256, err, sizeof(err));
+ */
+
+struct topo_design_query {
+    uint64_t hosts;
+    int radix;
+    int reserved_ports;        // per switch, e.g. 1 for management as in leaf_spine_topology.py
+    double max_oversubscription;   // at the leaves; 0 for no limit
+    double host_gbps, fabric_gbps;
+    double switch_cost, port_cost;
+    int max_tiers;             // 2 for leaf-spine only, 3 to include pods under super-spines
+    int max_parallel_links;    // between a leaf and a spine; 0 for no limit
+};
+
+#define TOPO_DESIGN_DEFAULTS {0, 16, 1, 0, 1.0, 10.0, 10000, 300, 3, 0}
+
+struct topo_design {
+    int tiers;                 // 2 or 3
+    int pods;                  // 1 for two tiers
+    int leaves;                // per pod
+    int spines;                // per pod
+    int super_spines;          // 0 for two tiers
+    int hosts_per_leaf;
+    int links_per_spine;       // parallel links from each leaf to each spine
+    int switches;
+    int64_t links;             // between switches
+    double cost;
+    double bisection_gbps;
+    double oversubscription;
+};
+
+/* Writes up to `max_designs` Pareto-optimal designs to `out`, by switch
+ * count, and returns how many there are (0 if nothing fits the radix), or
+ * -1 with a message in `err` for an invalid query or if memory runs out. */
+int topo_design_pareto(const struct topo_design_query *q, struct topo_design *out, int max_designs, char *err,
+                       size_t err_size);
+
+#endif
@@ -0,0 +1,199 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "topo_design.h"
+
+/**
+ * Fabric sizing benchmark.
+ * First checks topo_design_pareto() against an exhaustive search for small
+ * radixes: every spine count, parallel link count and hosts-per-leaf value
+ * that fits, with the same port, oversubscription, no-empty-leaf and
+ * tier and link count rules,
+ * reduced to its Pareto set by comparing all pairs. The two sets must hold
+ * the same (switches, cost, bisection) points.
+ *
+ * The timings solve radix 32 to 256 for a range of host counts, with and
+ * without an oversubscription limit, and print the extreme points of each
+ * Pareto set.
+ *
+ * Build: gcc -O2 topo_design_bench.c topo_design.c -o topo_design_bench -lm
+ */
+
+#define MAX_DESIGNS 100000
+
+struct point {
+    int switches;
+    double cost, bisection;
+};
+
+static double now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static int cmp_point(const void *x, const void *y) {
+    const struct point *a = x, *b = y;
+    if (a->switches != b->switches) return a->switches < b->switches ? -1 : 1;
+    if (a->cost != b->cost) return a->cost < b->cost ? -1 : 1;
+    return a->bisection > b->bisection ? -1 : a->bisection < b->bisection;
+}
+
+static void add(struct point *p, size_t *n, const struct topo_design_query *q, int switches, int64_t links,
+                double uplinks, int single_leaf) {
+    double host_cap = q->hosts * q->host_gbps;
+    p[*n].switches = switches;
+    p[*n].cost = switches * q->switch_cost + (2.0 * links + q->hosts) * q->port_cost;
+    p[*n].bisection = (single_leaf ? host_cap : fmin(host_cap, uplinks)) / 2;
+    (*n)++;
+}
+
+static int fits(const struct topo_design_query *q, int64_t h, int64_t uplinks) {
+    return q->max_oversubscription <= 0 ||
+           h * q->host_gbps <= uplinks * q->fabric_gbps * q->max_oversubscription * (1 + 1e-9);
+}
+
+// Every design, then the pairwise Pareto filter
+static size_t exhaustive(const struct topo_design_query *q, struct point *p) {
+    int64_t ports = q->radix - q->reserved_ports, hosts = (int64_t)q->hosts;
+    size_t n = 0;
+
+    for (int64_t l = 1; l <= ports; l++) {
+        for (int64_t h = 1; h < ports; h++) {
+            if (l * h < hosts || (l - 1) * h >= hosts) continue;
+            for (int64_t k = 1; l * k <= ports && (!q->max_parallel_links || k <= q->max_parallel_links); k++) {
+                for (int64_t s = 1; h + s * k <= ports; s++) {
+                    if (fits(q, h, s * k)) add(p, &n, q, (int)(l + s), l * s * k, (double)l * s * k * q->fabric_gbps,
+                                               l == 1);
+                }
+            }
+        }
+    }
+    for (int64_t e = 1; 2 * e <= ports && q->max_tiers >= 3; e++) {
+        for (int64_t pods = 2; pods <= ports; pods++) {
+            for (int64_t h = 1; h < ports; h++) {
+                if (pods * e * h < hosts || (pods - 1) * e * h >= hosts) continue;
+                for (int64_t a = 1; h + a <= ports; a++) {
+                    if (fits(q, h, a)) add(p, &n, q, (int)(pods * (e + a) + a * e), 2 * pods * e * a,
+                                           (double)pods * e * a * q->fabric_gbps, 0);
+                }
+            }
+        }
+    }
+
+    size_t kept = 0;
+    for (size_t i = 0; i < n; i++) {
+        int beaten = 0;
+        for (size_t j = 0; j < n && !beaten; j++) {
+            if (p[j].switches > p[i].switches || p[j].cost > p[i].cost || p[j].bisection < p[i].bisection - 1e-9) {
+                continue;
+            }
+            // Equal points: only the first survives
+            int equal = p[j].switches == p[i].switches && p[j].cost == p[i].cost &&
+                        fabs(p[j].bisection - p[i].bisection) <= 1e-9;
+            beaten = !equal || j < i;
+        }
+        if (!beaten) p[kept++] = p[i];
+    }
+    qsort(p, kept, sizeof(*p), cmp_point);
+    return kept;
+}
+
+static int check(struct topo_design *d) {
+    struct point *want = malloc(4000000 * sizeof(*want)), *got = malloc(MAX_DESIGNS * sizeof(*got));
+    int failures = 0, cases = 0;
+    char err[128];
+
+    for (int radix = 4; radix <= 14; radix += 2) {
+        for (uint64_t hosts = 1; hosts <= 300; hosts += hosts < 20 ? 1 : 37) {
+            for (int limit = 0; limit < 4; limit++) {
+                struct topo_design_query q = TOPO_DESIGN_DEFAULTS;
+                q.radix = radix;
+                q.hosts = hosts;
+                q.max_oversubscription = limit == 0 ? 0 : limit == 1 ? 1 : 0.25;
+                q.fabric_gbps = limit == 2 ? 1 : 10;
+                q.port_cost = limit == 2 ? 3000 : 300;
+                // As leaf_spine_topology.py builds: two tiers, single links
+                if (limit == 3) {
+                    q.max_tiers = 2;
+                    q.max_parallel_links = 1;
+                }
+
+                int n = topo_design_pareto(&q, d, MAX_DESIGNS, err, sizeof(err));
+                size_t m = exhaustive(&q, want);
+                cases++;
+                if (n < 0) {
+                    printf("ERROR radix %d hosts %llu: %s\n", radix, (unsigned long long)hosts, err);
+                    failures++;
+                    continue;
+                }
+                for (int i = 0; i < n; i++) {
+                    got[i] = (struct point){d[i].switches, d[i].cost, d[i].bisection_gbps};
+                }
+                qsort(got, n, sizeof(*got), cmp_point);
+                int same = (size_t)n == m;
+                for (int i = 0; same && i < n; i++) {
+                    same = got[i].switches == want[i].switches && fabs(got[i].cost - want[i].cost) < 1e-6 &&
+                           fabs(got[i].bisection - want[i].bisection) < 1e-6;
+                }
+                if (!same && failures++ < 5) {
+                    printf("MISMATCH radix %d hosts %llu limit %d: %d designs, exhaustive search %zu\n", radix,
+                           (unsigned long long)hosts, limit, n, m);
+                }
+            }
+        }
+    }
+    printf("Exhaustive check: %d cases, %s\n", cases, failures ? "FAILED" : "same Pareto sets");
+    free(want);
+    free(got);
+    return failures;
+}
+
+static void bench(struct topo_design *d, int radix, uint64_t hosts, double oversub) {
+    struct topo_design_query q = TOPO_DESIGN_DEFAULTS;
+    char err[128];
+    int n = 0, runs = 0;
+
+    q.radix = radix;
+    q.hosts = hosts;
+    q.max_oversubscription = oversub;
+    double t0 = now_sec(), elapsed;
+    do {
+        n = topo_design_pareto(&q, d, MAX_DESIGNS, err, sizeof(err));
+        runs++;
+        elapsed = now_sec() - t0;
+    } while (n >= 0 && elapsed < 0.2);
+    if (n < 0) {
+        printf("radix %3d %8llu hosts: %s\n", radix, (unsigned long long)hosts, err);
+        return;
+    }
+    char limit[16] = "any";
+    if (oversub) snprintf(limit, sizeof(limit), "%g:1", oversub);
+    printf("radix %3d %8llu hosts, oversubscription %4s: %6.2f ms, %4d Pareto designs", radix,
+           (unsigned long long)hosts, limit, elapsed / runs * 1e3, n);
+    if (n) {
+        const struct topo_design *a = &d[0], *b = &d[n - 1];
+        printf(", %d to %d switches, %.0f to %.0f Gbit/s\n", a->switches, b->switches, a->bisection_gbps,
+               b->bisection_gbps);
+    } else {
+        printf("\n");
+    }
+}
+
+int main(void) {
+    struct topo_design *d = malloc(MAX_DESIGNS * sizeof(*d));
+
+    if (check(d)) return 1;
+    printf("\n");
+    uint64_t hosts[] = {1000, 20000, 500000};
+    for (int radix = 32; radix <= 256; radix *= 2) {
+        for (int i = 0; i < 3; i++) {
+            bench(d, radix, hosts[i], 0);
+            bench(d, radix, hosts[i], 3);
+        }
+    }
+    free(d);
+    return 0;
+}
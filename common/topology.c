@@ -0,0 +1,234 @@
+#include "topology.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// Link parameters of leaf_spine_topology.py (TCLink bw / delay)
+#define SPINE_LEAF_GBPS 10.0
+#define SPINE_LEAF_DELAY_MS 1.0
+#define HOST_LEAF_GBPS 1.0
+#define HOST_LEAF_DELAY_MS 0.5
+// topo.py uses plain links, which Mininet does not limit
+#define TREE_GBPS 1.0
+#define TREE_DELAY_MS 0.0
+
+static int reserve(struct topology *t, uint32_t nodes, uint32_t links) {
+    t->nodes = calloc(nodes, sizeof(*t->nodes));
+    t->links = calloc(links, sizeof(*t->links));
+    t->adj_start = calloc(nodes + 1, sizeof(*t->adj_start));
+    t->adj = malloc(2 * (size_t)links * sizeof(*t->adj));
+    return t->nodes && t->links && t->adj_start && t->adj ? 0 : -1;
+}
+
+static uint32_t add_node(struct topology *t, enum topo_role role, uint32_t index) {
+    struct topo_node *n = &t->nodes[t->node_count];
+    n->role = role;
+    n->index = index;
+    if (role == TOPO_HOST) t->host_count++;
+    return t->node_count++;
+}
+
+static void add_link(struct topology *t, uint32_t a, uint32_t b, double gbps, double delay_ms) {
+    t->links[t->link_count++] = (struct topo_link){a, b, gbps, delay_ms};
+}
+
+// Compressed neighbour rows, in link order within each node
+static void build_adjacency(struct topology *t) {
+    memset(t->adj_start, 0, (t->node_count + 1) * sizeof(*t->adj_start));
+    for (uint32_t l = 0; l < t->link_count; l++) {
+        t->adj_start[t->links[l].a + 1]++;
+        t->adj_start[t->links[l].b + 1]++;
+    }
+    for (uint32_t n = 0; n < t->node_count; n++) t->adj_start[n + 1] += t->adj_start[n];
+
+    uint32_t *fill = malloc((t->node_count ? t->node_count : 1) * sizeof(*fill));
+    memcpy(fill, t->adj_start, t->node_count * sizeof(*fill));
+    for (uint32_t l = 0; l < t->link_count; l++) {
+        const struct topo_link *k = &t->links[l];
+        t->adj[fill[k->a]++] = (struct topo_adj){k->b, 2 * l};
+        t->adj[fill[k->b]++] = (struct topo_adj){k->a, 2 * l + 1};
+    }
+    free(fill);
+}
+
+int topo_leaf_spine(struct topology *t, int spine_count, int leaf_count, int hosts_per_leaf, int switch_radix,
+                    char *err, size_t err_size) {
+    memset(t, 0, sizeof(*t));
+    if (spine_count < 1 || leaf_count < 1 || hosts_per_leaf < 0) {
+        snprintf(err, err_size, "need at least one spine and one leaf");
+        return -1;
+    }
+    // Each switch keeps one port for management
+    int leaf_ports_needed = spine_count + hosts_per_leaf + 1;
+    int spine_ports_needed = leaf_count + 1;
+    if (leaf_ports_needed > switch_radix) {
+        snprintf(err, err_size, "Leaf switches need %d ports but radix is %d", leaf_ports_needed, switch_radix);
+        return -1;
+    }
+    if (spine_ports_needed > switch_radix) {
+        snprintf(err, err_size, "Spine switches need %d ports but radix is %d", spine_ports_needed, switch_radix);
+        return -1;
+    }
+
+    uint32_t hosts = (uint32_t)leaf_count * hosts_per_leaf;
+    uint32_t nodes = spine_count + leaf_count + hosts;
+    uint32_t links = (uint32_t)spine_count * leaf_count + hosts;
+    if (reserve(t, nodes, links) < 0) {
+        topo_free(t);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+    t->spine_count = spine_count;
+    t->leaf_count = leaf_count;
+    t->hosts_per_leaf = hosts_per_leaf;
+    t->switch_radix = switch_radix;
+
+    // Same creation order as the Mininet script: spines, leaves, then hosts leaf by leaf
+    for (int s = 0; s < spine_count; s++) add_node(t, TOPO_SPINE, s);
+    for (int l = 0; l < leaf_count; l++) add_node(t, TOPO_LEAF, l);
+    for (int s = 0; s < spine_count; s++) {
+        for (int l = 0; l < leaf_count; l++) add_link(t, s, spine_count + l, SPINE_LEAF_GBPS, SPINE_LEAF_DELAY_MS);
+    }
+    for (int l = 0; l < leaf_count; l++) {
+        for (int h = 0; h < hosts_per_leaf; h++) {
+            uint32_t n = add_node(t, TOPO_HOST, (uint32_t)l * hosts_per_leaf + h);
+            // 10.0.<leaf>.<host>, carrying into the second octet past 255 leaves
+            t->nodes[n].addr = 10u << 24 | (uint32_t)(l + 1) << 8 | (uint32_t)(h + 1);
+            t->nodes[n].uplink = spine_count + l;
+            add_link(t, n, spine_count + l, HOST_LEAF_GBPS, HOST_LEAF_DELAY_MS);
+        }
+    }
+    build_adjacency(t);
+    return 0;
+}
+
+int topo_binary_tree(struct topology *t, int depth, int hosts_per_leaf, char *err, size_t err_size) {
+    memset(t, 0, sizeof(*t));
+    if (depth < 1 || depth > 24 || hosts_per_leaf < 0) {
+        snprintf(err, err_size, "tree depth must be between 1 and 24");
+        return -1;
+    }
+    uint32_t switches = (1u << depth) - 1;
+    uint32_t bottom = 1u << (depth - 1), first_bottom = bottom - 1;
+    uint32_t hosts = hosts_per_leaf ? bottom * hosts_per_leaf : (bottom > 1 ? 2 : 1);
+    if (reserve(t, switches + hosts, switches - 1 + hosts) < 0) {
+        topo_free(t);
+        snprintf(err, err_size, "out of memory");
+        return -1;
+    }
+
+    // Same creation order as topo.py: switches, links top-down, then hosts
+    for (uint32_t s = 0; s < switches; s++) add_node(t, TOPO_SWITCH, s);
+    for (uint32_t s = 0; s < first_bottom; s++) {
+        add_link(t, s, 2 * s + 1, TREE_GBPS, TREE_DELAY_MS);
+        add_link(t, s, 2 * s + 2, TREE_GBPS, TREE_DELAY_MS);
+    }
+    for (uint32_t h = 0; h < hosts; h++) {
+        uint32_t sw;
+        if (hosts_per_leaf) sw = first_bottom + h / hosts_per_leaf;
+        else sw = h ? switches - 1 : first_bottom;
+        uint32_t n = add_node(t, TOPO_HOST, h);
+        t->nodes[n].addr = (10u << 24) + h + 1;
+        t->nodes[n].uplink = sw;
+        add_link(t, n, sw, TREE_GBPS, TREE_DELAY_MS);
+    }
+    build_adjacency(t);
+    return 0;
+}
+
+void topo_node_name(const struct topology *t, uint32_t node, char *buf, size_t size) {
+    static const char *prefix[] = {"h", "leaf", "spine", "s"};
+    const struct topo_node *n = &t->nodes[node];
+    snprintf(buf, size, "%s%u", prefix[n->role], n->index + 1);
+}
+
+void topo_free(struct topology *t) {
+    free(t->nodes);
+    free(t->links);
+    free(t->adj_start);
+    free(t->adj);
+    memset(t, 0, sizeof(*t));
+}
+
+int topo_router_init(struct topo_router *r, const struct topology *t) {
+    memset(r, 0, sizeof(*r));
+    r->t = t;
+    r->target = UINT32_MAX;
+    r->dist = malloc(t->node_count * sizeof(*r->dist));
+    r->queue = malloc(t->node_count * sizeof(*r->queue));
+    r->group_start = malloc(t->node_count * sizeof(*r->group_start));
+    r->group_len = malloc(t->node_count * sizeof(*r->group_len));
+    r->stamp = calloc(t->node_count, sizeof(*r->stamp));
+    r->ports = malloc((2 * (size_t)t->link_count + 1) * sizeof(*r->ports));
+    if (!r->dist || !r->queue || !r->group_start || !r->group_len || !r->stamp || !r->ports) {
+        topo_router_free(r);
+        return -1;
+    }
+    return 0;
+}
+
+void topo_router_target(struct topo_router *r, uint32_t dst) {
+    const struct topology *t = r->t;
+    uint32_t head = 0, tail = 0;
+
+    for (uint32_t n = 0; n < t->node_count; n++) r->dist[n] = UINT32_MAX;
+    r->dist[dst] = 0;
+    r->queue[tail++] = dst;
+    while (head < tail) {
+        uint32_t n = r->queue[head++];
+        for (uint32_t a = t->adj_start[n]; a < t->adj_start[n + 1]; a++) {
+            uint32_t m = t->adj[a].node;
+            if (t->nodes[m].role == TOPO_HOST || r->dist[m] != UINT32_MAX) continue;
+            r->dist[m] = r->dist[n] + 1;
+            r->queue[tail++] = m;
+        }
+    }
+    r->target = dst;
+    r->epoch++;
+    r->used = 0;
+}
+
+const uint32_t *topo_router_group(struct topo_router *r, uint32_t n, uint32_t *len) {
+    const struct topology *t = r->t;
+    if (r->stamp[n] != r->epoch) {
+        r->stamp[n] = r->epoch;
+        r->group_start[n] = r->used;
+        for (uint32_t a = t->adj_start[n]; a < t->adj_start[n + 1]; a++) {
+            uint32_t m = t->adj[a].node;
+            if (t->nodes[m].role == TOPO_HOST || r->dist[m] == UINT32_MAX) continue;
+            if (r->dist[m] + 1 == r->dist[n]) r->ports[r->used++] = t->adj[a].port;
+        }
+        r->group_len[n] = r->used - r->group_start[n];
+    }
+    *len = r->group_len[n];
+    return r->ports + r->group_start[n];
+}
+
+int topo_route(struct topo_router *r, uint32_t src, uint32_t dst, uint32_t hash, uint32_t *ports, int max_ports) {
+    const struct topology *t = r->t;
+    uint32_t n = t->nodes[src].uplink, last = t->nodes[dst].uplink;
+    int hops = 0;
+
+    if (r->target != last) topo_router_target(r, last);
+    if (r->dist[n] == UINT32_MAX || (int)r->dist[n] + 2 > max_ports) return -1;
+    ports[hops++] = topo_host_uplink(t, src);
+    while (n != last) {
+        uint32_t len;
+        const uint32_t *group = topo_router_group(r, n, &len);
+        ports[hops] = group[hash % len];
+        n = topo_port_to(t, ports[hops++]);
+    }
+    ports[hops++] = topo_host_downlink(t, dst);
+    return hops;
+}
+
+void topo_router_free(struct topo_router *r) {
+    free(r->dist);
+    free(r->queue);
+    free(r->group_start);
+    free(r->group_len);
+    free(r->stamp);
+    free(r->ports);
+    memset(r, 0, sizeof(*r));
+}
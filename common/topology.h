@@ -0,0 +1,142 @@
+#ifndef TOPOLOGY_H
+#define TOPOLOGY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * In-memory network topologies for the native simulators and solvers.
+ *
+ * A topology is a list of nodes (hosts and switches) and bidirectional links
+ * with a capacity and a delay. Each direction of a link is a port:
+ * link l is port 2l from links[l].a to links[l].b and port 2l + 1 back,
+ * so per-direction loads and queues can live in flat arrays indexed by port.
+ * Neighbours are stored in compressed rows (adj_start / adj), built once
+ * when the topology is complete.
+ *
+ * topo_leaf_spine() builds the same fabric as LeafSpineTopology in
+ * assignment_14/leaf_spine_topology.py, with the same radix checks, names
+ * (spine1, leaf1, h1, ...) and host addresses (10.0.<leaf>.<host>), so
+ * results can be compared with the Mininet emulation at small sizes.
+ * topo_binary_tree() builds the BinaryTreeTopo of assignment_13/topo.py
+ * (s1 .. s7, h1 on s4 and h2 on s7) or deeper trees of the same shape.
+ *
+ * struct topo_router gives shortest-path ECMP next hops towards one
+ * destination switch at a time: a BFS over the switches, then the group of
+ * ports one hop closer for each switch the first time it is asked for.
+ *
+ *     struct topology t;
+ *     char err[128];
+ *     if (topo_leaf_spine(&t, 4, 8, 16, 32, err, sizeof(err)) < 0) fprintf(stderr, "%s\n", err);
+ */
+
+enum topo_role { TOPO_HOST, TOPO_LEAF, TOPO_SPINE, TOPO_SWITCH };
+
+struct topo_node {
+    uint8_t role;              // enum topo_role
+    uint32_t index;            // position among the nodes of that role, from 0
+    uint32_t addr;             // hosts: IPv4 address in host byte order; switches: 0
+    uint32_t uplink;           // hosts: the switch they are attached to
+};
+
+struct topo_link {
+    uint32_t a, b;             // node numbers
+    double gbps;               // capacity in each direction
+    double delay_ms;
+};
+
+struct topo_adj {
+    uint32_t node;             // neighbour
+    uint32_t port;             // directed link towards it
+};
+
+struct topology {
+    struct topo_node *nodes;
+    uint32_t node_count;
+    uint32_t host_count;
+    struct topo_link *links;
+    uint32_t link_count;
+    uint32_t *adj_start;       // node_count + 1 entries
+    struct topo_adj *adj;      // 2 * link_count entries
+
+    // Parameters of topo_leaf_spine(), 0 for other shapes
+    int spine_count, leaf_count, hosts_per_leaf, switch_radix;
+};
+
+struct topo_router {
+    const struct topology *t;
+    uint32_t target;
+    uint32_t *dist;            // hops to the target, UINT32_MAX if unreachable
+    uint32_t *queue;
+    uint32_t *group_start;     // into ports[]
+    uint32_t *group_len;
+    uint32_t *stamp;           // the group of node n is valid when stamp[n] == epoch
+    uint32_t *ports;
+    uint32_t used;
+    uint32_t epoch;
+};
+
+static inline uint32_t topo_port_from(const struct topology *t, uint32_t port) {
+    const struct topo_link *l = &t->links[port >> 1];
+    return port & 1 ? l->b : l->a;
+}
+
+static inline uint32_t topo_port_to(const struct topology *t, uint32_t port) {
+    const struct topo_link *l = &t->links[port >> 1];
+    return port & 1 ? l->a : l->b;
+}
+
+/* Leaf-spine fabric: every leaf connects to every spine (10 Gbit/s, 1 ms)
+ * and hosts_per_leaf hosts hang off each leaf (1 Gbit/s, 0.5 ms). A leaf
+ * needs spine_count + hosts_per_leaf ports and a spine leaf_count, each plus
+ * one management port, within switch_radix. Returns -1 with a message in
+ * `err` if the fabric does not fit or memory runs out. */
+int topo_leaf_spine(struct topology *t, int spine_count, int leaf_count, int hosts_per_leaf, int switch_radix,
+                    char *err, size_t err_size);
+
+/* Binary tree of switches s1 .. s(2^depth - 1) in heap order (s1 is the
+ * root, the children of s(i) are s(2i) and s(2i + 1)), with hosts_per_leaf
+ * hosts on every bottom switch. hosts_per_leaf 0 gives the topo.py layout
+ * instead: h1 on the leftmost and h2 on the rightmost bottom switch. Hosts
+ * get Mininet's sequential addresses (10.0.0.1, ...). topo.py uses plain
+ * links without limits, so every link is taken as 1 Gbit/s with no delay. */
+int topo_binary_tree(struct topology *t, int depth, int hosts_per_leaf, char *err, size_t err_size);
+
+/* Name as in the Mininet scripts: spine1, leaf1, s1, h1 (numbered from 1). */
+void topo_node_name(const struct topology *t, uint32_t node, char *buf, size_t size);
+
+void topo_free(struct topology *t);
+
+/* Node number of host `i` (from 0): both builders add the hosts last. */
+static inline uint32_t topo_host_node(const struct topology *t, uint32_t i) {
+    return t->node_count - t->host_count + i;
+}
+
+/* Host's port into the network and the port delivering to it. */
+static inline uint32_t topo_host_uplink(const struct topology *t, uint32_t host) {
+    return t->adj[t->adj_start[host]].port;
+}
+
+static inline uint32_t topo_host_downlink(const struct topology *t, uint32_t host) {
+    return t->adj[t->adj_start[host]].port ^ 1;
+}
+
+int topo_router_init(struct topo_router *r, const struct topology *t);
+
+/* Hop counts from every switch to the switch `dst`; hosts are never transit
+ * nodes. Invalidates the groups of the previous target. */
+void topo_router_target(struct topo_router *r, uint32_t dst);
+
+/* Ports of switch `n` that lead one hop closer to the current target
+ * (none at the target itself or when it is unreachable). */
+const uint32_t *topo_router_group(struct topo_router *r, uint32_t n, uint32_t *len);
+
+/* Path from host `src` to host `dst` as ports, every switch picking
+ * group[hash % size] (retargets the router when dst is on another switch).
+ * Returns the number of ports, or -1 if dst is unreachable or the path is
+ * longer than max_ports. */
+int topo_route(struct topo_router *r, uint32_t src, uint32_t dst, uint32_t hash, uint32_t *ports, int max_ports);
+
+void topo_router_free(struct topo_router *r);
+
+#endif